@@ -0,0 +1,54 @@
+#include "protocol.h"
+
+static void put_uint32(unsigned char* dst, const uint32_t value) {
+	
+	dst[0] = (unsigned char) (value >> 24);
+	dst[1] = (unsigned char) (value >> 16);
+	dst[2] = (unsigned char) (value >> 8);
+	dst[3] = (unsigned char) value;
+	
+}
+
+static uint32_t get_uint32(const unsigned char* const src) {
+	
+	return ((uint32_t) src[0] << 24) | ((uint32_t) src[1] << 16) | ((uint32_t) src[2] << 8) | (uint32_t) src[3];
+	
+}
+
+void protocol_request_encode(const struct ProtocolRequest* const request, unsigned char* dst) {
+	
+	put_uint32(dst, request->id);
+	
+	dst[4] = request->operation;
+	dst[5] = 0;
+	dst[6] = (unsigned char) (request->options >> 8);
+	dst[7] = (unsigned char) request->options;
+	
+	put_uint32(dst + 8, request->size);
+	
+}
+
+void protocol_request_decode(const unsigned char* const src, struct ProtocolRequest* request) {
+	
+	request->id = get_uint32(src);
+	request->operation = src[4];
+	request->options = (uint16_t) ((src[6] << 8) | src[7]);
+	request->size = get_uint32(src + 8);
+	
+}
+
+void protocol_response_encode(const struct ProtocolResponse* const response, unsigned char* dst) {
+	
+	put_uint32(dst, response->id);
+	put_uint32(dst + 4, (uint32_t) response->code);
+	put_uint32(dst + 8, response->size);
+	
+}
+
+void protocol_response_decode(const unsigned char* const src, struct ProtocolResponse* response) {
+	
+	response->id = get_uint32(src);
+	response->code = (int32_t) get_uint32(src + 4);
+	response->size = get_uint32(src + 8);
+	
+}
@@ -0,0 +1,47 @@
+#ifndef PROTOCOL_H_INCLUDED
+#define PROTOCOL_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+The unalixd wire protocol. Clients send any number of requests without waiting for the responses
+(pipelining); each response carries the ID of its request, and responses may arrive in a different
+order than the requests were sent.
+
+Request:  id (u32) | operation (u8) | reserved (u8) | options (u16) | size (u32) | URL (size bytes)
+Response: id (u32) | code (i32) | size (u32) | URL (size bytes, empty unless code is 0)
+
+Integers are big-endian. URLs are not NUL-terminated.
+*/
+
+#define PROTOCOL_HEADER_SIZE 12
+
+// Requests with larger URLs are a protocol violation, and get the connection closed
+static const uint32_t PROTOCOL_MAX_URL_SIZE = 64 * 1024;
+
+enum ProtocolOperation {
+	PROTOCOL_OPERATION_CLEAN = 1,
+	PROTOCOL_OPERATION_UNSHORT = 2
+};
+
+struct ProtocolRequest {
+	uint32_t id;
+	uint8_t operation;
+	uint16_t options; // UNALIXD_* flags from unalixd_client.h
+	uint32_t size;
+};
+
+struct ProtocolResponse {
+	uint32_t id;
+	int32_t code;
+	uint32_t size;
+};
+
+void protocol_request_encode(const struct ProtocolRequest* const request, unsigned char* dst);
+void protocol_request_decode(const unsigned char* const src, struct ProtocolRequest* request);
+
+void protocol_response_encode(const struct ProtocolResponse* const response, unsigned char* dst);
+void protocol_response_decode(const unsigned char* const src, struct ProtocolResponse* response);
+
+#endif
@@ -0,0 +1,814 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "unalix.h"
+#include "errors.h"
+#include "threads.h"
+#include "worker_pool.h"
+#include "protocol.h"
+#include "unalixd_client.h"
+
+/*
+unalixd loads the ruleset once and cleans or unshortens URLs for any number of local clients,
+over a Unix domain socket (see protocol.h). Every client shares the same ruleset, connection pools,
+DNS and URL caches.
+
+Each connection has a thread of its own, which turns everything the client has sent so far into tasks
+for worker threads: clean requests are grouped into batches, whose responses are queued together,
+while each unshort request runs on its own. The connection thread writes the queued responses out
+and stops reading from clients that do not read them, so workers never wait on a client. Unshort
+requests have a pool of their own, so that slow redirect chains never hold clean batches back.
+
+The ruleset is reloaded on SIGHUP and whenever the file changes. A reload does not wait for anything:
+every request keeps using the ruleset it started with, and the previous one is freed once the last
+of them is done. The current ruleset is kept if the new one cannot be loaded.
+*/
+
+static const char USAGE[] =
+	"usage: unalixd -r <rulesets> -s <socket> [-t <threads>] [-u <threads>] [-T <timeout>] [-c <url cache>] [-n]\n"
+	"\n"
+	"  -r  ClearURLs ruleset file to load\n"
+	"  -s  path of the Unix domain socket to listen on\n"
+	"  -t  maximum number of worker threads for clean requests (default: 4)\n"
+	"  -u  maximum number of worker threads for unshort requests (default: 16)\n"
+	"  -T  timeout for unshort requests, in seconds\n"
+	"  -c  persistent URL cache file for unshort requests\n"
+	"  -n  do not watch the ruleset file for changes (SIGHUP still reloads it)\n";
+
+static const size_t UNALIXD_DEFAULT_THREADS = 4;
+
+// Unshort requests spend most of their time waiting on the network
+static const size_t UNALIXD_DEFAULT_UNSHORT_THREADS = 16;
+
+// How often (in milliseconds) the ruleset file is checked for changes
+static const int UNALIXD_WATCH_INTERVAL = 1000;
+
+// Clean requests answered together in a single task
+static const size_t UNALIXD_MAX_BATCH = 64;
+
+// Requests a single connection may have in flight before its reader stops reading
+static const size_t UNALIXD_MAX_PENDING = 256;
+
+// Bytes of responses a connection may have queued before its reader stops reading
+static const size_t UNALIXD_MAX_QUEUED = 256 * 1024;
+
+static const size_t UNALIXD_READ_SIZE = 16 * 1024;
+
+struct ResponseBuffer {
+	unsigned char* content;
+	size_t size;
+	size_t capacity;
+};
+
+struct Connection {
+	int fd;
+	int wakeup[2]; // Pipe the workers write to once they have queued responses
+	struct Mutex mutex;
+	size_t references;
+	size_t pending; // Requests submitted whose responses are not queued yet
+	struct ResponseBuffer queued; // Responses not written to the socket yet
+};
+
+struct Request {
+	uint32_t id;
+	uint8_t operation;
+	uint16_t options;
+	char* url;
+};
+
+struct Batch {
+	struct WorkerTask task;
+	struct Connection* connection;
+	size_t total_requests;
+	struct Request requests[];
+};
+
+struct FileState {
+	time_t modified;
+	off_t size;
+	ino_t inode;
+};
+
+static struct WorkerPool clean_pool = WORKER_POOL_INITIALIZER;
+static struct WorkerPool unshort_pool = WORKER_POOL_INITIALIZER;
+
+static int unshort_timeout = 0;
+
+static volatile sig_atomic_t reload_requested = 0;
+static volatile sig_atomic_t stop_requested = 0;
+
+static int reload(const char* const filename) {
+	
+	const int code = unalix_reload_file(filename);
+	
+	if (code == UNALIXERR_SUCCESS) {
+		fprintf(stderr, "unalixd: reloaded %s\n", filename);
+	} else {
+		fprintf(stderr, "unalixd: cannot reload %s: %s\n", filename, unalix_strerror(code));
+	}
+	
+	return code;
+	
+}
+
+static void connection_release(struct Connection* connection) {
+	
+	mutex_lock(&connection->mutex);
+	const size_t references = --connection->references;
+	mutex_unlock(&connection->mutex);
+	
+	if (references > 0) {
+		return;
+	}
+	
+	close(connection->fd);
+	close(connection->wakeup[0]);
+	close(connection->wakeup[1]);
+	
+	free(connection->queued.content);
+	free(connection);
+	
+}
+
+static void connection_wake(struct Connection* connection) {
+	
+	const unsigned char byte = 0;
+	
+	// A full pipe means the reader has yet to wake up anyway
+	while (write(connection->wakeup[1], &byte, sizeof(byte)) == -1 && errno == EINTR) {}
+	
+}
+
+static int connection_flush(struct Connection* connection) {
+	/*
+	Writes as much of the queued responses as the socket takes without blocking.
+	*/
+	
+	int code = UNALIXERR_SUCCESS;
+	
+	mutex_lock(&connection->mutex);
+	
+	struct ResponseBuffer* const queued = &connection->queued;
+	size_t offset = 0;
+	
+	while (offset < queued->size) {
+		const ssize_t written = send(connection->fd, queued->content + offset, queued->size - offset, MSG_NOSIGNAL);
+		
+		if (written == -1 && errno == EINTR) {
+			continue;
+		}
+		
+		if (written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		}
+		
+		if (written < 1) {
+			code = UNALIXERR_SOCKET_SEND_FAILURE;
+			break;
+		}
+		
+		offset += (size_t) written;
+	}
+	
+	queued->size -= offset;
+	memmove(queued->content, queued->content + offset, queued->size);
+	
+	mutex_unlock(&connection->mutex);
+	
+	return code;
+	
+}
+
+static int buffer_reserve(struct ResponseBuffer* buffer, const size_t size) {
+	
+	if (buffer->size + size <= buffer->capacity) {
+		return UNALIXERR_SUCCESS;
+	}
+	
+	const size_t capacity = (buffer->capacity * 2 > buffer->size + size) ? buffer->capacity * 2 : buffer->size + size;
+	unsigned char* content = (unsigned char*) realloc(buffer->content, capacity);
+	
+	if (content == NULL) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	buffer->content = content;
+	buffer->capacity = capacity;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int response_append(struct ResponseBuffer* buffer, const struct Request* const request, const int code, const char* const target_url) {
+	
+	const size_t url_size = (code == UNALIXERR_SUCCESS) ? strlen(target_url) : 0;
+	const size_t size = PROTOCOL_HEADER_SIZE + url_size;
+	
+	if (buffer_reserve(buffer, size) != UNALIXERR_SUCCESS) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	const struct ProtocolResponse response = {
+		.id = request->id,
+		.code = code,
+		.size = (uint32_t) url_size
+	};
+	
+	protocol_response_encode(&response, buffer->content + buffer->size);
+	memcpy(buffer->content + buffer->size + PROTOCOL_HEADER_SIZE, target_url, url_size);
+	
+	buffer->size += size;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int process(const struct Request* const request, char** target_url) {
+	
+	const int options = request->options;
+	
+	switch (request->operation) {
+		case PROTOCOL_OPERATION_CLEAN:
+			return unalix_clean_url(
+				request->url,
+				target_url,
+				(options & UNALIXD_IGNORE_REFERRAL_MARKETING) != 0,
+				(options & UNALIXD_IGNORE_RULES) != 0,
+				(options & UNALIXD_IGNORE_EXCEPTIONS) != 0,
+				(options & UNALIXD_IGNORE_RAW_RULES) != 0,
+				(options & UNALIXD_IGNORE_REDIRECTIONS) != 0,
+				(options & UNALIXD_STRIP_EMPTY) != 0,
+				(options & UNALIXD_STRIP_DUPLICATES) != 0
+			);
+		case PROTOCOL_OPERATION_UNSHORT:
+			return unalix_unshort_url(
+				request->url,
+				target_url,
+				(options & UNALIXD_IGNORE_REFERRAL_MARKETING) != 0,
+				(options & UNALIXD_IGNORE_RULES) != 0,
+				(options & UNALIXD_IGNORE_EXCEPTIONS) != 0,
+				(options & UNALIXD_IGNORE_RAW_RULES) != 0,
+				(options & UNALIXD_IGNORE_REDIRECTIONS) != 0,
+				(options & UNALIXD_STRIP_EMPTY) != 0,
+				(options & UNALIXD_STRIP_DUPLICATES) != 0,
+				NULL,
+				unshort_timeout
+			);
+		default:
+			return UNALIXERR_ARG_INVALID;
+	}
+	
+}
+
+static void batch_run(void* argument) {
+	
+	struct Batch* const batch = (struct Batch*) argument;
+	struct Connection* const connection = batch->connection;
+	
+	struct ResponseBuffer buffer = {0};
+	int code = UNALIXERR_SUCCESS;
+	
+	for (size_t index = 0; index < batch->total_requests; index++) {
+		struct Request* const request = &batch->requests[index];
+		
+		char* target_url = NULL;
+		const int result = process(request, &target_url);
+		
+		if (code == UNALIXERR_SUCCESS) {
+			code = response_append(&buffer, request, result, target_url);
+		}
+		
+		free(target_url);
+		free(request->url);
+	}
+	
+	// Written out by the reader, so that a client not reading its responses never blocks a worker
+	mutex_lock(&connection->mutex);
+	
+	if (code == UNALIXERR_SUCCESS) {
+		code = buffer_reserve(&connection->queued, buffer.size);
+	}
+	
+	if (code == UNALIXERR_SUCCESS) {
+		memcpy(connection->queued.content + connection->queued.size, buffer.content, buffer.size);
+		connection->queued.size += buffer.size;
+	}
+	
+	connection->pending -= batch->total_requests;
+	
+	mutex_unlock(&connection->mutex);
+	
+	// Responses cannot go missing silently, so the client is disconnected instead
+	if (code != UNALIXERR_SUCCESS) {
+		shutdown(connection->fd, SHUT_RDWR);
+	}
+	
+	connection_wake(connection);
+	connection_release(connection);
+	
+	free(buffer.content);
+	free(batch);
+	
+}
+
+static void batch_submit(struct WorkerPool* pool, struct Batch* batch) {
+	
+	struct Connection* const connection = batch->connection;
+	
+	mutex_lock(&connection->mutex);
+	
+	connection->pending += batch->total_requests;
+	connection->references++;
+	
+	mutex_unlock(&connection->mutex);
+	
+	batch->task.routine = batch_run;
+	batch->task.argument = batch;
+	
+	if (worker_pool_submit(pool, &batch->task) != UNALIXERR_SUCCESS) {
+		batch_run(batch);
+	}
+	
+}
+
+static struct Batch* batch_new(struct Connection* connection, const size_t max_requests) {
+	
+	struct Batch* batch = (struct Batch*) malloc(sizeof(struct Batch) + sizeof(struct Request) * max_requests);
+	
+	if (batch == NULL) {
+		return NULL;
+	}
+	
+	batch->connection = connection;
+	batch->total_requests = 0;
+	
+	return batch;
+	
+}
+
+static void batch_free(struct Batch* batch) {
+	
+	if (batch == NULL) {
+		return;
+	}
+	
+	for (size_t index = 0; index < batch->total_requests; index++) {
+		free(batch->requests[index].url);
+	}
+	
+	free(batch);
+	
+}
+
+static int parse_requests(struct Connection* connection, const unsigned char* const buffer, const size_t size, size_t* consumed, size_t* required) {
+	/*
+	Submits complete requests in buffer, until the connection has UNALIXD_MAX_PENDING of them in flight.
+	"consumed" receives how many bytes were used, and "required" how large the buffer must be to hold
+	the next request.
+	*/
+	
+	size_t offset = 0;
+	struct Batch* batch = NULL;
+	
+	int code = UNALIXERR_SUCCESS;
+	
+	*required = 0;
+	
+	while (size - offset >= PROTOCOL_HEADER_SIZE) {
+		mutex_lock(&connection->mutex);
+		const size_t pending = connection->pending + ((batch == NULL) ? 0 : batch->total_requests);
+		mutex_unlock(&connection->mutex);
+		
+		// The rest stays in the buffer until some responses have been queued
+		if (pending >= UNALIXD_MAX_PENDING) {
+			break;
+		}
+		
+		struct ProtocolRequest request = {0};
+		protocol_request_decode(buffer + offset, &request);
+		
+		if (request.size == 0 || request.size > PROTOCOL_MAX_URL_SIZE) {
+			code = UNALIXERR_ARG_INVALID;
+			break;
+		}
+		
+		if (size - offset < PROTOCOL_HEADER_SIZE + request.size) {
+			*required = PROTOCOL_HEADER_SIZE + request.size;
+			break;
+		}
+		
+		char* url = (char*) malloc(request.size + 1);
+		
+		if (url == NULL) {
+			code = UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+			break;
+		}
+		
+		memcpy(url, buffer + offset + PROTOCOL_HEADER_SIZE, request.size);
+		url[request.size] = '\0';
+		
+		offset += PROTOCOL_HEADER_SIZE + request.size;
+		
+		const struct Request item = {
+			.id = request.id,
+			.operation = request.operation,
+			.options = request.options,
+			.url = url
+		};
+		
+		if (request.operation == PROTOCOL_OPERATION_UNSHORT) {
+			struct Batch* single = batch_new(connection, 1);
+			
+			if (single == NULL) {
+				free(url);
+				code = UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+				break;
+			}
+			
+			single->requests[single->total_requests++] = item;
+			batch_submit(&unshort_pool, single);
+			
+			continue;
+		}
+		
+		if (batch == NULL) {
+			batch = batch_new(connection, UNALIXD_MAX_BATCH);
+			
+			if (batch == NULL) {
+				free(url);
+				code = UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+				break;
+			}
+		}
+		
+		batch->requests[batch->total_requests++] = item;
+		
+		if (batch->total_requests == UNALIXD_MAX_BATCH) {
+			batch_submit(&clean_pool, batch);
+			batch = NULL;
+		}
+	}
+	
+	if (batch != NULL) {
+		if (code == UNALIXERR_SUCCESS) {
+			batch_submit(&clean_pool, batch);
+		} else {
+			batch_free(batch);
+		}
+	}
+	
+	*consumed = offset;
+	
+	return code;
+	
+}
+
+static void connection_main(void* argument) {
+	/*
+	Reads the requests of a connection and writes out the responses the workers have queued for it,
+	never blocking on the socket. The connection is kept until the client has stopped sending and every
+	response has been written.
+	*/
+	
+	struct Connection* const connection = (struct Connection*) argument;
+	
+	size_t capacity = UNALIXD_READ_SIZE;
+	size_t size = 0;
+	
+	int reading = 1;
+	
+	unsigned char* buffer = (unsigned char*) malloc(capacity);
+	
+	while (buffer != NULL) {
+		size_t consumed = 0;
+		size_t required = 0;
+		
+		// Requests held back by UNALIXD_MAX_PENDING are submitted once earlier ones are answered
+		if (parse_requests(connection, buffer, size, &consumed, &required) != UNALIXERR_SUCCESS) {
+			break;
+		}
+		
+		size -= consumed;
+		memmove(buffer, buffer + consumed, size);
+		
+		if (required > capacity) {
+			unsigned char* content = (unsigned char*) realloc(buffer, required);
+			
+			if (content == NULL) {
+				break;
+			}
+			
+			buffer = content;
+			capacity = required;
+		}
+		
+		mutex_lock(&connection->mutex);
+		
+		const size_t pending = connection->pending;
+		const size_t queued = connection->queued.size;
+		
+		mutex_unlock(&connection->mutex);
+		
+		if (!reading && pending == 0 && queued == 0) {
+			break;
+		}
+		
+		struct pollfd descriptors[] = {
+			{.fd = connection->fd, .events = 0},
+			{.fd = connection->wakeup[0], .events = POLLIN}
+		};
+		
+		// A client that does not read its responses stops having its requests read
+		if (reading && size < capacity && pending < UNALIXD_MAX_PENDING && queued < UNALIXD_MAX_QUEUED) {
+			descriptors[0].events |= POLLIN;
+		}
+		
+		if (queued > 0) {
+			descriptors[0].events |= POLLOUT;
+		}
+		
+		if (poll(descriptors, sizeof(descriptors) / sizeof(*descriptors), -1) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			
+			break;
+		}
+		
+		if (descriptors[1].revents & POLLIN) {
+			unsigned char bytes[64];
+			while (read(connection->wakeup[0], bytes, sizeof(bytes)) > 0) {}
+		}
+		
+		if (descriptors[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			break;
+		}
+		
+		if ((descriptors[0].revents & POLLOUT) && connection_flush(connection) != UNALIXERR_SUCCESS) {
+			break;
+		}
+		
+		if ((descriptors[0].revents & POLLIN) == 0) {
+			continue;
+		}
+		
+		const ssize_t received = recv(connection->fd, buffer + size, capacity - size, 0);
+		
+		if (received == -1 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+			continue;
+		}
+		
+		if (received == -1) {
+			break;
+		}
+		
+		if (received == 0) {
+			reading = 0;
+		}
+		
+		size += (size_t) received;
+	}
+	
+	free(buffer);
+	
+	// Batches still running have nobody left to answer
+	shutdown(connection->fd, SHUT_RDWR);
+	connection_release(connection);
+	
+}
+
+static int set_nonblocking(const int fd) {
+	
+	const int flags = fcntl(fd, F_GETFL, 0);
+	
+	if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		return UNALIXERR_SOCKET_SETOPT_FAILURE;
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static void connection_accept(const int server) {
+	
+	const int fd = accept(server, NULL, NULL);
+	
+	if (fd == -1) {
+		return;
+	}
+	
+	int wakeup[2] = {-1, -1};
+	
+	struct Connection* connection = (struct Connection*) malloc(sizeof(struct Connection));
+	
+	if (connection == NULL || pipe(wakeup) != 0) {
+		close(fd);
+		free(connection);
+		return;
+	}
+	
+	const struct Connection initial = {
+		.fd = fd,
+		.wakeup = {wakeup[0], wakeup[1]},
+		.mutex = MUTEX_INITIALIZER,
+		.references = 1
+	};
+	
+	*connection = initial;
+	
+	if (set_nonblocking(fd) != UNALIXERR_SUCCESS || set_nonblocking(wakeup[0]) != UNALIXERR_SUCCESS || set_nonblocking(wakeup[1]) != UNALIXERR_SUCCESS || thread_create_detached(connection_main, connection) != UNALIXERR_SUCCESS) {
+		connection_release(connection);
+	}
+	
+}
+
+static void file_state(const char* const filename, struct FileState* state) {
+	
+	// Compared with memcmp(), padding included
+	memset(state, 0, sizeof(*state));
+	
+	struct stat st = {0};
+	
+	if (stat(filename, &st) != 0) {
+		return;
+	}
+	
+	state->modified = st.st_mtime;
+	state->size = st.st_size;
+	state->inode = st.st_ino;
+	
+}
+
+static void handle_signal(const int signal) {
+	
+	if (signal == SIGHUP) {
+		reload_requested = 1;
+	} else {
+		stop_requested = 1;
+	}
+	
+}
+
+static int listen_unix(const char* const path) {
+	
+	struct sockaddr_un address = {
+		.sun_family = AF_UNIX
+	};
+	
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		return -1;
+	}
+	
+	strcpy(address.sun_path, path);
+	
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	
+	if (fd == -1) {
+		return -1;
+	}
+	
+	// A socket left behind by a previous instance would make bind() fail
+	unlink(path);
+	
+	if (bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+		close(fd);
+		return -1;
+	}
+	
+	return fd;
+	
+}
+
+int main(int argc, char* argv[]) {
+	
+	const char* rulesets = NULL;
+	const char* path = NULL;
+	const char* url_cache = NULL;
+	
+	size_t threads = UNALIXD_DEFAULT_THREADS;
+	size_t unshort_threads = UNALIXD_DEFAULT_UNSHORT_THREADS;
+	int watch = 1;
+	
+	int option = 0;
+	
+	while ((option = getopt(argc, argv, "r:s:t:u:T:c:n")) != -1) {
+		switch (option) {
+			case 'r':
+				rulesets = optarg;
+				break;
+			case 's':
+				path = optarg;
+				break;
+			case 't':
+				threads = (size_t) strtoul(optarg, NULL, 10);
+				break;
+			case 'u':
+				unshort_threads = (size_t) strtoul(optarg, NULL, 10);
+				break;
+			case 'T':
+				unshort_timeout = atoi(optarg);
+				break;
+			case 'c':
+				url_cache = optarg;
+				break;
+			case 'n':
+				watch = 0;
+				break;
+			default:
+				fputs(USAGE, stderr);
+				return 1;
+		}
+	}
+	
+	if (rulesets == NULL || path == NULL || threads < 1 || unshort_threads < 1) {
+		fputs(USAGE, stderr);
+		return 1;
+	}
+	
+	int code = unalix_load_file(rulesets);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		fprintf(stderr, "unalixd: cannot load %s: %s\n", rulesets, unalix_strerror(code));
+		return 1;
+	}
+	
+	if (url_cache != NULL) {
+		code = unalix_url_cache_open(url_cache, 0, 0);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			fprintf(stderr, "unalixd: cannot open %s: %s\n", url_cache, unalix_strerror(code));
+			return 1;
+		}
+	}
+	
+	clean_pool.max_threads = threads;
+	unshort_pool.max_threads = unshort_threads;
+	
+	const int server = listen_unix(path);
+	
+	if (server == -1) {
+		fprintf(stderr, "unalixd: cannot listen on %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+	
+	struct sigaction action = {0};
+	action.sa_handler = handle_signal;
+	sigemptyset(&action.sa_mask);
+	
+	sigaction(SIGHUP, &action, NULL);
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	
+	signal(SIGPIPE, SIG_IGN);
+	
+	struct FileState current = {0};
+	file_state(rulesets, &current);
+	
+	while (!stop_requested) {
+		struct pollfd descriptor = {
+			.fd = server,
+			.events = POLLIN
+		};
+		
+		const int ready = poll(&descriptor, 1, UNALIXD_WATCH_INTERVAL);
+		
+		if (stop_requested) {
+			break;
+		}
+		
+		struct FileState state = {0};
+		
+		if (watch) {
+			file_state(rulesets, &state);
+		}
+		
+		if (reload_requested || (watch && memcmp(&state, &current, sizeof(state)) != 0)) {
+			reload_requested = 0;
+			
+			reload(rulesets);
+			file_state(rulesets, &current);
+		}
+		
+		if (ready > 0 && (descriptor.revents & POLLIN)) {
+			connection_accept(server);
+		}
+	}
+	
+	close(server);
+	unlink(path);
+	
+	return 0;
+	
+}
@@ -0,0 +1,243 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "unalixd_client.h"
+#include "protocol.h"
+#include "errors.h"
+
+struct unalixd_client {
+	int fd;
+	uint32_t last_id;
+};
+
+static int send_all(const int fd, const unsigned char* buffer, size_t size) {
+	
+	while (size > 0) {
+		const ssize_t written = send(fd, buffer, size, MSG_NOSIGNAL);
+		
+		if (written == -1 && errno == EINTR) {
+			continue;
+		}
+		
+		if (written < 1) {
+			return UNALIXERR_SOCKET_SEND_FAILURE;
+		}
+		
+		buffer += written;
+		size -= (size_t) written;
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int receive_all(const int fd, unsigned char* buffer, size_t size) {
+	
+	while (size > 0) {
+		const ssize_t received = recv(fd, buffer, size, 0);
+		
+		if (received == -1 && errno == EINTR) {
+			continue;
+		}
+		
+		if (received < 1) {
+			return UNALIXERR_SOCKET_RECV_FAILURE;
+		}
+		
+		buffer += received;
+		size -= (size_t) received;
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int unalixd_connect(struct unalixd_client** client, const char* const path) {
+	
+	if (client == NULL || path == NULL || *path == '\0') {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	struct sockaddr_un address = {
+		.sun_family = AF_UNIX
+	};
+	
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	strcpy(address.sun_path, path);
+	
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	
+	if (fd == -1) {
+		return UNALIXERR_SOCKET_FAILURE;
+	}
+	
+	if (connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0) {
+		close(fd);
+		return UNALIXERR_SOCKET_CONNECT_FAILURE;
+	}
+	
+	struct unalixd_client* obj = (struct unalixd_client*) malloc(sizeof(struct unalixd_client));
+	
+	if (obj == NULL) {
+		close(fd);
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	obj->fd = fd;
+	obj->last_id = 0;
+	
+	*client = obj;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+void unalixd_close(struct unalixd_client* client) {
+	
+	if (client == NULL) {
+		return;
+	}
+	
+	close(client->fd);
+	free(client);
+	
+}
+
+static int send_request(struct unalixd_client* client, const uint8_t operation, const char* const url, const int options, unsigned int* id) {
+	
+	if (client == NULL || url == NULL || *url == '\0') {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	const size_t size = strlen(url);
+	
+	if (size > PROTOCOL_MAX_URL_SIZE) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	const struct ProtocolRequest request = {
+		.id = ++client->last_id,
+		.operation = operation,
+		.options = (uint16_t) options,
+		.size = (uint32_t) size
+	};
+	
+	unsigned char buffer[PROTOCOL_HEADER_SIZE + size];
+	
+	protocol_request_encode(&request, buffer);
+	memcpy(buffer + PROTOCOL_HEADER_SIZE, url, size);
+	
+	const int code = send_all(client->fd, buffer, sizeof(buffer));
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	if (id != NULL) {
+		*id = request.id;
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int unalixd_send_clean(struct unalixd_client* client, const char* const url, const int options, unsigned int* id) {
+	return send_request(client, PROTOCOL_OPERATION_CLEAN, url, options, id);
+}
+
+int unalixd_send_unshort(struct unalixd_client* client, const char* const url, const int options, unsigned int* id) {
+	return send_request(client, PROTOCOL_OPERATION_UNSHORT, url, options, id);
+}
+
+int unalixd_receive(struct unalixd_client* client, unsigned int* id, int* code, char** target_url) {
+	/*
+	Waits for the next response. "code" receives the result of the request itself, while the return
+	value only reports failures to talk to the daemon.
+	*/
+	
+	if (client == NULL || code == NULL || target_url == NULL) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	unsigned char header[PROTOCOL_HEADER_SIZE];
+	
+	int status = receive_all(client->fd, header, sizeof(header));
+	
+	if (status != UNALIXERR_SUCCESS) {
+		return status;
+	}
+	
+	struct ProtocolResponse response = {0};
+	protocol_response_decode(header, &response);
+	
+	if (response.size > PROTOCOL_MAX_URL_SIZE) {
+		return UNALIXERR_SOCKET_RECV_FAILURE;
+	}
+	
+	char* url = NULL;
+	
+	if (response.code == 0) {
+		url = (char*) malloc(response.size + 1);
+		
+		if (url == NULL) {
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+		
+		status = receive_all(client->fd, (unsigned char*) url, response.size);
+		
+		if (status != UNALIXERR_SUCCESS) {
+			free(url);
+			return status;
+		}
+		
+		url[response.size] = '\0';
+	}
+	
+	if (id != NULL) {
+		*id = response.id;
+	}
+	
+	*code = response.code;
+	*target_url = url;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int request(struct unalixd_client* client, const uint8_t operation, const char* const source_url, char** target_url, const int options) {
+	
+	unsigned int id = 0;
+	
+	int code = send_request(client, operation, source_url, options, &id);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	int result = 0;
+	
+	code = unalixd_receive(client, NULL, &result, target_url);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	return result;
+	
+}
+
+int unalixd_clean_url(struct unalixd_client* client, const char* const source_url, char** target_url, const int options) {
+	return request(client, PROTOCOL_OPERATION_CLEAN, source_url, target_url, options);
+}
+
+int unalixd_unshort_url(struct unalixd_client* client, const char* const source_url, char** target_url, const int options) {
+	return request(client, PROTOCOL_OPERATION_UNSHORT, source_url, target_url, options);
+}
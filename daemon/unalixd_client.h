@@ -0,0 +1,33 @@
+#ifndef UNALIXD_CLIENT_H_INCLUDED
+#define UNALIXD_CLIENT_H_INCLUDED
+
+#include <stddef.h>
+
+/*
+Client for unalixd, the URL cleaning daemon. Error codes are the same UNALIXERR_* codes
+libunalix returns; those produced by the daemon are passed through unchanged.
+*/
+
+#define UNALIXD_IGNORE_REFERRAL_MARKETING (1 << 0)
+#define UNALIXD_IGNORE_RULES (1 << 1)
+#define UNALIXD_IGNORE_EXCEPTIONS (1 << 2)
+#define UNALIXD_IGNORE_RAW_RULES (1 << 3)
+#define UNALIXD_IGNORE_REDIRECTIONS (1 << 4)
+#define UNALIXD_STRIP_EMPTY (1 << 5)
+#define UNALIXD_STRIP_DUPLICATES (1 << 6)
+
+struct unalixd_client;
+
+int unalixd_connect(struct unalixd_client** client, const char* const path);
+void unalixd_close(struct unalixd_client* client);
+
+// Pipelined interface: any number of requests can be sent before reading their responses
+int unalixd_send_clean(struct unalixd_client* client, const char* const url, const int options, unsigned int* id);
+int unalixd_send_unshort(struct unalixd_client* client, const char* const url, const int options, unsigned int* id);
+int unalixd_receive(struct unalixd_client* client, unsigned int* id, int* code, char** target_url);
+
+// Blocking interface: one request at a time, with nothing else in flight
+int unalixd_clean_url(struct unalixd_client* client, const char* const source_url, char** target_url, const int options);
+int unalixd_unshort_url(struct unalixd_client* client, const char* const source_url, char** target_url, const int options);
+
+#endif
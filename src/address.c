@@ -45,3 +45,29 @@ int address_parse(struct Address* obj, const char* sa, const int sa_port) {
 	return UNALIXERR_DNS_CANNOT_PARSE_ADDRESS;
 	
 }
+
+int address_from_sockaddr(struct Address* obj, const struct sockaddr* sa, const socklen_t sa_size) {
+	
+	if (!(sa->sa_family == AF_INET || sa->sa_family == AF_INET6) || (size_t) sa_size > sizeof(obj->addr_storage)) {
+		return UNALIXERR_DNS_CANNOT_PARSE_ADDRESS;
+	}
+	
+	memset(&obj->addr_storage, 0, sizeof(obj->addr_storage));
+	memcpy(&obj->addr_storage, sa, (size_t) sa_size);
+	
+	obj->af = sa->sa_family;
+	obj->addr_storage_size = sa_size;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+void address_set_port(struct Address* obj, const int port) {
+	
+	if (obj->af == AF_INET) {
+		((struct sockaddr_in*) &obj->addr_storage)->sin_port = htons(port);
+	} else if (obj->af == AF_INET6) {
+		((struct sockaddr_in6*) &obj->addr_storage)->sin6_port = htons(port);
+	}
+	
+}
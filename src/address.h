@@ -1,13 +1,28 @@
+#ifndef ADDRESS_H_INCLUDED
+#define ADDRESS_H_INCLUDED
+
 #ifdef _WIN32
-	#include <windows.h>
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
 #else
 	#include <arpa/inet.h>
 #endif
 
+#define MAX_ADDRESSES 16
+
 struct Address {
 	int af;
 	struct sockaddr_storage addr_storage;
 	socklen_t addr_storage_size;
 };
 
+struct Addresses {
+	size_t offset;
+	struct Address items[MAX_ADDRESSES];
+};
+
 int address_parse(struct Address* obj, const char* sa, const int sa_port);
+int address_from_sockaddr(struct Address* obj, const struct sockaddr* sa, const socklen_t sa_size);
+void address_set_port(struct Address* obj, const int port);
+
+#endif
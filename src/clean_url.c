@@ -8,32 +8,94 @@
 #include "errors.h"
 #include "regex.h"
 #include "ruleset.h"
+#include "frozen.h"
 #include "uri.h"
 #include "query.h"
 #include "utils.h"
 
-static void prepend_scheme_if_needed(char* src) {
+// Redirections are followed this many levels deep at most; deeper ones are left in place
+static const size_t CLEAN_URL_DEFAULT_MAX_DEPTH = 16;
+
+static size_t max_depth = CLEAN_URL_DEFAULT_MAX_DEPTH;
+
+void unalix_clean_url_max_depth(const size_t depth) {
+	max_depth = depth;
+}
+
+struct RedirectionBuffer {
+	char* data;
+	size_t size;
+};
+
+static const char* redirection_target(struct RedirectionBuffer* buffer, const char* const start, const size_t length) {
+	/*
+	Decodes the URL a redirection points to into buffer, which is grown as needed. Room for a scheme
+	is kept in front of it, so that URLs without one can get it without moving anything. Returns
+	where the URL starts in buffer, or NULL if it could not be grown.
+	*/
 	
-	struct URI uri = {0};
+	const size_t prefix_length = strlen(HTTP_SCHEME) + strlen(SCHEME_SEPARATOR);
+	const size_t size = prefix_length + length + 1;
 	
-	const int code = uri_parse(&uri, src);
+	if (size > buffer->size) {
+		char* data = (char*) realloc(buffer->data, size);
+		
+		if (data == NULL) {
+			return NULL;
+		}
+		
+		buffer->data = data;
+		buffer->size = size;
+	}
 	
-	uri_free(&uri);
+	char* const url = buffer->data + prefix_length;
+	
+	memcpy(url, start, length);
+	url[length] = '\0';
+	
+	// Decoding never makes it longer, so it can be done in place
+	rfc3986_unquote_safe(url, url);
 	
-	if (code == UNALIXERR_URI_SCHEME_MISSING) {
-		const size_t prefix_length = strlen(HTTP_SCHEME) + strlen(SCHEME_SEPARATOR);
-		char prefix[prefix_length + 1];
+	// Workaround for URLs without scheme (see https://github.com/ClearURLs/Addon/issues/71)
+	if (strstr(url, SCHEME_SEPARATOR) != NULL) {
+		return url;
+	}
+	
+	memcpy(buffer->data, HTTP_SCHEME, strlen(HTTP_SCHEME));
+	memcpy(buffer->data + strlen(HTTP_SCHEME), SCHEME_SEPARATOR, strlen(SCHEME_SEPARATOR));
+	
+	return buffer->data;
+	
+}
+
+static void strip_parameters(const struct Rules* const rules, const struct FrozenList* const list, char** subject) {
+	/*
+	Strips the parameters matching rules from subject. When every rule is a plain parameter name, the
+	whole list is skipped unless one of those names is there.
+	*/
+	
+	if (list != NULL && list->all_literal && !frozen_set_matches_parameters(&list->set, *subject)) {
+		return;
+	}
+	
+	for (size_t index = 0; index < rules->total_items; index++) {
+		const char* const literal = (rules->literals == NULL) ? NULL : rules->literals[index];
 		
-		strcpy(prefix, HTTP_SCHEME);
-		strcat(prefix, SCHEME_SEPARATOR);
+		if (literal != NULL) {
+			literal_strip(literal, subject);
+		} else {
+			regex_strip(rules->items[index], (PCRE2_SPTR) *subject, subject);
+		}
 		
-		memmove(src + prefix_length, src, strlen(src) + 1);
-		memcpy(src, prefix, prefix_length);
+		if (*subject == NULL) {
+			break;
+		}
 	}
 	
 }
 
-int unalix_clean_url(
+static int clean_url(
+	const struct Rulesets* const rulesets,
 	const char* const source_url,
 	char** target_url,
 	const int ignore_referral_marketing,
@@ -42,18 +104,14 @@ int unalix_clean_url(
 	const int ignore_raw_rules,
 	const int ignore_redirections,
 	const int strip_empty,
-	const int strip_duplicates
+	const int strip_duplicates,
+	const char** redirection_start,
+	size_t* redirection_length
 ) {
-	
-	if (source_url == NULL || *source_url == '\0' || target_url == NULL) {
-		return UNALIXERR_ARG_INVALID;
-	}
-	
-	const struct Rulesets rulesets = get_rulesets();
-	
-	if (rulesets.offset < 1) {
-		return UNALIXERR_RULESETS_EMPTY;
-	}
+	/*
+	Cleans a single URL. If a redirection matches, nothing is cleaned; target_url is left untouched, and
+	redirection_start and redirection_length are set to where the URL it points to lies within source_url.
+	*/
 	
 	struct URI uri = {0};
 	
@@ -65,8 +123,21 @@ int unalix_clean_url(
 	
 	const PCRE2_SPTR subject = (PCRE2_SPTR) source_url;
 	
-	for (size_t index = 0; index < rulesets.offset; index++) {
-		const struct Ruleset ruleset = rulesets.items[index];
+	const struct FrozenRuleset* const frozen = rulesets->frozen;
+	unsigned char candidates[(frozen == NULL) ? 1 : frozen->total_providers + 1];
+	
+	if (frozen != NULL) {
+		frozen_candidates(frozen, source_url, candidates);
+	}
+	
+	for (size_t index = 0; index < rulesets->offset; index++) {
+		const struct Ruleset ruleset = rulesets->items[index];
+		const struct FrozenProvider* const provider = (frozen != NULL && index < frozen->total_providers) ? &frozen->providers[index] : NULL;
+		
+		// The URL lacks the host label this provider's URL pattern requires
+		if (provider != NULL && provider->host != NULL && !candidates[index]) {
+			continue;
+		}
 		
 		if (regex_match(ruleset.url_pattern, subject)) {
 			if (!ignore_exceptions) {
@@ -90,98 +161,47 @@ int unalix_clean_url(
 				for (size_t index = 0; index < ruleset.redirections.total_items; index++) {
 					const pcre2_code* redirection = ruleset.redirections.items[index];
 					
-					pcre2_match_data* match_data = pcre2_match_data_create_from_pattern(redirection, NULL);
+					pcre2_match_data* match_data = regex_match_data_create(redirection);
 					const int code = pcre2_match(redirection, subject, PCRE2_ZERO_TERMINATED, 0, 0, match_data, NULL);
 					
 					if (code > 0) {
 						const PCRE2_SIZE* ovector = pcre2_get_ovector_pointer(match_data);
 						
-						const char* start = (const char*) subject + ovector[2];
-						const size_t length = ovector[3] - ovector[2];
-						
-						char url[length + 1];
-						memcpy(url, start, length);
-						url[length] = '\0';
-						
-						char safe_unquoted_url[sizeof(url) + strlen(HTTPS_SCHEME) + strlen(SCHEME_SEPARATOR)];
-						rfc3986_unquote_safe(url, safe_unquoted_url);
-						
-						// Workaround for URLs without scheme (see https://github.com/ClearURLs/Addon/issues/71)
-						prepend_scheme_if_needed(&safe_unquoted_url[0]);
-						
-						const int rc = unalix_clean_url(
-							safe_unquoted_url,
-							target_url,
-							ignore_referral_marketing,
-							ignore_rules,
-							ignore_exceptions,
-							ignore_raw_rules,
-							ignore_redirections,
-							strip_empty,
-							strip_duplicates
-						);
+						*redirection_start = source_url + ovector[2];
+						*redirection_length = ovector[3] - ovector[2];
 						
 						uri_free(&uri);
 						pcre2_match_data_free(match_data);
 						
-						return rc;
+						return UNALIXERR_SUCCESS;
 					}
 					
 					pcre2_match_data_free(match_data);
 				}
 			}
 			
-			if (uri.query != NULL && !ignore_rules) {
-				for (size_t index = 0; index < ruleset.rules.total_items; index++) {
-					const pcre2_code* pattern = ruleset.rules.items[index];
-					const PCRE2_SPTR subject = (PCRE2_SPTR) uri.query;
-					
-					regex_strip(pattern, subject, &uri.query);
-					
-					if (uri.query == NULL) {
-						break;
-					}
-				}
+			/*
+			Rules that are plain names can only strip something if one of the keys starts with a name
+			in the filter, so providers made only of those are skipped when none does.
+			*/
+			const int strip_query = (uri.query != NULL && (!ruleset.parameters_filtered || parameter_filter_matches(&rulesets->filter, uri.query)));
+			const int strip_fragment = (uri.fragment != NULL && (!ruleset.parameters_filtered || parameter_filter_matches(&rulesets->filter, uri.fragment)));
+			
+			if (strip_query && !ignore_rules) {
+				strip_parameters(&ruleset.rules, (provider == NULL) ? NULL : &provider->lists[FROZEN_LIST_RULES], &uri.query);
 			}
 			
-			if (uri.query != NULL && !ignore_referral_marketing) {
-				for (size_t index = 0; index < ruleset.referral_marketing.total_items; index++) {
-					const pcre2_code* pattern = ruleset.referral_marketing.items[index];
-					const PCRE2_SPTR subject = (PCRE2_SPTR) uri.query;
-					
-					regex_strip(pattern, subject, &uri.query);
-					
-					if (uri.query == NULL) {
-						break;
-					}
-				}
+			if (strip_query && uri.query != NULL && !ignore_referral_marketing) {
+				strip_parameters(&ruleset.referral_marketing, (provider == NULL) ? NULL : &provider->lists[FROZEN_LIST_REFERRAL_MARKETING], &uri.query);
 			}
 			
 			// The fragment might contains tracking fields as well
-			if (uri.fragment != NULL && !ignore_rules) {
-				for (size_t index = 0; index < ruleset.rules.total_items; index++) {
-					const pcre2_code* pattern = ruleset.rules.items[index];
-					const PCRE2_SPTR subject = (PCRE2_SPTR) uri.fragment;
-					
-					regex_strip(pattern, subject, &uri.fragment);
-					
-					if (uri.fragment == NULL) {
-						break;
-					}
-				}
+			if (strip_fragment && !ignore_rules) {
+				strip_parameters(&ruleset.rules, (provider == NULL) ? NULL : &provider->lists[FROZEN_LIST_RULES], &uri.fragment);
 			}
 			
-			if (uri.fragment != NULL && !ignore_referral_marketing) {
-				for (size_t index = 0; index < ruleset.referral_marketing.total_items; index++) {
-					const pcre2_code* pattern = ruleset.referral_marketing.items[index];
-					const PCRE2_SPTR subject = (PCRE2_SPTR) uri.fragment;
-					
-					regex_strip(pattern, subject, &uri.fragment);
-					
-					if (uri.fragment == NULL) {
-						break;
-					}
-				}
+			if (strip_fragment && uri.fragment != NULL && !ignore_referral_marketing) {
+				strip_parameters(&ruleset.referral_marketing, (provider == NULL) ? NULL : &provider->lists[FROZEN_LIST_REFERRAL_MARKETING], &uri.fragment);
 			}
 			
 			if (uri.path != NULL && !ignore_raw_rules) {
@@ -291,3 +311,82 @@ int unalix_clean_url(
 	return UNALIXERR_SUCCESS;
 	
 }
+
+int unalix_clean_url(
+	const char* const source_url,
+	char** target_url,
+	const int ignore_referral_marketing,
+	const int ignore_rules,
+	const int ignore_exceptions,
+	const int ignore_raw_rules,
+	const int ignore_redirections,
+	const int strip_empty,
+	const int strip_duplicates
+) {
+	
+	if (source_url == NULL || *source_url == '\0' || target_url == NULL) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	// Held until the end, so that the rulesets can be replaced while they are being used here
+	const struct Rulesets* const rulesets = rulesets_acquire();
+	
+	if (rulesets->offset < 1) {
+		rulesets_release(rulesets);
+		return UNALIXERR_RULESETS_EMPTY;
+	}
+	
+	/*
+	Redirections are followed one level at a time. Each URL is decoded into the buffer the current one
+	does not live in, so two buffers are enough however deep they go.
+	*/
+	struct RedirectionBuffer buffers[2] = {0};
+	size_t buffer = 0;
+	
+	const char* url = source_url;
+	int code = UNALIXERR_SUCCESS;
+	
+	for (size_t depth = 0; ; depth++) {
+		const char* redirection_start = NULL;
+		size_t redirection_length = 0;
+		
+		char* cleaned_url = NULL;
+		
+		code = clean_url(
+			rulesets,
+			url,
+			&cleaned_url,
+			ignore_referral_marketing,
+			ignore_rules,
+			ignore_exceptions,
+			ignore_raw_rules,
+			ignore_redirections || depth >= max_depth,
+			strip_empty,
+			strip_duplicates,
+			&redirection_start,
+			&redirection_length
+		);
+		
+		if (code != UNALIXERR_SUCCESS || redirection_start == NULL) {
+			*target_url = cleaned_url;
+			break;
+		}
+		
+		url = redirection_target(&buffers[buffer], redirection_start, redirection_length);
+		
+		if (url == NULL) {
+			code = UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+			break;
+		}
+		
+		buffer = !buffer;
+	}
+	
+	free(buffers[0].data);
+	free(buffers[1].data);
+	
+	rulesets_release(rulesets);
+	
+	return code;
+	
+}
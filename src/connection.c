@@ -11,43 +11,385 @@
 #else
 	#include <netdb.h>
 	#include <unistd.h>
+	#include <fcntl.h>
+	#include <errno.h>
 #endif
 
 #include <bearssl.h>
 
 #include "connection.h"
+#include "ssl_pool.h"
+#include "address.h"
 #include "errors.h"
+#include "utils.h"
+#include "metrics.h"
+
+#ifndef MSG_NOSIGNAL
+	#define MSG_NOSIGNAL 0
+#endif
 
 void connection_free(struct Connection* obj) {
 	
-	if (obj->ssl_context.is_initialized) {
-		br_sslio_close(&obj->ssl_context.ioc);
+	metrics_add(METRICS_BYTES_RECEIVED, obj->bytes_received);
+	metrics_add(METRICS_BYTES_SENT, obj->bytes_sent);
+	
+	obj->bytes_received = 0;
+	obj->bytes_sent = 0;
+	
+	if (obj->ssl_context != NULL) {
+		if (obj->ssl_context->is_initialized) {
+			br_sslio_close(&obj->ssl_context->ioc);
+		}
+		
+		ssl_context_release(obj->ssl_context);
+		obj->ssl_context = NULL;
 	}
 	
-	close(obj->fd);
+	// Freeing twice must not close a descriptor that has since been handed to someone else
+	if (obj->fd > 0) {
+		socket_close(obj->fd);
+		obj->fd = -1;
+	}
 	
 }
 
-int connection_set_timeout(struct Connection* obj, const int timeout) {
+void connection_abort(struct Connection* obj) {
+	/*
+	Closes the connection with a TCP reset instead of a graceful shutdown. Whatever the peer
+	still has in flight is dropped, and the TLS closure handshake (which would otherwise wait
+	for the rest of the response) is skipped.
+	*/
 	
-	#ifdef _WIN32
-		const DWORD time = timeout * 1000;
-	#else
-		const struct timeval time = {.tv_sec = timeout};
-	#endif
+	if (obj->fd > 0) {
+		const struct linger linger = {
+			.l_onoff = 1,
+			.l_linger = 0
+		};
+		
+		setsockopt(obj->fd, SOL_SOCKET, SO_LINGER, (char*) &linger, sizeof(linger));
+		socket_close(obj->fd);
+		
+		obj->fd = -1;
+	}
+	
+	ssl_context_release(obj->ssl_context);
+	obj->ssl_context = NULL;
 	
-	int code = setsockopt(obj->fd, SOL_SOCKET, SO_RCVTIMEO, (char*) &time, sizeof(time));
+}
+
+static int connection_remaining(const struct Connection* obj) {
+	/*
+	Returns how long (in milliseconds) the next socket operation may wait, or -1 for no limit.
+	*/
+	
+	int remaining = (obj->timeout > 0) ? obj->timeout * 1000 : -1;
 	
-	if (code != 0) {
-		return UNALIXERR_SOCKET_SETOPT_FAILURE;
+	if (obj->deadline > 0) {
+		const unsigned long long now = get_monotonic_time();
+		const unsigned long long left = (obj->deadline > now) ? obj->deadline - now : 0;
+		
+		if (remaining == -1 || left < (unsigned long long) remaining) {
+			remaining = (int) left;
+		}
 	}
 	
-	code = setsockopt(obj->fd, SOL_SOCKET, SO_SNDTIMEO, (char*) &time, sizeof(time));
+	return remaining;
+	
+}
+
+static int connection_wait(struct Connection* obj, const short events) {
+	
+	struct pollfd pfd = {
+		.fd = obj->fd,
+		.events = events
+	};
 	
-	if (code != 0) {
-		return UNALIXERR_SOCKET_SETOPT_FAILURE;
+	while (1) {
+		const int remaining = connection_remaining(obj);
+		
+		if (remaining == 0) {
+			obj->timed_out = 1;
+			return UNALIXERR_SOCKET_TIMEOUT;
+		}
+		
+		const int code = poll(&pfd, 1, remaining);
+		
+		if (code > 0) {
+			return UNALIXERR_SUCCESS;
+		}
+		
+		if (code == 0) {
+			obj->timed_out = 1;
+			return UNALIXERR_SOCKET_TIMEOUT;
+		}
+		
+		if (!socket_in_progress()) {
+			return UNALIXERR_SOCKET_FAILURE;
+		}
 	}
 	
+}
+
+ssize_t connection_recv(struct Connection* obj, void* buffer, const size_t buffer_size) {
+	
+	while (1) {
+		if (connection_wait(obj, POLLIN) != UNALIXERR_SUCCESS) {
+			return -1;
+		}
+		
+		const ssize_t size = recv(obj->fd, buffer, buffer_size, 0);
+		
+		if (size == -1 && socket_in_progress()) {
+			continue;
+		}
+		
+		if (size > 0) {
+			obj->bytes_received += (unsigned long long) size;
+		}
+		
+		return size;
+	}
+	
+}
+
+ssize_t connection_send(struct Connection* obj, const void* buffer, const size_t buffer_size) {
+	
+	size_t offset = 0;
+	
+	while (offset < buffer_size) {
+		if (connection_wait(obj, POLLOUT) != UNALIXERR_SUCCESS) {
+			return -1;
+		}
+		
+		const ssize_t size = send(obj->fd, (const char*) buffer + offset, buffer_size - offset, MSG_NOSIGNAL);
+		
+		if (size == -1 && socket_in_progress()) {
+			continue;
+		}
+		
+		if (size < 1) {
+			return -1;
+		}
+		
+		offset += (size_t) size;
+		obj->bytes_sent += (unsigned long long) size;
+	}
+	
+	return (ssize_t) offset;
+	
+}
+
+static void sort_addresses(const struct Addresses* addresses, size_t* order) {
+	/*
+	Interleaves address families, starting with the one the resolver preferred (RFC 8305, section 4).
+	*/
+	
+	const int first_family = addresses->items[0].af;
+	
+	size_t preferred = 0;
+	size_t other = 0;
+	
+	for (size_t index = 0; index < addresses->offset; index++) {
+		const int take_preferred = (index % 2 == 0);
+		
+		while (preferred < addresses->offset && addresses->items[preferred].af != first_family) {
+			preferred++;
+		}
+		
+		while (other < addresses->offset && addresses->items[other].af == first_family) {
+			other++;
+		}
+		
+		if ((take_preferred && preferred < addresses->offset) || other >= addresses->offset) {
+			order[index] = preferred++;
+		} else {
+			order[index] = other++;
+		}
+	}
+	
+}
+
+int connection_connect(struct Connection* obj, const struct Addresses* addresses) {
+	/*
+	Connects to the first address that answers. A new attempt is started whenever the previous
+	one fails or has been pending for CONNECTION_ATTEMPT_DELAY, and all pending attempts race
+	until one succeeds or the deadline expires.
+	*/
+	
+	if (addresses->offset == 0) {
+		return UNALIXERR_SOCKET_CONNECT_FAILURE;
+	}
+	
+	size_t order[MAX_ADDRESSES];
+	sort_addresses(addresses, order);
+	
+	struct pollfd attempts[MAX_ADDRESSES];
+	
+	size_t total_started = 0;
+	size_t total_pending = 0;
+	
+	unsigned long long next_attempt = 0;
+	
+	int winner = -1;
+	
+	obj->timed_out = 0;
+	
+	while (winner == -1) {
+		const unsigned long long now = get_monotonic_time();
+		
+		if (total_started < addresses->offset && (total_pending == 0 || now >= next_attempt)) {
+			const struct Address* const address = &addresses->items[order[total_started]];
+			struct pollfd* const attempt = &attempts[total_started++];
+			
+			attempt->fd = (int) socket(address->af, SOCK_STREAM, IPPROTO_TCP);
+			attempt->events = POLLOUT;
+			attempt->revents = 0;
+			
+			if (attempt->fd == -1) {
+				continue;
+			}
+			
+			if (socket_set_blocking(attempt->fd, 0) != UNALIXERR_SUCCESS) {
+				socket_close(attempt->fd);
+				attempt->fd = -1;
+				
+				continue;
+			}
+			
+			if (connect(attempt->fd, (struct sockaddr*) &address->addr_storage, address->addr_storage_size) == 0) {
+				winner = attempt->fd;
+				attempt->fd = -1;
+				
+				break;
+			}
+			
+			if (!socket_in_progress()) {
+				socket_close(attempt->fd);
+				attempt->fd = -1;
+				next_attempt = 0;
+				
+				continue;
+			}
+			
+			total_pending++;
+			next_attempt = now + CONNECTION_ATTEMPT_DELAY;
+			
+			continue;
+		}
+		
+		if (total_pending == 0) {
+			break;
+		}
+		
+		int wait = connection_remaining(obj);
+		
+		if (wait == 0) {
+			obj->timed_out = 1;
+			break;
+		}
+		
+		if (total_started < addresses->offset) {
+			const int delay = (next_attempt > now) ? (int) (next_attempt - now) : 0;
+			
+			if (wait == -1 || delay < wait) {
+				wait = delay;
+			}
+		}
+		
+		const int code = poll(attempts, (unsigned long) total_started, wait);
+		
+		if (code == -1 && !socket_in_progress()) {
+			break;
+		}
+		
+		for (size_t index = 0; index < total_started && code > 0; index++) {
+			struct pollfd* const attempt = &attempts[index];
+			
+			if (attempt->fd == -1 || attempt->revents == 0) {
+				continue;
+			}
+			
+			int error = 0;
+			socklen_t error_size = sizeof(error);
+			
+			if (getsockopt(attempt->fd, SOL_SOCKET, SO_ERROR, (char*) &error, &error_size) == 0 && error == 0) {
+				winner = attempt->fd;
+				attempt->fd = -1;
+				
+				break;
+			}
+			
+			socket_close(attempt->fd);
+			attempt->fd = -1;
+			
+			total_pending--;
+			
+			// The next address is tried right away rather than after the rest of the delay
+			next_attempt = 0;
+		}
+	}
+	
+	for (size_t index = 0; index < total_started; index++) {
+		if (attempts[index].fd != -1) {
+			socket_close(attempts[index].fd);
+		}
+	}
+	
+	if (winner == -1) {
+		return obj->timed_out ? UNALIXERR_SOCKET_TIMEOUT : UNALIXERR_SOCKET_CONNECT_FAILURE;
+	}
+	
+	// The socket stays non-blocking; every read and write waits for it with the connection deadline
+	obj->fd = winner;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int socket_set_blocking(const int fd, const int blocking) {
+	
+	#ifdef _WIN32
+		u_long mode = blocking ? 0 : 1;
+		
+		if (ioctlsocket(fd, FIONBIO, &mode) != 0) {
+			return UNALIXERR_SOCKET_SETOPT_FAILURE;
+		}
+	#else
+		const int flags = fcntl(fd, F_GETFL, 0);
+		
+		if (flags == -1) {
+			return UNALIXERR_SOCKET_SETOPT_FAILURE;
+		}
+		
+		if (fcntl(fd, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK)) == -1) {
+			return UNALIXERR_SOCKET_SETOPT_FAILURE;
+		}
+	#endif
+	
 	return UNALIXERR_SUCCESS;
 	
 }
+
+int socket_in_progress(void) {
+	/*
+	Returns true (1) if the last socket operation failed only because it would have blocked.
+	*/
+	
+	#ifdef _WIN32
+		const int code = WSAGetLastError();
+		return (code == WSAEWOULDBLOCK || code == WSAEINPROGRESS);
+	#else
+		return (errno == EINPROGRESS || errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+	#endif
+	
+}
+
+void socket_close(const int fd) {
+	
+	#ifdef _WIN32
+		closesocket(fd);
+	#else
+		close(fd);
+	#endif
+	
+}
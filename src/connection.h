@@ -1,18 +1,40 @@
-#include <bearssl.h>
-
-struct SSLContext {
-	br_ssl_client_context sc;
-	br_x509_minimal_context xc;
-	unsigned char iobuf[BR_SSL_BUFSIZE_BIDI];
-	br_sslio_context ioc;
-	int is_initialized;
-};
+#ifndef CONNECTION_H_INCLUDED
+#define CONNECTION_H_INCLUDED
+
+#ifdef _WIN32
+	#include <winsock2.h>
+	
+	#define poll WSAPoll
+#else
+	#include <poll.h>
+#endif
+
+#include <sys/types.h>
+
+#include "address.h"
+#include "ssl_pool.h"
+
+// Delay between connection attempts to successive addresses (RFC 8305, section 5)
+static const int CONNECTION_ATTEMPT_DELAY = 250;
 
 struct Connection {
 	int fd;
-	struct SSLContext ssl_context;
-	int timeout;
+	struct SSLContext* ssl_context; // Borrowed from the pool for HTTPS connections; NULL otherwise
+	int timeout; // Max time (in seconds) to wait for a single socket operation
+	unsigned long long deadline; // Monotonic time (in milliseconds) past which no socket operation may wait; 0 means none
+	int timed_out;
+	unsigned long long bytes_received;
+	unsigned long long bytes_sent;
 };
 
-int connection_set_timeout(struct Connection* obj, const int timeout);
+int connection_connect(struct Connection* obj, const struct Addresses* addresses);
+ssize_t connection_recv(struct Connection* obj, void* buffer, const size_t buffer_size);
+ssize_t connection_send(struct Connection* obj, const void* buffer, const size_t buffer_size);
 void connection_free(struct Connection* obj);
+void connection_abort(struct Connection* obj);
+
+int socket_set_blocking(const int fd, const int blocking);
+int socket_in_progress(void);
+void socket_close(const int fd);
+
+#endif
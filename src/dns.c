@@ -1,170 +1,179 @@
 #include <stdlib.h>
 #include <string.h>
-#include <arpa/inet.h>
-#include <netdb.h>
 
-#include <inttypes.h>
+#ifdef _WIN32
+	#ifdef _WIN32_WINNT
+		#undef _WIN32_WINNT
+	#endif
+	
+	#define _WIN32_WINNT 0x0600
+	
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+#else
+	#include <arpa/inet.h>
+	#include <sys/socket.h>
+	#include <strings.h>
+#endif
+
 #include <bearssl.h>
 
-#include "errors.h"
-#include "http.h"
-#include "uri.h"
+#include "unalix.h"
+#include "dns.h"
 #include "address.h"
+#include "connection.h"
+#include "threads.h"
+#include "errors.h"
 #include "utils.h"
-#include "socket.h"
-#include "ssl.h"
-#include "callbacks.h"
-
-/* Structure of the bytes for a DNS header */
-typedef struct {
-  unsigned short xid;
-  unsigned short flags;
-  unsigned short qdcount;
-  unsigned short ancount;
-  unsigned short nscount;
-  unsigned short arcount;
-} DNSHeader;
-
-/* Structure of the bytes for a DNS question */
-typedef struct
-{
-  unsigned char *name;
-  unsigned short dnstype;
-  unsigned short dnsclass;
-} DNSQuestion;
-
-/* Structure of the bytes for an IPv4 answer */
-typedef struct {
-  unsigned short compression;
-  unsigned short type;
-  unsigned short class;
-  unsigned int ttl;
-  unsigned short length;
-  struct in_addr addr;
-} __attribute__((packed)) dns_record_a_t;
-
-void print_dns_response (unsigned char *response)
-{
-  /* First, check the header for an error response code */
-  DNSHeader *header = (DNSHeader *)response;
-  if ((ntohs (header->flags) & 0xf) != 0)
-    {
-      fprintf (stderr, "Failed to get response\n");
-      return;
-    }
-
-  /* Reconstruct the question */
-  unsigned char *start_of_question = response + sizeof(DNSHeader);
-//  start_of_question--;
-  printf("kkkk %i\n", header->ancount);
-  DNSQuestion *questions = calloc (sizeof(DNSQuestion), header->ancount);
-  for (int i = 0; i < ntohs (header->ancount); i++)
-    {
-      questions[i].name = (char *)start_of_question;
-      puts(start_of_question);
-      unsigned char total = 0;
-      unsigned char *field_length = (unsigned char *)questions[i].name;
-      while (*field_length != 0)
-        {
-          total += *field_length + 1;
-          *field_length = '.';
-          field_length = (unsigned char *)questions[i].name + total;
-        }
-      questions[i].name++;
-      /* Skip null byte, qtype, and qclass */
-      start_of_question = field_length + 5;
-    }
-
-  /* The records start right after the question section. For each record,
-     confirm that it is an A record (only type supported). If any are not
-     an A-type, then return. */
-  dns_record_a_t *records = (dns_record_a_t *)start_of_question;
-  for (int i = 0; i < ntohs (header->ancount); i++)
-    {
-      printf ("Record for %s\n", questions[i].name);
-      printf ("  TYPE: %" PRId16 "\n", ntohs (records[i].type));
-      printf ("  CLASS: %" PRId16 "\n", ntohs (records[i].class));
-      printf ("  TTL: %" PRIx32 "\n", ntohl (records[i].ttl));
-      printf ("  IPv4: %08" PRIx32 "\n",
-              ntohl ((unsigned int)records[i].addr.s_addr));
-      printf ("  IPv4: %s\n", inet_ntoa (records[i].addr));
-    }
-}
+#include "uri.h"
 
+static const size_t DNS_HEADER_SIZE = 12;
+static const size_t TCP_LENGTH_FIELD_SIZE = 2;
 
-enum DNSQType {
-	A = 1,
-	AAAA = 28
-};
+static const unsigned short DNS_CLASS_IN = 1;
 
-enum DNSSpecification {
-	DNS_OVER_HTTPS,
-	DNS_OVER_TLS,
-	DNS_OVER_PLAIN_UDP,
-	DNS_OVER_PLAIN_TCP,
-};
+static const unsigned short DNS_FLAG_QR = 0x8000;
+static const unsigned short DNS_FLAG_TC = 0x0200;
+static const unsigned short DNS_FLAG_RD = 0x0100;
+static const unsigned short DNS_RCODE_MASK = 0x000F;
 
-struct DNSRequest {
-	enum DNSQType qtype;
-	const char* domain_name;
-	enum DNSSpecification specification;
-};
+static const unsigned short DNS_RCODE_NXDOMAIN = 3;
 
-static const enum DNSQType QTYPES[] = {A, AAAA};
+static const unsigned char DNS_POINTER_MASK = 0xC0;
+static const int DNS_MAX_POINTERS = 16;
 
-static const char TCP_LENGTH_FIELD[] = {
-	0x00,
-	0x00
-};
+static const size_t DNS_MAX_ANSWERS = 64;
+
+static const size_t IPV4_ADDRESS_SIZE = 4;
+static const size_t IPV6_ADDRESS_SIZE = 16;
+
+static const enum DNSQType QTYPES[] = {DNS_QTYPE_A, DNS_QTYPE_AAAA};
 
-static const char DNS_BUFFER_PREFIX[] = {
-	0x00, 0x00, 0x01, 0x00,
-	0x00, 0x01, 0x00, 0x00,
-	0x00, 0x00, 0x00, 0x00
+#define TOTAL_QTYPES (sizeof(QTYPES) / sizeof(*QTYPES))
+
+struct DNSRecord {
+	char name[DNS_MAX_NAME_SIZE + 1];
+	unsigned short type;
+	unsigned int ttl;
+	size_t rdata_offset;
+	size_t rdata_size;
 };
 
-static const char DNS_BUFFER_SUFFIX[] = {
-	0x00, 0x00, 0x00, 0x00, 0x01
+struct DNSQuery {
+	struct DNSRequest request;
+	char* buffer;
+	size_t buffer_size;
+	int code;
+	int is_done;
+	int is_truncated;
+	struct Addresses addresses;
+	int ttl;
 };
 
-static const size_t IPV4_ADDRESS_SIZE = 4;
-static const size_t IPV6_ADDRESS_SIZE = 16;
+static struct Mutex id_mutex = MUTEX_INITIALIZER;
+static br_hmac_drbg_context id_generator;
+static int id_generator_seeded = 0;
+
+static unsigned short read_u16(const unsigned char* const buffer) {
+	return (unsigned short) ((buffer[0] << 8) | buffer[1]);
+}
+
+static unsigned int read_u32(const unsigned char* const buffer) {
+	return ((unsigned int) buffer[0] << 24) | ((unsigned int) buffer[1] << 16) | ((unsigned int) buffer[2] << 8) | (unsigned int) buffer[3];
+}
+
+static void write_u16(char* const buffer, const unsigned short value) {
+	buffer[0] = (char) ((value >> 8) & 0xFF);
+	buffer[1] = (char) (value & 0xFF);
+}
+
+static unsigned short dns_generate_id(void) {
+	/*
+	Query IDs must be unpredictable, otherwise off-path attackers can spoof answers.
+	*/
+	
+	unsigned short id = 0;
+	
+	mutex_lock(&id_mutex);
+	
+	if (!id_generator_seeded) {
+		const unsigned long long now = get_monotonic_time();
+		
+		br_hmac_drbg_init(&id_generator, &br_sha256_vtable, &now, sizeof(now));
+		
+		const br_prng_seeder seeder = br_prng_seeder_system(NULL);
+		
+		if (seeder != 0) {
+			seeder(&id_generator.vtable);
+		}
+		
+		id_generator_seeded = 1;
+	}
+	
+	br_hmac_drbg_generate(&id_generator, &id, sizeof(id));
+	
+	mutex_unlock(&id_mutex);
+	
+	return id;
+	
+}
 
 int dns_request_stringify(const struct DNSRequest obj, char** dst, size_t* dst_size) {
-	(void) QTYPES;
 	
-	const int length_field_required = obj.specification == DNS_OVER_PLAIN_TCP || obj.specification == DNS_OVER_TLS;
+	const int length_field_required = (obj.specification == DNS_OVER_PLAIN_TCP);
+	
+	const size_t domain_size = strlen(obj.domain_name);
+	
+	if (domain_size < 1 || domain_size > DNS_MAX_NAME_SIZE - 2) {
+		return UNALIXERR_URI_HOSTNAME_TOO_LONG;
+	}
 	
-	const size_t domain_size = strlen(obj.domain_name) + 1;
-	const size_t buffer_size = (length_field_required ? sizeof(TCP_LENGTH_FIELD) : 0) + sizeof(DNS_BUFFER_PREFIX) + domain_size + sizeof(DNS_BUFFER_PREFIX);
+	// Header + labels + root label + qtype + qclass
+	const size_t message_size = DNS_HEADER_SIZE + 1 + domain_size + 1 + 4;
+	const size_t buffer_size = (length_field_required ? TCP_LENGTH_FIELD_SIZE : 0) + message_size;
 	
-	char* buffer = malloc(buffer_size);
+	char* buffer = (char*) malloc(buffer_size);
 	
 	if (buffer == NULL) {
 		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
 	}
 	
-	int buffer_offset = 0;
+	size_t buffer_offset = 0;
 	
 	if (length_field_required) {
-		memcpy(buffer, TCP_LENGTH_FIELD, sizeof(TCP_LENGTH_FIELD));
-		buffer_offset += sizeof(TCP_LENGTH_FIELD);
-		buffer[buffer_offset - 1] = (char) buffer_size - buffer_offset;
+		write_u16(buffer, (unsigned short) message_size);
+		buffer_offset += TCP_LENGTH_FIELD_SIZE;
 	}
 	
-	memcpy(buffer + buffer_offset, DNS_BUFFER_PREFIX, sizeof(DNS_BUFFER_PREFIX));
-	buffer_offset += sizeof(DNS_BUFFER_PREFIX);
+	write_u16(buffer + buffer_offset, obj.id);
+	write_u16(buffer + buffer_offset + 2, DNS_FLAG_RD);
+	write_u16(buffer + buffer_offset + 4, 1);
+	write_u16(buffer + buffer_offset + 6, 0);
+	write_u16(buffer + buffer_offset + 8, 0);
+	write_u16(buffer + buffer_offset + 10, 0);
+	
+	buffer_offset += DNS_HEADER_SIZE;
 	
 	const char* label_start = obj.domain_name;
 	
 	// Encode domain name using the DNS name notation
-	for (size_t index = 0; index < domain_size; index++) {
-		const char* ch = &obj.domain_name[index];
+	for (size_t index = 0; index < domain_size + 1; index++) {
+		const char* const ch = &obj.domain_name[index];
 		
 		if (*ch == '.' || *ch == '\0') {
-			const size_t label_length = ch - label_start;
+			const size_t label_length = (size_t) (ch - label_start);
+			
+			// Trailing dot (fully qualified domain name)
+			if (label_length == 0 && *ch == '\0' && index > 0) {
+				break;
+			}
+			
+			if (label_length < MIN_LABEL_SIZE || label_length > MAX_LABEL_SIZE) {
+				free(buffer);
+				return label_length < MIN_LABEL_SIZE ? UNALIXERR_URI_HOSTNAME_LABEL_EMPTY : UNALIXERR_URI_HOSTNAME_LABEL_TOO_LONG;
+			}
 			
-			buffer[buffer_offset++] = label_length;
+			buffer[buffer_offset++] = (char) label_length;
 			memcpy(buffer + buffer_offset, label_start, label_length);
 			buffer_offset += label_length;
 			
@@ -172,295 +181,939 @@ int dns_request_stringify(const struct DNSRequest obj, char** dst, size_t* dst_s
 		}
 	}
 	
-	memcpy(buffer + buffer_offset, DNS_BUFFER_SUFFIX, sizeof(DNS_BUFFER_SUFFIX));
-	buffer_offset += sizeof(DNS_BUFFER_SUFFIX);
-	buffer[buffer_offset - 3] = (char) obj.qtype;
+	buffer[buffer_offset++] = '\0';
+	
+	write_u16(buffer + buffer_offset, (unsigned short) obj.qtype);
+	write_u16(buffer + buffer_offset + 2, DNS_CLASS_IN);
+	
+	buffer_offset += 4;
+	
+	if (length_field_required) {
+		write_u16(buffer, (unsigned short) (buffer_offset - TCP_LENGTH_FIELD_SIZE));
+	}
 	
 	*dst = buffer;
-	*dst_size = buffer_size;
+	*dst_size = buffer_offset;
 	
 	return UNALIXERR_SUCCESS;
 	
 }
 
-int dns_query(
-	const char* domain_name,
-	const int port,
-	const struct URI dns_server,
-	struct Address* res
-) {
+static int read_name(const unsigned char* const message, const size_t message_size, size_t* offset, char* dst) {
+	/*
+	Decodes the (possibly compressed) domain name at *offset into dotted notation.
+	On return, *offset points right after the name as it appears at its original position.
+	*/
 	
-	struct DNSRequest dns_request = {.domain_name = domain_name};
+	size_t position = *offset;
+	size_t name_size = 0;
 	
-	if (strcmp(dns_server.scheme, "https") == 0) {
-		dns_request.specification = DNS_OVER_HTTPS;
-	} else if (strcmp(dns_server.scheme, "tls") == 0) {
-		dns_request.specification = DNS_OVER_TLS;
-	} else if (strcmp(dns_server.scheme, "udp") == 0) {
-		dns_request.specification = DNS_OVER_PLAIN_UDP;
-	} else if (strcmp(dns_server.scheme, "tcp") == 0) {
-		dns_request.specification = DNS_OVER_PLAIN_TCP;
-	} else {
-		return UNALIXERR_DNS_UNSUPPORTED_PROTOCOL;
-	}
+	int total_pointers = 0;
+	int jumped = 0;
 	
-	const char* sa = dns_server.hostname;
-	int sa_port = dns_server.port;
+	*dst = '\0';
 	
-	if (sa_port < MIN_PORT_NUMBER) {
-		switch (dns_request.specification) {
-			case DNS_OVER_HTTPS:
-				sa_port = 443;
-				break;
-			case DNS_OVER_TLS:
-				sa_port = 853;
-				break;
-			case DNS_OVER_PLAIN_UDP:
-			case DNS_OVER_PLAIN_TCP:
-				sa_port = 53;
-				break;
+	while (1) {
+		if (position >= message_size) {
+			return UNALIXERR_DNS_MALFORMED_RESPONSE;
+		}
+		
+		const unsigned char length = message[position];
+		
+		if ((length & DNS_POINTER_MASK) == DNS_POINTER_MASK) {
+			if (position + 1 >= message_size || ++total_pointers > DNS_MAX_POINTERS) {
+				return UNALIXERR_DNS_MALFORMED_RESPONSE;
+			}
+			
+			if (!jumped) {
+				*offset = position + 2;
+				jumped = 1;
+			}
+			
+			position = ((size_t) (length & ~DNS_POINTER_MASK) << 8) | message[position + 1];
+			
+			continue;
+		}
+		
+		if ((length & DNS_POINTER_MASK) != 0) {
+			return UNALIXERR_DNS_MALFORMED_RESPONSE;
 		}
-	}
-	
-	struct Address address = {};
-	
-	if (address_parse(&address, sa, sa_port) != UNALIXERR_SUCCESS) {
-		struct addrinfo hints = {.ai_family = AF_UNSPEC};
-		struct addrinfo* res = NULL;
 		
-		char value[intlen(sa_port) + 1];
-		snprintf(value, sizeof(value), "%i", sa_port);
+		position++;
 		
-		if (getaddrinfo(sa, value, &hints, &res) != 0) {
-			return UNALIXERR_DNS_GAI_FAILURE;
+		if (length == 0) {
+			break;
 		}
 		
-		memcpy(&address.addr_storage, res->ai_addr, res->ai_addrlen);
+		if (position + length > message_size || name_size + length + 1 > DNS_MAX_NAME_SIZE) {
+			return UNALIXERR_DNS_MALFORMED_RESPONSE;
+		}
+		
+		if (name_size > 0) {
+			dst[name_size++] = '.';
+		}
 		
-		address.af = res->ai_family;
-		address.addr_storage_size = res->ai_addrlen;
+		memcpy(dst + name_size, message + position, length);
+		name_size += length;
 		
-		freeaddrinfo(res);
+		position += length;
+	}
+	
+	dst[name_size] = '\0';
+	
+	if (!jumped) {
+		*offset = position;
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int name_equals(const char* const a, const char* const b) {
+	/*
+	Compares two domain names, ignoring case and the trailing dot of fully qualified names.
+	*/
+	
+	size_t a_size = strlen(a);
+	size_t b_size = strlen(b);
+	
+	if (a_size > 0 && a[a_size - 1] == '.') {
+		a_size--;
 	}
 	
-	const int domain = (address.af);
-	const int type = (dns_request.specification == DNS_OVER_PLAIN_UDP ? SOCK_DGRAM : SOCK_STREAM);
-	const int protocol = (type == SOCK_DGRAM ? IPPROTO_UDP : IPPROTO_TCP);
+	if (b_size > 0 && b[b_size - 1] == '.') {
+		b_size--;
+	}
+	
+	return (a_size == b_size && strncasecmp(a, b, a_size) == 0);
+	
+}
+
+int dns_response_parse(const struct DNSRequest request, const unsigned char* response, const size_t response_size, struct Addresses* dst, int* ttl) {
+	/*
+	Parses a DNS response, appending every address of the requested type to dst.
+	CNAME records are followed, and ttl is set to the lowest TTL seen along the chain.
+	An empty answer (NODATA) is not an error.
+	*/
+	
+	if (response_size < DNS_HEADER_SIZE) {
+		return UNALIXERR_DNS_MALFORMED_RESPONSE;
+	}
+	
+	const unsigned short id = read_u16(response);
+	const unsigned short flags = read_u16(response + 2);
+	const unsigned short qdcount = read_u16(response + 4);
+	const unsigned short ancount = read_u16(response + 6);
+	
+	if (id != request.id || (flags & DNS_FLAG_QR) == 0 || qdcount != 1) {
+		return UNALIXERR_DNS_MALFORMED_RESPONSE;
+	}
+	
+	if ((flags & DNS_FLAG_TC) != 0) {
+		return UNALIXERR_DNS_TRUNCATED_RESPONSE;
+	}
+	
+	const unsigned short rcode = flags & DNS_RCODE_MASK;
+	
+	if (rcode == DNS_RCODE_NXDOMAIN) {
+		return UNALIXERR_DNS_NXDOMAIN;
+	}
 	
-	for (size_t index = 0; index < sizeof(QTYPES) / sizeof(*QTYPES); index++) {
-		dns_request.qtype = QTYPES[index];
+	if (rcode != 0) {
+		return UNALIXERR_DNS_SERVER_FAILURE;
+	}
+	
+	size_t offset = DNS_HEADER_SIZE;
+	
+	// Question section
+	char name[DNS_MAX_NAME_SIZE + 1];
+	
+	int code = read_name(response, response_size, &offset, name);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	if (offset + 4 > response_size) {
+		return UNALIXERR_DNS_MALFORMED_RESPONSE;
+	}
+	
+	if (!name_equals(name, request.domain_name) || read_u16(response + offset) != (unsigned short) request.qtype) {
+		return UNALIXERR_DNS_MALFORMED_RESPONSE;
+	}
+	
+	offset += 4;
+	
+	// Answer section
+	const size_t total_records = ancount > DNS_MAX_ANSWERS ? DNS_MAX_ANSWERS : ancount;
+	
+	struct DNSRecord* records = NULL;
+	
+	if (total_records > 0) {
+		records = (struct DNSRecord*) malloc(sizeof(*records) * total_records);
 		
-		char* request = NULL;
-		size_t request_size = 0;
+		if (records == NULL) {
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+	}
+	
+	for (size_t index = 0; index < total_records; index++) {
+		struct DNSRecord* const record = &records[index];
 		
-		const int code = dns_request_stringify(dns_request, &request, &request_size);
+		code = read_name(response, response_size, &offset, record->name);
 		
 		if (code != UNALIXERR_SUCCESS) {
+			free(records);
 			return code;
 		}
 		
-		if (dns_request.specification == DNS_OVER_HTTPS) {
-			struct HTTPRequest http_request = {
-				.version = HTTP10,
-				.method = POST
-			};
+		if (offset + 10 > response_size) {
+			free(records);
+			return UNALIXERR_DNS_MALFORMED_RESPONSE;
+		}
+		
+		record->type = read_u16(response + offset);
+		record->ttl = read_u32(response + offset + 4);
+		record->rdata_size = read_u16(response + offset + 8);
+		record->rdata_offset = offset + 10;
+		
+		// Records of any other class are never relevant to us
+		if (read_u16(response + offset + 2) != DNS_CLASS_IN) {
+			record->type = 0;
+		}
+		
+		offset = record->rdata_offset + record->rdata_size;
+		
+		if (offset > response_size) {
+			free(records);
+			return UNALIXERR_DNS_MALFORMED_RESPONSE;
+		}
+	}
+	
+	// Follow the CNAME chain, starting from the name we asked for
+	char target[DNS_MAX_NAME_SIZE + 1];
+	strcpy(target, request.domain_name);
+	
+	unsigned int lowest_ttl = 0x7FFFFFFF;
+	
+	for (int hops = 0; hops <= DNS_MAX_CNAME_CHAIN; hops++) {
+		int is_alias = 0;
+		
+		for (size_t index = 0; index < total_records; index++) {
+			const struct DNSRecord* const record = &records[index];
 			
-			http_request_set_uri(&http_request, dns_server);
+			if (record->type != DNS_QTYPE_CNAME || !name_equals(record->name, target)) {
+				continue;
+			}
 			
-			http_headers_add(&http_request.headers, "Accept", "application/dns-udpwireformat");
-			http_headers_add(&http_request.headers, "Accept-Encoding", "identity");
-			http_headers_add(&http_request.headers, "Connection", "close");
-			http_headers_add(&http_request.headers, "Content-Type", "application/dns-udpwireformat");
+			size_t rdata_offset = record->rdata_offset;
+			code = read_name(response, response_size, &rdata_offset, target);
 			
-			http_body_set(&http_request.body, request, request_size);
+			if (code != UNALIXERR_SUCCESS) {
+				free(records);
+				return code;
+			}
 			
-			free(request);
+			if (record->ttl < lowest_ttl) {
+				lowest_ttl = record->ttl;
+			}
 			
-			const int code = http_request_stringify(&http_request, &request, &request_size);
+			is_alias = 1;
 			
-			http_request_free(&http_request);
+			break;
+		}
+		
+		if (!is_alias) {
+			break;
+		}
+	}
+	
+	const size_t rdata_size = request.qtype == DNS_QTYPE_A ? IPV4_ADDRESS_SIZE : IPV6_ADDRESS_SIZE;
+	const size_t initial_offset = dst->offset;
+	
+	unsigned int lowest_address_ttl = 0x7FFFFFFF;
+	
+	for (size_t index = 0; index < total_records && dst->offset < MAX_ADDRESSES; index++) {
+		const struct DNSRecord* const record = &records[index];
+		
+		if (record->type != (unsigned short) request.qtype || record->rdata_size != rdata_size || !name_equals(record->name, target)) {
+			continue;
+		}
+		
+		struct Address* const address = &dst->items[dst->offset];
+		memset(address, 0, sizeof(*address));
+		
+		if (request.qtype == DNS_QTYPE_A) {
+			struct sockaddr_in* const addr_in = (struct sockaddr_in*) &address->addr_storage;
 			
-			if (code != UNALIXERR_SUCCESS) {
-				return code;
+			addr_in->sin_family = AF_INET;
+			memcpy(&addr_in->sin_addr, response + record->rdata_offset, rdata_size);
+			
+			address->af = AF_INET;
+			address->addr_storage_size = sizeof(*addr_in);
+		} else {
+			struct sockaddr_in6* const addr_in6 = (struct sockaddr_in6*) &address->addr_storage;
+			
+			addr_in6->sin6_family = AF_INET6;
+			memcpy(&addr_in6->sin6_addr, response + record->rdata_offset, rdata_size);
+			
+			address->af = AF_INET6;
+			address->addr_storage_size = sizeof(*addr_in6);
+		}
+		
+		if (record->ttl < lowest_address_ttl) {
+			lowest_address_ttl = record->ttl;
+		}
+		
+		dst->offset++;
+	}
+	
+	free(records);
+	
+	if (dst->offset > initial_offset) {
+		if (lowest_address_ttl < lowest_ttl) {
+			lowest_ttl = lowest_address_ttl;
+		}
+		
+		*ttl = (int) lowest_ttl;
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int dns_server_parse(struct DNSServer* obj, const char* const uri) {
+	/*
+	Parses a DNS server specification such as "udp://192.0.2.1" or "tcp://[2001:db8::1]:5353".
+	*/
+	
+	struct URI server = {0};
+	
+	int code = uri_parse(&server, uri);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		uri_free(&server);
+		return code;
+	}
+	
+	if (strcmp(server.scheme, "udp") == 0) {
+		obj->specification = DNS_OVER_PLAIN_UDP;
+	} else if (strcmp(server.scheme, "tcp") == 0) {
+		obj->specification = DNS_OVER_PLAIN_TCP;
+	} else {
+		uri_free(&server);
+		return UNALIXERR_DNS_UNSUPPORTED_PROTOCOL;
+	}
+	
+	// The server itself must not require name resolution
+	code = address_parse(&obj->address, server.hostname, server.port > 0 ? server.port : DNS_DEFAULT_PORT);
+	
+	uri_free(&server);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	if (obj->timeout < 1) {
+		obj->timeout = DNS_DEFAULT_TIMEOUT;
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int wait_socket(const int fd, const short events, const unsigned long long deadline) {
+	/*
+	Waits until the socket is ready for events or the deadline is reached.
+	*/
+	
+	while (1) {
+		const unsigned long long now = get_monotonic_time();
+		
+		if (now >= deadline) {
+			return UNALIXERR_DNS_TIMEOUT;
+		}
+		
+		struct pollfd pfd = {
+			.fd = fd,
+			.events = events
+		};
+		
+		const int rc = poll(&pfd, 1, (int) (deadline - now));
+		
+		if (rc > 0) {
+			return UNALIXERR_SUCCESS;
+		}
+		
+		if (rc < 0 && !socket_in_progress()) {
+			return UNALIXERR_SOCKET_FAILURE;
+		}
+	}
+	
+}
+
+static void query_answer(struct DNSQuery* queries, const size_t total_queries, const unsigned char* message, const size_t message_size) {
+	/*
+	Matches an incoming message against the outstanding queries by ID and parses it.
+	Messages that don't belong to any of them are silently dropped.
+	*/
+	
+	if (message_size < 2) {
+		return;
+	}
+	
+	const unsigned short id = read_u16(message);
+	
+	for (size_t index = 0; index < total_queries; index++) {
+		struct DNSQuery* const query = &queries[index];
+		
+		if (query->is_done || query->request.id != id) {
+			continue;
+		}
+		
+		const int code = dns_response_parse(query->request, message, message_size, &query->addresses, &query->ttl);
+		
+		if (code == UNALIXERR_DNS_MALFORMED_RESPONSE) {
+			// Might be spoofed or belong to a previous transmission; keep waiting
+			return;
+		}
+		
+		if (code == UNALIXERR_DNS_TRUNCATED_RESPONSE) {
+			query->is_truncated = 1;
+		} else {
+			query->code = code;
+		}
+		
+		query->is_done = 1;
+		
+		return;
+	}
+	
+}
+
+static int queries_settle(struct DNSQuery* queries, const size_t total_queries, const int code) {
+	/*
+	Fails the queries that are still pending with code. The lookup as a whole only fails if none of
+	them had completed; an A answer is still worth having when the AAAA query never got one.
+	*/
+	
+	size_t total_done = 0;
+	
+	for (size_t index = 0; index < total_queries; index++) {
+		struct DNSQuery* const query = &queries[index];
+		
+		if (query->is_done) {
+			total_done++;
+			continue;
+		}
+		
+		query->code = code;
+		query->is_done = 1;
+	}
+	
+	return total_done > 0 ? UNALIXERR_SUCCESS : code;
+	
+}
+
+static int query_udp(const struct DNSServer* server, struct DNSQuery* queries, const size_t total_queries, const unsigned long long deadline) {
+	
+	const int fd = (int) socket(server->address.af, SOCK_DGRAM, IPPROTO_UDP);
+	
+	if (fd == -1) {
+		return UNALIXERR_SOCKET_FAILURE;
+	}
+	
+	int code = socket_set_blocking(fd, 0);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		socket_close(fd);
+		return code;
+	}
+	
+	// A connected UDP socket only receives datagrams coming from the server
+	if (connect(fd, (const struct sockaddr*) &server->address.addr_storage, server->address.addr_storage_size) != 0) {
+		socket_close(fd);
+		return UNALIXERR_SOCKET_CONNECT_FAILURE;
+	}
+	
+	unsigned long long next_transmission = 0;
+	
+	while (1) {
+		size_t total_pending = 0;
+		
+		for (size_t index = 0; index < total_queries; index++) {
+			total_pending += !queries[index].is_done;
+		}
+		
+		if (total_pending == 0) {
+			break;
+		}
+		
+		const unsigned long long now = get_monotonic_time();
+		
+		if (now >= deadline) {
+			socket_close(fd);
+			return queries_settle(queries, total_queries, UNALIXERR_DNS_TIMEOUT);
+		}
+		
+		// (Re)transmit every pending query in parallel
+		if (now >= next_transmission) {
+			for (size_t index = 0; index < total_queries; index++) {
+				const struct DNSQuery* const query = &queries[index];
+				
+				if (!query->is_done) {
+					send(fd, query->buffer, query->buffer_size, 0);
+				}
 			}
+			
+			next_transmission = now + DNS_RETRANSMIT_INTERVAL;
 		}
 		
-		char response[MAX_BUFFER_SIZE + 1];
-		size_t response_size = sizeof(response);
+		code = wait_socket(fd, POLLIN, next_transmission < deadline ? next_transmission : deadline);
 		
-		struct sockaddr* addr = (struct sockaddr*) &address.addr_storage;
-		socklen_t addrlen = address.addr_storage_size;
+		if (code == UNALIXERR_DNS_TIMEOUT) {
+			continue;
+		}
 		
-		int fd = socket_create(domain, type, protocol);
+		if (code != UNALIXERR_SUCCESS) {
+			socket_close(fd);
+			return queries_settle(queries, total_queries, code);
+		}
 		
-		if (protocol == IPPROTO_TCP) {
-			if (socket_connect(fd, addr, addrlen) != UNALIXERR_SUCCESS) {
-				socket_close(fd);
-				return code;
+		while (1) {
+			unsigned char message[DNS_MAX_UDP_MESSAGE_SIZE * 8];
+			const ssize_t size = recv(fd, (char*) message, sizeof(message), 0);
+			
+			if (size < 0) {
+				break;
 			}
 			
-			if (dns_request.specification == DNS_OVER_PLAIN_TCP) {
-				const ssize_t ssize = socket_send(fd, request, request_size, NULL, 0);
-				
-				free(request);
-				
-				if (ssize != (ssize_t) request_size) {
+			query_answer(queries, total_queries, message, (size_t) size);
+		}
+	}
+	
+	socket_close(fd);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int query_tcp(const struct DNSServer* server, struct DNSQuery* queries, const size_t total_queries, const unsigned long long deadline) {
+	
+	const int fd = (int) socket(server->address.af, SOCK_STREAM, IPPROTO_TCP);
+	
+	if (fd == -1) {
+		return UNALIXERR_SOCKET_FAILURE;
+	}
+	
+	int code = socket_set_blocking(fd, 0);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		socket_close(fd);
+		return code;
+	}
+	
+	if (connect(fd, (const struct sockaddr*) &server->address.addr_storage, server->address.addr_storage_size) != 0) {
+		if (!socket_in_progress()) {
+			socket_close(fd);
+			return UNALIXERR_SOCKET_CONNECT_FAILURE;
+		}
+		
+		code = wait_socket(fd, POLLOUT, deadline);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			socket_close(fd);
+			return code;
+		}
+		
+		int error = 0;
+		socklen_t error_size = sizeof(error);
+		
+		if (getsockopt(fd, SOL_SOCKET, SO_ERROR, (char*) &error, &error_size) != 0 || error != 0) {
+			socket_close(fd);
+			return UNALIXERR_SOCKET_CONNECT_FAILURE;
+		}
+	}
+	
+	// Pipeline all queries over the same connection
+	for (size_t index = 0; index < total_queries; index++) {
+		const struct DNSQuery* const query = &queries[index];
+		
+		if (query->is_done) {
+			continue;
+		}
+		
+		size_t offset = 0;
+		
+		while (offset < query->buffer_size) {
+			const ssize_t size = send(fd, query->buffer + offset, query->buffer_size - offset, 0);
+			
+			if (size < 0) {
+				if (!socket_in_progress()) {
 					socket_close(fd);
-					return UNALIXERR_SOCKET_SEND_ERROR;
+					return UNALIXERR_SOCKET_SEND_FAILURE;
 				}
 				
-				const ssize_t rsize = socket_recv(fd, response, response_size, NULL, 0);
-				
-				socket_close(fd);
+				code = wait_socket(fd, POLLOUT, deadline);
 				
-				if (rsize < (ssize_t) MIN_BUFFER_SIZE) {
-					return UNALIXERR_SOCKET_RECV_ERROR;
-				}
-				
-				if (rsize > (ssize_t) MAX_BUFFER_SIZE) {
-					return UNALIXERR_SOCKET_MAX_BUFFER_SIZE_EXCEEDED;
-				}
-				
-				response_size = rsize;
-			} else {
-				br_ssl_client_context sc = {};
-				br_x509_minimal_context xc = {};
-				unsigned char iobuf[BR_SSL_BUFSIZE_BIDI];
-				br_sslio_context ioc = {};
-				
-				br_ssl_client_init_full(&sc, &xc, TAs, TAs_NUM);
-				br_ssl_engine_set_buffer(&sc.eng, iobuf, sizeof(iobuf), 1);
-				br_ssl_client_reset(&sc, sa, 0);
-				br_sslio_init(&ioc, &sc.eng, sock_read, &fd, sock_write, &fd);
-				
-				br_sslio_write_all(&ioc, request, request_size);
-				br_sslio_flush(&ioc);
-				
-				free(request);
-				
-				const size_t rsize = br_sslio_read(&ioc, response, response_size);
-				
-				br_sslio_close(&ioc);
-				socket_close(fd);
-				
-				const int code = br_ssl_engine_last_error(&sc.eng);
-				
-				if (code != BR_ERR_OK && code != BR_ERR_IO) {
-					return UNALIXERR_SSL_FAILURE;
-				}
-				
-				if (rsize > MAX_BUFFER_SIZE) {
-					return UNALIXERR_SOCKET_MAX_BUFFER_SIZE_EXCEEDED;
+				if (code != UNALIXERR_SUCCESS) {
+					socket_close(fd);
+					return code;
 				}
 				
-				response_size = rsize;
-			}
-		} else {
-			const size_t ssize = socket_send(fd, request, request_size, addr, addrlen);
-			
-			free(request);
-			
-			if (ssize != request_size) {
-				socket_close(fd);
-				return UNALIXERR_SOCKET_SEND_ERROR;
-			};
-			
-			const size_t rsize = socket_recv(fd, response, response_size, addr, &addrlen);
-			
-			socket_close(fd);
-			
-			if (rsize < MIN_BUFFER_SIZE) {
-				return UNALIXERR_SOCKET_RECV_ERROR;
+				continue;
 			}
 			
-			if (rsize > MAX_BUFFER_SIZE) {
-				return UNALIXERR_SOCKET_MAX_BUFFER_SIZE_EXCEEDED;
+			offset += (size_t) size;
+		}
+	}
+	
+	unsigned char* buffer = (unsigned char*) malloc(TCP_LENGTH_FIELD_SIZE + DNS_MAX_MESSAGE_SIZE);
+	
+	if (buffer == NULL) {
+		socket_close(fd);
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	size_t buffer_offset = 0;
+	
+	while (1) {
+		size_t total_pending = 0;
+		
+		for (size_t index = 0; index < total_queries; index++) {
+			total_pending += !queries[index].is_done;
+		}
+		
+		if (total_pending == 0) {
+			break;
+		}
+		
+		code = wait_socket(fd, POLLIN, deadline);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			break;
+		}
+		
+		const ssize_t size = recv(fd, (char*) buffer + buffer_offset, TCP_LENGTH_FIELD_SIZE + DNS_MAX_MESSAGE_SIZE - buffer_offset, 0);
+		
+		if (size == 0) {
+			code = UNALIXERR_SOCKET_RECV_FAILURE;
+			break;
+		}
+		
+		if (size < 0) {
+			if (socket_in_progress()) {
+				continue;
 			}
 			
-			response_size = rsize;
+			code = UNALIXERR_SOCKET_RECV_FAILURE;
+			break;
 		}
 		
-		if (dns_request.specification == DNS_OVER_HTTPS) {
-			struct HTTPResponse http_response = {};
-			
-			const int code = http_response_parse(&http_response, response, response_size);
-			
-			if (code != UNALIXERR_SUCCESS) {
-				return code;
-			}
+		buffer_offset += (size_t) size;
+		
+		// Consume every complete message we have so far
+		while (buffer_offset >= TCP_LENGTH_FIELD_SIZE) {
+			const size_t message_size = read_u16(buffer);
 			
-			if (http_response.status.code != OK) {
-				return UNALIXERR_DOH_BAD_STATUS_CODE;
+			if (buffer_offset < TCP_LENGTH_FIELD_SIZE + message_size) {
+				break;
 			}
 			
-			memcpy(response, http_response.body.content, http_response.body.size);
-			response_size = http_response.body.size;
+			query_answer(queries, total_queries, buffer + TCP_LENGTH_FIELD_SIZE, message_size);
 			
-			http_response_free(&http_response);
+			buffer_offset -= TCP_LENGTH_FIELD_SIZE + message_size;
+			memmove(buffer, buffer + TCP_LENGTH_FIELD_SIZE + message_size, buffer_offset);
 		}
+	}
+	
+	free(buffer);
+	socket_close(fd);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return queries_settle(queries, total_queries, code);
+	}
+	
+	return code;
+	
+}
+
+static void queries_free(struct DNSQuery* queries, const size_t total_queries) {
+	
+	for (size_t index = 0; index < total_queries; index++) {
+		struct DNSQuery* const query = &queries[index];
 		
-		if (memcmp(response, "\x00\x00", 2) != 0) {
-			return UNALIXERR_DNS_MALFORMED_RESPONSE;
+		if (query->buffer != NULL) {
+			free(query->buffer);
+			query->buffer = NULL;
+		}
+	}
+	
+}
+
+static int queries_prepare(struct DNSQuery* queries, const size_t total_queries, const enum DNSSpecification specification) {
+	
+	for (size_t index = 0; index < total_queries; index++) {
+		struct DNSQuery* const query = &queries[index];
+		
+		if (query->is_done) {
+			continue;
 		}
 		
-		if (memcmp(response + 2, "\x81\x80", 2) != 0) {
-			return UNALIXERR_DNS_NXDOMAIN;
+		if (query->buffer != NULL) {
+			free(query->buffer);
+			query->buffer = NULL;
 		}
-		print_dns_response((unsigned char*) response);
-		for (int i =0; i<response_size;i++) {
-			printf("0x%X ", response[i]);
-			printf("%c ", response[i]);
+		
+		query->request.specification = specification;
+		query->request.id = dns_generate_id();
+		
+		const int code = dns_request_stringify(query->request, &query->buffer, &query->buffer_size);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
 		}
-		exit (0);
-		printf("qt %i\n", dns_request.qtype);
-		switch (dns_request.qtype) {
-			case A: {
-				const size_t rdlength = response[response_size - 5];
-				
-				if (rdlength != IPV4_ADDRESS_SIZE) {
-					puts("a");
-					continue;
-				}
-				
-				char address[MAX_IPV4_ADDRESS_SIZE + 1];
-				inet_ntop(AF_INET, &response[response_size - IPV4_ADDRESS_SIZE], address, sizeof(address));
-				
-				printf("k %i\n", address_parse(res, address, port));
-				
-				return UNALIXERR_SUCCESS;
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int dns_query(const struct DNSServer* server, const char* const domain_name, struct Addresses* dst, int* ttl) {
+	/*
+	Resolves domain_name into its IPv4 and IPv6 addresses.
+	
+	Both queries are sent in parallel through non-blocking sockets and the whole operation is bounded by the server timeout.
+	Answers truncated over UDP are retried over TCP. Queries left unanswered fail on their own, without
+	discarding the answers that did arrive.
+	*/
+	
+	struct DNSQuery queries[TOTAL_QTYPES];
+	memset(queries, 0, sizeof(queries));
+	
+	for (size_t index = 0; index < TOTAL_QTYPES; index++) {
+		struct DNSQuery* const query = &queries[index];
+		
+		query->request.qtype = QTYPES[index];
+		query->request.domain_name = domain_name;
+		query->ttl = -1;
+	}
+	
+	const unsigned long long deadline = get_monotonic_time() + (unsigned long long) server->timeout;
+	
+	int code = queries_prepare(queries, TOTAL_QTYPES, server->specification);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		queries_free(queries, TOTAL_QTYPES);
+		return code;
+	}
+	
+	if (server->specification == DNS_OVER_PLAIN_UDP) {
+		code = query_udp(server, queries, TOTAL_QTYPES, deadline);
+		
+		int is_truncated = 0;
+		
+		for (size_t index = 0; index < TOTAL_QTYPES; index++) {
+			struct DNSQuery* const query = &queries[index];
+			
+			if (query->is_truncated) {
+				query->is_done = 0;
+				query->is_truncated = 0;
+				is_truncated = 1;
 			}
-			case AAAA: {
-				const int rdlength = (int) response[response_size - (IPV6_ADDRESS_SIZE + 1)];
-				printf("rdlength = %i\n", rdlength);
-				if (rdlength != IPV6_ADDRESS_SIZE) {
-					puts("b");
-					continue;
-				}
-				
-				char address[MAX_IPV6_ADDRESS_SIZE + 1];
-				inet_ntop(AF_INET6, &response[response_size - IPV6_ADDRESS_SIZE], address, sizeof(address));
-				
-				printf("k %i\n", address_parse(res, address, port));
-				
-				return UNALIXERR_SUCCESS;
+		}
+		
+		if (code == UNALIXERR_SUCCESS && is_truncated) {
+			code = queries_prepare(queries, TOTAL_QTYPES, DNS_OVER_PLAIN_TCP);
+			
+			if (code == UNALIXERR_SUCCESS) {
+				code = query_tcp(server, queries, TOTAL_QTYPES, deadline);
 			}
 		}
+	} else {
+		code = query_tcp(server, queries, TOTAL_QTYPES, deadline);
+	}
+	
+	queries_free(queries, TOTAL_QTYPES);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	dst->offset = 0;
+	*ttl = -1;
+	
+	int total_nxdomain = 0;
+	int last_error = UNALIXERR_DNS_NO_ADDRESS;
+	
+	for (size_t index = 0; index < TOTAL_QTYPES; index++) {
+		const struct DNSQuery* const query = &queries[index];
+		
+		if (query->code != UNALIXERR_SUCCESS) {
+			total_nxdomain += (query->code == UNALIXERR_DNS_NXDOMAIN);
+			last_error = query->code;
+			
+			continue;
+		}
+		
+		for (size_t address_index = 0; address_index < query->addresses.offset && dst->offset < MAX_ADDRESSES; address_index++) {
+			dst->items[dst->offset++] = query->addresses.items[address_index];
+		}
+		
+		if (query->addresses.offset > 0 && (*ttl == -1 || query->ttl < *ttl)) {
+			*ttl = query->ttl;
+		}
+	}
+	
+	if (dst->offset < 1) {
+		return total_nxdomain == (int) TOTAL_QTYPES ? UNALIXERR_DNS_NXDOMAIN : last_error;
 	}
 	
 	return UNALIXERR_SUCCESS;
 	
 }
 
-int main() {
-	struct URI uri = {};
-	uri_parse(&uri, "https://doh-ch.blahdns.com/dns-query");
-	struct Address address = {};
-	printf("%i\n", dns_query("g.co", 80, uri, &address));
+/*
+The server used by unalix_dns_set_server(). Lookups already in flight hold a reference to the one they
+started with, so replacing it never pulls it out from under them; it is freed by whoever drops the last
+reference.
+*/
+struct SharedDNSServer {
+	struct DNSServer server;
+	size_t references;
+};
+
+static struct Mutex server_mutex = MUTEX_INITIALIZER;
+static struct SharedDNSServer* default_server = NULL;
+
+static struct SharedDNSServer* server_acquire(void) {
 	
-	char host[NI_MAXHOST];
-	char port[NI_MAXSERV];
-	getnameinfo((struct sockaddr*) &address.addr_storage, address.addr_storage_size, host, sizeof(host), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV);
+	mutex_lock(&server_mutex);
 	
-	printf("Got connection from %s on port %s\n", host, port);
+	struct SharedDNSServer* const server = default_server;
 	
-}
\ No newline at end of file
+	if (server != NULL) {
+		server->references++;
+	}
+	
+	mutex_unlock(&server_mutex);
+	
+	return server;
+	
+}
+
+static void server_release(struct SharedDNSServer* server) {
+	
+	if (server == NULL) {
+		return;
+	}
+	
+	mutex_lock(&server_mutex);
+	
+	const int is_unused = (--server->references == 0);
+	
+	mutex_unlock(&server_mutex);
+	
+	if (is_unused) {
+		free(server);
+	}
+	
+}
+
+static void server_replace(struct SharedDNSServer* server) {
+	
+	mutex_lock(&server_mutex);
+	
+	struct SharedDNSServer* const previous = default_server;
+	default_server = server;
+	
+	mutex_unlock(&server_mutex);
+	
+	server_release(previous);
+	
+}
+
+static int dns_resolve(
+	const char* const hostname,
+	struct sockaddr_storage* addresses,
+	size_t* total_addresses,
+	int* ttl,
+	void* userdata
+) {
+	/*
+	Resolver hook for the DNS cache backed by the built-in stub resolver.
+	*/
+	
+	(void) userdata;
+	
+	struct SharedDNSServer* const server = server_acquire();
+	
+	// Only lookups racing with unalix_dns_set_server(NULL) get here
+	if (server == NULL) {
+		return UNALIXERR_DNS_NO_ADDRESS;
+	}
+	
+	struct Addresses items = {0};
+	int items_ttl = 0;
+	
+	const int code = dns_query(&server->server, hostname, &items, &items_ttl);
+	
+	server_release(server);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	size_t offset = 0;
+	
+	for (size_t index = 0; index < items.offset && offset < *total_addresses; index++) {
+		memcpy(&addresses[offset++], &items.items[index].addr_storage, sizeof(*addresses));
+	}
+	
+	*total_addresses = offset;
+	*ttl = items_ttl;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int unalix_dns_set_server(const char* const uri, const int timeout) {
+	/*
+	Makes the HTTP client resolve hostnames through the built-in stub resolver, querying the given server.
+	Passing NULL switches back to the system resolver.
+	*/
+	
+	if (uri == NULL) {
+		unalix_dns_set_resolver(NULL, NULL);
+		server_replace(NULL);
+		
+		return UNALIXERR_SUCCESS;
+	}
+	
+	if (timeout < 0) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	struct SharedDNSServer* server = (struct SharedDNSServer*) calloc(1, sizeof(*server));
+	
+	if (server == NULL) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	server->server.timeout = timeout;
+	server->references = 1;
+	
+	const int code = dns_server_parse(&server->server, uri);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		free(server);
+		return code;
+	}
+	
+	server_replace(server);
+	
+	unalix_dns_set_resolver(dns_resolve, NULL);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
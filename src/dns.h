@@ -1,17 +1,49 @@
-enum QType {
-	A = 1,
-	AAAA = 28
+#ifndef DNS_H_INCLUDED
+#define DNS_H_INCLUDED
+
+#include <stddef.h>
+
+#include "address.h"
+#include "uri.h"
+
+#define DNS_MAX_NAME_SIZE 255
+
+enum DNSQType {
+	DNS_QTYPE_A = 1,
+	DNS_QTYPE_CNAME = 5,
+	DNS_QTYPE_AAAA = 28
 };
 
-enum DNS {
-	DNS_OVER_HTTPS,
-	DNS_OVER_TLS,
+enum DNSSpecification {
 	DNS_OVER_PLAIN_UDP,
-	DNS_OVER_PLAIN_TCP,
+	DNS_OVER_PLAIN_TCP
 };
 
 struct DNSRequest {
-	enum QType qtype;
+	unsigned short id;
+	enum DNSQType qtype;
 	const char* domain_name;
-	enum DNS specification;
-};
\ No newline at end of file
+	enum DNSSpecification specification;
+};
+
+struct DNSServer {
+	enum DNSSpecification specification;
+	struct Address address;
+	int timeout;
+};
+
+static const int DNS_DEFAULT_PORT = 53;
+static const int DNS_DEFAULT_TIMEOUT = 5000;
+static const int DNS_RETRANSMIT_INTERVAL = 1000;
+
+static const int DNS_MAX_CNAME_CHAIN = 8;
+static const size_t DNS_MAX_UDP_MESSAGE_SIZE = 512;
+static const size_t DNS_MAX_MESSAGE_SIZE = 65535;
+
+int dns_request_stringify(const struct DNSRequest obj, char** dst, size_t* dst_size);
+int dns_response_parse(const struct DNSRequest request, const unsigned char* response, const size_t response_size, struct Addresses* dst, int* ttl);
+
+int dns_server_parse(struct DNSServer* obj, const char* const uri);
+int dns_query(const struct DNSServer* server, const char* const domain_name, struct Addresses* dst, int* ttl);
+
+#endif
@@ -0,0 +1,521 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+	#ifdef _WIN32_WINNT
+		#undef _WIN32_WINNT
+	#endif
+	
+	#define _WIN32_WINNT 0x0600
+	
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+#else
+	#include <netdb.h>
+	#include <strings.h>
+#endif
+
+#include "unalix.h"
+#include "dns_cache.h"
+#include "address.h"
+#include "threads.h"
+#include "errors.h"
+#include "utils.h"
+
+struct DNSCacheEntry {
+	char* hostname;
+	size_t hash;
+	int code;
+	struct Addresses addresses;
+	unsigned long long expires;
+	unsigned long long stale_expires;
+	int is_refreshing;
+	struct DNSCacheEntry* next;
+	struct DNSCacheEntry* previous_used;
+	struct DNSCacheEntry* next_used;
+};
+
+struct DNSCache {
+	struct Mutex mutex;
+	size_t max_entries;
+	size_t total_entries;
+	size_t total_buckets;
+	struct DNSCacheEntry** buckets;
+	struct DNSCacheEntry* most_recently_used;
+	struct DNSCacheEntry* least_recently_used;
+	int ttl;
+	int negative_ttl;
+	int stale_ttl;
+	unalix_resolver_t resolver;
+	void* userdata;
+};
+
+static struct DNSCache cache = {
+	.mutex = MUTEX_INITIALIZER,
+	.max_entries = DNS_CACHE_DEFAULT_MAX_ENTRIES,
+	.ttl = DNS_CACHE_DEFAULT_TTL,
+	.negative_ttl = DNS_CACHE_DEFAULT_NEGATIVE_TTL,
+	.stale_ttl = DNS_CACHE_DEFAULT_STALE_TTL
+};
+
+static int getaddrinfo_resolve(
+	const char* const hostname,
+	struct sockaddr_storage* addresses,
+	size_t* total_addresses,
+	int* ttl,
+	void* userdata
+) {
+	/*
+	Default resolver. getaddrinfo() does not expose record TTLs, so the configured default TTL is used.
+	*/
+	
+	(void) ttl;
+	(void) userdata;
+	
+	const struct addrinfo hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+		.ai_protocol = IPPROTO_TCP
+	};
+	
+	struct addrinfo* res = NULL;
+	
+	if (getaddrinfo(hostname, NULL, &hints, &res) != 0) {
+		return UNALIXERR_DNS_GAI_FAILURE;
+	}
+	
+	size_t offset = 0;
+	
+	for (const struct addrinfo* item = res; item != NULL && offset < *total_addresses; item = item->ai_next) {
+		if (!(item->ai_family == AF_INET || item->ai_family == AF_INET6) || (size_t) item->ai_addrlen > sizeof(*addresses)) {
+			continue;
+		}
+		
+		memset(&addresses[offset], 0, sizeof(*addresses));
+		memcpy(&addresses[offset], item->ai_addr, (size_t) item->ai_addrlen);
+		
+		offset++;
+	}
+	
+	freeaddrinfo(res);
+	
+	*total_addresses = offset;
+	
+	return offset > 0 ? UNALIXERR_SUCCESS : UNALIXERR_DNS_GAI_FAILURE;
+	
+}
+
+static int cache_resolver_resolve(const char* const hostname, struct Addresses* dst, int* ttl) {
+	/*
+	Resolves hostname using the user-supplied resolver, or getaddrinfo() if there is none.
+	Must be called without holding the cache lock.
+	*/
+	
+	mutex_lock(&cache.mutex);
+	
+	const unalix_resolver_t resolver = cache.resolver == NULL ? getaddrinfo_resolve : cache.resolver;
+	void* const userdata = cache.userdata;
+	
+	*ttl = cache.ttl;
+	
+	mutex_unlock(&cache.mutex);
+	
+	struct sockaddr_storage addresses[MAX_ADDRESSES];
+	size_t total_addresses = sizeof(addresses) / sizeof(*addresses);
+	
+	const int code = resolver(hostname, addresses, &total_addresses, ttl, userdata);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	dst->offset = 0;
+	
+	for (size_t index = 0; index < total_addresses && index < MAX_ADDRESSES; index++) {
+		const struct sockaddr_storage* const item = &addresses[index];
+		const socklen_t size = (socklen_t) (item->ss_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+		
+		if (address_from_sockaddr(&dst->items[dst->offset], (const struct sockaddr*) item, size) == UNALIXERR_SUCCESS) {
+			dst->offset++;
+		}
+	}
+	
+	if (dst->offset < 1) {
+		return UNALIXERR_DNS_GAI_FAILURE;
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static void cache_unlink_used(struct DNSCacheEntry* entry) {
+	
+	if (entry->previous_used != NULL) {
+		entry->previous_used->next_used = entry->next_used;
+	} else {
+		cache.most_recently_used = entry->next_used;
+	}
+	
+	if (entry->next_used != NULL) {
+		entry->next_used->previous_used = entry->previous_used;
+	} else {
+		cache.least_recently_used = entry->previous_used;
+	}
+	
+	entry->previous_used = NULL;
+	entry->next_used = NULL;
+	
+}
+
+static void cache_mark_used(struct DNSCacheEntry* entry) {
+	
+	if (cache.most_recently_used == entry) {
+		return;
+	}
+	
+	if (entry->previous_used != NULL || entry->next_used != NULL || cache.least_recently_used == entry) {
+		cache_unlink_used(entry);
+	}
+	
+	entry->next_used = cache.most_recently_used;
+	
+	if (cache.most_recently_used != NULL) {
+		cache.most_recently_used->previous_used = entry;
+	}
+	
+	cache.most_recently_used = entry;
+	
+	if (cache.least_recently_used == NULL) {
+		cache.least_recently_used = entry;
+	}
+	
+}
+
+static struct DNSCacheEntry* cache_find(const char* const hostname, const size_t hash) {
+	
+	if (cache.total_buckets < 1) {
+		return NULL;
+	}
+	
+	struct DNSCacheEntry* entry = cache.buckets[hash % cache.total_buckets];
+	
+	while (entry != NULL) {
+		if (entry->hash == hash && strcasecmp(entry->hostname, hostname) == 0) {
+			return entry;
+		}
+		
+		entry = entry->next;
+	}
+	
+	return NULL;
+	
+}
+
+static void cache_remove(struct DNSCacheEntry* entry) {
+	
+	struct DNSCacheEntry** link = &cache.buckets[entry->hash % cache.total_buckets];
+	
+	while (*link != entry) {
+		link = &(*link)->next;
+	}
+	
+	*link = entry->next;
+	
+	cache_unlink_used(entry);
+	
+	free(entry->hostname);
+	free(entry);
+	
+	cache.total_entries--;
+	
+}
+
+static void cache_store(const char* const hostname, const int code, const struct Addresses* const addresses, const int ttl) {
+	/*
+	Inserts or replaces the entry for hostname. Must be called with the cache lock held.
+	Failures to allocate memory are ignored; the result will simply not be cached.
+	*/
+	
+	if (cache.max_entries < 1) {
+		return;
+	}
+	
+	if (cache.total_buckets < 1) {
+		const size_t total_buckets = cache.max_entries;
+		
+		cache.buckets = (struct DNSCacheEntry**) calloc(total_buckets, sizeof(*cache.buckets));
+		
+		if (cache.buckets == NULL) {
+			return;
+		}
+		
+		cache.total_buckets = total_buckets;
+	}
+	
+	const size_t hash = hash_string(hostname, strlen(hostname));
+	struct DNSCacheEntry* entry = cache_find(hostname, hash);
+	
+	if (entry == NULL) {
+		while (cache.total_entries >= cache.max_entries && cache.least_recently_used != NULL) {
+			cache_remove(cache.least_recently_used);
+		}
+		
+		entry = (struct DNSCacheEntry*) calloc(1, sizeof(*entry));
+		
+		if (entry == NULL) {
+			return;
+		}
+		
+		entry->hostname = (char*) malloc(strlen(hostname) + 1);
+		
+		if (entry->hostname == NULL) {
+			free(entry);
+			return;
+		}
+		
+		strcpy(entry->hostname, hostname);
+		entry->hash = hash;
+		
+		const size_t bucket = hash % cache.total_buckets;
+		
+		entry->next = cache.buckets[bucket];
+		cache.buckets[bucket] = entry;
+		
+		cache.total_entries++;
+	}
+	
+	const unsigned long long now = get_monotonic_time();
+	
+	entry->code = code;
+	entry->expires = now + (unsigned long long) (ttl > 0 ? ttl : 0) * 1000;
+	entry->stale_expires = entry->expires;
+	entry->is_refreshing = 0;
+	
+	if (code == UNALIXERR_SUCCESS) {
+		entry->addresses = *addresses;
+		entry->stale_expires += (unsigned long long) (cache.stale_ttl > 0 ? cache.stale_ttl : 0) * 1000;
+	} else {
+		entry->addresses.offset = 0;
+	}
+	
+	cache_mark_used(entry);
+	
+}
+
+static void cache_refresh(void* argument) {
+	/*
+	Revalidates a stale entry in the background. The entry keeps being served until this finishes.
+	*/
+	
+	char* const hostname = (char*) argument;
+	
+	struct Addresses addresses = {0};
+	int ttl = 0;
+	
+	const int code = cache_resolver_resolve(hostname, &addresses, &ttl);
+	
+	mutex_lock(&cache.mutex);
+	
+	if (code == UNALIXERR_SUCCESS) {
+		cache_store(hostname, code, &addresses, ttl);
+	} else {
+		// Keep serving the stale addresses; retry on the next lookup
+		struct DNSCacheEntry* const entry = cache_find(hostname, hash_string(hostname, strlen(hostname)));
+		
+		if (entry != NULL) {
+			entry->is_refreshing = 0;
+		}
+	}
+	
+	mutex_unlock(&cache.mutex);
+	
+	free(hostname);
+	
+}
+
+static void copy_addresses(struct Addresses* dst, const struct Addresses* const src, const int port) {
+	
+	*dst = *src;
+	
+	for (size_t index = 0; index < dst->offset; index++) {
+		address_set_port(&dst->items[index], port);
+	}
+	
+}
+
+int dns_cache_resolve(const char* const hostname, const int port, struct Addresses* dst) {
+	/*
+	Resolves hostname into a list of addresses, consulting the cache first.
+	
+	Entries are fresh for their TTL. After that, they are still served for up to stale_ttl seconds while a
+	background lookup revalidates them. Failed lookups are remembered for negative_ttl seconds.
+	*/
+	
+	dst->offset = 0;
+	
+	// IP addresses don't need to be resolved
+	if (address_parse(&dst->items[0], hostname, port) == UNALIXERR_SUCCESS) {
+		dst->offset = 1;
+		return UNALIXERR_SUCCESS;
+	}
+	
+	const size_t hash = hash_string(hostname, strlen(hostname));
+	const unsigned long long now = get_monotonic_time();
+	
+	mutex_lock(&cache.mutex);
+	
+	struct DNSCacheEntry* const entry = cache_find(hostname, hash);
+	
+	if (entry != NULL) {
+		if (now < entry->expires) {
+			const int code = entry->code;
+			
+			copy_addresses(dst, &entry->addresses, port);
+			cache_mark_used(entry);
+			
+			mutex_unlock(&cache.mutex);
+			
+			return code;
+		}
+		
+		if (entry->code == UNALIXERR_SUCCESS && now < entry->stale_expires) {
+			copy_addresses(dst, &entry->addresses, port);
+			cache_mark_used(entry);
+			
+			int should_refresh = !entry->is_refreshing;
+			
+			if (should_refresh) {
+				entry->is_refreshing = 1;
+			}
+			
+			mutex_unlock(&cache.mutex);
+			
+			if (should_refresh) {
+				char* const argument = (char*) malloc(strlen(hostname) + 1);
+				
+				if (argument == NULL) {
+					mutex_lock(&cache.mutex);
+					
+					struct DNSCacheEntry* const entry = cache_find(hostname, hash);
+					
+					if (entry != NULL) {
+						entry->is_refreshing = 0;
+					}
+					
+					mutex_unlock(&cache.mutex);
+				} else {
+					strcpy(argument, hostname);
+					
+					// Revalidate synchronously if we can't do it in the background
+					if (thread_create_detached(cache_refresh, argument) != UNALIXERR_SUCCESS) {
+						cache_refresh(argument);
+					}
+				}
+			}
+			
+			return UNALIXERR_SUCCESS;
+		}
+	}
+	
+	mutex_unlock(&cache.mutex);
+	
+	struct Addresses addresses = {0};
+	int ttl = 0;
+	
+	const int code = cache_resolver_resolve(hostname, &addresses, &ttl);
+	
+	mutex_lock(&cache.mutex);
+	cache_store(hostname, code, &addresses, code == UNALIXERR_SUCCESS ? ttl : cache.negative_ttl);
+	mutex_unlock(&cache.mutex);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	copy_addresses(dst, &addresses, port);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static void cache_clear(void) {
+	
+	while (cache.least_recently_used != NULL) {
+		cache_remove(cache.least_recently_used);
+	}
+	
+	free(cache.buckets);
+	
+	cache.buckets = NULL;
+	cache.total_buckets = 0;
+	
+}
+
+int unalix_dns_cache_configure(const size_t max_entries, const int ttl, const int negative_ttl, const int stale_ttl) {
+	
+	if (ttl < 0 || negative_ttl < 0 || stale_ttl < 0) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	mutex_lock(&cache.mutex);
+	
+	cache_clear();
+	
+	cache.max_entries = max_entries;
+	cache.ttl = ttl;
+	cache.negative_ttl = negative_ttl;
+	cache.stale_ttl = stale_ttl;
+	
+	mutex_unlock(&cache.mutex);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int unalix_dns_cache_add(const char* const hostname, const char* const* addresses, const size_t total_addresses, const int ttl) {
+	
+	if (hostname == NULL || *hostname == '\0' || addresses == NULL || total_addresses < 1 || ttl < 0) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	struct Addresses items = {0};
+	
+	for (size_t index = 0; index < total_addresses && index < MAX_ADDRESSES; index++) {
+		const int code = address_parse(&items.items[items.offset], addresses[index], 0);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+		
+		items.offset++;
+	}
+	
+	mutex_lock(&cache.mutex);
+	cache_store(hostname, UNALIXERR_SUCCESS, &items, ttl);
+	mutex_unlock(&cache.mutex);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+void unalix_dns_cache_clear(void) {
+	
+	mutex_lock(&cache.mutex);
+	cache_clear();
+	mutex_unlock(&cache.mutex);
+	
+}
+
+void unalix_dns_set_resolver(const unalix_resolver_t resolver, void* userdata) {
+	
+	mutex_lock(&cache.mutex);
+	
+	cache.resolver = resolver;
+	cache.userdata = userdata;
+	
+	cache_clear();
+	
+	mutex_unlock(&cache.mutex);
+	
+}
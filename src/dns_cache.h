@@ -0,0 +1,14 @@
+#ifndef DNS_CACHE_H_INCLUDED
+#define DNS_CACHE_H_INCLUDED
+
+#include "address.h"
+
+static const size_t DNS_CACHE_DEFAULT_MAX_ENTRIES = 512;
+
+static const int DNS_CACHE_DEFAULT_TTL = 300;
+static const int DNS_CACHE_DEFAULT_NEGATIVE_TTL = 30;
+static const int DNS_CACHE_DEFAULT_STALE_TTL = 600;
+
+int dns_cache_resolve(const char* const hostname, const int port, struct Addresses* dst);
+
+#endif
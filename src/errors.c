@@ -117,6 +117,42 @@ const char* unalix_strerror(const int code) {
 			return "Cannot format time object to string";
 		case UNALIXERR_OS_STRPTIME_FAILURE:
 			return "Cannot parse string into time object";
+		case UNALIXERR_ARG_INVALID:
+			return "Invalid argument passed to function call";
+		case UNALIXERR_THREAD_CREATE_FAILURE:
+			return "Cannot create thread";
+		case UNALIXERR_DNS_MALFORMED_RESPONSE:
+			return "The DNS server sent a malformed response";
+		case UNALIXERR_DNS_NXDOMAIN:
+			return "The domain name does not exist";
+		case UNALIXERR_DNS_SERVER_FAILURE:
+			return "The DNS server failed to answer the query";
+		case UNALIXERR_DNS_TRUNCATED_RESPONSE:
+			return "The DNS response was truncated";
+		case UNALIXERR_DNS_TIMEOUT:
+			return "The DNS server did not answer in time";
+		case UNALIXERR_DNS_UNSUPPORTED_PROTOCOL:
+			return "Unsupported DNS transport protocol";
+		case UNALIXERR_DNS_NO_ADDRESS:
+			return "The domain name has no IPv4 or IPv6 addresses";
+		case UNALIXERR_OS_MMAP_FAILURE:
+			return "Cannot map file into memory";
+		case UNALIXERR_URL_CACHE_INVALID_FILE:
+			return "The URL cache file is corrupted or has an incompatible format";
+		case UNALIXERR_SOCKET_TIMEOUT:
+			return "The connection timed out";
+		case UNALIXERR_HTTP_MALFORMED_BODY:
+			return "The HTTP response body is malformed or truncated";
+		case UNALIXERR_BUFFER_TOO_SMALL:
+			return "The output buffer is too small to hold the result";
+		case UNALIXERR_CANCELLED:
+			return "The operation was cancelled";
+		case UNALIXERR_RULESETS_SEGMENT_INVALID:
+			return "The shared ruleset segment is corrupted or was built by an incompatible version";
+		case UNALIXERR_RULESETS_SEGMENT_NOT_ATTACHED:
+			return "No shared ruleset segment is attached";
+		case UNALIXERR_RULESETS_NOT_BUILTIN:
+			return "The library was built without an embedded ruleset";
 		default:
 			return "Unknown error code";
 	}
@@ -69,4 +69,30 @@
 
 #define UNALIXERR_ARG_INVALID -57 /* Invalid argument passed to function call */
 
+#define UNALIXERR_THREAD_CREATE_FAILURE -58 /* Cannot create thread */
+
+#define UNALIXERR_DNS_MALFORMED_RESPONSE -59 /* The DNS server sent a malformed response */
+#define UNALIXERR_DNS_NXDOMAIN -60 /* The domain name does not exist */
+#define UNALIXERR_DNS_SERVER_FAILURE -61 /* The DNS server failed to answer the query */
+#define UNALIXERR_DNS_TRUNCATED_RESPONSE -62 /* The DNS response was truncated */
+#define UNALIXERR_DNS_TIMEOUT -63 /* The DNS server did not answer in time */
+#define UNALIXERR_DNS_UNSUPPORTED_PROTOCOL -64 /* Unsupported DNS transport protocol */
+#define UNALIXERR_DNS_NO_ADDRESS -65 /* The domain name has no IPv4 or IPv6 addresses */
+
+#define UNALIXERR_OS_MMAP_FAILURE -66 /* Cannot map file into memory */
+#define UNALIXERR_URL_CACHE_INVALID_FILE -67 /* The URL cache file is corrupted or has an incompatible format */
+
+#define UNALIXERR_SOCKET_TIMEOUT -68 /* The connection timed out */
+
+#define UNALIXERR_HTTP_MALFORMED_BODY -69 /* The HTTP response body is malformed or truncated */
+
+#define UNALIXERR_BUFFER_TOO_SMALL -70 /* The output buffer is too small to hold the result */
+
+#define UNALIXERR_CANCELLED -71 /* The operation was cancelled */
+
+#define UNALIXERR_RULESETS_SEGMENT_INVALID -72 /* The shared ruleset segment is corrupted or was built by an incompatible version */
+#define UNALIXERR_RULESETS_SEGMENT_NOT_ATTACHED -73 /* No shared ruleset segment is attached */
+
+#define UNALIXERR_RULESETS_NOT_BUILTIN -74 /* The library was built without an embedded ruleset */
+
 const char* unalix_strerror(const int code);
@@ -0,0 +1,249 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "frozen.h"
+#include "ruleset.h"
+#include "parameter_filter.h"
+#include "uri.h"
+#include "errors.h"
+
+// How the patterns of each list are used, indexed by enum FrozenListIndex
+static const enum PatternUsage LIST_USAGES[FROZEN_TOTAL_LISTS] = {
+	PATTERN_USAGE_STRIP_PARAMETER,
+	PATTERN_USAGE_STRIP,
+	PATTERN_USAGE_STRIP_PARAMETER,
+	PATTERN_USAGE_MATCH,
+	PATTERN_USAGE_CAPTURE
+};
+
+// Characters that separate the labels of an authority, or end it
+static const char AUTHORITY_DELIMITERS[] = ".@:/?#";
+
+uint32_t frozen_hash(const char* const key, const size_t length, const uint32_t seed) {
+	/*
+	32-bit FNV-1a, seeded. Must match frozen_hash() in tool/ruleset.c.py.
+	*/
+	
+	uint32_t value = UINT32_C(2166136261) ^ seed;
+	
+	for (size_t index = 0; index < length; index++) {
+		value ^= (unsigned char) key[index];
+		value *= UINT32_C(16777619);
+	}
+	
+	value ^= value >> 16;
+	
+	return value;
+	
+}
+
+static int frozen_set_slot(const struct FrozenSet* const set, const char* const key, const size_t length, uint32_t* slot) {
+	
+	const uint32_t bucket = frozen_hash(key, length, 0) % set->total_buckets;
+	const uint32_t position = frozen_hash(key, length, set->displacements[bucket]) % set->total_slots;
+	
+	const char* const item = set->slots[position];
+	
+	if (item == NULL || strncmp(item, key, length) != 0 || item[length] != '\0') {
+		return 0;
+	}
+	
+	*slot = position;
+	
+	return 1;
+	
+}
+
+int frozen_set_contains(const struct FrozenSet* const set, const char* const key, const size_t length) {
+	
+	uint32_t slot = 0;
+	
+	return frozen_set_slot(set, key, length, &slot);
+	
+}
+
+static int set_contains(const void* set, const char* const key, const size_t length) {
+	
+	const struct FrozenSet* const frozen_set = (const struct FrozenSet*) set;
+	
+	return (frozen_set->lengths >> length & 1) && frozen_set_contains(frozen_set, key, length);
+	
+}
+
+int frozen_set_matches_parameters(const struct FrozenSet* const set, const char* const subject) {
+	/*
+	Tells whether a query (or fragment) has a parameter whose key starts with one of the names in set.
+	This is the same condition under which one of the rules the set was built from would strip something.
+	*/
+	
+	return parameter_keys_match(subject, set_contains, set);
+	
+}
+
+void frozen_candidates(const struct FrozenRuleset* const frozen, const char* const url, unsigned char* candidates) {
+	/*
+	Marks the providers whose URL pattern could match url, as far as host labels can tell. Providers with
+	no host label (see struct FrozenProvider) are not marked, and must always be tried.
+	*/
+	
+	memset(candidates, 0, frozen->total_providers);
+	
+	size_t scheme_length = 0;
+	
+	if (strncmp(url, HTTPS_SCHEME, strlen(HTTPS_SCHEME)) == 0) {
+		scheme_length = strlen(HTTPS_SCHEME);
+	} else if (strncmp(url, HTTP_SCHEME, strlen(HTTP_SCHEME)) == 0) {
+		scheme_length = strlen(HTTP_SCHEME);
+	}
+	
+	// Every URL pattern with a host label requires one of these schemes
+	if (scheme_length == 0 || strncmp(url + scheme_length, SCHEME_SEPARATOR, strlen(SCHEME_SEPARATOR)) != 0) {
+		return;
+	}
+	
+	const char* const authority = url + scheme_length + strlen(SCHEME_SEPARATOR);
+	const size_t authority_length = strcspn(authority, "/?#");
+	
+	size_t offset = 0;
+	
+	while (offset <= authority_length) {
+		const char* const label = authority + offset;
+		const size_t length = strcspn(label, AUTHORITY_DELIMITERS);
+		
+		uint32_t slot = 0;
+		
+		if (length > 0 && frozen_set_slot(&frozen->hosts, label, length, &slot)) {
+			for (uint32_t index = frozen->host_offsets[slot]; index < frozen->host_offsets[slot + 1]; index++) {
+				candidates[frozen->host_providers[index]] = 1;
+			}
+		}
+		
+		offset += length + 1;
+	}
+	
+}
+
+static int frozen_rules_load(const struct FrozenList* const list, const enum PatternUsage usage, struct Rulesets* rulesets, struct Ruleset* ruleset, struct Rules* rules) {
+	/*
+	Compiles the patterns of list into rules. Rules matching a plain parameter name are not compiled;
+	they are stripped through literal_strip() instead.
+	*/
+	
+	if (list->total_items < 1) {
+		return UNALIXERR_SUCCESS;
+	}
+	
+	rules->items = (pcre2_code**) calloc(list->total_items, sizeof(pcre2_code*));
+	
+	if (rules->items == NULL) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	rules->total_items = list->total_items;
+	
+	for (size_t index = 0; index < list->total_items; index++) {
+		const char* const literal = list->literals[index];
+		
+		if (usage == PATTERN_USAGE_STRIP_PARAMETER && !rulesets_filter_rule(rulesets, list->patterns[index])) {
+			ruleset->parameters_filtered = 0;
+		}
+		
+		if (literal != NULL) {
+			if (rules->literals == NULL) {
+				rules->literals = (const char**) calloc(list->total_items, sizeof(const char*));
+				
+				if (rules->literals == NULL) {
+					return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+				}
+			}
+			
+			rules->literals[index] = literal;
+			
+			continue;
+		}
+		
+		const int code = rule_compile(list->patterns[index], usage, &rules->items[index]);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int frozen_load(const struct FrozenRuleset* const frozen, struct Rulesets* rulesets) {
+	/*
+	Compiles frozen into rulesets. Patterns are compiled the same way load_ruleset() compiles them.
+	*/
+	
+	if (frozen->total_providers < 1) {
+		return UNALIXERR_RULESETS_EMPTY;
+	}
+	
+	rulesets->items = (struct Ruleset*) calloc(frozen->total_providers, sizeof(struct Ruleset));
+	
+	if (rulesets->items == NULL) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	rulesets->offset = frozen->total_providers;
+	rulesets->size = sizeof(struct Ruleset) * frozen->total_providers;
+	rulesets->frozen = frozen;
+	
+	for (size_t index = 0; index < frozen->total_providers; index++) {
+		const struct FrozenProvider* const provider = &frozen->providers[index];
+		struct Ruleset* const ruleset = &rulesets->items[index];
+		ruleset->parameters_filtered = 1;
+		
+		int code = rule_compile(provider->url_pattern, PATTERN_USAGE_MATCH, &ruleset->url_pattern);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+		
+		// Indexed by enum FrozenListIndex
+		struct Rules* const objects[] = {
+			&ruleset->rules,
+			&ruleset->raw_rules,
+			&ruleset->referral_marketing,
+			&ruleset->exceptions,
+			&ruleset->redirections
+		};
+		
+		for (size_t list = 0; list < FROZEN_TOTAL_LISTS; list++) {
+			code = frozen_rules_load(&provider->lists[list], LIST_USAGES[list], rulesets, ruleset, objects[list]);
+			
+			if (code != UNALIXERR_SUCCESS) {
+				return code;
+			}
+		}
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int unalix_load_frozen(void) {
+	/*
+	Replaces the loaded rulesets with the ruleset compiled into the library at build time. Rulesets loaded
+	from JSON afterwards are added after it, as with unalix_load_file().
+	*/
+	
+	#ifdef UNALIX_FROZEN_RULESET
+		struct Rulesets compiled = {0};
+		
+		const int code = frozen_load(&FROZEN_RULESET, &compiled);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			rulesets_free(&compiled);
+			return code;
+		}
+		
+		return set_rulesets(&compiled);
+	#else
+		return UNALIXERR_RULESETS_NOT_BUILTIN;
+	#endif
+	
+}
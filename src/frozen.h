@@ -0,0 +1,65 @@
+#ifndef FROZEN_H_INCLUDED
+#define FROZEN_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+A ruleset compiled into C source at build time by tool/ruleset.c.py (see the UNALIX_FROZEN_RULESET
+CMake option). Everything here is read-only data generated by that tool.
+*/
+
+// Number of pattern lists each provider has, in the same order as struct Ruleset
+#define FROZEN_TOTAL_LISTS 5
+
+enum FrozenListIndex {
+	FROZEN_LIST_RULES = 0,
+	FROZEN_LIST_RAW_RULES = 1,
+	FROZEN_LIST_REFERRAL_MARKETING = 2,
+	FROZEN_LIST_EXCEPTIONS = 3,
+	FROZEN_LIST_REDIRECTIONS = 4
+};
+
+/*
+A perfect hash set of strings (hash and displace). A key lives at slot
+hash(key, displacements[hash(key, 0) % total_buckets]) % total_slots.
+*/
+struct FrozenSet {
+	uint32_t total_buckets;
+	uint32_t total_slots;
+	const uint32_t* displacements;
+	const char* const* slots; // NULL for empty slots
+	uint64_t lengths; // Bit n is set if some key is n bytes long
+};
+
+struct FrozenList {
+	size_t total_items;
+	const char* const* patterns; // As written in the ruleset
+	const char* const* literals; // The parameter name, for rules matching a plain name; NULL otherwise
+	int all_literal; // Every rule matches a plain name, so "set" tells whether any of them can match
+	struct FrozenSet set;
+};
+
+struct FrozenProvider {
+	const char* url_pattern;
+	const char* host; // Host label the URL pattern requires, or NULL if it could not be determined
+	struct FrozenList lists[FROZEN_TOTAL_LISTS];
+};
+
+struct FrozenRuleset {
+	size_t total_providers;
+	const struct FrozenProvider* providers;
+	struct FrozenSet hosts;
+	const uint32_t* host_offsets; // Providers requiring the host label at slot n are host_providers[host_offsets[n]..host_offsets[n + 1]]
+	const uint32_t* host_providers;
+};
+
+uint32_t frozen_hash(const char* const key, const size_t length, const uint32_t seed);
+int frozen_set_contains(const struct FrozenSet* const set, const char* const key, const size_t length);
+int frozen_set_matches_parameters(const struct FrozenSet* const set, const char* const subject);
+void frozen_candidates(const struct FrozenRuleset* const frozen, const char* const url, unsigned char* candidates);
+
+// Generated from the UNALIX_FROZEN_RULESET file, when that option is set
+extern const struct FrozenRuleset FROZEN_RULESET;
+
+#endif
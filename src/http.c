@@ -13,36 +13,31 @@
 	#include <ws2tcpip.h>
 #else
 	#include <netdb.h>
+	#include <strings.h>
 #endif
 
 #include <bearssl.h>
 
 #include "address.h"
+#include "dns_cache.h"
 #include "http.h"
 #include "callbacks.h"
 #include "utils.h"
 #include "errors.h"
 #include "uri.h"
-#include "ssl.h"
+#include "ssl_pool.h"
+#include "metrics.h"
 
 static const char PROTOCOL_NAME[] = "HTTP";
 static const char CRLF[] = "\r\n";
-static const char CRLFCRLF[] = "\r\n\r\n";
-
-static const char HEADER_SEPARATOR[] = ": ";
 
 static const char HEADER_NAME_SAFE_SYMBOLS[] = "-_";
 static const char HEADER_VALUE_SAFE_SYMBOLS[] = "_ :;.,\\/\"'?!(){}[]@<>=-+*#$&`|~^%";
 
-static const size_t MAX_CHUNK_SIZE = 1024;
-static const size_t MAX_HEADERS_SIZE = MAX_CHUNK_SIZE * 10;
-
-static int header_name_safe(const char* const s) {
+static int header_name_safe(const char* s) {
 	
-	for (size_t index = 0; index < strlen(s); index++) {
-		const char ch = s[index];
-		
-		const int is_safe = (isalnum(ch) || strchr(HEADER_NAME_SAFE_SYMBOLS, ch) != NULL);
+	for (; *s != '\0'; s++) {
+		const int is_safe = (isalnum((unsigned char) *s) || strchr(HEADER_NAME_SAFE_SYMBOLS, *s) != NULL);
 		
 		if (!is_safe) {
 			return is_safe;
@@ -53,12 +48,10 @@ static int header_name_safe(const char* const s) {
 	
 }
 
-static int header_value_safe(const char* const s) {
+static int header_value_safe(const char* s) {
 	
-	for (size_t index = 0; index < strlen(s); index++) {
-		const char ch = s[index];
-		
-		const int is_safe = (isalnum(ch) || strchr(HEADER_VALUE_SAFE_SYMBOLS, ch) != NULL);
+	for (; *s != '\0'; s++) {
+		const int is_safe = (isalnum((unsigned char) *s) || strchr(HEADER_VALUE_SAFE_SYMBOLS, *s) != NULL);
 		
 		if (!is_safe) {
 			return is_safe;
@@ -240,44 +233,13 @@ static const char* http_status_stringify(const enum HTTPStatusCode status_code)
 	
 }
 
-static void http_headers_stringify(const struct HTTPHeaders headers, char* dst) {
+static int http_headers_reserve(struct HTTPHeaders* obj) {
 	
-	for (size_t index = 0; index < headers.offset; index++) {
-		const struct HTTPHeader header = headers.items[index];
-		
-		if (*dst != '\0') {
-			strcat(dst, CRLF);
-		}
-		
-		if (header.key != NULL) {
-			strcat(dst, header.key);
-		}
-		
-		strcat(dst, COLON);
-		strcat(dst, SPACE);
-		
-		if (header.value != NULL) {
-			strcat(dst, header.value);
-		}
+	if ((obj->offset + 1) * sizeof(*obj->items) <= obj->size) {
+		return UNALIXERR_SUCCESS;
 	}
 	
-}
-
-static int http_headers_add(struct HTTPHeaders* obj, const char* key, const char* value) {
-	
-	struct HTTPHeader header = {
-		.key = (char*) malloc(strlen(key) + 1),
-		.value = (char*) malloc(strlen(value) + 1)
-	};
-	
-	if (header.key == NULL || header.value == NULL) {
-		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
-	}
-	
-	strcpy(header.key, key);
-	strcpy(header.value, value);
-	
-	const size_t size = obj->size + sizeof(struct HTTPHeader) * 1;
+	const size_t size = (obj->size == 0) ? sizeof(*obj->items) * 16 : obj->size * 2;
 	struct HTTPHeader* items = (struct HTTPHeader*) realloc(obj->items, size);
 	
 	if (items == NULL) {
@@ -286,23 +248,54 @@ static int http_headers_add(struct HTTPHeaders* obj, const char* key, const char
 	
 	obj->size = size;
 	obj->items = items;
-	obj->items[obj->offset++] = header;
 	
-	if (obj->slength > 0) {
-		obj->slength += strlen(CRLF);
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int http_headers_append(struct HTTPHeaders* obj, char* key, char* value, const int borrowed) {
+	
+	const int code = http_headers_reserve(obj);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
 	}
 	
-	if (key != NULL) {
-		obj->slength += strlen(key);
+	struct HTTPHeader* const header = &obj->items[obj->offset++];
+	
+	header->key = key;
+	header->value = value;
+	header->borrowed = borrowed;
+	
+	// Serialized as "key: value\r\n"
+	obj->slength += strlen(key) + strlen(COLON) + strlen(SPACE) + strlen(value) + strlen(CRLF);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int http_headers_add(struct HTTPHeaders* obj, const char* key, const char* value) {
+	
+	// The key and its value share a single allocation
+	const size_t key_size = strlen(key) + 1;
+	const size_t value_size = strlen(value) + 1;
+	
+	char* buffer = (char*) malloc(key_size + value_size);
+	
+	if (buffer == NULL) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
 	}
 	
-	obj->slength += strlen(COLON) + strlen(SPACE);
+	memcpy(buffer, key, key_size);
+	memcpy(buffer + key_size, value, value_size);
+	
+	const int code = http_headers_append(obj, buffer, buffer + key_size, 0);
 	
-	if (value != NULL) {
-		obj->slength += strlen(value);
+	if (code != UNALIXERR_SUCCESS) {
+		free(buffer);
 	}
 	
-	return UNALIXERR_SUCCESS;
+	return code;
 	
 }
 
@@ -311,7 +304,7 @@ static const struct HTTPHeader* http_headers_get(const struct HTTPHeaders* obj,
 	for (size_t index = 0; index < obj->offset; index++) {
 		const struct HTTPHeader* header = &obj->items[index];
 		
-		if (strcmp(header->key, key) == 0) {
+		if (strcasecmp(header->key, key) == 0) {
 			return header;
 		}
 	}
@@ -324,6 +317,16 @@ int http_request_add_header(struct HTTPContext* context, const char* key, const
 	return http_headers_add(&context->request.headers, key, value);
 }
 
+int http_request_add_static_header(struct HTTPContext* context, const char* key, const char* value) {
+	/*
+	Like http_request_add_header(), but the key and value are referenced instead of copied. They must
+	outlive the request (e.g. string literals or the caller's own arguments).
+	*/
+	
+	return http_headers_append(&context->request.headers, (char*) key, (char*) value, 1);
+	
+}
+
 const struct HTTPHeader* http_response_get_header(const struct HTTPContext* context, const char* key) {
 	return http_headers_get(&context->response.headers, key);
 }
@@ -338,6 +341,7 @@ int http_body_set(struct HTTPBody* obj, const char* buffer, const size_t buffer_
 	
 	memcpy(obj->content, buffer, buffer_size);
 	obj->size = buffer_size;
+	obj->capacity = buffer_size;
 	
 	return UNALIXERR_SUCCESS;
 	
@@ -351,74 +355,110 @@ const struct HTTPStatus* http_response_get_status(struct HTTPContext* context) {
 	return &context->response.status;
 }
 
-int http_request_stringify(struct HTTPRequest* obj, char** dst, size_t* dst_size) {
+static char* write_string(char* cursor, const char* const s, const size_t size) {
+	
+	memcpy(cursor, s, size);
+	
+	return cursor + size;
+	
+}
+
+int http_request_serialize(const struct HTTPRequest* obj, struct HTTPBody* dst) {
+	/*
+	Writes the whole request into dst in a single pass. The buffer is reused (and only grown) across calls.
+	*/
+	
+	const char* const http_method = http_method_stringify(obj->method);
+	const char* const http_version = http_version_stringify(obj->version);
+	
+	const size_t method_size = strlen(http_method);
+	const size_t version_size = strlen(http_version);
+	const size_t path_size = (obj->uri.path != NULL) ? strlen(obj->uri.path) : 0;
+	const size_t query_size = (obj->uri.query != NULL) ? strlen(obj->uri.query) : 0;
+	
+	char content_length[64];
+	size_t content_length_size = 0;
 	
 	if (obj->body.size > 0) {
-		char value[intlen(obj->body.size) + 1];
-		snprintf(value, sizeof(value), "%zu", obj->body.size);
-		
-		const int code = http_headers_add(&obj->headers, "Content-Length", value);
+		content_length_size = (size_t) snprintf(content_length, sizeof(content_length), "Content-Length: %zu%s", obj->body.size, CRLF);
+	}
+	
+	const size_t size = (
+		method_size + strlen(SPACE) + strlen(SLASH) + path_size + (obj->uri.query != NULL ? strlen(QUESTION_MARK) + query_size : 0) + strlen(SPACE) +
+		strlen(PROTOCOL_NAME) + strlen(SLASH) + version_size + strlen(CRLF) +
+		obj->headers.slength + content_length_size + strlen(CRLF) + obj->body.size
+	);
+	
+	if (size > dst->capacity) {
+		char* content = (char*) realloc(dst->content, size);
 		
-		if (code != UNALIXERR_SUCCESS) {
-			return code;
+		if (content == NULL) {
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
 		}
+		
+		dst->content = content;
+		dst->capacity = size;
 	}
 	
-	char resource_location[strlen(SLASH) + (obj->uri.path != NULL ? strlen(obj->uri.path) : 0) + (obj->uri.query != NULL ? strlen(QUESTION_MARK) + strlen(obj->uri.query) : 0) + 1];
-	strcpy(resource_location, SLASH);
+	char* cursor = dst->content;
+	
+	// Request line
+	cursor = write_string(cursor, http_method, method_size);
+	cursor = write_string(cursor, SPACE, strlen(SPACE));
+	cursor = write_string(cursor, SLASH, strlen(SLASH));
 	
 	if (obj->uri.path != NULL) {
-		strcat(resource_location, obj->uri.path);
+		cursor = write_string(cursor, obj->uri.path, path_size);
 	}
 	
 	if (obj->uri.query != NULL) {
-		strcat(resource_location, QUESTION_MARK);
-		strcat(resource_location, obj->uri.query);
+		cursor = write_string(cursor, QUESTION_MARK, strlen(QUESTION_MARK));
+		cursor = write_string(cursor, obj->uri.query, query_size);
 	}
 	
-	const char* const http_method = http_method_stringify(obj->method);
-	const char* const http_version = http_version_stringify(obj->version);
-	
-	char headers[obj->headers.slength + 1];
-	*headers = '\0';
+	cursor = write_string(cursor, SPACE, strlen(SPACE));
+	cursor = write_string(cursor, PROTOCOL_NAME, strlen(PROTOCOL_NAME));
+	cursor = write_string(cursor, SLASH, strlen(SLASH));
+	cursor = write_string(cursor, http_version, version_size);
+	cursor = write_string(cursor, CRLF, strlen(CRLF));
 	
-	http_headers_stringify(obj->headers, headers);
+	// Headers
+	for (size_t index = 0; index < obj->headers.offset; index++) {
+		const struct HTTPHeader* const header = &obj->headers.items[index];
+		
+		cursor = write_string(cursor, header->key, strlen(header->key));
+		cursor = write_string(cursor, COLON, strlen(COLON));
+		cursor = write_string(cursor, SPACE, strlen(SPACE));
+		cursor = write_string(cursor, header->value, strlen(header->value));
+		cursor = write_string(cursor, CRLF, strlen(CRLF));
+	}
 	
-	const size_t buffer_size = (
-		strlen(http_method) + strlen(SPACE) + strlen(resource_location) + strlen(SPACE) + strlen(PROTOCOL_NAME) + strlen(SLASH) + strlen(http_version) + strlen(CRLF) +
-		strlen(headers) + strlen(CRLFCRLF) + obj->body.size
-	);
-	char* buffer = (char*) malloc(buffer_size);
+	cursor = write_string(cursor, content_length, content_length_size);
+	cursor = write_string(cursor, CRLF, strlen(CRLF));
 	
-	if (buffer == NULL) {
-		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	// Body
+	if (obj->body.size > 0) {
+		cursor = write_string(cursor, obj->body.content, obj->body.size);
 	}
 	
-	// HTTP method
-	strcpy(buffer, http_method);
-	strcat(buffer, SPACE);
+	dst->size = size;
 	
-	// Resource location
-	strcat(buffer, resource_location);
-	strcat(buffer, SPACE);
+	return UNALIXERR_SUCCESS;
 	
-	// HTTP version
-	strcat(buffer, PROTOCOL_NAME);
-	strcat(buffer, SLASH);
-	strcat(buffer, http_version);
-	strcat(buffer, CRLF);
+}
+
+int http_request_stringify(struct HTTPRequest* obj, char** dst, size_t* dst_size) {
 	
-	// Headers
-	strcat(buffer, headers);
-	strcat(buffer, CRLFCRLF);
+	struct HTTPBody buffer = {0};
 	
-	// Body
-	if (obj->body.size > 0) {
-		memcpy(strrchr(buffer, '\0'), obj->body.content, obj->body.size);
+	const int code = http_request_serialize(obj, &buffer);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
 	}
 	
-	*dst = buffer;
-	*dst_size = buffer_size;
+	*dst = buffer.content;
+	*dst_size = buffer.size;
 	
 	return UNALIXERR_SUCCESS;
 	
@@ -428,7 +468,7 @@ static int set_host_header(struct HTTPHeaders* headers, const struct URI uri) {
 	
 	const size_t port_size = intlen(uri.port);
 	
-	char host[strlen(uri.hostname) + strlen(COLON) + (uri.port > 0 ? port_size : 0)];
+	char host[strlen(uri.hostname) + strlen(COLON) + (uri.port > 0 ? port_size : 0) + 1];
 	strcpy(host, uri.hostname);
 	
 	if (uri.port > 0 && ((strcmp(uri.scheme, HTTP_SCHEME) == 0 && uri.port != HTTP_PORT) || (strcmp(uri.scheme, HTTPS_SCHEME) == 0 && uri.port != HTTPS_PORT))) {
@@ -549,15 +589,13 @@ static void http_headers_free(struct HTTPHeaders* obj) {
 	for (size_t index = 0; index < obj->offset; index++) {
 		struct HTTPHeader* header = &obj->items[index];
 		
-		if (header->key != NULL) {
+		// The value shares the key's allocation
+		if (!header->borrowed) {
 			free(header->key);
-			header->key = NULL;
 		}
 		
-		if (header->value != NULL) {
-			free(header->value);
-			header->value = NULL;
-		}
+		header->key = NULL;
+		header->value = NULL;
 	}
 	
 	free(obj->items);
@@ -565,12 +603,13 @@ static void http_headers_free(struct HTTPHeaders* obj) {
 	
 	obj->size = 0;
 	obj->offset = 0;
+	obj->slength = 0;
 	
 }
 
 static void http_body_free(struct HTTPBody* obj) {
 	
-	if (obj->size < 1) {
+	if (obj->content == NULL) {
 		return;
 	}
 	
@@ -578,6 +617,7 @@ static void http_body_free(struct HTTPBody* obj) {
 	
 	obj->content = NULL;
 	obj->size = 0;
+	obj->capacity = 0;
 	
 }
 
@@ -603,6 +643,10 @@ void http_response_free(struct HTTPResponse* obj) {
 	http_headers_free(&obj->headers);
 	http_body_free(&obj->body);
 	
+	obj->parser.state = HTTP_PARSER_STATUS_LINE;
+	obj->parser.size = 0;
+	obj->parser.offset = 0;
+	
 }
 
 void http_context_free(struct HTTPContext* context) {
@@ -610,80 +654,51 @@ void http_context_free(struct HTTPContext* context) {
 	connection_free(&context->connection);
 	http_request_free(&context->request);
 	http_response_free(&context->response);
+	http_body_free(&context->buffer);
 	
 }
 
 
-static int parse_http_response(struct HTTPResponse* obj, const char* buffer, const size_t buffer_size) {
+static int parse_status_line(struct HTTPResponse* obj, const char* const line, const size_t line_size) {
 	
-	char data[buffer_size + 1];
-	memcpy(data, buffer, buffer_size);
-	data[buffer_size] = '\0';
+	// HTTP/1.1 200[ reason]
+	const size_t prefix_size = strlen(PROTOCOL_NAME) + strlen(SLASH);
+	const size_t version_size = strlen(http_version_stringify(HTTP11));
 	
-	const char* data_end = &data[buffer_size];
-	
-	const char* separator = strstr(data, CRLFCRLF);
-	
-	// Headers
-	const size_t headers_size = (size_t) (separator - data);
-	
-	char headers[headers_size + 1];
-	memcpy(headers, data, headers_size);
-	headers[headers_size] = '\0';
-	
-	// Body
-	const char* body_start = separator;
-	body_start += strlen(CRLFCRLF);
-	
-	const size_t body_size = (size_t) (data_end - body_start);
-	
-	char body[body_size + 1];
-	
-	if (body_size > 0) {
-		memcpy(body, body_start, body_size);
+	if (line_size < prefix_size + version_size || memcmp(line, PROTOCOL_NAME, strlen(PROTOCOL_NAME)) != 0 || line[strlen(PROTOCOL_NAME)] != *SLASH) {
+		return UNALIXERR_HTTP_UNSUPPORTED_VERSION;
 	}
 	
-	body[body_size] = '\0';
+	const char* const version = line + prefix_size;
 	
-	// HTTP version
-	const char* http_version_start = strstr(headers, SLASH);
-	http_version_start += strlen(SLASH);
-	const char* http_version_end = strstr(http_version_start, SPACE);
-	
-	const size_t http_version_size = (size_t) (http_version_end - http_version_start);
-	
-	char http_version[http_version_size + 1];
-	memcpy(http_version, http_version_start, http_version_size);
-	http_version[http_version_size] = '\0';
-	
-	if (strcmp(http_version, http_version_stringify(HTTP10)) == 0) {
+	if (memcmp(version, http_version_stringify(HTTP10), version_size) == 0) {
 		obj->version = HTTP10;
-	} else if (strcmp(http_version, http_version_stringify(HTTP11)) == 0) {
+	} else if (memcmp(version, http_version_stringify(HTTP11), version_size) == 0) {
 		obj->version = HTTP11;
 	} else {
 		return UNALIXERR_HTTP_UNSUPPORTED_VERSION;
 	}
 	
-	// Status code
-	const char* status_code_start = strstr(http_version_end, SPACE);
-	status_code_start += strlen(SPACE);
-	const char* status_code_end = strstr(status_code_start, SPACE);
+	const char* const status_code = version + version_size + strlen(SPACE);
+	const size_t status_code_size = intlen(OK);
 	
-	const size_t status_code_size = (size_t) (status_code_end - status_code_start);
-	
-	if (status_code_size != intlen(OK)) {
+	if (line_size < (size_t) (status_code - line) + status_code_size || status_code[-1] != *SPACE) {
 		return UNALIXERR_HTTP_MALFORMED_STATUS_CODE;
 	}
 	
-	char status_code[status_code_size + 1];
-	memcpy(status_code, status_code_start, status_code_size);
-	status_code[status_code_size] = '\0';
-	
-	if (!isnumeric(status_code)) {
+	if (!(status_code[status_code_size] == '\0' || status_code[status_code_size] == *SPACE)) {
 		return UNALIXERR_HTTP_MALFORMED_STATUS_CODE;
 	}
 	
-	const int value = atoi(status_code);
+	int value = 0;
+	
+	for (size_t index = 0; index < status_code_size; index++) {
+		if (!isdigit((unsigned char) status_code[index])) {
+			return UNALIXERR_HTTP_MALFORMED_STATUS_CODE;
+		}
+		
+		value = value * 10 + (status_code[index] - '0');
+	}
 	
 	const enum HTTPStatusCode http_status = (enum HTTPStatusCode) value;
 	const char* http_status_message = http_status_stringify(http_status);
@@ -695,99 +710,145 @@ static int parse_http_response(struct HTTPResponse* obj, const char* buffer, con
 		return UNALIXERR_HTTP_UNKNOWN_STATUS_CODE;
 	}
 	
-	const char* header_start = strstr(headers, CRLF);
-	header_start += strlen(CRLF);
-	const char* header_end = strstr(header_start, CRLF);
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int parse_header_line(struct HTTPResponse* obj, char* const line, const size_t line_size) {
+	
+	char* const separator = (char*) memchr(line, *COLON, line_size);
 	
-	const char* headers_end = strchr(headers, '\0');
+	if (separator == NULL) {
+		return UNALIXERR_HTTP_MALFORMED_HEADER;
+	}
 	
-	while (1) {
-		if (!header_end) {
-			header_end = headers_end;
-		}
-		
-		const char* separator = strstr(header_start, HEADER_SEPARATOR);
+	if (separator == line) {
+		return UNALIXERR_HTTP_MISSING_HEADER_NAME;
+	}
+	
+	*separator = '\0';
+	
+	if (!header_name_safe(line)) {
+		return UNALIXERR_HTTP_HEADER_CONTAINS_INVALID_CHARACTER;
+	}
+	
+	char* value = separator + 1;
+	char* value_end = line + line_size;
+	
+	while (value < value_end && (*value == ' ' || *value == '\t')) {
+		value++;
+	}
+	
+	while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) {
+		value_end--;
+	}
+	
+	*value_end = '\0';
+	
+	if (value == value_end) {
+		return UNALIXERR_HTTP_MISSING_HEADER_VALUE;
+	}
+	
+	if (!header_value_safe(value)) {
+		return UNALIXERR_HTTP_HEADER_CONTAINS_INVALID_CHARACTER;
+	}
+	
+	// Names and values point into the receive buffer
+	return http_headers_append(&obj->headers, line, value, 1);
+	
+}
+
+static int http_parser_feed(struct HTTPResponse* obj) {
+	/*
+	Consumes every complete line received since the last call. Lines are terminated in place, so
+	header names and values become strings pointing into the receive buffer; nothing is copied,
+	and bytes already consumed are never scanned again.
+	*/
+	
+	struct HTTPParser* const parser = &obj->parser;
+	
+	while (parser->state != HTTP_PARSER_DONE) {
+		char* const line = parser->buffer + parser->offset;
+		char* const line_feed = (char*) memchr(line, '\n', parser->size - parser->offset);
 		
-		if (separator == NULL || separator > header_end) {
-			return UNALIXERR_HTTP_MALFORMED_HEADER;
+		if (line_feed == NULL) {
+			break;
 		}
 		
-		const size_t key_size = (size_t) (separator - header_start);
+		parser->offset = (size_t) (line_feed - parser->buffer) + 1;
 		
-		if (key_size < 1) {
-			return UNALIXERR_HTTP_MISSING_HEADER_NAME;
-		}
-		
-		char key[key_size + 1];
-		memcpy(key, header_start, key_size);
-		key[key_size] = '\0';
+		char* line_end = line_feed;
 		
-		if (!header_name_safe(key)) {
-			return UNALIXERR_HTTP_HEADER_CONTAINS_INVALID_CHARACTER;
+		if (line_end > line && line_end[-1] == '\r') {
+			line_end--;
 		}
 		
-		separator += strlen(HEADER_SEPARATOR);
-		
-		const size_t value_size = (size_t) (header_end - separator);
+		*line_end = '\0';
 		
-		if (value_size < 1) {
-			return UNALIXERR_HTTP_MISSING_HEADER_VALUE;
-		}
+		const size_t line_size = (size_t) (line_end - line);
 		
-		char value[value_size + 1];
-		memcpy(value, separator, value_size);
-		value[value_size] = '\0';
+		int code = UNALIXERR_SUCCESS;
 		
-		if (!header_value_safe(value)) {
-			return UNALIXERR_HTTP_HEADER_CONTAINS_INVALID_CHARACTER;
+		if (parser->state == HTTP_PARSER_STATUS_LINE) {
+			code = parse_status_line(obj, line, line_size);
+			parser->state = HTTP_PARSER_HEADERS;
+		} else if (line_size == 0) {
+			parser->state = HTTP_PARSER_DONE;
+		} else {
+			code = parse_header_line(obj, line, line_size);
 		}
 		
-		const int code = http_headers_add(&obj->headers, key, value);
-		
 		if (code != UNALIXERR_SUCCESS) {
 			return code;
 		}
-		
-		if (header_end == headers_end) {
-			break;
-		}
-		
-		header_start = header_end;
-		header_start += strlen(CRLF);
-		
-		header_end = strstr(header_start, CRLF);
-	}
-	
-	if (body_size > 0) {
-		obj->body.content = (char*) malloc(body_size);
-		
-		if (obj->body.content == NULL) {
-			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
-		}
-	 	
-		memcpy(obj->body.content, body, body_size);
-		obj->body.size = body_size;
 	}
 	
 	return UNALIXERR_SUCCESS;
 	
 }
 
-static int find_crlfcrlf(const char* buffer, const size_t buffer_size) {
+static int response_has_body(const struct HTTPContext* context) {
 	
-	for (size_t index = 0; index < buffer_size; index++) {
-		if (memcmp(buffer + index, CRLFCRLF, strlen(CRLFCRLF)) == 0) {
-			return 1;
-		}
+	const enum HTTPStatusCode status = context->response.status.code;
+	
+	return !(context->request.method == HEAD || (status >= CONTINUE && status < OK) || status == NO_CONTENT || status == NOT_MODIFIED);
+	
+}
+
+static void http_response_discard(struct HTTPContext* context) {
+	/*
+	Gets rid of the body of a probe response. Requests are sent as HTTP/1.0 without keep-alive and
+	connections are never reused, so whatever the server has left to send is dropped with a reset
+	instead of being read.
+	*/
+	
+	if (response_has_body(context)) {
+		connection_abort(&context->connection);
+	}
+	
+}
+
+static void phase_end(struct unalix_request_metrics* metrics, const enum unalix_phase phase, unsigned long long* start) {
+	/*
+	Records how long a phase of the request took, and marks the start of the next one.
+	*/
+	
+	if (metrics == NULL) {
+		return;
 	}
 	
-	return 0;
+	const unsigned long long now = get_monotonic_time_us();
+	
+	// Anything quicker than the clock resolution still counts as having gone through the phase
+	metrics->phases[phase] = (now > *start) ? now - *start : 1;
+	
+	*start = now;
 	
 }
 
-int http_request_send(struct HTTPContext* context) {
+static int request_send(struct HTTPContext* context, struct unalix_request_metrics* metrics) {
 	
-	struct Address address = {0};
+	unsigned long long start = (metrics == NULL) ? 0 : get_monotonic_time_us();
 	
 	const char* sa = context->request.uri.hostname;
 	int sa_port = context->request.uri.port;
@@ -802,204 +863,475 @@ int http_request_send(struct HTTPContext* context) {
 		}
 	}
 	
-	if (address_parse(&address, sa, sa_port) != UNALIXERR_SUCCESS) {
-		struct addrinfo hints = {.ai_family = AF_UNSPEC};
-		struct addrinfo* res = NULL;
-		
-		char value[intlen(sa_port) + 1];
-		snprintf(value, sizeof(value), "%i", sa_port);
-		
-		if (getaddrinfo(sa, value, &hints, &res) != 0) {
-			return UNALIXERR_DNS_GAI_FAILURE;
-		}
-		
-		memcpy(&address.addr_storage, res->ai_addr, (size_t) res->ai_addrlen);
-		
-		address.af = res->ai_family;
-		address.addr_storage_size = res->ai_addrlen;
-		
-		freeaddrinfo(res);
-	}
+	struct Addresses addresses = {0};
 	
-	context->connection.fd = socket(address.af, SOCK_STREAM, IPPROTO_TCP);
+	const int rc = dns_cache_resolve(sa, sa_port, &addresses);
 	
-	if (context->connection.fd == -1) {
-		return UNALIXERR_SOCKET_FAILURE;
+	if (rc != UNALIXERR_SUCCESS) {
+		return rc;
 	}
 	
-	if (context->connection.timeout > 0) {
-		const int code = connection_set_timeout(&context->connection, context->connection.timeout);
-		
-		if (code != UNALIXERR_SUCCESS) {
-			return code;
-		}
-	}
+	phase_end(metrics, UNALIX_PHASE_DNS, &start);
+	
+	const int cc = connection_connect(&context->connection, &addresses);
 	
-	if (connect(context->connection.fd, (struct sockaddr*) &address.addr_storage, address.addr_storage_size) != 0) {
-		return UNALIXERR_SOCKET_CONNECT_FAILURE;
+	if (cc != UNALIXERR_SUCCESS) {
+		return cc;
 	}
 	
-	char* buffer = NULL;
-	size_t buffer_size = 0;
+	phase_end(metrics, UNALIX_PHASE_CONNECT, &start);
+	metrics_add(METRICS_CONNECTIONS_OPENED, 1);
 	
-	const int code = http_request_stringify(&context->request, &buffer, &buffer_size);
+	const int code = http_request_serialize(&context->request, &context->buffer);
 	
 	if (code != UNALIXERR_SUCCESS) {
 		return code;
 	}
 	
+	const char* const buffer = context->buffer.content;
+	const size_t buffer_size = context->buffer.size;
+	
 	const int is_https = strcmp(context->request.uri.scheme, HTTPS_SCHEME) == 0;
 	
 	if (is_https) {
-		if (!context->connection.ssl_context.is_initialized) {
-			br_ssl_client_init_full(&context->connection.ssl_context.sc, &context->connection.ssl_context.xc, TAs, TAs_NUM);
-			br_ssl_engine_set_buffer(&context->connection.ssl_context.sc.eng, context->connection.ssl_context.iobuf, sizeof(context->connection.ssl_context.iobuf), 1);
-			br_sslio_init(&context->connection.ssl_context.ioc, &context->connection.ssl_context.sc.eng, sock_read, &context->connection.fd, sock_write, &context->connection.fd);
+		if (context->connection.ssl_context == NULL) {
+			const int scode = ssl_context_acquire(&context->connection.ssl_context);
 			
-			context->connection.ssl_context.is_initialized = 1;
+			if (scode != UNALIXERR_SUCCESS) {
+				return scode;
+			}
 		}
 		
-		br_ssl_client_reset(&context->connection.ssl_context.sc, context->request.uri.hostname, 0);
+		struct SSLContext* const ssl_context = context->connection.ssl_context;
 		
-		const ssize_t size = br_sslio_write_all(&context->connection.ssl_context.ioc, buffer, buffer_size);
+		br_sslio_init(&ssl_context->ioc, &ssl_context->sc.eng, sock_read, &context->connection, sock_write, &context->connection);
+		br_ssl_client_reset(&ssl_context->sc, context->request.uri.hostname, 0);
 		
-		free(buffer);
+		ssl_context->is_initialized = 1;
+		
+		const ssize_t size = br_sslio_write_all(&ssl_context->ioc, buffer, buffer_size);
 		
 		if (size != 0) {
-			return UNALIXERR_SSL_FAILURE;
+			return context->connection.timed_out ? UNALIXERR_SOCKET_TIMEOUT : UNALIXERR_SSL_FAILURE;
 		}
 		
-		br_sslio_flush(&context->connection.ssl_context.ioc);
-	} else {
-		const ssize_t size = send(context->connection.fd, buffer, buffer_size, 0);
+		// The engine only accepts application data once the handshake is over
+		phase_end(metrics, UNALIX_PHASE_TLS, &start);
+		metrics_add(METRICS_TLS_HANDSHAKES, 1);
 		
-		free(buffer);
+		br_sslio_flush(&ssl_context->ioc);
+	} else {
+		const ssize_t size = connection_send(&context->connection, buffer, buffer_size);
 		
 		if ((size_t) size != buffer_size) {
-			return UNALIXERR_SOCKET_SEND_FAILURE;
+			return context->connection.timed_out ? UNALIXERR_SOCKET_TIMEOUT : UNALIXERR_SOCKET_SEND_FAILURE;
 		}
 	}
 	
-	char headers[MAX_HEADERS_SIZE];
-	size_t offset = 0;
+	if (metrics != NULL) {
+		start = get_monotonic_time_us();
+	}
 	
-	while (1) {
-		char chunk[MAX_CHUNK_SIZE];
+	struct HTTPParser* const parser = &context->response.parser;
+	
+	while (parser->state != HTTP_PARSER_DONE) {
+		if (parser->size == sizeof(parser->buffer)) {
+			return UNALIXERR_HTTP_HEADERS_TOO_BIG;
+		}
+		
+		char* const chunk = parser->buffer + parser->size;
+		const size_t chunk_max_size = sizeof(parser->buffer) - parser->size;
+		
 		ssize_t chunk_size = 0;
 		
 		if (is_https) {
-			chunk_size = br_sslio_read(&context->connection.ssl_context.ioc, chunk, sizeof(chunk));
+			chunk_size = br_sslio_read(&context->connection.ssl_context->ioc, chunk, chunk_max_size);
 			
 			if (chunk_size == -1) {
-				if (br_ssl_engine_last_error(&context->connection.ssl_context.sc.eng) != BR_ERR_IO) {
+				if (context->connection.timed_out) {
+					return UNALIXERR_SOCKET_TIMEOUT;
+				}
+				
+				if (br_ssl_engine_last_error(&context->connection.ssl_context->sc.eng) != BR_ERR_IO) {
 					return UNALIXERR_SSL_FAILURE;
 				}
 				
-				break;
+				chunk_size = 0;
 			}
 			
 			if (chunk_size == 0) {
-				if (offset == 0) {
-					return UNALIXERR_SSL_FAILURE;
-				}
-				
-				break;
+				return (parser->size == 0) ? UNALIXERR_SSL_FAILURE : UNALIXERR_HTTP_MALFORMED_HEADER;
 			}
 		} else {
-			chunk_size = recv(context->connection.fd, chunk, sizeof(chunk), 0);
+			chunk_size = connection_recv(&context->connection, chunk, chunk_max_size);
 			
 			if (chunk_size == -1) {
-				return UNALIXERR_SOCKET_RECV_FAILURE;
+				return context->connection.timed_out ? UNALIXERR_SOCKET_TIMEOUT : UNALIXERR_SOCKET_RECV_FAILURE;
 			}
 			
 			if (chunk_size == 0) {
-				if (offset == 0) {
-					return UNALIXERR_SOCKET_RECV_FAILURE;
-				}
-				
-				break;
+				return (parser->size == 0) ? UNALIXERR_SOCKET_RECV_FAILURE : UNALIXERR_HTTP_MALFORMED_HEADER;
 			}
 		}
 		
-		if ((offset + (size_t) chunk_size) > sizeof(headers)) {
-			return UNALIXERR_HTTP_HEADERS_TOO_BIG;
+		if (parser->size == 0) {
+			phase_end(metrics, UNALIX_PHASE_FIRST_BYTE, &start);
 		}
 		
-		memcpy(headers + offset, chunk, (size_t) chunk_size);
-		offset += (size_t) chunk_size;
+		parser->size += (size_t) chunk_size;
 		
-		if (find_crlfcrlf(headers, offset)) {
-			break;
+		const int rcode = http_parser_feed(&context->response);
+		
+		if (rcode != UNALIXERR_SUCCESS) {
+			return rcode;
 		}
 	}
 	
-	return parse_http_response(&context->response, headers, offset);
+	if (context->request.probe) {
+		http_response_discard(context);
+	}
+	
+	return UNALIXERR_SUCCESS;
 	
 }
 
-int http_response_read(struct HTTPContext* context, FILE* file) {
+int http_request_send(struct HTTPContext* context) {
 	
-	if (file != NULL && context->response.body.size > 0) {
-		if (fwrite(context->response.body.content, sizeof(*context->response.body.content), context->response.body.size, file) != context->response.body.size) {
-			return UNALIXERR_FILE_CANNOT_WRITE;
-		}
+	if (!metrics_is_enabled()) {
+		return request_send(context, NULL);
 	}
 	
-	while (1) {
-		char chunk[MAX_CHUNK_SIZE];
-		ssize_t chunk_size = 0;
+	struct unalix_request_metrics metrics = {
+		.hostname = context->request.uri.hostname
+	};
+	
+	unsigned long long start = get_monotonic_time_us();
+	
+	metrics.code = request_send(context, &metrics);
+	
+	phase_end(&metrics, UNALIX_PHASE_REQUEST, &start);
+	
+	metrics.bytes_received = context->connection.bytes_received;
+	metrics.bytes_sent = context->connection.bytes_sent;
+	
+	metrics_record_request(&metrics);
+	
+	return metrics.code;
+	
+}
+
+struct BodyReader {
+	struct HTTPContext* context;
+	const char* data;
+	size_t offset;
+	size_t size;
+	char buffer[HTTP_BODY_CHUNK_SIZE];
+};
+
+static int body_reader_fill(struct BodyReader* reader) {
+	/*
+	Makes more body bytes available. Returns UNALIXERR_SUCCESS with reader->size == 0 at end of stream.
+	*/
+	
+	struct HTTPContext* const context = reader->context;
+	
+	ssize_t size = 0;
+	
+	if (context->connection.ssl_context != NULL && context->connection.ssl_context->is_initialized) {
+		size = br_sslio_read(&context->connection.ssl_context->ioc, reader->buffer, sizeof(reader->buffer));
 		
-		if (strcmp(context->request.uri.scheme, HTTPS_SCHEME) == 0) {
-			chunk_size = br_sslio_read(&context->connection.ssl_context.ioc, chunk, sizeof(chunk));
-			
-			if (chunk_size == -1) {
-				const int code = br_ssl_engine_last_error(&context->connection.ssl_context.sc.eng);
-				
-				if (!(code == BR_ERR_IO || code == BR_ERR_OK)) {
-					return UNALIXERR_SSL_FAILURE;
-				}
-				
-				break;
+		if (size == -1) {
+			if (context->connection.timed_out) {
+				return UNALIXERR_SOCKET_TIMEOUT;
 			}
 			
-			if (chunk_size == 0) {
-				break;
+			const int code = br_ssl_engine_last_error(&context->connection.ssl_context->sc.eng);
+			
+			if (!(code == BR_ERR_IO || code == BR_ERR_OK)) {
+				return UNALIXERR_SSL_FAILURE;
 			}
-		} else {
-			chunk_size = recv(context->connection.fd, chunk, sizeof(chunk), 0);
 			
-			if (chunk_size == -1) {
-				return UNALIXERR_SOCKET_RECV_FAILURE;
+			size = 0;
+		}
+	} else {
+		size = connection_recv(&context->connection, reader->buffer, sizeof(reader->buffer));
+		
+		if (size == -1) {
+			return context->connection.timed_out ? UNALIXERR_SOCKET_TIMEOUT : UNALIXERR_SOCKET_RECV_FAILURE;
+		}
+	}
+	
+	reader->data = reader->buffer;
+	reader->offset = 0;
+	reader->size = (size_t) size;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int body_reader_forward(struct BodyReader* reader, size_t* remaining, const int until_eof, const http_body_sink_t sink, void* userdata) {
+	/*
+	Hands the next *remaining bytes (or everything up to the end of stream) to the sink, straight from the read buffer.
+	*/
+	
+	while (until_eof || *remaining > 0) {
+		if (reader->offset == reader->size) {
+			const int code = body_reader_fill(reader);
+			
+			if (code != UNALIXERR_SUCCESS) {
+				return code;
 			}
 			
-			if (chunk_size == 0) {
-				break;
+			if (reader->size == 0) {
+				return until_eof ? UNALIXERR_SUCCESS : UNALIXERR_HTTP_MALFORMED_BODY;
 			}
 		}
 		
-		if (file == NULL) {
-			const size_t size = context->response.body.size + (size_t) chunk_size;
-			char* content = (char*) realloc(context->response.body.content, size);
+		size_t size = reader->size - reader->offset;
+		
+		if (!until_eof && size > *remaining) {
+			size = *remaining;
+		}
+		
+		const int code = sink(reader->data + reader->offset, size, userdata);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+		
+		reader->offset += size;
+		
+		if (!until_eof) {
+			*remaining -= size;
+		}
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int body_reader_line(struct BodyReader* reader, char* line, const size_t line_size) {
+	/*
+	Reads a CRLF-terminated line of the chunked framing (sizes and trailers), which are always short.
+	*/
+	
+	size_t offset = 0;
+	
+	while (1) {
+		if (reader->offset == reader->size) {
+			const int code = body_reader_fill(reader);
 			
-			if (content == NULL) {
-				return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+			if (code != UNALIXERR_SUCCESS) {
+				return code;
 			}
 			
-			memcpy(content + context->response.body.size, chunk, (size_t) chunk_size);
-			
-			context->response.body.size = size;
-			context->response.body.content = content;
-		} else {
-			if (fwrite(chunk, sizeof(*chunk), (size_t) chunk_size, file) != (size_t) chunk_size) {
-				return UNALIXERR_FILE_CANNOT_WRITE;
+			if (reader->size == 0) {
+				return UNALIXERR_HTTP_MALFORMED_BODY;
 			}
 		}
+		
+		const char ch = reader->data[reader->offset++];
+		
+		if (ch == '\n') {
+			break;
+		}
+		
+		if (offset + 1 >= line_size) {
+			return UNALIXERR_HTTP_MALFORMED_BODY;
+		}
+		
+		line[offset++] = ch;
+	}
+	
+	if (offset > 0 && line[offset - 1] == '\r') {
+		offset--;
+	}
+	
+	line[offset] = '\0';
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int body_reader_chunked(struct BodyReader* reader, const http_body_sink_t sink, void* userdata) {
+	
+	char line[256];
+	
+	while (1) {
+		int code = body_reader_line(reader, line, sizeof(line));
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+		
+		// Chunk extensions (";name=value") are ignored
+		char* end = NULL;
+		size_t remaining = (size_t) strtoull(line, &end, 16);
+		
+		if (end == line || !(*end == '\0' || *end == ';' || *end == ' ' || *end == '\t')) {
+			return UNALIXERR_HTTP_MALFORMED_BODY;
+		}
+		
+		if (remaining == 0) {
+			break;
+		}
+		
+		code = body_reader_forward(reader, &remaining, 0, sink, userdata);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+		
+		code = body_reader_line(reader, line, sizeof(line));
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+		
+		if (*line != '\0') {
+			return UNALIXERR_HTTP_MALFORMED_BODY;
+		}
+	}
+	
+	// Trailer fields, up to the final empty line
+	do {
+		const int code = body_reader_line(reader, line, sizeof(line));
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+	} while (*line != '\0');
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int response_content_length(const struct HTTPContext* context, size_t* dst) {
+	/*
+	Returns true (1) if the response declares a valid Content-Length.
+	*/
+	
+	const struct HTTPHeader* const header = http_headers_get(&context->response.headers, "Content-Length");
+	
+	if (header == NULL || !isnumeric(header->value)) {
+		return 0;
+	}
+	
+	*dst = (size_t) strtoull(header->value, NULL, 10);
+	
+	return 1;
+	
+}
+
+int http_response_stream(struct HTTPContext* context, const http_body_sink_t sink, void* userdata) {
+	/*
+	Reads the response body, delivering it to the sink as it arrives. The end of the body is found from
+	the chunked framing or Content-Length when available, and from the connection closing otherwise.
+	*/
+	
+	if (!response_has_body(context)) {
+		return UNALIXERR_SUCCESS;
+	}
+	
+	const struct HTTPParser* const parser = &context->response.parser;
+	
+	struct BodyReader* reader = (struct BodyReader*) malloc(sizeof(*reader));
+	
+	if (reader == NULL) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	// Whatever part of the body arrived along with the headers is consumed first
+	reader->context = context;
+	reader->data = parser->buffer;
+	reader->offset = parser->offset;
+	reader->size = parser->size;
+	
+	const struct HTTPHeader* const transfer_encoding = http_headers_get(&context->response.headers, "Transfer-Encoding");
+	
+	size_t content_length = 0;
+	int code = UNALIXERR_SUCCESS;
+	
+	if (transfer_encoding != NULL && strcasecmp(transfer_encoding->value, "chunked") == 0) {
+		code = body_reader_chunked(reader, sink, userdata);
+	} else if (response_content_length(context, &content_length)) {
+		code = body_reader_forward(reader, &content_length, 0, sink, userdata);
+	} else {
+		code = body_reader_forward(reader, &content_length, 1, sink, userdata);
+	}
+	
+	free(reader);
+	
+	return code;
+	
+}
+
+static int file_sink(const char* const buffer, const size_t buffer_size, void* userdata) {
+	
+	FILE* const file = (FILE*) userdata;
+	
+	if (fwrite(buffer, sizeof(*buffer), buffer_size, file) != buffer_size) {
+		return UNALIXERR_FILE_CANNOT_WRITE;
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int body_sink(const char* const buffer, const size_t buffer_size, void* userdata) {
+	
+	struct HTTPBody* const body = (struct HTTPBody*) userdata;
+	
+	if (body->size + buffer_size > body->capacity) {
+		size_t capacity = (body->capacity > 0) ? body->capacity * 2 : HTTP_BODY_CHUNK_SIZE;
+		
+		while (capacity < body->size + buffer_size) {
+			capacity *= 2;
+		}
+		
+		char* content = (char*) realloc(body->content, capacity);
+		
+		if (content == NULL) {
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+		
+		body->content = content;
+		body->capacity = capacity;
 	}
 	
+	memcpy(body->content + body->size, buffer, buffer_size);
+	body->size += buffer_size;
+	
 	return UNALIXERR_SUCCESS;
 	
 }
 
+int http_response_read(struct HTTPContext* context, FILE* file) {
+	
+	if (file != NULL) {
+		return http_response_stream(context, file_sink, file);
+	}
+	
+	struct HTTPBody* const body = &context->response.body;
+	
+	// Bodies with a known size are allocated once
+	size_t content_length = 0;
+	
+	if (response_content_length(context, &content_length) && content_length > body->capacity) {
+		char* content = (char*) realloc(body->content, content_length);
+		
+		if (content == NULL) {
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+		
+		body->content = content;
+		body->capacity = content_length;
+	}
+	
+	return http_response_stream(context, body_sink, body);
+	
+}
+
 int http_get_redirect(const struct HTTPContext* context, char** dst) {
 	
 	const struct HTTPHeader* const location_header = http_headers_get(&context->response.headers, "Location");
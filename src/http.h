@@ -93,6 +93,7 @@ enum HTTPStatusCode {
 struct HTTPHeader {
 	char* key;
 	char* value;
+	int borrowed; // The key and value are not owned by the header
 };
 
 struct HTTPHeaders {
@@ -105,6 +106,7 @@ struct HTTPHeaders {
 struct HTTPBody {
 	size_t size;
 	char* content;
+	size_t capacity;
 };
 
 struct HTTPStatus {
@@ -118,6 +120,27 @@ struct HTTPRequest {
 	struct HTTPHeaders headers;
 	struct HTTPBody body;
 	struct URI uri;
+	int probe; // Only the status line and headers are wanted; the response body is never read
+};
+
+#define HTTP_MAX_HEADERS_SIZE (1024 * 10)
+
+// Size of each read while streaming a response body (the largest TLS record)
+#define HTTP_BODY_CHUNK_SIZE (1024 * 16)
+
+typedef int (*http_body_sink_t)(const char* const buffer, const size_t buffer_size, void* userdata);
+
+enum HTTPParserState {
+	HTTP_PARSER_STATUS_LINE,
+	HTTP_PARSER_HEADERS,
+	HTTP_PARSER_DONE
+};
+
+struct HTTPParser {
+	enum HTTPParserState state;
+	char buffer[HTTP_MAX_HEADERS_SIZE]; // Receive buffer; response header names and values point into it
+	size_t size; // Bytes received
+	size_t offset; // Bytes consumed by the parser; once done, the body starts here
 };
 
 struct HTTPResponse {
@@ -125,12 +148,14 @@ struct HTTPResponse {
 	enum HTTPVersion version;
 	struct HTTPHeaders headers;
 	struct HTTPBody body;
+	struct HTTPParser parser;
 };
 
 struct HTTPContext {
 	struct HTTPRequest request;
 	struct HTTPResponse response;
 	struct Connection connection;
+	struct HTTPBody buffer; // Serialized outgoing request, reused across requests
 };
 
 static const char HTTP_DATE_FORMAT[] = "%a, %d %b %Y %H:%M:%S GMT";
@@ -152,13 +177,22 @@ static const char HTTP_HEADER_LOCATION[] = "Location";
 static const char HTTP_HEADER_USER_AGENT[] = "User-Agent";
 static const char HTTP_HEADER_LAST_MODIFIED[] = "Last-Modified";
 static const char HTTP_HEADER_IF_MODIFIED_SINCE[] = "If-Modified-Since";
+static const char HTTP_HEADER_ETAG[] = "ETag";
+static const char HTTP_HEADER_IF_NONE_MATCH[] = "If-None-Match";
 
 int http_request_set_url(struct HTTPContext* context, const char* url);
 int http_request_set_uri(struct HTTPContext* context, const struct URI uri);
 int http_request_add_header(struct HTTPContext* context, const char* key, const char* value);
+int http_request_add_static_header(struct HTTPContext* context, const char* key, const char* value);
 int http_request_send(struct HTTPContext* context);
+int http_request_serialize(const struct HTTPRequest* obj, struct HTTPBody* dst);
+int http_request_stringify(struct HTTPRequest* obj, char** dst, size_t* dst_size);
+void http_request_free(struct HTTPRequest* obj);
+
+int http_body_set(struct HTTPBody* obj, const char* buffer, const size_t buffer_size);
 
 int http_response_read(struct HTTPContext* context, FILE* file);
+int http_response_stream(struct HTTPContext* context, const http_body_sink_t sink, void* userdata);
 const struct HTTPHeader* http_response_get_header(const struct HTTPContext* context, const char* key);
 const struct HTTPBody* http_response_get_body(struct HTTPContext* context);
 const struct HTTPStatus* http_response_get_status(struct HTTPContext* context);
@@ -0,0 +1,160 @@
+#include <stddef.h>
+
+#include "unalix.h"
+#include "metrics.h"
+#include "threads.h"
+
+/*
+Process-wide counters and latency histograms for the HTTP client.
+
+Everything is disabled by default. While disabled, instrumented code only pays for a relaxed load
+of the enabled flag; no clock is read and no counter is touched. Counters are updated with relaxed
+atomic additions, so a snapshot taken while requests are in flight may be slightly inconsistent
+across fields (but never torn within one).
+*/
+
+static int enabled = 0;
+
+static struct unalix_metrics metrics = {0};
+
+static struct Mutex callback_mutex = MUTEX_INITIALIZER;
+static unalix_metrics_callback_t callback = NULL;
+static void* callback_userdata = NULL;
+
+static unsigned long long* counter_get(const enum MetricsCounter counter) {
+	
+	switch (counter) {
+		case METRICS_CONNECTIONS_OPENED:
+			return &metrics.connections_opened;
+		case METRICS_TLS_HANDSHAKES:
+			return &metrics.tls_handshakes;
+		case METRICS_BYTES_RECEIVED:
+			return &metrics.bytes_received;
+		case METRICS_BYTES_SENT:
+			return &metrics.bytes_sent;
+		case METRICS_REDIRECTS_FOLLOWED:
+			return &metrics.redirects_followed;
+		case METRICS_UNSHORTS:
+			return &metrics.unshorts;
+		case METRICS_UNSHORTS_FAILED:
+			return &metrics.unshorts_failed;
+	}
+	
+	return NULL;
+	
+}
+
+static size_t histogram_bucket(unsigned long long duration) {
+	
+	size_t bucket = 0;
+	
+	while (duration > 0 && bucket < UNALIX_METRICS_TOTAL_BUCKETS - 1) {
+		duration >>= 1;
+		bucket++;
+	}
+	
+	return bucket;
+	
+}
+
+int metrics_is_enabled(void) {
+	return __atomic_load_n(&enabled, __ATOMIC_RELAXED);
+}
+
+void metrics_add(const enum MetricsCounter counter, const unsigned long long value) {
+	
+	if (!metrics_is_enabled()) {
+		return;
+	}
+	
+	unsigned long long* const item = counter_get(counter);
+	
+	if (item != NULL) {
+		__atomic_add_fetch(item, value, __ATOMIC_RELAXED);
+	}
+	
+}
+
+void metrics_record_phase(const enum unalix_phase phase, const unsigned long long duration) {
+	
+	if (!metrics_is_enabled()) {
+		return;
+	}
+	
+	__atomic_add_fetch(&metrics.phase_count[phase], 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&metrics.phase_total[phase], duration, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&metrics.histogram[phase][histogram_bucket(duration)], 1, __ATOMIC_RELAXED);
+	
+}
+
+void metrics_record_request(const struct unalix_request_metrics* const request) {
+	/*
+	Accounts for a finished HTTP request and hands its measurements over to the user callback.
+	Only phases the request went through (those with a non-zero duration) are recorded.
+	*/
+	
+	if (!metrics_is_enabled()) {
+		return;
+	}
+	
+	__atomic_add_fetch(&metrics.requests, 1, __ATOMIC_RELAXED);
+	
+	if (request->code < 0 && -request->code < UNALIX_METRICS_TOTAL_ERRORS) {
+		__atomic_add_fetch(&metrics.errors[-request->code], 1, __ATOMIC_RELAXED);
+	}
+	
+	for (size_t phase = 0; phase < UNALIX_TOTAL_PHASES; phase++) {
+		if (request->phases[phase] > 0) {
+			metrics_record_phase((enum unalix_phase) phase, request->phases[phase]);
+		}
+	}
+	
+	mutex_lock(&callback_mutex);
+	
+	const unalix_metrics_callback_t function = callback;
+	void* const userdata = callback_userdata;
+	
+	mutex_unlock(&callback_mutex);
+	
+	if (function != NULL) {
+		function(request, userdata);
+	}
+	
+}
+
+void unalix_metrics_enable(const int value) {
+	__atomic_store_n(&enabled, !!value, __ATOMIC_RELAXED);
+}
+
+void unalix_metrics_snapshot(struct unalix_metrics* dst) {
+	
+	const unsigned long long* const source = (const unsigned long long*) &metrics;
+	unsigned long long* const destination = (unsigned long long*) dst;
+	
+	// The structure is made of nothing but counters
+	for (size_t index = 0; index < sizeof(metrics) / sizeof(*source); index++) {
+		destination[index] = __atomic_load_n(&source[index], __ATOMIC_RELAXED);
+	}
+	
+}
+
+void unalix_metrics_reset(void) {
+	
+	unsigned long long* const destination = (unsigned long long*) &metrics;
+	
+	for (size_t index = 0; index < sizeof(metrics) / sizeof(*destination); index++) {
+		__atomic_store_n(&destination[index], 0, __ATOMIC_RELAXED);
+	}
+	
+}
+
+void unalix_metrics_set_callback(const unalix_metrics_callback_t function, void* userdata) {
+	
+	mutex_lock(&callback_mutex);
+	
+	callback = function;
+	callback_userdata = userdata;
+	
+	mutex_unlock(&callback_mutex);
+	
+}
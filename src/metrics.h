@@ -0,0 +1,21 @@
+#ifndef METRICS_H_INCLUDED
+#define METRICS_H_INCLUDED
+
+#include "unalix.h"
+
+enum MetricsCounter {
+	METRICS_CONNECTIONS_OPENED,
+	METRICS_TLS_HANDSHAKES,
+	METRICS_BYTES_RECEIVED,
+	METRICS_BYTES_SENT,
+	METRICS_REDIRECTS_FOLLOWED,
+	METRICS_UNSHORTS,
+	METRICS_UNSHORTS_FAILED
+};
+
+int metrics_is_enabled(void);
+void metrics_add(const enum MetricsCounter counter, const unsigned long long value);
+void metrics_record_phase(const enum unalix_phase phase, const unsigned long long duration);
+void metrics_record_request(const struct unalix_request_metrics* const request);
+
+#endif
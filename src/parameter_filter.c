@@ -0,0 +1,158 @@
+#include <string.h>
+
+#include "parameter_filter.h"
+
+// Bits set per name
+static const size_t PARAMETER_FILTER_TOTAL_HASHES = 3;
+
+static uint64_t parameter_hash(const char* const name, const size_t length) {
+	/*
+	64-bit FNV-1a. Both halves are used, to derive each of the filter's hashes (Kirsch-Mitzenmacher).
+	*/
+	
+	uint64_t value = UINT64_C(14695981039346656037);
+	
+	for (size_t index = 0; index < length; index++) {
+		value ^= (unsigned char) name[index];
+		value *= UINT64_C(1099511628211);
+	}
+	
+	return value;
+	
+}
+
+static size_t parameter_filter_bit(const uint64_t hash, const size_t index) {
+	
+	const uint32_t first = (uint32_t) hash;
+	const uint32_t second = (uint32_t) (hash >> 32) | 1;
+	
+	return (size_t) ((first + index * second) % (PARAMETER_FILTER_SIZE * 8));
+	
+}
+
+size_t parameter_name_from_rule(const char* const rule, char* dst) {
+	/*
+	Gets the parameter name a rule matches, if the rule is nothing but a plain name (letters, digits,
+	"_", "-" and escaped dots). dst must hold PARAMETER_MAX_NAME_LENGTH + 1 bytes. Returns
+	the length of the name, or 0 if the rule is not one.
+	*/
+	
+	size_t length = 0;
+	
+	for (const char* character = rule; *character != '\0'; character++) {
+		if (length >= PARAMETER_MAX_NAME_LENGTH) {
+			return 0;
+		}
+		
+		if (*character == '\\' && *(character + 1) == '.') {
+			dst[length++] = '.';
+			character++;
+			
+			continue;
+		}
+		
+		const int allowed = (
+			(*character >= 'a' && *character <= 'z') ||
+			(*character >= 'A' && *character <= 'Z') ||
+			(*character >= '0' && *character <= '9') ||
+			*character == '_' ||
+			*character == '-'
+		);
+		
+		if (!allowed) {
+			return 0;
+		}
+		
+		dst[length++] = *character;
+	}
+	
+	dst[length] = '\0';
+	
+	return length;
+	
+}
+
+void parameter_filter_add(struct ParameterFilter* filter, const char* const name, const size_t length) {
+	
+	const uint64_t hash = parameter_hash(name, length);
+	
+	for (size_t index = 0; index < PARAMETER_FILTER_TOTAL_HASHES; index++) {
+		const size_t bit = parameter_filter_bit(hash, index);
+		filter->bits[bit / 8] |= (unsigned char) (1 << (bit % 8));
+	}
+	
+	filter->lengths |= UINT64_C(1) << length;
+	
+}
+
+int parameter_filter_may_contain(const struct ParameterFilter* const filter, const char* const name, const size_t length) {
+	
+	if (length > PARAMETER_MAX_NAME_LENGTH || !(filter->lengths >> length & 1)) {
+		return 0;
+	}
+	
+	const uint64_t hash = parameter_hash(name, length);
+	
+	for (size_t index = 0; index < PARAMETER_FILTER_TOTAL_HASHES; index++) {
+		const size_t bit = parameter_filter_bit(hash, index);
+		
+		if (!(filter->bits[bit / 8] & (1 << (bit % 8)))) {
+			return 0;
+		}
+	}
+	
+	return 1;
+	
+}
+
+int parameter_keys_match(const char* const subject, int (*contains)(const void* set, const char* const name, const size_t length), const void* const set) {
+	/*
+	Tells whether a query (or fragment) has a parameter whose key starts with a name that "contains"
+	finds in set. Keys start where the rules' PREFIX_EXTENDED_PATTERN matches: at the beginning of
+	subject, and after each "&" or "?".
+	*/
+	
+	for (size_t offset = 0; subject[offset] != '\0'; offset++) {
+		if (!(offset == 0 || subject[offset - 1] == '&' || subject[offset - 1] == '?')) {
+			continue;
+		}
+		
+		const char* const key = subject + offset;
+		
+		// Names never contain any of these, so they bound the longest name that can match here
+		size_t available = strcspn(key, "&?=");
+		
+		if (available > PARAMETER_MAX_NAME_LENGTH) {
+			available = PARAMETER_MAX_NAME_LENGTH;
+		}
+		
+		for (size_t length = 1; length <= available; length++) {
+			if (contains(set, key, length)) {
+				return 1;
+			}
+		}
+	}
+	
+	return 0;
+	
+}
+
+static int filter_contains(const void* set, const char* const name, const size_t length) {
+	
+	return parameter_filter_may_contain((const struct ParameterFilter*) set, name, length);
+	
+}
+
+int parameter_filter_matches(const struct ParameterFilter* const filter, const char* const subject) {
+	/*
+	Tells whether a query (or fragment) may have a parameter whose key starts with one of the names
+	in filter.
+	*/
+	
+	if (subject == NULL || filter->lengths == 0) {
+		return 0;
+	}
+	
+	return parameter_keys_match(subject, filter_contains, filter);
+	
+}
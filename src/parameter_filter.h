@@ -0,0 +1,31 @@
+#ifndef PARAMETER_FILTER_H_INCLUDED
+#define PARAMETER_FILTER_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+A Bloom filter over the parameter names that the literal rules (rules and referralMarketing entries
+that are plain names, such as "utm_source") of the loaded rulesets strip. When none of the
+keys of a query can start with one of those names, providers whose rules are all literal have
+nothing to strip from it.
+*/
+
+#define PARAMETER_FILTER_SIZE 1024
+
+// Longest parameter name matched without a regular expression, by the filter as well as by frozen sets
+// (MAX_LITERAL_LENGTH in tool/ruleset.c.py); rules naming longer parameters are handled as regular expressions
+#define PARAMETER_MAX_NAME_LENGTH 63
+
+struct ParameterFilter {
+	unsigned char bits[PARAMETER_FILTER_SIZE];
+	uint64_t lengths; // Bit n is set if some name is n bytes long
+};
+
+size_t parameter_name_from_rule(const char* const rule, char* dst);
+void parameter_filter_add(struct ParameterFilter* filter, const char* const name, const size_t length);
+int parameter_filter_may_contain(const struct ParameterFilter* const filter, const char* const name, const size_t length);
+int parameter_keys_match(const char* const subject, int (*contains)(const void* set, const char* const name, const size_t length), const void* const set);
+int parameter_filter_matches(const struct ParameterFilter* const filter, const char* const subject);
+
+#endif
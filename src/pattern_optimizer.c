@@ -0,0 +1,85 @@
+#define PCRE2_CODE_UNIT_WIDTH 8
+
+#include <pcre2.h>
+
+#include "pattern_optimizer.h"
+
+static int references_groups(const char* const src) {
+	/*
+	Tells whether src may refer to capture groups by number (backreferences, subroutine calls,
+	conditions). Those would point at different groups, or none, once unnamed groups stop
+	capturing. False positives only cost the optimization.
+	*/
+	
+	for (const char* character = src; *character != '\0'; character++) {
+		if (*character == '\\') {
+			const char next = *(character + 1);
+			
+			if ((next >= '0' && next <= '9') || next == 'g' || next == 'k') {
+				return 1;
+			}
+			
+			if (next != '\0') {
+				character++;
+			}
+			
+			continue;
+		}
+		
+		if (*character == '(' && *(character + 1) == '?') {
+			const char next = *(character + 2);
+			
+			if ((next >= '0' && next <= '9') || next == '+' || next == '-' || next == '&' || next == '(' || next == 'P' || next == 'R') {
+				return 1;
+			}
+		}
+	}
+	
+	return 0;
+	
+}
+
+static const char* skip_leading_dot_star(const char* const src) {
+	/*
+	An unanchored pattern starting with ".*" (or ".*?") matches a subject exactly when the rest of it
+	matches somewhere in that subject, since ".*" may match nothing. Only whether there is a match
+	is preserved, not where it starts.
+	*/
+	
+	if (!(src[0] == '.' && src[1] == '*')) {
+		return src;
+	}
+	
+	const char* const rest = (src[2] == '?') ? src + 3 : src + 2;
+	
+	// Possessive or otherwise quantified further, it would not be the same ".*"
+	if (*rest == '+' || *rest == '*' || *rest == '?' || *rest == '{') {
+		return src;
+	}
+	
+	return rest;
+	
+}
+
+uint32_t pattern_optimize(const char* const src, const enum PatternUsage usage, const char** dst) {
+	/*
+	Rewrites src for the given usage. dst is set to the pattern to compile (src itself, or a suffix
+	of it), and the options to compile it with are returned.
+	*/
+	
+	uint32_t options = 0;
+	
+	*dst = src;
+	
+	if (usage == PATTERN_USAGE_MATCH) {
+		*dst = skip_leading_dot_star(src);
+	}
+	
+	// Unused captures still cost their bookkeeping on every match attempt
+	if (usage != PATTERN_USAGE_CAPTURE && !references_groups(src)) {
+		options |= PCRE2_NO_AUTO_CAPTURE;
+	}
+	
+	return options;
+	
+}
@@ -0,0 +1,20 @@
+#ifndef PATTERN_OPTIMIZER_H_INCLUDED
+#define PATTERN_OPTIMIZER_H_INCLUDED
+
+#include <stdint.h>
+
+/*
+Load-time rewrites of ruleset patterns into equivalent, cheaper forms. What is equivalent depends
+on what the result of matching is used for.
+*/
+
+enum PatternUsage {
+	PATTERN_USAGE_MATCH, // Only whether it matches is used (urlPattern, exceptions)
+	PATTERN_USAGE_STRIP, // Matches are removed (rawRules)
+	PATTERN_USAGE_STRIP_PARAMETER, // Matches are removed, after extending the pattern to the whole parameter (rules, referralMarketing)
+	PATTERN_USAGE_CAPTURE // Capture groups are read (redirections)
+};
+
+uint32_t pattern_optimize(const char* const src, const enum PatternUsage usage, const char** dst);
+
+#endif
@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 
 #define PCRE2_CODE_UNIT_WIDTH 8
@@ -31,9 +32,23 @@ int regex_compile(const char* src, pcre2_code** dst) {
 	
 }
 
+pcre2_match_data* regex_match_data_create(const pcre2_code* pattern) {
+	/*
+	Same as pcre2_match_data_create_from_pattern(), except that it does not allocate through the
+	memory functions stored in the pattern. Patterns attached from a shared ruleset segment
+	live in read-only memory mapped by another process, and carry no usable allocator.
+	*/
+	
+	uint32_t capture_count = 0;
+	pcre2_pattern_info(pattern, PCRE2_INFO_CAPTURECOUNT, &capture_count);
+	
+	return pcre2_match_data_create(capture_count + 1, NULL);
+	
+}
+
 int regex_match(const pcre2_code* pattern, const PCRE2_SPTR subject) {
 	
-	pcre2_match_data* match_data = pcre2_match_data_create_from_pattern(pattern, NULL);
+	pcre2_match_data* match_data = regex_match_data_create(pattern);
 	const int code = pcre2_match(pattern, subject, PCRE2_ZERO_TERMINATED, 0, 0, match_data, NULL);
 	pcre2_match_data_free(match_data);
 	
@@ -47,13 +62,15 @@ void regex_strip(const pcre2_code* pattern, const PCRE2_SPTR subject, char** des
 		PCRE2_UCHAR output[strlen(*destination)];
 		PCRE2_SIZE output_length = sizeof(output);
 		
+		pcre2_match_data* match_data = regex_match_data_create(pattern);
+		
 		pcre2_substitute(
 			pattern,
 			subject,
 			PCRE2_ZERO_TERMINATED,
 			0,
 			PCRE2_SUBSTITUTE_GLOBAL,
-			NULL,
+			match_data,
 			NULL,
 			NULL,
 			0,
@@ -61,6 +78,8 @@ void regex_strip(const pcre2_code* pattern, const PCRE2_SPTR subject, char** des
 			&output_length
 		);
 		
+		pcre2_match_data_free(match_data);
+		
 		if (output_length < 1) {
 			free(*destination);
 			*destination = NULL;
@@ -72,3 +91,69 @@ void regex_strip(const pcre2_code* pattern, const PCRE2_SPTR subject, char** des
 	}
 	
 }
+
+static size_t literal_match(const char* const subject, const char* const literal, const size_t length) {
+	/*
+	Returns the length of the parameter subject starts with if it is named literal, or 0 if it is not.
+	Like PREFIX_EXTENDED_PATTERN and SUFFIX_EXTENDED_PATTERN, the name only needs to be a prefix of the key.
+	*/
+	
+	if (strncmp(subject, literal, length) != 0) {
+		return 0;
+	}
+	
+	size_t offset = length;
+	
+	if (subject[offset] == '=') {
+		offset += strcspn(subject + offset, "&");
+	}
+	
+	return offset;
+	
+}
+
+void literal_strip(const char* const literal, char** destination) {
+	/*
+	Strips every parameter named literal from destination, in place. Gives the same result as regex_strip()
+	with the rule compiled through rule_compile(), without going through PCRE2.
+	*/
+	
+	char* const subject = *destination;
+	
+	const size_t length = strlen(literal);
+	
+	size_t position = 0;
+	size_t offset = 0;
+	
+	while (subject[offset] != '\0') {
+		size_t match_length = 0;
+		
+		if (offset == 0) {
+			match_length = literal_match(subject, literal, length);
+		}
+		
+		// The separator before the parameter goes with it
+		if (match_length == 0 && (subject[offset] == '&' || subject[offset] == '?')) {
+			match_length = literal_match(subject + offset + 1, literal, length);
+			
+			if (match_length > 0) {
+				match_length++;
+			}
+		}
+		
+		if (match_length > 0) {
+			offset += match_length;
+			continue;
+		}
+		
+		subject[position++] = subject[offset++];
+	}
+	
+	subject[position] = '\0';
+	
+	if (position < 1) {
+		free(*destination);
+		*destination = NULL;
+	}
+	
+}
@@ -3,7 +3,9 @@
 #include <pcre2.h>
 
 //int regex_compile(pcre2_code** obj, const char* pattern);
+pcre2_match_data* regex_match_data_create(const pcre2_code* pattern);
 int regex_match(const pcre2_code* pattern, const PCRE2_SPTR subject);
 void regex_strip(const pcre2_code* pattern, const PCRE2_SPTR subject, char** destination);
+void literal_strip(const char* const literal, char** destination);
 
 void concatenate_pattern(const char* const src, char* dst);
@@ -1,7 +1,7 @@
 #ifdef _WIN32
 	#include <stdio.h>
 #else
-	#define _XOPEN_SOURCE
+	#define _XOPEN_SOURCE 700
 #endif
 
 #include <stdlib.h>
@@ -16,6 +16,8 @@
 #include "http.h"
 #include "utils.h"
 #include "sha256.h"
+#include "ruleset_segment.h"
+#include "threads.h"
 
 static const char URL_PATTERN[] = "urlPattern";
 static const char COMPLETE_PROVIDER[] = "completeProvider";
@@ -41,21 +43,42 @@ static const char PREFIX_EXTENDED_PATTERN[] = "(?:^|&|\\?)";
 static const char SUFFIX_EXTENDED_PATTERN[] = "(?:=[^&]*)?";
 
 static const char RULESET_TEMPORARY_FILE[] = "ruleset.json";
+static const char RULESET_TEMPORARY_SUFFIX[] = ".tmp";
+static const char RULESET_ETAG_SUFFIX[] = ".etag";
 
-static int regex_compile(const char* src, pcre2_code** dst) {
+static const size_t RULESET_DOWNLOAD_CHUNK_SIZE = 64 * 1024;
+
+#define RULESET_MAX_ETAG_SIZE 256
+
+static int regex_compile(const char* src, const enum PatternUsage usage, pcre2_code** dst) {
 	
 	int error_number = 0;
 	PCRE2_SIZE error_offset = 0;
 	
+	const char* optimized = NULL;
+	const uint32_t options = pattern_optimize(src, usage, &optimized);
+	
 	pcre2_code* re = pcre2_compile(
-		(PCRE2_SPTR) src,
+		(PCRE2_SPTR) optimized,
 		PCRE2_ZERO_TERMINATED,
-		0,
+		options,
 		&error_number,
 		&error_offset,
 		NULL
 	);
 	
+	// The rewritten pattern compiles whenever the original does, but the original is what decides
+	if (re == NULL && (optimized != src || options != 0)) {
+		re = pcre2_compile(
+			(PCRE2_SPTR) src,
+			PCRE2_ZERO_TERMINATED,
+			0,
+			&error_number,
+			&error_offset,
+			NULL
+		);
+	}
+	
 	if (re == NULL) {
 		return UNALIXERR_REGEX_COMPILE_PATTERN_FAILURE;
 	}
@@ -66,7 +89,64 @@ static int regex_compile(const char* src, pcre2_code** dst) {
 	
 }
 
-static struct Rulesets rulesets = {0};
+int rule_compile(const char* const src, const enum PatternUsage usage, pcre2_code** dst) {
+	/*
+	Compiles a rule. Rules matching query parameters (rules and referralMarketing) are extended
+	to match the whole parameter, value included.
+	*/
+	
+	if (usage != PATTERN_USAGE_STRIP_PARAMETER) {
+		return regex_compile(src, usage, dst);
+	}
+	
+	char extended_src[strlen(PREFIX_EXTENDED_PATTERN) + strlen(src) + strlen(SUFFIX_EXTENDED_PATTERN) + 1];
+	strcpy(extended_src, PREFIX_EXTENDED_PATTERN);
+	strcat(extended_src, src);
+	strcat(extended_src, SUFFIX_EXTENDED_PATTERN);
+	
+	return regex_compile(extended_src, usage, dst);
+	
+}
+
+int rulesets_filter_rule(struct Rulesets* rulesets, const char* const rule) {
+	/*
+	Adds the parameter name a rules or referralMarketing entry strips to the filter of rulesets.
+	Returns 0 if the rule is not a plain name, and therefore cannot be filtered.
+	*/
+	
+	char name[PARAMETER_MAX_NAME_LENGTH + 1];
+	const size_t length = parameter_name_from_rule(rule, name);
+	
+	if (length == 0) {
+		return 0;
+	}
+	
+	parameter_filter_add(&rulesets->filter, name, length);
+	
+	return 1;
+	
+}
+
+/*
+The loaded rulesets are published as immutable, reference counted snapshots. Cleaning holds a reference
+to the snapshot it started with, so replacing the rulesets never frees them under a running request; the
+last one to let go of a snapshot frees it.
+
+Loading more rulesets on top of the current ones makes a new snapshot that shares the providers of the
+previous one (its base) instead of copying them. The base is kept alive for as long as the new snapshot
+is. Loads racing with each other are not merged; the last one to finish wins.
+*/
+struct RulesetsSnapshot {
+	struct Rulesets rulesets; // Must come first; see rulesets_release()
+	struct RulesetsSnapshot* base;
+	size_t total_inherited; // Leading providers owned by base
+	size_t references;
+};
+
+static struct Mutex rulesets_mutex = MUTEX_INITIALIZER;
+static struct RulesetsSnapshot* current_rulesets = NULL;
+
+static const struct Rulesets EMPTY_RULESETS = {0};
 
 static int load_ruleset(json_t* tree, struct Rulesets* rulesets) {
 	
@@ -111,7 +191,9 @@ static int load_ruleset(json_t* tree, struct Rulesets* rulesets) {
 			}
 		}
 		
-		struct Ruleset ruleset = {0};
+		struct Ruleset ruleset = {
+			.parameters_filtered = 1
+		};
 		
 		/*
 		urlPattern
@@ -128,7 +210,7 @@ static int load_ruleset(json_t* tree, struct Rulesets* rulesets) {
 		}
 		
 		const char* const url_pattern = json_string_value(obj);
-		const int code = regex_compile(url_pattern, &ruleset.url_pattern);
+		const int code = rule_compile(url_pattern, PATTERN_USAGE_MATCH, &ruleset.url_pattern);
 		
 		if (code != UNALIXERR_SUCCESS) {
 			return code;
@@ -181,6 +263,16 @@ static int load_ruleset(json_t* tree, struct Rulesets* rulesets) {
 			
 			const int should_modify_pattern = ((strcmp(name, RULES) == 0) || (strcmp(name, REFERRAL_MARKETING) == 0));
 			
+			enum PatternUsage usage = PATTERN_USAGE_STRIP;
+			
+			if (should_modify_pattern) {
+				usage = PATTERN_USAGE_STRIP_PARAMETER;
+			} else if (strcmp(name, EXCEPTIONS) == 0) {
+				usage = PATTERN_USAGE_MATCH;
+			} else if (strcmp(name, REDIRECTIONS) == 0) {
+				usage = PATTERN_USAGE_CAPTURE;
+			}
+			
 			json_array_foreach(obj, array_index, array_item) {
 				if (!json_is_string(array_item)) {
 					return UNALIXERR_JSON_NON_MATCHING_TYPE;
@@ -189,17 +281,10 @@ static int load_ruleset(json_t* tree, struct Rulesets* rulesets) {
 				const char* const src = json_string_value(array_item);
 				pcre2_code* dst = NULL;
 				
-				int code = 0;
+				const int code = rule_compile(src, usage, &dst);
 				
-				if (should_modify_pattern) {
-					char extended_src[strlen(PREFIX_EXTENDED_PATTERN) + strlen(src) + strlen(SUFFIX_EXTENDED_PATTERN) + 1];
-					strcpy(extended_src, PREFIX_EXTENDED_PATTERN);
-					strcat(extended_src, src);
-					strcat(extended_src, SUFFIX_EXTENDED_PATTERN);
-					
-					code = regex_compile(extended_src, &dst);
-				} else {
-					code = regex_compile(src, &dst);
+				if (should_modify_pattern && !rulesets_filter_rule(rulesets, src)) {
+					ruleset.parameters_filtered = 0;
 				}
 				
 				if (code != UNALIXERR_SUCCESS) {
@@ -239,56 +324,93 @@ static int load_ruleset(json_t* tree, struct Rulesets* rulesets) {
 	
 }
 
-void rulesets_free(struct Rulesets* rulesets) {
+static void ruleset_free(struct Ruleset* ruleset, const int patterns_borrowed) {
 	
-	for (size_t index = 0; index < rulesets->offset; index++) {
-		struct Ruleset* ruleset = &rulesets->items[index];
-		
-		if (ruleset->url_pattern != NULL) {
-			pcre2_code_free(ruleset->url_pattern);
-			ruleset->url_pattern = NULL;
-		}
-		
-		const struct Rules objects[] = {
-			ruleset->rules,
-			ruleset->raw_rules,
-			ruleset->referral_marketing,
-			ruleset->exceptions,
-			ruleset->redirections
-		};
+	if (ruleset->url_pattern != NULL && !patterns_borrowed) {
+		pcre2_code_free(ruleset->url_pattern);
+		ruleset->url_pattern = NULL;
+	}
+	
+	const struct Rules objects[] = {
+		ruleset->rules,
+		ruleset->raw_rules,
+		ruleset->referral_marketing,
+		ruleset->exceptions,
+		ruleset->redirections
+	};
+	
+	for (size_t index = 0; index < sizeof(objects) / sizeof(*objects); index++) {
+		struct Rules object = objects[index];
 		
-		for (size_t index = 0; index < sizeof(objects) / sizeof(*objects); index++) {
-			struct Rules object = objects[index];
-			
-			if (object.items != NULL) {
-				for (size_t index = 0; index < object.total_items; index++) {
-					pcre2_code_free(object.items[index]);
-				}
-				
-				free(object.items);
-				object.items = NULL;
-				object.total_items = 0;
+		if (object.items != NULL) {
+			for (size_t index = 0; index < object.total_items && !patterns_borrowed; index++) {
+				pcre2_code_free(object.items[index]);
 			}
+			
+			free(object.items);
+			free(object.literals);
+			object.items = NULL;
+			object.total_items = 0;
 		}
 	}
 	
+}
+
+void rulesets_free(struct Rulesets* rulesets) {
+	
+	for (size_t index = 0; index < rulesets->offset; index++) {
+		ruleset_free(&rulesets->items[index], rulesets->patterns_borrowed);
+	}
+	
 	rulesets->offset = 0;
 	rulesets->size = 0;
 	
 	free(rulesets->items);
 	rulesets->items = NULL;
 	
+	free(rulesets->tables);
+	rulesets->tables = NULL;
+	
+	if (rulesets->segment != NULL && rulesets->segment_size > 0) {
+		ruleset_segment_unmap((void*) rulesets->segment, rulesets->segment_size);
+	}
+	
+	rulesets->segment = NULL;
+	rulesets->segment_size = 0;
+	rulesets->patterns_borrowed = 0;
+	rulesets->frozen = NULL;
+	
+	memset(&rulesets->filter, 0, sizeof(rulesets->filter));
+	
 }
 
-static int load_file(const char* const filename, struct Rulesets* dst) {
+static int load_tree(const char* const filename, json_t** tree) {
+	
+	if (!file_exists(filename)) {
+		return UNALIXERR_FILE_CANNOT_OPEN;
+	}
 	
-	json_t* tree = json_load_file(filename, 0, NULL);
+	*tree = json_load_file(filename, 0, NULL);
 	
-	if (tree == NULL) {
+	if (*tree == NULL) {
 		return UNALIXERR_JSON_CANNOT_PARSE;
 	}
 	
-	const int code = load_ruleset(tree, dst);
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int load_file(const char* const filename, struct Rulesets* dst) {
+	
+	json_t* tree = NULL;
+	
+	int code = load_tree(filename, &tree);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	code = load_ruleset(tree, dst);
 	
 	json_decref(tree);
 	
@@ -296,15 +418,177 @@ static int load_file(const char* const filename, struct Rulesets* dst) {
 	
 }
 
-struct Rulesets get_rulesets(void) {
-	return rulesets;
+static void rulesets_discard(struct Rulesets* rulesets, const size_t total_inherited) {
+	/*
+	Frees rulesets, except for its first total_inherited providers, which belong to a base snapshot.
+	*/
+	
+	if (total_inherited == 0) {
+		rulesets_free(rulesets);
+		return;
+	}
+	
+	for (size_t index = total_inherited; index < rulesets->offset; index++) {
+		ruleset_free(&rulesets->items[index], 0);
+	}
+	
+	free(rulesets->items);
+	rulesets->items = NULL;
+	rulesets->offset = 0;
+	
+}
+
+const struct Rulesets* rulesets_acquire(void) {
+	/*
+	Returns the loaded rulesets, which stay valid until they are given back with rulesets_release(),
+	however they are replaced in the meantime.
+	*/
+	
+	mutex_lock(&rulesets_mutex);
+	
+	struct RulesetsSnapshot* const snapshot = current_rulesets;
+	
+	if (snapshot != NULL) {
+		snapshot->references++;
+	}
+	
+	mutex_unlock(&rulesets_mutex);
+	
+	return (snapshot == NULL) ? &EMPTY_RULESETS : &snapshot->rulesets;
+	
 }
 
-static int check_ruleset_update(
-	const char* const filename,
-	const char* const url,
-	struct HTTPContext* context
-) {
+void rulesets_release(const struct Rulesets* const rulesets) {
+	
+	if (rulesets == &EMPTY_RULESETS) {
+		return;
+	}
+	
+	struct RulesetsSnapshot* snapshot = (struct RulesetsSnapshot*) rulesets;
+	
+	// Freeing a snapshot drops its reference to the base, which may have been the last one
+	while (snapshot != NULL) {
+		mutex_lock(&rulesets_mutex);
+		const int is_unused = (--snapshot->references == 0);
+		mutex_unlock(&rulesets_mutex);
+		
+		if (!is_unused) {
+			break;
+		}
+		
+		struct RulesetsSnapshot* const base = snapshot->base;
+		
+		rulesets_discard(&snapshot->rulesets, snapshot->total_inherited);
+		free(snapshot);
+		
+		snapshot = base;
+	}
+	
+}
+
+static int rulesets_publish(struct Rulesets* src, struct RulesetsSnapshot* base, const size_t total_inherited) {
+	/*
+	Makes src (and base, whose reference is handed over) the loaded rulesets. On failure, src is freed
+	and base released.
+	*/
+	
+	struct RulesetsSnapshot* snapshot = NULL;
+	
+	if (src != NULL) {
+		snapshot = (struct RulesetsSnapshot*) malloc(sizeof(*snapshot));
+		
+		if (snapshot == NULL) {
+			rulesets_discard(src, total_inherited);
+			
+			if (base != NULL) {
+				rulesets_release(&base->rulesets);
+			}
+			
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+		
+		snapshot->rulesets = *src;
+		snapshot->base = base;
+		snapshot->total_inherited = total_inherited;
+		snapshot->references = 1;
+	}
+	
+	mutex_lock(&rulesets_mutex);
+	
+	struct RulesetsSnapshot* const previous = current_rulesets;
+	current_rulesets = snapshot;
+	
+	mutex_unlock(&rulesets_mutex);
+	
+	if (previous != NULL) {
+		rulesets_release(&previous->rulesets);
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int set_rulesets(struct Rulesets* src) {
+	/*
+	Replaces the loaded rulesets with src, which is now owned by the global state (or freed, if that fails).
+	*/
+	
+	return rulesets_publish(src, NULL, 0);
+	
+}
+
+static int rulesets_extend(json_t* tree) {
+	/*
+	Loads the providers in tree on top of the loaded rulesets. The loaded rulesets are left as they
+	were if any of them cannot be loaded.
+	*/
+	
+	const struct Rulesets* const current = rulesets_acquire();
+	
+	struct Rulesets extended = {0};
+	size_t total_inherited = 0;
+	
+	// Rulesets attached from a shared segment cannot be extended, only replaced
+	if (current->offset > 0 && current->segment == NULL) {
+		extended.size = sizeof(*current->items) * current->offset;
+		extended.items = (struct Ruleset*) malloc(extended.size);
+		
+		if (extended.items == NULL) {
+			rulesets_release(current);
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+		
+		memcpy(extended.items, current->items, extended.size);
+		
+		extended.offset = current->offset;
+		extended.frozen = current->frozen;
+		extended.filter = current->filter;
+		
+		total_inherited = current->offset;
+	}
+	
+	const int code = load_ruleset(tree, &extended);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		rulesets_discard(&extended, total_inherited);
+		rulesets_release(current);
+		
+		return code;
+	}
+	
+	if (total_inherited == 0) {
+		rulesets_release(current);
+		return rulesets_publish(&extended, NULL, 0);
+	}
+	
+	return rulesets_publish(&extended, (struct RulesetsSnapshot*) current, total_inherited);
+	
+}
+
+static int local_last_modified(const char* const filename, time_t* last_modified, char* if_modified_since) {
+	/*
+	Gets the modification time of the local copy (as UTC), and formats it for the If-Modified-Since header.
+	*/
 	
 	if (!file_exists(filename)) {
 		return UNALIXERR_OS_STAT_FAILURE;
@@ -329,38 +613,135 @@ static int check_ruleset_update(
 	#endif
 	
 	// Convert local time to UTC time
-	const time_t last_modified = mktime(&time);
+	*last_modified = mktime(&time);
 	
-	if (last_modified == -1) {
+	if (*last_modified == -1) {
 		return UNALIXERR_OS_MKTIME_FAILURE;
 	}
 	
-	char if_modified_since[HTTP_DATE_SIZE + 1];
-	const size_t size = strftime(if_modified_since, sizeof(if_modified_since), HTTP_DATE_FORMAT, &time);
+	const size_t size = strftime(if_modified_since, HTTP_DATE_SIZE + 1, HTTP_DATE_FORMAT, &time);
 	
 	if (size != HTTP_DATE_SIZE) {
 		return UNALIXERR_OS_STRFTIME_FAILURE;
 	}
 	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static void etag_filename(const char* const filename, char* dst) {
+	
+	strcpy(dst, filename);
+	strcat(dst, RULESET_ETAG_SUFFIX);
+	
+}
+
+static int etag_read(const char* const filename, char* dst, const size_t dst_size) {
+	/*
+	Reads the entity tag the local copy was downloaded with, if any was stored next to it.
+	*/
+	
+	char name[strlen(filename) + strlen(RULESET_ETAG_SUFFIX) + 1];
+	etag_filename(filename, name);
+	
+	FILE* const file = fopen(name, "r");
+	
+	if (file == NULL) {
+		return 0;
+	}
+	
+	const size_t size = fread(dst, sizeof(*dst), dst_size - 1, file);
+	
+	fclose(file);
+	
+	dst[size] = '\0';
+	
+	return size > 0;
+	
+}
+
+static void etag_write(const char* const filename, const char* const etag) {
+	
+	char name[strlen(filename) + strlen(RULESET_ETAG_SUFFIX) + 1];
+	etag_filename(filename, name);
+	
+	if (*etag == '\0') {
+		remove_file(name);
+		return;
+	}
+	
+	FILE* const file = fopen(name, "w");
+	
+	if (file == NULL) {
+		return;
+	}
+	
+	fputs(etag, file);
+	fclose(file);
+	
+}
+
+static int add_conditional_headers(struct HTTPContext* context, const char* const filename, time_t* last_modified) {
+	/*
+	Makes the request conditional on the remote file differing from the local copy, based on both its
+	modification time and the entity tag it was downloaded with.
+	*/
+	
+	char if_modified_since[HTTP_DATE_SIZE + 1];
+	
+	int code = local_last_modified(filename, last_modified, if_modified_since);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	code = http_request_add_header(context, HTTP_HEADER_IF_MODIFIED_SINCE, if_modified_since);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	char etag[RULESET_MAX_ETAG_SIZE];
+	
+	if (etag_read(filename, etag, sizeof(etag))) {
+		code = http_request_add_header(context, HTTP_HEADER_IF_NONE_MATCH, etag);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int check_ruleset_update(
+	const char* const filename,
+	const char* const url,
+	struct HTTPContext* context
+) {
+	
 	int code = http_request_set_url(context, url);
 	
 	if (code != UNALIXERR_SUCCESS) {
 		return code;
 	}
 	
-	code = http_request_add_header(context, HTTP_HEADER_USER_AGENT, HTTP_DEFAULT_USER_AGENT);
+	time_t last_modified = 0;
+	
+	code = add_conditional_headers(context, filename, &last_modified);
 	
 	if (code != UNALIXERR_SUCCESS) {
 		return code;
 	}
 	
-	code = http_request_add_header(context, HTTP_HEADER_ACCEPT, "application/json");
+	code = http_request_add_static_header(context, HTTP_HEADER_USER_AGENT, HTTP_DEFAULT_USER_AGENT);
 	
 	if (code != UNALIXERR_SUCCESS) {
 		return code;
 	}
 	
-	code = http_request_add_header(context, HTTP_HEADER_IF_MODIFIED_SINCE, if_modified_since);
+	code = http_request_add_static_header(context, HTTP_HEADER_ACCEPT, "application/json");
 	
 	if (code != UNALIXERR_SUCCESS) {
 		return code;
@@ -445,21 +826,70 @@ static int check_ruleset_update(
 	
 }
 
-static int ruleset_update(const char* const filename, const char* const url, const char* const sha256_url, const char* const temporary_directory, struct HTTPContext* context) {
+struct RulesetDownload {
+	FILE* file;
+	br_sha256_context hash;
+	struct HTTPBody content;
+};
+
+static int ruleset_download_sink(const char* const buffer, const size_t buffer_size, void* userdata) {
+	/*
+	Writes each received chunk to the temporary file, while also feeding it to the hash and keeping
+	it in memory, so the ruleset never needs to be read back from disk to be verified and parsed.
+	*/
 	
-	int code = http_request_set_url(context, url);
+	struct RulesetDownload* const download = (struct RulesetDownload*) userdata;
+	
+	if (fwrite(buffer, sizeof(*buffer), buffer_size, download->file) != buffer_size) {
+		return UNALIXERR_FILE_CANNOT_WRITE;
+	}
+	
+	br_sha256_update(&download->hash, buffer, buffer_size);
+	
+	struct HTTPBody* const content = &download->content;
+	
+	if (content->size + buffer_size > content->capacity) {
+		size_t capacity = (content->capacity > 0) ? content->capacity * 2 : RULESET_DOWNLOAD_CHUNK_SIZE;
+		
+		while (capacity < content->size + buffer_size) {
+			capacity *= 2;
+		}
+		
+		char* buffer = (char*) realloc(content->content, capacity);
+		
+		if (buffer == NULL) {
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+		
+		content->content = buffer;
+		content->capacity = capacity;
+	}
+	
+	memcpy(content->content + content->size, buffer, buffer_size);
+	content->size += buffer_size;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int fetch_sha256(const char* const sha256_url, struct HTTPContext* context, char* dst) {
+	/*
+	Fetches the published hash of the ruleset, normalized to lowercase.
+	*/
+	
+	int code = http_request_set_url(context, sha256_url);
 	
 	if (code != UNALIXERR_SUCCESS) {
 		return code;
 	}
 	
-	code = http_request_add_header(context, HTTP_HEADER_USER_AGENT, HTTP_DEFAULT_USER_AGENT);
+	code = http_request_add_static_header(context, HTTP_HEADER_USER_AGENT, HTTP_DEFAULT_USER_AGENT);
 	
 	if (code != UNALIXERR_SUCCESS) {
 		return code;
 	}
 	
-	code = http_request_add_header(context, HTTP_HEADER_ACCEPT, "application/json");
+	code = http_request_add_static_header(context, HTTP_HEADER_ACCEPT, "text/plain");
 	
 	if (code != UNALIXERR_SUCCESS) {
 		return code;
@@ -477,123 +907,176 @@ static int ruleset_update(const char* const filename, const char* const url, con
 		return UNALIXERR_HTTP_BAD_STATUS_CODE;
 	}
 	
-	char* directory = (char*) temporary_directory;
+	code = http_response_read(context, NULL);
 	
-	if (directory == NULL) {
-		directory = get_temporary_directory();
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
 	}
 	
-	char ruleset_file[strlen(directory) + strlen(RULESET_TEMPORARY_FILE) + 1];
-	strcpy(ruleset_file, directory);
-	strcat(ruleset_file, RULESET_TEMPORARY_FILE);
+	const struct HTTPBody* body = http_response_get_body(context);
 	
-	if (temporary_directory == NULL) {
-		free(directory);
+	if (body->size < (br_sha256_SIZE * 2)) {
+		return UNALIXERR_RULESETS_MISMATCH_HASH;
 	}
 	
-	FILE* file = fopen(ruleset_file, "wb");
+	memcpy(dst, body->content, br_sha256_SIZE * 2);
 	
-	if (file == NULL) {
-		return UNALIXERR_FILE_CANNOT_OPEN;
+	// Normalize SHA256 hash, converting uppercase characters to lower ones
+	for (size_t index = 0; index < br_sha256_SIZE * 2; index++) {
+		char* ch = &dst[index];
+		
+		if (*ch >= 'A' && *ch <= 'F') {
+			*ch = *ch + 32;
+		}
 	}
 	
-	code = http_response_read(context, file);
+	return UNALIXERR_SUCCESS;
 	
-	fclose(file);
+}
+
+static int ruleset_download(
+	const char* const filename,
+	const char* const url,
+	const char* const sha256_url,
+	const char* const temporary_file,
+	struct HTTPContext* context,
+	struct Rulesets* dst,
+	char* etag
+) {
+	/*
+	Downloads the ruleset into the temporary file in a single pass: it is hashed and kept in memory
+	as it arrives, then verified and compiled from that buffer. When "filename" is given, the request
+	is made conditional on the remote file differing from that local copy.
 	
-	http_context_free(context);
+	On success, "dst" holds the compiled ruleset and "etag" the entity tag of the response (empty if
+	the server sent none).
+	*/
+	
+	int code = http_request_set_url(context, url);
 	
 	if (code != UNALIXERR_SUCCESS) {
-		remove_file(ruleset_file);
-		
 		return code;
 	}
 	
-	if (sha256_url != NULL) {
-		int code = http_request_set_url(context, sha256_url);
-		
-		if (code != UNALIXERR_SUCCESS) {
-			return code;
-		}
-		
-		code = http_request_add_header(context, HTTP_HEADER_USER_AGENT, HTTP_DEFAULT_USER_AGENT);
-		
-		if (code != UNALIXERR_SUCCESS) {
-			return code;
-		}
-		
-		code = http_request_add_header(context, HTTP_HEADER_ACCEPT, "text/plain");
-		
-		if (code != UNALIXERR_SUCCESS) {
-			return code;
-		}
-		
-		code = http_request_send(context);
-		
-		if (code != UNALIXERR_SUCCESS) {
-			return code;
-		}
+	if (filename != NULL && file_exists(filename)) {
+		time_t last_modified = 0;
 		
-		const struct HTTPStatus* status = http_response_get_status(context);
-		
-		if (status->code != OK) {
-			return UNALIXERR_HTTP_BAD_STATUS_CODE;
-		}
-		
-		code = http_response_read(context, NULL);
+		code = add_conditional_headers(context, filename, &last_modified);
 		
 		if (code != UNALIXERR_SUCCESS) {
-			remove_file(ruleset_file);
-			
 			return code;
 		}
+	}
+	
+	code = http_request_add_static_header(context, HTTP_HEADER_USER_AGENT, HTTP_DEFAULT_USER_AGENT);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	code = http_request_add_static_header(context, HTTP_HEADER_ACCEPT, "application/json");
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	code = http_request_send(context);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	const struct HTTPStatus* status = http_response_get_status(context);
+	
+	if (status->code == NOT_MODIFIED) {
+		return UNALIXERR_RULESETS_NOT_MODIFIED;
+	}
+	
+	if (status->code != OK) {
+		return UNALIXERR_HTTP_BAD_STATUS_CODE;
+	}
+	
+	*etag = '\0';
+	
+	const struct HTTPHeader* const header = http_response_get_header(context, HTTP_HEADER_ETAG);
+	
+	if (header != NULL && strlen(header->value) < RULESET_MAX_ETAG_SIZE) {
+		strcpy(etag, header->value);
+	}
+	
+	struct RulesetDownload download = {0};
+	
+	download.file = fopen(temporary_file, "wb");
+	
+	if (download.file == NULL) {
+		return UNALIXERR_FILE_CANNOT_OPEN;
+	}
+	
+	br_sha256_init(&download.hash);
+	
+	code = http_response_stream(context, ruleset_download_sink, &download);
+	
+	if (fclose(download.file) != 0 && code == UNALIXERR_SUCCESS) {
+		code = UNALIXERR_FILE_CANNOT_WRITE;
+	}
+	
+	http_context_free(context);
+	
+	if (code == UNALIXERR_SUCCESS && sha256_url != NULL) {
+		char rsha256[SHA256_DIGEST_SIZE];
+		code = fetch_sha256(sha256_url, context, rsha256);
 		
-		const struct HTTPBody* body = http_response_get_body(context);
-		
-		if (body->size < (br_sha256_SIZE * 2)) {
-			return UNALIXERR_RULESETS_MISMATCH_HASH;
-		}
-		
-		char rsha256[br_sha256_SIZE * 2];
-		memcpy(rsha256, body->content, sizeof(rsha256));
-		
-		http_context_free(context);
-		
-		// Normalize SHA256 hash, converting uppercase characters to lower ones
-		for (size_t index = 0; index < sizeof(rsha256); index++) {
-			char* ch = &rsha256[index];
+		if (code == UNALIXERR_SUCCESS) {
+			char lsha256[SHA256_DIGEST_SIZE];
+			sha256_hexdigest(&download.hash, lsha256);
 			
-			if (*ch >= 'A' && *ch <= 'F') {
-				*ch = *ch + 32;
+			// Compare both hashes to ensure the remote file was not tampered
+			if (memcmp(lsha256, rsha256, SHA256_DIGEST_SIZE) != 0) {
+				code = UNALIXERR_RULESETS_MISMATCH_HASH;
 			}
 		}
+	}
+	
+	if (code == UNALIXERR_SUCCESS) {
+		// The ruleset is compiled from memory before the file is moved to the specified location
+		json_t* tree = json_loadb(download.content.content, download.content.size, 0, NULL);
 		
-		char lsha256[SHA256_DIGEST_SIZE];
-		code = sha256_digest(ruleset_file, lsha256);
-		
-		if (code != UNALIXERR_SUCCESS) {
-			remove_file(ruleset_file);
-			
-			return code;
+		if (tree == NULL) {
+			code = UNALIXERR_JSON_CANNOT_PARSE;
+		} else {
+			code = load_ruleset(tree, dst);
+			json_decref(tree);
 		}
 		
-		// Compare both hashes to ensure the remote file was not tampered
-		if (memcmp(lsha256, rsha256, SHA256_DIGEST_SIZE) != 0) {
-			remove_file(ruleset_file);
-			
-			return UNALIXERR_RULESETS_MISMATCH_HASH;
+		if (code != UNALIXERR_SUCCESS) {
+			rulesets_free(dst);
 		}
 	}
 	
-	// Attempt to load the ruleset manually before moving it to the specified location
+	free(download.content.content);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		remove_file(temporary_file);
+	}
+	
+	return code;
+	
+}
+
+static int ruleset_update(const char* const filename, const char* const url, const char* const sha256_url, const char* const temporary_directory, struct HTTPContext* context) {
+	
+	char ruleset_file[strlen(temporary_directory) + strlen(RULESET_TEMPORARY_FILE) + 1];
+	strcpy(ruleset_file, temporary_directory);
+	strcat(ruleset_file, RULESET_TEMPORARY_FILE);
+	
 	struct Rulesets rulesets = {0};
-	code = load_file(ruleset_file, &rulesets);
+	char etag[RULESET_MAX_ETAG_SIZE];
+	
+	const int code = ruleset_download(NULL, url, sha256_url, ruleset_file, context, &rulesets, etag);
 	
 	rulesets_free(&rulesets);
 	
 	if (code != UNALIXERR_SUCCESS) {
-		remove_file(ruleset_file);
-		
 		return code;
 	}
 	
@@ -601,10 +1084,41 @@ static int ruleset_update(const char* const filename, const char* const url, con
 		return UNALIXERR_FILE_CANNOT_MOVE;
 	}
 	
+	etag_write(filename, etag);
+	
 	return UNALIXERR_SUCCESS;
 	
 }
 
+static int ruleset_update_load(const char* const filename, const char* const url, const char* const sha256_url, struct HTTPContext* context) {
+	
+	char temporary_file[strlen(filename) + strlen(RULESET_TEMPORARY_SUFFIX) + 1];
+	strcpy(temporary_file, filename);
+	strcat(temporary_file, RULESET_TEMPORARY_SUFFIX);
+	
+	struct Rulesets compiled = {0};
+	char etag[RULESET_MAX_ETAG_SIZE];
+	
+	const int code = ruleset_download(filename, url, sha256_url, temporary_file, context, &compiled, etag);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	if (!move_file(temporary_file, filename)) {
+		rulesets_free(&compiled);
+		remove_file(temporary_file);
+		
+		return UNALIXERR_FILE_CANNOT_MOVE;
+	}
+	
+	etag_write(filename, etag);
+	
+	// Publish the ruleset that was just compiled instead of loading the file again
+	return set_rulesets(&compiled);
+	
+}
+
 int unalix_ruleset_check_update(const char* const filename, const char* const url) {
 	
 	if (filename == NULL || *filename == '\0' || url == NULL || *url == '\0') {
@@ -653,13 +1167,73 @@ int unalix_ruleset_update(const char* const filename, const char* const url, con
 	
 }
 
+int unalix_ruleset_update_load(const char* const filename, const char* const url, const char* const sha256_url) {
+	
+	if (filename == NULL || *filename == '\0' || url == NULL || *url == '\0') {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	struct HTTPContext context = {
+		.request = {
+			.version = HTTP10,
+			.method = GET
+		},
+		.connection = {
+			.timeout = HTTP_DEFAULT_TIMEOUT
+		}
+	};
+	
+	const int code = ruleset_update_load(filename, url, sha256_url, &context);
+	
+	http_context_free(&context);
+	
+	return code;
+	
+}
+
 int unalix_load_file(const char* const filename) {
 	
 	if (filename == NULL || *filename == '\0') {
 		return UNALIXERR_ARG_INVALID;
 	}
 	
-	return load_file(filename, &rulesets);
+	json_t* tree = NULL;
+	
+	int code = load_tree(filename, &tree);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	code = rulesets_extend(tree);
+	
+	json_decref(tree);
+	
+	return code;
+	
+}
+
+int unalix_reload_file(const char* const filename) {
+	/*
+	Replaces the loaded rulesets with the ones in filename. The previous rulesets stay loaded if
+	the file cannot be loaded.
+	*/
+	
+	if (filename == NULL || *filename == '\0') {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	struct Rulesets compiled = {0};
+	
+	const int code = load_file(filename, &compiled);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		rulesets_free(&compiled);
+		return code;
+	}
+	
+	return set_rulesets(&compiled);
+	
 }
 
 int unalix_load_string(const char* const string) {
@@ -674,7 +1248,7 @@ int unalix_load_string(const char* const string) {
 		return UNALIXERR_JSON_CANNOT_PARSE;
 	}
 	
-	const int code = load_ruleset(tree, &rulesets);
+	const int code = rulesets_extend(tree);
 	
 	json_decref(tree);
 	
@@ -683,7 +1257,7 @@ int unalix_load_string(const char* const string) {
 }
 
 void unalix_unload_rulesets(void) {
-	rulesets_free(&rulesets);
+	rulesets_publish(NULL, NULL, 0);
 }
 
 /*
@@ -1,10 +1,19 @@
+#ifndef RULESET_H_INCLUDED
+#define RULESET_H_INCLUDED
+
 #define PCRE2_CODE_UNIT_WIDTH 8
 
 #include <pcre2.h>
 
+#include "parameter_filter.h"
+#include "pattern_optimizer.h"
+
+struct FrozenRuleset;
+
 struct Rules {
 	size_t total_items;
-	pcre2_code** items;
+	pcre2_code** items; // An item is NULL only if it has a literal
+	const char** literals; // Parameter names for rules stripped without PCRE2, or NULL; entries are not owned
 };
 
 struct Ruleset {
@@ -14,19 +23,37 @@ struct Ruleset {
 	struct Rules referral_marketing;
 	struct Rules exceptions;
 	struct Rules redirections;
+	int parameters_filtered; // Every rule and referralMarketing entry is a plain name, found in the filter of the rulesets
 };
 
 struct Rulesets {
 	size_t offset;
 	size_t size;
 	struct Ruleset* items;
+	const void* segment; // Shared ruleset segment these rulesets were attached from, if any
+	size_t segment_size; // Size of the segment mapping to release, or 0 if the segment is not owned
+	int patterns_borrowed; // Patterns point into the segment and must not be freed one by one
+	unsigned char* tables; // Character tables shared by patterns copied out of a segment
+	const struct FrozenRuleset* frozen; // Ruleset compiled into the library the first providers were loaded from, if any
+	struct ParameterFilter filter; // Names stripped by the literal rules of all providers
 };
 
 int unalix_ruleset_check_update(const char* const filename, const char* const url);
 int unalix_ruleset_update(const char* const filename, const char* const url, const char* const sha256_url, const char* const temporary_directory);
+int unalix_ruleset_update_load(const char* const filename, const char* const url, const char* const sha256_url);
 
 int unalix_load_file(const char* const filename);
 int unalix_load_string(const char* const string);
+int unalix_reload_file(const char* const filename);
+int unalix_load_frozen(void);
 
 void unalix_unload_rulesets(void);
-struct Rulesets get_rulesets(void);
+const struct Rulesets* rulesets_acquire(void);
+void rulesets_release(const struct Rulesets* const rulesets);
+int set_rulesets(struct Rulesets* src);
+void rulesets_free(struct Rulesets* rulesets);
+int rule_compile(const char* const src, const enum PatternUsage usage, pcre2_code** dst);
+int rulesets_filter_rule(struct Rulesets* rulesets, const char* const rule);
+int frozen_load(const struct FrozenRuleset* const frozen, struct Rulesets* rulesets);
+
+#endif
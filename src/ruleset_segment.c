@@ -0,0 +1,729 @@
+#ifndef _WIN32
+	#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+// BearSSL has a config.h of its own earlier in the include path
+#ifdef HAVE_CONFIG_H
+	#include "../submodules/pcre2/src/config.h"
+#endif
+
+#include <pcre2_internal.h>
+
+#include "unalix.h"
+#include "ruleset.h"
+#include "ruleset_segment.h"
+#include "errors.h"
+#include "utils.h"
+
+/*
+A compiled ruleset laid out as one flat, self-describing block of memory:
+
+	header | providers | pattern offsets | character tables | code blocks
+
+Code blocks are the pcre2_real_code structures produced by pcre2_compile(), copied verbatim. The only
+absolute pointer PCRE2 follows while matching is the one to the character tables, so a segment that is
+mapped at the address it was fixed up for (header.base) can be used in place by any number of processes,
+with the patterns being shared pages instead of per-process copies. A process that cannot map the
+segment at that address falls back to copying the code blocks out of it, which still skips parsing and
+compiling the ruleset.
+
+Nothing in the segment needs the memory functions stored in the code blocks (see regex_match_data_create()),
+so those are zeroed by the publisher.
+*/
+
+static char* attached_filename = NULL;
+
+static size_t align_size(const size_t size) {
+	
+	return (size + RULESET_SEGMENT_ALIGNMENT - 1) & ~(RULESET_SEGMENT_ALIGNMENT - 1);
+	
+}
+
+static struct Rules* get_rules(struct Ruleset* ruleset, const size_t index) {
+	
+	struct Rules* const objects[] = {
+		&ruleset->rules,
+		&ruleset->raw_rules,
+		&ruleset->referral_marketing,
+		&ruleset->exceptions,
+		&ruleset->redirections
+	};
+	
+	return objects[index];
+	
+}
+
+int ruleset_segment_encode(const struct Rulesets* const rulesets, unsigned char** dst, size_t* dst_size) {
+	/*
+	Serializes the compiled patterns of rulesets into a new segment. The segment is not fixed up for any
+	address yet (see ruleset_segment_fixup()).
+	*/
+	
+	size_t total_patterns = 0;
+	size_t patterns_size = 0;
+	
+	const uint8_t* tables = NULL;
+	
+	for (size_t index = 0; index < rulesets->offset; index++) {
+		struct Ruleset* const ruleset = &rulesets->items[index];
+		
+		const pcre2_real_code* code = (const pcre2_real_code*) ruleset->url_pattern;
+		
+		tables = code->tables;
+		patterns_size += align_size(code->blocksize);
+		total_patterns++;
+		
+		for (size_t list = 0; list < RULESET_SEGMENT_TOTAL_LISTS; list++) {
+			const struct Rules* const rules = get_rules(ruleset, list);
+			
+			for (size_t item = 0; item < rules->total_items; item++) {
+				code = (const pcre2_real_code*) rules->items[item];
+				
+				// Rules stripped without PCRE2 (see unalix_load_frozen()) have nothing to share
+				if (code == NULL) {
+					return UNALIXERR_ARG_INVALID;
+				}
+				
+				patterns_size += align_size(code->blocksize);
+				total_patterns++;
+			}
+		}
+	}
+	
+	const size_t providers_offset = align_size(sizeof(struct RulesetSegmentHeader));
+	const size_t patterns_offset = align_size(providers_offset + sizeof(struct RulesetSegmentProvider) * rulesets->offset);
+	const size_t tables_offset = align_size(patterns_offset + sizeof(uint64_t) * total_patterns);
+	const size_t blocks_offset = align_size(tables_offset + TABLES_LENGTH);
+	
+	const size_t size = blocks_offset + patterns_size;
+	
+	unsigned char* segment = (unsigned char*) calloc(1, size);
+	
+	if (segment == NULL) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	struct RulesetSegmentHeader* const header = (struct RulesetSegmentHeader*) segment;
+	
+	memcpy(header->magic, RULESET_SEGMENT_MAGIC, sizeof(header->magic));
+	
+	header->version = RULESET_SEGMENT_VERSION;
+	header->pcre2_version = (PCRE2_MAJOR << 16) | PCRE2_MINOR;
+	header->pointer_size = sizeof(void*);
+	header->total_providers = (uint32_t) rulesets->offset;
+	header->total_patterns = total_patterns;
+	header->size = size;
+	header->providers_offset = providers_offset;
+	header->patterns_offset = patterns_offset;
+	header->tables_offset = tables_offset;
+	header->filter = rulesets->filter;
+	
+	if (tables != NULL) {
+		memcpy(segment + tables_offset, tables, TABLES_LENGTH);
+	}
+	
+	struct RulesetSegmentProvider* const providers = (struct RulesetSegmentProvider*) (segment + providers_offset);
+	uint64_t* const offsets = (uint64_t*) (segment + patterns_offset);
+	
+	size_t offset = blocks_offset;
+	size_t pattern = 0;
+	
+	for (size_t index = 0; index < rulesets->offset; index++) {
+		struct Ruleset* const ruleset = &rulesets->items[index];
+		
+		providers[index].parameters_filtered = (uint32_t) ruleset->parameters_filtered;
+		
+		for (size_t list = 0; list <= RULESET_SEGMENT_TOTAL_LISTS; list++) {
+			const struct Rules* const rules = (list == 0) ? NULL : get_rules(ruleset, list - 1);
+			const size_t total_items = (list == 0) ? 1 : rules->total_items;
+			
+			if (list > 0) {
+				providers[index].total_items[list - 1] = (uint32_t) total_items;
+			}
+			
+			for (size_t item = 0; item < total_items; item++) {
+				const pcre2_real_code* const code = (const pcre2_real_code*) ((list == 0) ? ruleset->url_pattern : rules->items[item]);
+				pcre2_real_code* const copy = (pcre2_real_code*) (segment + offset);
+				
+				memcpy(copy, code, code->blocksize);
+				
+				// Absolute pointers are meaningless to other processes
+				memset(&copy->memctl, 0, sizeof(copy->memctl));
+				copy->tables = NULL;
+				copy->executable_jit = NULL;
+				copy->flags &= ~PCRE2_DEREF_TABLES;
+				
+				offsets[pattern++] = offset;
+				offset += align_size(code->blocksize);
+			}
+		}
+	}
+	
+	*dst = segment;
+	*dst_size = size;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int segment_validate(const unsigned char* const segment, const size_t segment_size) {
+	
+	const struct RulesetSegmentHeader* const header = (const struct RulesetSegmentHeader*) segment;
+	
+	if (segment_size < sizeof(*header) || memcmp(header->magic, RULESET_SEGMENT_MAGIC, sizeof(header->magic)) != 0) {
+		return UNALIXERR_RULESETS_SEGMENT_INVALID;
+	}
+	
+	if (header->version != RULESET_SEGMENT_VERSION || header->pcre2_version != ((PCRE2_MAJOR << 16) | PCRE2_MINOR) || header->pointer_size != sizeof(void*)) {
+		return UNALIXERR_RULESETS_SEGMENT_INVALID;
+	}
+	
+	if (header->size != segment_size || header->total_patterns > segment_size || header->total_providers > segment_size) {
+		return UNALIXERR_RULESETS_SEGMENT_INVALID;
+	}
+	
+	if (header->providers_offset + sizeof(struct RulesetSegmentProvider) * header->total_providers > segment_size) {
+		return UNALIXERR_RULESETS_SEGMENT_INVALID;
+	}
+	
+	if (header->patterns_offset + sizeof(uint64_t) * header->total_patterns > segment_size || header->tables_offset + TABLES_LENGTH > segment_size) {
+		return UNALIXERR_RULESETS_SEGMENT_INVALID;
+	}
+	
+	const struct RulesetSegmentProvider* const providers = (const struct RulesetSegmentProvider*) (segment + header->providers_offset);
+	
+	uint64_t total_patterns = 0;
+	
+	for (size_t index = 0; index < header->total_providers; index++) {
+		total_patterns++;
+		
+		for (size_t list = 0; list < RULESET_SEGMENT_TOTAL_LISTS; list++) {
+			total_patterns += providers[index].total_items[list];
+		}
+	}
+	
+	if (total_patterns != header->total_patterns) {
+		return UNALIXERR_RULESETS_SEGMENT_INVALID;
+	}
+	
+	const uint64_t* const offsets = (const uint64_t*) (segment + header->patterns_offset);
+	
+	for (size_t index = 0; index < header->total_patterns; index++) {
+		const uint64_t offset = offsets[index];
+		
+		if (offset % RULESET_SEGMENT_ALIGNMENT != 0 || offset + sizeof(pcre2_real_code) > segment_size) {
+			return UNALIXERR_RULESETS_SEGMENT_INVALID;
+		}
+		
+		const pcre2_real_code* const code = (const pcre2_real_code*) (segment + offset);
+		
+		if (code->magic_number != MAGIC_NUMBER || code->blocksize < sizeof(pcre2_real_code) || offset + code->blocksize > segment_size) {
+			return UNALIXERR_RULESETS_SEGMENT_INVALID;
+		}
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int ruleset_segment_fixup(unsigned char* const segment, const size_t segment_size, const uintptr_t base) {
+	/*
+	Points the code blocks at the character tables of the segment, as they will be seen once the segment
+	is mapped at base. The segment must be writable.
+	*/
+	
+	const int code = segment_validate(segment, segment_size);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	struct RulesetSegmentHeader* const header = (struct RulesetSegmentHeader*) segment;
+	const uint64_t* const offsets = (const uint64_t*) (segment + header->patterns_offset);
+	
+	for (size_t index = 0; index < header->total_patterns; index++) {
+		pcre2_real_code* const code = (pcre2_real_code*) (segment + offsets[index]);
+		code->tables = (const uint8_t*) (base + header->tables_offset);
+	}
+	
+	header->base = base;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int ruleset_segment_attach(const unsigned char* const segment, const size_t segment_size, struct Rulesets* dst) {
+	/*
+	Builds rulesets out of a segment. Patterns are used in place when the segment was fixed up for
+	the address it lives at, and copied to the heap otherwise. The segment must outlive dst
+	in the former case.
+	*/
+	
+	int code = segment_validate(segment, segment_size);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	const struct RulesetSegmentHeader* const header = (const struct RulesetSegmentHeader*) segment;
+	const struct RulesetSegmentProvider* const providers = (const struct RulesetSegmentProvider*) (segment + header->providers_offset);
+	const uint64_t* const offsets = (const uint64_t*) (segment + header->patterns_offset);
+	
+	const int in_place = (header->base == (uintptr_t) segment);
+	
+	struct Rulesets rulesets = {
+		.segment = segment,
+		.patterns_borrowed = in_place,
+		.filter = header->filter
+	};
+	
+	pcre2_memctl memctl = {0};
+	
+	if (!in_place) {
+		rulesets.tables = (unsigned char*) malloc(TABLES_LENGTH);
+		
+		if (rulesets.tables == NULL) {
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+		
+		memcpy(rulesets.tables, segment + header->tables_offset, TABLES_LENGTH);
+		
+		// Copies are released by pcre2_code_free(), so they must come from PCRE2's own allocator
+		pcre2_general_context* context = pcre2_general_context_create(NULL, NULL, NULL);
+		
+		if (context == NULL) {
+			free(rulesets.tables);
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+		
+		memctl = ((pcre2_real_general_context*) context)->memctl;
+		pcre2_general_context_free(context);
+	}
+	
+	if (header->total_providers > 0) {
+		rulesets.size = sizeof(struct Ruleset) * header->total_providers;
+		rulesets.items = (struct Ruleset*) calloc(header->total_providers, sizeof(struct Ruleset));
+		
+		if (rulesets.items == NULL) {
+			rulesets_free(&rulesets);
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+	}
+	
+	size_t pattern = 0;
+	
+	for (size_t index = 0; index < header->total_providers; index++) {
+		struct Ruleset* const ruleset = &rulesets.items[index];
+		ruleset->parameters_filtered = (int) providers[index].parameters_filtered;
+		rulesets.offset++;
+		
+		for (size_t list = 0; list <= RULESET_SEGMENT_TOTAL_LISTS; list++) {
+			struct Rules* const rules = (list == 0) ? NULL : get_rules(ruleset, list - 1);
+			const size_t total_items = (list == 0) ? 1 : providers[index].total_items[list - 1];
+			
+			if (total_items == 0) {
+				continue;
+			}
+			
+			if (list > 0) {
+				rules->items = (pcre2_code**) calloc(total_items, sizeof(pcre2_code*));
+				
+				if (rules->items == NULL) {
+					rulesets_free(&rulesets);
+					return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+				}
+			}
+			
+			for (size_t item = 0; item < total_items; item++) {
+				const pcre2_real_code* const source = (const pcre2_real_code*) (segment + offsets[pattern++]);
+				pcre2_real_code* target = (pcre2_real_code*) source;
+				
+				if (!in_place) {
+					target = (pcre2_real_code*) memctl.malloc(source->blocksize, memctl.memory_data);
+					
+					if (target == NULL) {
+						rulesets_free(&rulesets);
+						return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+					}
+					
+					memcpy(target, source, source->blocksize);
+					
+					target->memctl = memctl;
+					target->tables = rulesets.tables;
+				}
+				
+				if (list == 0) {
+					ruleset->url_pattern = (pcre2_code*) target;
+				} else {
+					rules->items[rules->total_items++] = (pcre2_code*) target;
+				}
+			}
+		}
+	}
+	
+	*dst = rulesets;
+	
+	return code;
+	
+}
+
+void ruleset_segment_unmap(void* segment, const size_t segment_size) {
+	
+	#ifdef _WIN32
+		(void) segment_size;
+		UnmapViewOfFile(segment);
+	#else
+		munmap(segment, segment_size);
+	#endif
+	
+}
+
+#ifndef _WIN32
+	static int segment_write(const char* const filename, const unsigned char* const segment, const size_t segment_size) {
+		
+		const int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		
+		if (fd == -1) {
+			return UNALIXERR_FILE_CANNOT_OPEN;
+		}
+		
+		size_t offset = 0;
+		
+		while (offset < segment_size) {
+			const ssize_t size = write(fd, segment + offset, segment_size - offset);
+			
+			if (size < 1) {
+				close(fd);
+				return UNALIXERR_FILE_CANNOT_WRITE;
+			}
+			
+			offset += (size_t) size;
+		}
+		
+		close(fd);
+		
+		return UNALIXERR_SUCCESS;
+		
+	}
+	
+	static int segment_map(const char* const filename, const int writable, void* const address, void** dst, size_t* dst_size) {
+		/*
+		Maps the whole file, preferably at address (if not NULL).
+		*/
+		
+		const int fd = open(filename, writable ? O_RDWR : O_RDONLY);
+		
+		if (fd == -1) {
+			return UNALIXERR_FILE_CANNOT_OPEN;
+		}
+		
+		struct stat st = {0};
+		
+		if (fstat(fd, &st) != 0) {
+			close(fd);
+			return UNALIXERR_OS_STAT_FAILURE;
+		}
+		
+		const size_t size = (size_t) st.st_size;
+		
+		if (size < sizeof(struct RulesetSegmentHeader)) {
+			close(fd);
+			return UNALIXERR_RULESETS_SEGMENT_INVALID;
+		}
+		
+		int flags = MAP_SHARED;
+		
+		#ifdef MAP_FIXED_NOREPLACE
+			if (address != NULL) {
+				flags |= MAP_FIXED_NOREPLACE;
+			}
+		#endif
+		
+		void* map = mmap(address, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, flags, fd, 0);
+		
+		// Kernels older than Linux 4.17 do not know the flag, and treat the address as a hint
+		if (map == MAP_FAILED && address != NULL) {
+			map = mmap(NULL, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+		}
+		
+		close(fd);
+		
+		if (map == MAP_FAILED) {
+			return UNALIXERR_OS_MMAP_FAILURE;
+		}
+		
+		*dst = map;
+		*dst_size = size;
+		
+		return UNALIXERR_SUCCESS;
+		
+	}
+	
+	static uint64_t segment_generation(const char* const filename) {
+		/*
+		Returns the newest generation known for the segment currently at filename, or 0 if there is none.
+		*/
+		
+		const int fd = open(filename, O_RDONLY);
+		
+		if (fd == -1) {
+			return 0;
+		}
+		
+		struct RulesetSegmentHeader header = {0};
+		
+		const ssize_t size = pread(fd, &header, sizeof(header), 0);
+		close(fd);
+		
+		if (size != sizeof(header) || memcmp(header.magic, RULESET_SEGMENT_MAGIC, sizeof(header.magic)) != 0) {
+			return 0;
+		}
+		
+		return (header.latest_generation > header.generation) ? header.latest_generation : header.generation;
+		
+	}
+#endif
+
+int unalix_ruleset_segment_publish(const char* const filename) {
+	/*
+	Writes the currently loaded rulesets to filename as a shared ruleset segment, replacing (and
+	superseding) any segment already there.
+	*/
+	
+	if (filename == NULL || *filename == '\0') {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	#ifdef _WIN32
+		return UNALIXERR_OS_MMAP_FAILURE;
+	#else
+		const struct Rulesets* const rulesets = rulesets_acquire();
+		
+		if (rulesets->offset < 1) {
+			rulesets_release(rulesets);
+			return UNALIXERR_RULESETS_EMPTY;
+		}
+		
+		unsigned char* segment = NULL;
+		size_t segment_size = 0;
+		
+		int code = ruleset_segment_encode(rulesets, &segment, &segment_size);
+		
+		rulesets_release(rulesets);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+		
+		struct RulesetSegmentHeader* header = (struct RulesetSegmentHeader*) segment;
+		
+		header->generation = segment_generation(filename) + 1;
+		header->latest_generation = header->generation;
+		
+		char temporary_file[strlen(filename) + strlen(RULESET_SEGMENT_TEMPORARY_SUFFIX) + 1];
+		strcpy(temporary_file, filename);
+		strcat(temporary_file, RULESET_SEGMENT_TEMPORARY_SUFFIX);
+		
+		code = segment_write(temporary_file, segment, segment_size);
+		free(segment);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			remove_file(temporary_file);
+			return code;
+		}
+		
+		/*
+		Fix the segment up for the address the kernel picks here. Processes forked from this one, and most
+		unrelated processes, will find that range free as well; those that do not fall back to a private copy.
+		*/
+		void* map = NULL;
+		size_t map_size = 0;
+		
+		code = segment_map(temporary_file, 1, NULL, &map, &map_size);
+		
+		if (code == UNALIXERR_SUCCESS) {
+			code = ruleset_segment_fixup((unsigned char*) map, map_size, (uintptr_t) map);
+			munmap(map, map_size);
+		}
+		
+		if (code != UNALIXERR_SUCCESS) {
+			remove_file(temporary_file);
+			return code;
+		}
+		
+		// Keep the previous segment around, to tell processes still attached to it that it was replaced
+		void* previous = NULL;
+		size_t previous_size = 0;
+		
+		const int has_previous = (segment_map(filename, 1, NULL, &previous, &previous_size) == UNALIXERR_SUCCESS);
+		
+		if (!move_file(temporary_file, filename)) {
+			if (has_previous) {
+				munmap(previous, previous_size);
+			}
+			
+			remove_file(temporary_file);
+			
+			return UNALIXERR_FILE_CANNOT_MOVE;
+		}
+		
+		if (has_previous) {
+			header = (struct RulesetSegmentHeader*) previous;
+			
+			if (memcmp(header->magic, RULESET_SEGMENT_MAGIC, sizeof(header->magic)) == 0) {
+				__atomic_store_n(&header->latest_generation, segment_generation(filename), __ATOMIC_RELEASE);
+			}
+			
+			munmap(previous, previous_size);
+		}
+		
+		return UNALIXERR_SUCCESS;
+	#endif
+	
+}
+
+int unalix_ruleset_segment_attach(const char* const filename) {
+	/*
+	Replaces the loaded rulesets with the shared ruleset segment at filename.
+	*/
+	
+	if (filename == NULL || *filename == '\0') {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	#ifdef _WIN32
+		return UNALIXERR_OS_MMAP_FAILURE;
+	#else
+		const int fd = open(filename, O_RDONLY);
+		
+		if (fd == -1) {
+			return UNALIXERR_FILE_CANNOT_OPEN;
+		}
+		
+		struct RulesetSegmentHeader header = {0};
+		
+		const ssize_t size = pread(fd, &header, sizeof(header), 0);
+		close(fd);
+		
+		if (size != sizeof(header)) {
+			return UNALIXERR_RULESETS_SEGMENT_INVALID;
+		}
+		
+		void* map = NULL;
+		size_t map_size = 0;
+		
+		int code = segment_map(filename, 0, (void*) (uintptr_t) header.base, &map, &map_size);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+		
+		struct Rulesets rulesets = {0};
+		
+		code = ruleset_segment_attach((const unsigned char*) map, map_size, &rulesets);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			munmap(map, map_size);
+			return code;
+		}
+		
+		// The mapping stays around even for private copies, as it carries the generation counter
+		rulesets.segment_size = map_size;
+		
+		char* name = strdup(filename);
+		
+		if (name == NULL) {
+			rulesets_free(&rulesets);
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+		
+		code = set_rulesets(&rulesets);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			free(name);
+			return code;
+		}
+		
+		free(attached_filename);
+		attached_filename = name;
+		
+		return UNALIXERR_SUCCESS;
+	#endif
+	
+}
+
+int unalix_ruleset_segment_refresh(void) {
+	/*
+	Switches to the segment that replaced the attached one, if any. Cheap enough to be
+	called before every request.
+	*/
+	
+	const struct Rulesets* const rulesets = rulesets_acquire();
+	
+	if (attached_filename == NULL || rulesets->segment == NULL || rulesets->segment_size == 0) {
+		rulesets_release(rulesets);
+		return UNALIXERR_RULESETS_SEGMENT_NOT_ATTACHED;
+	}
+	
+	const struct RulesetSegmentHeader* const header = (const struct RulesetSegmentHeader*) rulesets->segment;
+	const int is_latest = (__atomic_load_n(&header->latest_generation, __ATOMIC_ACQUIRE) == header->generation);
+	
+	rulesets_release(rulesets);
+	
+	if (is_latest) {
+		return UNALIXERR_RULESETS_NOT_MODIFIED;
+	}
+	
+	return unalix_ruleset_segment_attach(attached_filename);
+	
+}
+
+unsigned long long unalix_ruleset_segment_generation(void) {
+	
+	const struct Rulesets* const rulesets = rulesets_acquire();
+	
+	unsigned long long generation = 0;
+	
+	if (attached_filename != NULL && rulesets->segment != NULL && rulesets->segment_size > 0) {
+		generation = (unsigned long long) ((const struct RulesetSegmentHeader*) rulesets->segment)->generation;
+	}
+	
+	rulesets_release(rulesets);
+	
+	return generation;
+	
+}
+
+int unalix_load_builtin(void) {
+	/*
+	Replaces the loaded rulesets with the ones compiled into the library at build time. Nothing is parsed
+	or compiled; the code blocks are only copied out of the read-only segment.
+	*/
+	
+	#ifdef UNALIX_BUILTIN_RULESET
+		struct Rulesets attached = {0};
+		
+		const int code = ruleset_segment_attach(BUILTIN_RULESET, BUILTIN_RULESET_SIZE, &attached);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+		
+		return set_rulesets(&attached);
+	#else
+		return UNALIXERR_RULESETS_NOT_BUILTIN;
+	#endif
+	
+}
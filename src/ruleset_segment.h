@@ -0,0 +1,54 @@
+#ifndef RULESET_SEGMENT_H_INCLUDED
+#define RULESET_SEGMENT_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ruleset.h"
+
+static const char RULESET_SEGMENT_MAGIC[] = "UNXRULES";
+static const uint32_t RULESET_SEGMENT_VERSION = 2;
+
+// Code blocks and tables are placed at offsets that are a multiple of this
+static const size_t RULESET_SEGMENT_ALIGNMENT = 16;
+
+static const char RULESET_SEGMENT_TEMPORARY_SUFFIX[] = ".tmp";
+
+/*
+Number of pattern lists each provider has, in the same order as struct Ruleset
+(rules, rawRules, referralMarketing, exceptions and redirections).
+*/
+#define RULESET_SEGMENT_TOTAL_LISTS 5
+
+struct RulesetSegmentHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t pcre2_version; // PCRE2_MAJOR << 16 | PCRE2_MINOR
+	uint32_t pointer_size;
+	uint32_t total_providers;
+	uint64_t total_patterns;
+	uint64_t size;
+	uint64_t generation;
+	uint64_t latest_generation; // Bumped in place once a newer segment replaces this one
+	uint64_t base; // Address the code blocks were fixed up for; 0 if they must be copied before use
+	uint64_t providers_offset;
+	uint64_t patterns_offset; // uint64_t offset of each code block, in provider order
+	uint64_t tables_offset;
+	struct ParameterFilter filter; // Filter of the rulesets (see parameter_filter.h)
+};
+
+struct RulesetSegmentProvider {
+	uint32_t total_items[RULESET_SEGMENT_TOTAL_LISTS];
+	uint32_t parameters_filtered;
+};
+
+int ruleset_segment_encode(const struct Rulesets* const rulesets, unsigned char** dst, size_t* dst_size);
+int ruleset_segment_fixup(unsigned char* const segment, const size_t segment_size, const uintptr_t base);
+int ruleset_segment_attach(const unsigned char* const segment, const size_t segment_size, struct Rulesets* dst);
+void ruleset_segment_unmap(void* segment, const size_t segment_size);
+
+// Generated by tool/ruleset_compiler.c from the UNALIX_BUILTIN_RULESET file, when that option is set
+extern const unsigned char* const BUILTIN_RULESET;
+extern const size_t BUILTIN_RULESET_SIZE;
+
+#endif
@@ -0,0 +1,521 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "scanner.h"
+#include "errors.h"
+
+// Words longer than this (in bytes) are passed through as they are, without looking for URLs in them
+static const size_t SCANNER_MAX_WORD_SIZE = 8 * 1024;
+
+static const char SCHEME_LESS_PREFIX[] = "http://";
+
+struct unalix_scanner {
+	int ignore_referral_marketing;
+	int ignore_rules;
+	int ignore_exceptions;
+	int ignore_raw_rules;
+	int ignore_redirections;
+	int strip_empty;
+	int strip_duplicates;
+	unalix_scanner_sink_t sink;
+	void* userdata;
+	char* carry; // The last word of the previous chunks, which may continue in the next one
+	size_t carry_size;
+	int skipping; // The carried word grew too long, and is being passed through until it ends
+	char* url; // NUL-terminated copy of the URL being cleaned
+};
+
+static int is_delimiter(const char ch) {
+	/*
+	Characters that can never be part of a URL, and therefore end one.
+	*/
+	
+	const unsigned char byte = (unsigned char) ch;
+	
+	return byte <= 0x20 || byte == 0x7F || ch == '<' || ch == '>' || ch == '"' || ch == '`';
+}
+
+static int is_alphanumeric(const char ch) {
+	return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9');
+}
+
+static int is_scheme_character(const char ch) {
+	return is_alphanumeric(ch) || ch == '+' || ch == '-' || ch == '.';
+}
+
+static size_t trim_trailing_punctuation(const char* const url, size_t size) {
+	/*
+	Drops characters that end a sentence, or that enclose the URL, rather than being part of it.
+	Closing parentheses are kept while they have a matching opening one within the URL.
+	*/
+	
+	while (size > 0) {
+		const char ch = url[size - 1];
+		
+		if (ch == ')') {
+			size_t opening = 0;
+			size_t closing = 0;
+			
+			for (size_t index = 0; index < size; index++) {
+				opening += url[index] == '(';
+				closing += url[index] == ')';
+			}
+			
+			if (closing <= opening) {
+				break;
+			}
+		} else if (strchr(".,;:!?'*]}", ch) == NULL) {
+			break;
+		}
+		
+		size--;
+	}
+	
+	return size;
+	
+}
+
+static int emit(struct unalix_scanner* scanner, const char* const buffer, const size_t buffer_size) {
+	
+	if (buffer_size == 0) {
+		return UNALIXERR_SUCCESS;
+	}
+	
+	return scanner->sink(buffer, buffer_size, scanner->userdata);
+	
+}
+
+static int emit_url(struct unalix_scanner* scanner, const char* const url, const size_t size, const int scheme_less) {
+	/*
+	Emits the cleaned version of the URL, or the URL itself if it cannot be cleaned.
+	*/
+	
+	const size_t prefix_size = scheme_less ? strlen(SCHEME_LESS_PREFIX) : 0;
+	
+	memcpy(scanner->url, SCHEME_LESS_PREFIX, prefix_size);
+	memcpy(scanner->url + prefix_size, url, size);
+	scanner->url[prefix_size + size] = '\0';
+	
+	char* target_url = NULL;
+	
+	const int code = unalix_clean_url(
+		scanner->url,
+		&target_url,
+		scanner->ignore_referral_marketing,
+		scanner->ignore_rules,
+		scanner->ignore_exceptions,
+		scanner->ignore_raw_rules,
+		scanner->ignore_redirections,
+		scanner->strip_empty,
+		scanner->strip_duplicates
+	);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return emit(scanner, url, size);
+	}
+	
+	const char* start = target_url;
+	
+	// URLs written without a scheme are kept that way, unless cleaning sent them somewhere else
+	if (scheme_less && strncmp(start, SCHEME_LESS_PREFIX, prefix_size) == 0) {
+		start += prefix_size;
+	}
+	
+	const int rc = emit(scanner, start, strlen(start));
+	
+	free(target_url);
+	
+	return rc;
+	
+}
+
+static int scan(struct unalix_scanner* scanner, const char* const text, const size_t size) {
+	/*
+	Rewrites every URL found in the text, which must only contain complete words. Candidates are
+	found by looking for the ':' of "://" and the '.' of "www." with memchr(), which is vectorized
+	by most C libraries; everything between URLs is emitted as is, in as few pieces as possible.
+	*/
+	
+	const char* const end = text + size;
+	
+	const char* position = text;
+	const char* pending = text; // Start of the text not emitted yet
+	
+	const char* colon = NULL;
+	const char* dot = NULL;
+	
+	while (position < end) {
+		if (colon != NULL && colon < position) {
+			colon = NULL;
+		}
+		
+		if (dot != NULL && dot < position) {
+			dot = NULL;
+		}
+		
+		if (colon == NULL) {
+			colon = (const char*) memchr(position, ':', (size_t) (end - position));
+			
+			if (colon == NULL) {
+				colon = end;
+			}
+		}
+		
+		if (dot == NULL) {
+			dot = (const char*) memchr(position, '.', (size_t) (end - position));
+			
+			if (dot == NULL) {
+				dot = end;
+			}
+		}
+		
+		const char* const candidate = (colon < dot) ? colon : dot;
+		
+		if (candidate == end) {
+			break;
+		}
+		
+		position = candidate + 1;
+		
+		const char* start = NULL;
+		int scheme_less = 0;
+		
+		if (candidate == colon) {
+			if (end - candidate < 4 || candidate[1] != '/' || candidate[2] != '/' || is_delimiter(candidate[3])) {
+				continue;
+			}
+			
+			start = candidate;
+			
+			while (start > pending && is_scheme_character(start[-1])) {
+				start--;
+			}
+			
+			// Schemes must start with a letter
+			while (start < candidate && !is_alphanumeric(*start)) {
+				start++;
+			}
+			
+			if (start == candidate || (*start >= '0' && *start <= '9')) {
+				continue;
+			}
+		} else {
+			if (candidate - text < 3 || end - candidate < 2 || !is_alphanumeric(candidate[1])) {
+				continue;
+			}
+			
+			start = candidate - 3;
+			
+			if (start < pending || (start[0] | 0x20) != 'w' || (start[1] | 0x20) != 'w' || (start[2] | 0x20) != 'w') {
+				continue;
+			}
+			
+			// Not a "www." that only happens to be in the middle of a word
+			if (start > text && (is_alphanumeric(start[-1]) || strchr(".-_/@:%", start[-1]) != NULL)) {
+				continue;
+			}
+			
+			scheme_less = 1;
+		}
+		
+		const char* stop = candidate;
+		
+		while (stop < end && !is_delimiter(*stop)) {
+			stop++;
+		}
+		
+		const size_t url_size = trim_trailing_punctuation(start, (size_t) (stop - start));
+		
+		if (url_size <= (size_t) (candidate - start) + 1 || url_size > SCANNER_MAX_WORD_SIZE) {
+			position = stop;
+			continue;
+		}
+		
+		int code = emit(scanner, pending, (size_t) (start - pending));
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+		
+		code = emit_url(scanner, start, url_size, scheme_less);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+		
+		pending = start + url_size;
+		position = stop;
+	}
+	
+	return emit(scanner, pending, (size_t) (end - pending));
+	
+}
+
+static int carry_append(struct unalix_scanner* scanner, const char* const buffer, const size_t buffer_size) {
+	/*
+	Holds on to the start of a word that continues in the next chunk. Words that grow past the
+	limit are passed through instead, keeping memory bounded no matter the input.
+	*/
+	
+	if (scanner->skipping) {
+		return emit(scanner, buffer, buffer_size);
+	}
+	
+	if (scanner->carry_size + buffer_size > SCANNER_MAX_WORD_SIZE) {
+		const int code = emit(scanner, scanner->carry, scanner->carry_size);
+		
+		scanner->carry_size = 0;
+		scanner->skipping = 1;
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+		
+		return emit(scanner, buffer, buffer_size);
+	}
+	
+	memcpy(scanner->carry + scanner->carry_size, buffer, buffer_size);
+	scanner->carry_size += buffer_size;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int carry_flush(struct unalix_scanner* scanner) {
+	
+	const int code = scan(scanner, scanner->carry, scanner->carry_size);
+	
+	scanner->carry_size = 0;
+	scanner->skipping = 0;
+	
+	return code;
+	
+}
+
+int unalix_scanner_new(
+	struct unalix_scanner** scanner,
+	const int ignore_referral_marketing,
+	const int ignore_rules,
+	const int ignore_exceptions,
+	const int ignore_raw_rules,
+	const int ignore_redirections,
+	const int strip_empty,
+	const int strip_duplicates,
+	const unalix_scanner_sink_t sink,
+	void* userdata
+) {
+	/*
+	Creates a scanner that finds the URLs in the text it is fed, and passes the text on to the
+	sink with each URL replaced by its cleaned version. The text may be fed in chunks of any size;
+	memory use stays bounded regardless of the size of the whole text.
+	*/
+	
+	if (scanner == NULL || sink == NULL) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	struct unalix_scanner* const obj = (struct unalix_scanner*) malloc(sizeof(*obj));
+	
+	if (obj == NULL) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	memset(obj, 0, sizeof(*obj));
+	
+	obj->carry = (char*) malloc(SCANNER_MAX_WORD_SIZE);
+	obj->url = (char*) malloc(strlen(SCHEME_LESS_PREFIX) + SCANNER_MAX_WORD_SIZE + 1);
+	
+	if (obj->carry == NULL || obj->url == NULL) {
+		unalix_scanner_free(obj);
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	obj->ignore_referral_marketing = ignore_referral_marketing;
+	obj->ignore_rules = ignore_rules;
+	obj->ignore_exceptions = ignore_exceptions;
+	obj->ignore_raw_rules = ignore_raw_rules;
+	obj->ignore_redirections = ignore_redirections;
+	obj->strip_empty = strip_empty;
+	obj->strip_duplicates = strip_duplicates;
+	obj->sink = sink;
+	obj->userdata = userdata;
+	
+	*scanner = obj;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int unalix_scanner_feed(struct unalix_scanner* scanner, const char* const buffer, const size_t buffer_size) {
+	
+	if (scanner == NULL || (buffer == NULL && buffer_size > 0)) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	const char* const end = buffer + buffer_size;
+	const char* start = buffer;
+	
+	// Complete the word carried over from the previous chunk
+	if (scanner->carry_size > 0 || scanner->skipping) {
+		while (start < end && !is_delimiter(*start)) {
+			start++;
+		}
+		
+		int code = carry_append(scanner, buffer, (size_t) (start - buffer));
+		
+		if (code != UNALIXERR_SUCCESS || start == end) {
+			return code;
+		}
+		
+		code = carry_flush(scanner);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			return code;
+		}
+	}
+	
+	// Everything up to the last delimiter is made of complete words, and can be scanned in place
+	const char* last = end;
+	
+	while (last > start && !is_delimiter(last[-1])) {
+		last--;
+	}
+	
+	const int code = scan(scanner, start, (size_t) (last - start));
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	return carry_append(scanner, last, (size_t) (end - last));
+	
+}
+
+int unalix_scanner_finish(struct unalix_scanner* scanner) {
+	/*
+	Signals the end of the text, flushing whatever was held back. The scanner can then be fed a
+	new text.
+	*/
+	
+	if (scanner == NULL) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	if (scanner->skipping) {
+		scanner->skipping = 0;
+		return UNALIXERR_SUCCESS;
+	}
+	
+	return carry_flush(scanner);
+	
+}
+
+void unalix_scanner_free(struct unalix_scanner* scanner) {
+	
+	if (scanner == NULL) {
+		return;
+	}
+	
+	free(scanner->carry);
+	free(scanner->url);
+	free(scanner);
+	
+}
+
+static int buffer_sink(const char* const buffer, const size_t buffer_size, void* userdata) {
+	
+	struct ScannerBuffer* const dst = (struct ScannerBuffer*) userdata;
+	
+	if (dst->size + buffer_size + 1 > dst->capacity) {
+		size_t capacity = (dst->capacity > 0) ? dst->capacity * 2 : 1024;
+		
+		while (capacity < dst->size + buffer_size + 1) {
+			capacity *= 2;
+		}
+		
+		char* content = (char*) realloc(dst->content, capacity);
+		
+		if (content == NULL) {
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+		
+		dst->content = content;
+		dst->capacity = capacity;
+	}
+	
+	memcpy(dst->content + dst->size, buffer, buffer_size);
+	dst->size += buffer_size;
+	dst->content[dst->size] = '\0';
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int unalix_clean_text(
+	const char* const source_text,
+	const size_t source_text_size,
+	char** target_text,
+	size_t* target_text_size,
+	const int ignore_referral_marketing,
+	const int ignore_rules,
+	const int ignore_exceptions,
+	const int ignore_raw_rules,
+	const int ignore_redirections,
+	const int strip_empty,
+	const int strip_duplicates
+) {
+	/*
+	Cleans every URL in a text that is entirely in memory. The result is NUL-terminated.
+	*/
+	
+	if (source_text == NULL || target_text == NULL) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	struct ScannerBuffer buffer = {0};
+	struct unalix_scanner* scanner = NULL;
+	
+	int code = unalix_scanner_new(
+		&scanner,
+		ignore_referral_marketing,
+		ignore_rules,
+		ignore_exceptions,
+		ignore_raw_rules,
+		ignore_redirections,
+		strip_empty,
+		strip_duplicates,
+		buffer_sink,
+		&buffer
+	);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	code = unalix_scanner_feed(scanner, source_text, source_text_size);
+	
+	if (code == UNALIXERR_SUCCESS) {
+		code = unalix_scanner_finish(scanner);
+	}
+	
+	// An empty text still yields an empty string
+	if (code == UNALIXERR_SUCCESS && buffer.content == NULL) {
+		code = buffer_sink("", 0, &buffer);
+	}
+	
+	unalix_scanner_free(scanner);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		free(buffer.content);
+		return code;
+	}
+	
+	*target_text = buffer.content;
+	
+	if (target_text_size != NULL) {
+		*target_text_size = buffer.size;
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
@@ -0,0 +1,14 @@
+#ifndef SCANNER_H_INCLUDED
+#define SCANNER_H_INCLUDED
+
+#include <stddef.h>
+
+#include "unalix.h"
+
+struct ScannerBuffer {
+	char* content;
+	size_t size;
+	size_t capacity;
+};
+
+#endif
@@ -5,6 +5,7 @@
 
 #include "errors.h"
 #include "utils.h"
+#include "sha256.h"
 
 int sha256_digest(const char* const filename, char* dst) {
 	
@@ -36,8 +37,19 @@ int sha256_digest(const char* const filename, char* dst) {
 		br_sha256_update(&context, chunk, size);
 	}
 	
+	sha256_hexdigest(&context, dst);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+void sha256_hexdigest(const br_sha256_context* const context, char* dst) {
+	/*
+	Writes the SHA256_DIGEST_SIZE lowercase hex digits of the hash computed so far to dst.
+	*/
+	
 	char sha256[br_sha256_SIZE];
-	br_sha256_out(&context, sha256);
+	br_sha256_out(context, sha256);
 	
 	size_t dst_offset = 0;
 	
@@ -48,6 +60,4 @@ int sha256_digest(const char* const filename, char* dst) {
 		dst[dst_offset++] = to_hex((ch & 0x0F) >> 0);
 	}
 	
-	return UNALIXERR_SUCCESS;
-	
 }
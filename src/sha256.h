@@ -1,3 +1,6 @@
+#include <bearssl.h>
+
 static const size_t SHA256_DIGEST_SIZE = 64;
 
-int sha256_digest(const char* const filename, char* dst);
\ No newline at end of file
+int sha256_digest(const char* const filename, char* dst);
+void sha256_hexdigest(const br_sha256_context* const context, char* dst);
\ No newline at end of file
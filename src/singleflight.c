@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "singleflight.h"
+#include "threads.h"
+#include "errors.h"
+#include "utils.h"
+
+/*
+Coalesces concurrent identical calls. The first caller for a given (key, variant, options) tuple
+performs the call; everyone arriving while it is in progress waits for it and gets a copy of its
+result and return code instead of repeating the work.
+*/
+
+static int flight_matches(const struct Flight* const flight, const char* const key, const char* const variant, const uint32_t options) {
+	
+	if (flight->options != options || strcmp(flight->key, key) != 0) {
+		return 0;
+	}
+	
+	if (flight->variant == NULL || variant == NULL) {
+		return flight->variant == variant;
+	}
+	
+	return strcmp(flight->variant, variant) == 0;
+	
+}
+
+static void flight_free(struct Flight* flight) {
+	
+	free(flight->result);
+	free(flight);
+	
+}
+
+static int flight_wait(struct FlightGroup* group, struct Flight* flight, const unsigned long long deadline, char** result) {
+	/*
+	Waits for the call to finish. Must be called with the group lock held.
+	*/
+	
+	int code = UNALIXERR_SUCCESS;
+	
+	flight->total_waiters++;
+	
+	while (!flight->done) {
+		int timeout = -1;
+		
+		if (deadline > 0) {
+			const unsigned long long now = get_monotonic_time();
+			timeout = (deadline > now) ? (int) (deadline - now) : 0;
+		}
+		
+		if (timeout == 0 || condition_wait(&group->condition, &group->mutex, timeout)) {
+			if (!flight->done) {
+				code = UNALIXERR_SOCKET_TIMEOUT;
+				break;
+			}
+		}
+	}
+	
+	if (flight->done) {
+		code = flight->code;
+		
+		if (flight->result != NULL) {
+			*result = (char*) malloc(strlen(flight->result) + 1);
+			
+			if (*result == NULL) {
+				code = UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+			} else {
+				strcpy(*result, flight->result);
+			}
+		}
+	}
+	
+	flight->total_waiters--;
+	
+	if (flight->done && flight->total_waiters == 0) {
+		flight_free(flight);
+	}
+	
+	return code;
+	
+}
+
+int singleflight_do(
+	struct FlightGroup* group,
+	const char* const key,
+	const char* const variant,
+	const uint32_t options,
+	const unsigned long long deadline,
+	const singleflight_call_t call,
+	void* userdata,
+	char** result
+) {
+	/*
+	Performs call(userdata, result), unless an identical call is already in progress, in which case
+	its outcome is shared. Waiting gives up with UNALIXERR_SOCKET_TIMEOUT once the deadline (a
+	monotonic time in milliseconds, or 0 for none) passes.
+	*/
+	
+	*result = NULL;
+	
+	mutex_lock(&group->mutex);
+	
+	for (struct Flight* flight = group->flights; flight != NULL; flight = flight->next) {
+		if (flight_matches(flight, key, variant, options)) {
+			const int code = flight_wait(group, flight, deadline, result);
+			
+			mutex_unlock(&group->mutex);
+			
+			return code;
+		}
+	}
+	
+	struct Flight* const flight = (struct Flight*) malloc(sizeof(struct Flight));
+	
+	if (flight == NULL) {
+		mutex_unlock(&group->mutex);
+		
+		// Coalescing is only an optimization
+		return call(userdata, result);
+	}
+	
+	memset(flight, 0, sizeof(*flight));
+	
+	flight->key = key;
+	flight->variant = variant;
+	flight->options = options;
+	flight->next = group->flights;
+	
+	group->flights = flight;
+	
+	mutex_unlock(&group->mutex);
+	
+	const int code = call(userdata, result);
+	
+	mutex_lock(&group->mutex);
+	
+	for (struct Flight** item = &group->flights; *item != NULL; item = &(*item)->next) {
+		if (*item == flight) {
+			*item = flight->next;
+			break;
+		}
+	}
+	
+	flight->done = 1;
+	flight->code = code;
+	
+	if (flight->total_waiters == 0) {
+		flight_free(flight);
+	} else {
+		if (*result != NULL) {
+			flight->result = (char*) malloc(strlen(*result) + 1);
+			
+			if (flight->result == NULL) {
+				flight->code = UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+			} else {
+				strcpy(flight->result, *result);
+			}
+		}
+		
+		// The key belongs to the caller, which is about to return
+		flight->key = NULL;
+		flight->variant = NULL;
+		
+		condition_broadcast(&group->condition);
+	}
+	
+	mutex_unlock(&group->mutex);
+	
+	return code;
+	
+}
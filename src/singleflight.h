@@ -0,0 +1,41 @@
+#ifndef SINGLEFLIGHT_H_INCLUDED
+#define SINGLEFLIGHT_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "threads.h"
+
+typedef int (*singleflight_call_t)(void* userdata, char** result);
+
+struct Flight {
+	const char* key; // Borrowed from the caller performing the call
+	const char* variant;
+	uint32_t options;
+	int done;
+	int code;
+	char* result;
+	size_t total_waiters;
+	struct Flight* next;
+};
+
+struct FlightGroup {
+	struct Mutex mutex;
+	struct Condition condition;
+	struct Flight* flights;
+};
+
+#define FLIGHT_GROUP_INITIALIZER {MUTEX_INITIALIZER, CONDITION_INITIALIZER, NULL}
+
+int singleflight_do(
+	struct FlightGroup* group,
+	const char* const key,
+	const char* const variant,
+	const uint32_t options,
+	const unsigned long long deadline,
+	const singleflight_call_t call,
+	void* userdata,
+	char** result
+);
+
+#endif
@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <bearssl.h>
+
+#include "ssl_pool.h"
+#include "ssl.h"
+#include "x509_cache.h"
+#include "threads.h"
+#include "errors.h"
+
+struct SSLPool {
+	struct Mutex mutex;
+	struct SSLContext* idle;
+	size_t total_idle;
+	size_t max_idle;
+	int half_duplex;
+	const br_x509_trust_anchor* anchors;
+	size_t total_anchors;
+};
+
+static struct SSLPool pool = {
+	.mutex = MUTEX_INITIALIZER,
+	.max_idle = SSL_POOL_DEFAULT_MAX_IDLE,
+	.anchors = TAs,
+	.total_anchors = TAs_NUM
+};
+
+/*
+The bundled trust anchors, followed by any added at runtime. Entries are only ever appended, so
+contexts created earlier can keep using the array with the count they were given.
+*/
+static br_x509_trust_anchor anchors[TAs_NUM + SSL_POOL_MAX_EXTRA_ANCHORS];
+
+struct AnchorName {
+	unsigned char* data;
+	size_t size;
+	size_t capacity;
+};
+
+static void anchor_name_append(void* userdata, const void* buffer, size_t size) {
+	
+	struct AnchorName* const name = (struct AnchorName*) userdata;
+	
+	if (name->data == NULL || name->capacity - name->size < size) {
+		const size_t capacity = (name->size + size) * 2;
+		unsigned char* const data = (unsigned char*) realloc(name->data, capacity);
+		
+		if (data == NULL) {
+			free(name->data);
+			
+			name->data = NULL;
+			name->capacity = 0;
+			
+			return;
+		}
+		
+		name->data = data;
+		name->capacity = capacity;
+	}
+	
+	memcpy(name->data + name->size, buffer, size);
+	name->size += size;
+	
+}
+
+static void ssl_context_free(struct SSLContext* obj) {
+	
+	x509_cache_free(&obj->xcc);
+	free(obj);
+	
+}
+
+static void pool_clear(void) {
+	/*
+	Frees every idle context. Must be called with the pool lock held.
+	*/
+	
+	struct SSLContext* context = pool.idle;
+	
+	while (context != NULL) {
+		struct SSLContext* const next = context->next;
+		ssl_context_free(context);
+		context = next;
+	}
+	
+	pool.idle = NULL;
+	pool.total_idle = 0;
+	
+}
+
+static struct SSLContext* ssl_context_create(const int half_duplex, const br_x509_trust_anchor* trust_anchors, const size_t total_trust_anchors) {
+	/*
+	Allocates a client context and performs the one-time engine setup (cipher suites, trust anchors
+	and I/O buffer). Only br_ssl_client_reset() is needed before each handshake afterwards.
+	*/
+	
+	const size_t iobuf_size = half_duplex ? BR_SSL_BUFSIZE_MONO : BR_SSL_BUFSIZE_BIDI;
+	
+	struct SSLContext* const context = (struct SSLContext*) malloc(sizeof(struct SSLContext) + iobuf_size);
+	
+	if (context == NULL) {
+		return NULL;
+	}
+	
+	br_ssl_client_init_full(&context->sc, &context->xc, trust_anchors, total_trust_anchors);
+	
+	x509_cache_init(&context->xcc, &context->xc);
+	br_ssl_engine_set_x509(&context->sc.eng, &context->xcc.vtable);
+	
+	br_ssl_engine_set_buffer(&context->sc.eng, context->iobuf, iobuf_size, !half_duplex);
+	
+	context->is_initialized = 0;
+	context->half_duplex = half_duplex;
+	context->next = NULL;
+	
+	return context;
+	
+}
+
+int ssl_context_acquire(struct SSLContext** dst) {
+	/*
+	Takes an idle context from the pool, or creates a new one if there is none left.
+	*/
+	
+	mutex_lock(&pool.mutex);
+	
+	struct SSLContext* context = pool.idle;
+	const int half_duplex = pool.half_duplex;
+	const br_x509_trust_anchor* const trust_anchors = pool.anchors;
+	const size_t total_trust_anchors = pool.total_anchors;
+	
+	if (context != NULL) {
+		pool.idle = context->next;
+		pool.total_idle--;
+	}
+	
+	mutex_unlock(&pool.mutex);
+	
+	if (context == NULL) {
+		context = ssl_context_create(half_duplex, trust_anchors, total_trust_anchors);
+		
+		if (context == NULL) {
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+	}
+	
+	context->next = NULL;
+	
+	*dst = context;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+void ssl_context_release(struct SSLContext* obj) {
+	/*
+	Gives a context back to the pool. It is freed instead if the pool is full or if it was created
+	for a buffer mode that is no longer in use.
+	*/
+	
+	if (obj == NULL) {
+		return;
+	}
+	
+	obj->is_initialized = 0;
+	
+	mutex_lock(&pool.mutex);
+	
+	if (obj->half_duplex == pool.half_duplex && pool.total_idle < pool.max_idle) {
+		obj->next = pool.idle;
+		
+		pool.idle = obj;
+		pool.total_idle++;
+		
+		obj = NULL;
+	}
+	
+	mutex_unlock(&pool.mutex);
+	
+	if (obj != NULL) {
+		ssl_context_free(obj);
+	}
+	
+}
+
+void unalix_ssl_pool_configure(const size_t max_idle, const int half_duplex) {
+	
+	mutex_lock(&pool.mutex);
+	
+	pool_clear();
+	
+	pool.max_idle = max_idle;
+	pool.half_duplex = half_duplex != 0;
+	
+	mutex_unlock(&pool.mutex);
+	
+}
+
+int unalix_ssl_add_trust_anchor(const unsigned char* const certificate, const size_t certificate_size) {
+	/*
+	Trusts the given DER-encoded CA certificate, in addition to the bundled ones, for connections
+	made from now on.
+	*/
+	
+	if (certificate == NULL || certificate_size == 0) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	struct AnchorName name = {0};
+	
+	br_x509_decoder_context decoder;
+	br_x509_decoder_init(&decoder, anchor_name_append, &name);
+	br_x509_decoder_push(&decoder, certificate, certificate_size);
+	
+	const br_x509_pkey* const pkey = br_x509_decoder_get_pkey(&decoder);
+	
+	if (pkey == NULL || name.data == NULL) {
+		free(name.data);
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	br_x509_trust_anchor anchor = {
+		.dn = {
+			.data = name.data,
+			.len = name.size
+		},
+		.flags = br_x509_decoder_isCA(&decoder) ? BR_X509_TA_CA : 0,
+		.pkey = *pkey
+	};
+	
+	// The key material points into the decoder, which is about to go away
+	const size_t key_size = (pkey->key_type == BR_KEYTYPE_RSA) ? pkey->key.rsa.nlen + pkey->key.rsa.elen : pkey->key.ec.qlen;
+	unsigned char* const key = (unsigned char*) malloc(key_size);
+	
+	if (key == NULL) {
+		free(name.data);
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	if (pkey->key_type == BR_KEYTYPE_RSA) {
+		memcpy(key, pkey->key.rsa.n, pkey->key.rsa.nlen);
+		memcpy(key + pkey->key.rsa.nlen, pkey->key.rsa.e, pkey->key.rsa.elen);
+		
+		anchor.pkey.key.rsa.n = key;
+		anchor.pkey.key.rsa.e = key + pkey->key.rsa.nlen;
+	} else {
+		memcpy(key, pkey->key.ec.q, pkey->key.ec.qlen);
+		
+		anchor.pkey.key.ec.q = key;
+	}
+	
+	mutex_lock(&pool.mutex);
+	
+	if (pool.total_anchors == TAs_NUM + SSL_POOL_MAX_EXTRA_ANCHORS) {
+		mutex_unlock(&pool.mutex);
+		
+		free(name.data);
+		free(key);
+		
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	if (pool.anchors == TAs) {
+		memcpy(anchors, TAs, sizeof(TAs));
+		pool.anchors = anchors;
+	}
+	
+	anchors[pool.total_anchors++] = anchor;
+	
+	// Idle contexts were set up with the previous list
+	pool_clear();
+	
+	mutex_unlock(&pool.mutex);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
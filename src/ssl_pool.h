@@ -0,0 +1,29 @@
+#ifndef SSL_POOL_H_INCLUDED
+#define SSL_POOL_H_INCLUDED
+
+#include <stddef.h>
+
+#include <bearssl.h>
+
+#include "x509_cache.h"
+
+static const size_t SSL_POOL_DEFAULT_MAX_IDLE = 8;
+
+// Room for trust anchors added at runtime, on top of the bundled ones
+#define SSL_POOL_MAX_EXTRA_ANCHORS 16
+
+struct SSLContext {
+	br_ssl_client_context sc;
+	br_x509_minimal_context xc;
+	struct X509CacheContext xcc; // Wraps xc
+	br_sslio_context ioc;
+	int is_initialized; // Whether a TLS session is bound to the owning connection
+	int half_duplex;
+	struct SSLContext* next;
+	unsigned char iobuf[]; // BR_SSL_BUFSIZE_BIDI or BR_SSL_BUFSIZE_MONO bytes, depending on half_duplex
+};
+
+int ssl_context_acquire(struct SSLContext** dst);
+void ssl_context_release(struct SSLContext* obj);
+
+#endif
@@ -0,0 +1,183 @@
+#include <stdlib.h>
+
+#ifndef _WIN32
+	#include <time.h>
+	#include <errno.h>
+#endif
+
+#include "threads.h"
+#include "errors.h"
+
+struct ThreadArguments {
+	void (*routine)(void*);
+	void* argument;
+};
+
+void mutex_lock(struct Mutex* obj) {
+	
+	#ifdef _WIN32
+		AcquireSRWLockExclusive(&obj->lock);
+	#else
+		pthread_mutex_lock(&obj->lock);
+	#endif
+	
+}
+
+void mutex_unlock(struct Mutex* obj) {
+	
+	#ifdef _WIN32
+		ReleaseSRWLockExclusive(&obj->lock);
+	#else
+		pthread_mutex_unlock(&obj->lock);
+	#endif
+	
+}
+
+void rwlock_read_lock(struct RWLock* obj) {
+	
+	#ifdef _WIN32
+		AcquireSRWLockShared(&obj->lock);
+	#else
+		pthread_rwlock_rdlock(&obj->lock);
+	#endif
+	
+}
+
+void rwlock_read_unlock(struct RWLock* obj) {
+	
+	#ifdef _WIN32
+		ReleaseSRWLockShared(&obj->lock);
+	#else
+		pthread_rwlock_unlock(&obj->lock);
+	#endif
+	
+}
+
+void rwlock_write_lock(struct RWLock* obj) {
+	
+	#ifdef _WIN32
+		AcquireSRWLockExclusive(&obj->lock);
+	#else
+		pthread_rwlock_wrlock(&obj->lock);
+	#endif
+	
+}
+
+void rwlock_write_unlock(struct RWLock* obj) {
+	
+	#ifdef _WIN32
+		ReleaseSRWLockExclusive(&obj->lock);
+	#else
+		pthread_rwlock_unlock(&obj->lock);
+	#endif
+	
+}
+
+int condition_wait(struct Condition* obj, struct Mutex* mutex, const int timeout) {
+	/*
+	Waits (with the mutex held) for the condition to be signaled, or for timeout milliseconds
+	to elapse if timeout is not -1. Returns 0 when woken up and 1 on timeout. Spurious wakeups
+	are possible, so callers must recheck whatever they are waiting for.
+	*/
+	
+	#ifdef _WIN32
+		if (!SleepConditionVariableSRW(&obj->variable, &mutex->lock, (timeout == -1) ? INFINITE : (DWORD) timeout, 0)) {
+			return GetLastError() == ERROR_TIMEOUT;
+		}
+	#else
+		if (timeout == -1) {
+			pthread_cond_wait(&obj->variable, &mutex->lock);
+			return 0;
+		}
+		
+		struct timespec deadline = {0};
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		
+		deadline.tv_sec += timeout / 1000;
+		deadline.tv_nsec += (long) (timeout % 1000) * 1000000;
+		
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		
+		if (pthread_cond_timedwait(&obj->variable, &mutex->lock, &deadline) == ETIMEDOUT) {
+			return 1;
+		}
+	#endif
+	
+	return 0;
+	
+}
+
+void condition_broadcast(struct Condition* obj) {
+	
+	#ifdef _WIN32
+		WakeAllConditionVariable(&obj->variable);
+	#else
+		pthread_cond_broadcast(&obj->variable);
+	#endif
+	
+}
+
+#ifdef _WIN32
+	static DWORD WINAPI thread_start(LPVOID argument) {
+#else
+	static void* thread_start(void* argument) {
+#endif
+	
+	struct ThreadArguments arguments = *(struct ThreadArguments*) argument;
+	free(argument);
+	
+	arguments.routine(arguments.argument);
+	
+	#ifdef _WIN32
+		return 0;
+	#else
+		return NULL;
+	#endif
+	
+}
+
+int thread_create_detached(void (*routine)(void*), void* argument) {
+	/*
+	Runs routine(argument) on a new thread that nobody will ever join.
+	*/
+	
+	struct ThreadArguments* arguments = (struct ThreadArguments*) malloc(sizeof(struct ThreadArguments));
+	
+	if (arguments == NULL) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	arguments->routine = routine;
+	arguments->argument = argument;
+	
+	#ifdef _WIN32
+		const HANDLE handle = CreateThread(NULL, 0, thread_start, arguments, 0, NULL);
+		
+		if (handle == NULL) {
+			free(arguments);
+			return UNALIXERR_THREAD_CREATE_FAILURE;
+		}
+		
+		CloseHandle(handle);
+	#else
+		pthread_attr_t attributes;
+		pthread_attr_init(&attributes);
+		pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+		
+		pthread_t thread;
+		const int code = pthread_create(&thread, &attributes, thread_start, arguments);
+		
+		pthread_attr_destroy(&attributes);
+		
+		if (code != 0) {
+			free(arguments);
+			return UNALIXERR_THREAD_CREATE_FAILURE;
+		}
+	#endif
+	
+	return UNALIXERR_SUCCESS;
+	
+}
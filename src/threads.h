@@ -0,0 +1,65 @@
+#ifndef THREADS_H_INCLUDED
+#define THREADS_H_INCLUDED
+
+#ifdef _WIN32
+	#ifdef _WIN32_WINNT
+		#undef _WIN32_WINNT
+	#endif
+	
+	#define _WIN32_WINNT 0x0600
+	
+	#include <windows.h>
+	
+	struct Mutex {
+		SRWLOCK lock;
+	};
+	
+	#define MUTEX_INITIALIZER {SRWLOCK_INIT}
+	
+	struct Condition {
+		CONDITION_VARIABLE variable;
+	};
+	
+	#define CONDITION_INITIALIZER {CONDITION_VARIABLE_INIT}
+	
+	struct RWLock {
+		SRWLOCK lock;
+	};
+	
+	#define RWLOCK_INITIALIZER {SRWLOCK_INIT}
+#else
+	#include <pthread.h>
+	
+	struct Mutex {
+		pthread_mutex_t lock;
+	};
+	
+	#define MUTEX_INITIALIZER {PTHREAD_MUTEX_INITIALIZER}
+	
+	struct Condition {
+		pthread_cond_t variable;
+	};
+	
+	#define CONDITION_INITIALIZER {PTHREAD_COND_INITIALIZER}
+	
+	struct RWLock {
+		pthread_rwlock_t lock;
+	};
+	
+	#define RWLOCK_INITIALIZER {PTHREAD_RWLOCK_INITIALIZER}
+#endif
+
+void mutex_lock(struct Mutex* obj);
+void mutex_unlock(struct Mutex* obj);
+
+void rwlock_read_lock(struct RWLock* obj);
+void rwlock_read_unlock(struct RWLock* obj);
+void rwlock_write_lock(struct RWLock* obj);
+void rwlock_write_unlock(struct RWLock* obj);
+
+int condition_wait(struct Condition* obj, struct Mutex* mutex, const int timeout);
+void condition_broadcast(struct Condition* obj);
+
+int thread_create_detached(void (*routine)(void*), void* argument);
+
+#endif
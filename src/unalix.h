@@ -1,3 +1,67 @@
+#ifndef UNALIX_H_INCLUDED
+#define UNALIX_H_INCLUDED
+
+#include <stddef.h>
+
+struct sockaddr_storage;
+
+enum unalix_phase {
+	UNALIX_PHASE_DNS, // Name resolution
+	UNALIX_PHASE_CONNECT, // TCP connection establishment
+	UNALIX_PHASE_TLS, // TLS handshake
+	UNALIX_PHASE_FIRST_BYTE, // From the request being sent until the first byte of the response
+	UNALIX_PHASE_REQUEST, // A whole HTTP request, up to the end of the response headers
+	UNALIX_PHASE_UNSHORT // A whole unalix_unshort_url() call (never reported per request)
+};
+
+#define UNALIX_TOTAL_PHASES 6
+
+// Bucket n counts durations of less than 2^n microseconds (and at least 2^(n - 1)); the last one also counts anything longer
+#define UNALIX_METRICS_TOTAL_BUCKETS 28
+
+// Error counters are indexed by -code
+#define UNALIX_METRICS_TOTAL_ERRORS 128
+
+struct unalix_request_metrics {
+	const char* hostname;
+	int code;
+	unsigned long long phases[UNALIX_TOTAL_PHASES]; // Microseconds; 0 for phases the request did not go through
+	unsigned long long bytes_received;
+	unsigned long long bytes_sent;
+};
+
+struct unalix_metrics {
+	unsigned long long requests;
+	unsigned long long connections_opened;
+	unsigned long long tls_handshakes;
+	unsigned long long bytes_received;
+	unsigned long long bytes_sent;
+	unsigned long long redirects_followed;
+	unsigned long long unshorts;
+	unsigned long long unshorts_failed;
+	unsigned long long errors[UNALIX_METRICS_TOTAL_ERRORS]; // Failed HTTP requests, by error code
+	unsigned long long phase_count[UNALIX_TOTAL_PHASES];
+	unsigned long long phase_total[UNALIX_TOTAL_PHASES]; // Microseconds
+	unsigned long long histogram[UNALIX_TOTAL_PHASES][UNALIX_METRICS_TOTAL_BUCKETS];
+};
+
+typedef void (*unalix_metrics_callback_t)(const struct unalix_request_metrics* metrics, void* userdata);
+
+typedef void (*unalix_unshort_callback_t)(const unsigned long long id, const int code, const char* const target_url, void* userdata);
+typedef void (*unalix_thread_hook_t)(void* userdata);
+
+struct unalix_scanner;
+
+typedef int (*unalix_scanner_sink_t)(const char* const buffer, const size_t buffer_size, void* userdata);
+
+typedef int (*unalix_resolver_t)(
+	const char* const hostname,
+	struct sockaddr_storage* addresses,
+	size_t* total_addresses,
+	int* ttl,
+	void* userdata
+);
+
 int unalix_clean_url(
 	const char* source_url,
 	char** target_url,
@@ -10,6 +74,39 @@ int unalix_clean_url(
 	const int strip_duplicates
 );
 
+void unalix_clean_url_max_depth(const size_t depth);
+
+int unalix_clean_text(
+	const char* const source_text,
+	const size_t source_text_size,
+	char** target_text,
+	size_t* target_text_size,
+	const int ignore_referral_marketing,
+	const int ignore_rules,
+	const int ignore_exceptions,
+	const int ignore_raw_rules,
+	const int ignore_redirections,
+	const int strip_empty,
+	const int strip_duplicates
+);
+
+int unalix_scanner_new(
+	struct unalix_scanner** scanner,
+	const int ignore_referral_marketing,
+	const int ignore_rules,
+	const int ignore_exceptions,
+	const int ignore_raw_rules,
+	const int ignore_redirections,
+	const int strip_empty,
+	const int strip_duplicates,
+	const unalix_scanner_sink_t sink,
+	void* userdata
+);
+
+int unalix_scanner_feed(struct unalix_scanner* scanner, const char* const buffer, const size_t buffer_size);
+int unalix_scanner_finish(struct unalix_scanner* scanner);
+void unalix_scanner_free(struct unalix_scanner* scanner);
+
 int unalix_unshort_url(
 	const char* const source_url,
 	char** target_url,
@@ -24,8 +121,63 @@ int unalix_unshort_url(
 	const int timeout
 );
 
+int unalix_unshort_url_async(
+	const char* const source_url,
+	const int ignore_referral_marketing,
+	const int ignore_rules,
+	const int ignore_exceptions,
+	const int ignore_raw_rules,
+	const int ignore_redirections,
+	const int strip_empty,
+	const int strip_duplicates,
+	const char* const user_agent,
+	const int timeout,
+	const unalix_unshort_callback_t callback,
+	void* userdata,
+	unsigned long long* id
+);
+
+int unalix_unshort_cancel(const unsigned long long id);
+int unalix_unshort_async_configure(const size_t max_threads, const unalix_thread_hook_t thread_start, const unalix_thread_hook_t thread_stop, void* userdata);
+void unalix_unshort_async_stop(void);
+
+void unalix_unshort_use_head(const int enabled);
+int unalix_unshort_policy_set_hosts(const char* const* hosts, const size_t total_hosts);
+int unalix_unshort_policy_learn(const size_t max_hosts, const int ttl);
+
+int unalix_url_cache_open(const char* const filename, const size_t max_entries, const int ttl);
+void unalix_url_cache_close(void);
+
 int unalix_load_file(const char* const filename);
 int unalix_load_string(const char* const string);
+int unalix_reload_file(const char* const filename);
+int unalix_load_frozen(void);
+int unalix_load_builtin(void);
+void unalix_unload_rulesets(void);
 
 int unalix_ruleset_check_update(const char* const filename, const char* const url);
 int unalix_ruleset_update(const char* const filename, const char* const url, const char* const sha256_url, const char* const temporary_directory);
+int unalix_ruleset_update_load(const char* const filename, const char* const url, const char* const sha256_url);
+
+int unalix_ruleset_segment_publish(const char* const filename);
+int unalix_ruleset_segment_attach(const char* const filename);
+int unalix_ruleset_segment_refresh(void);
+unsigned long long unalix_ruleset_segment_generation(void);
+
+
+int unalix_dns_cache_configure(const size_t max_entries, const int ttl, const int negative_ttl, const int stale_ttl);
+int unalix_dns_cache_add(const char* const hostname, const char* const* addresses, const size_t total_addresses, const int ttl);
+void unalix_dns_cache_clear(void);
+void unalix_dns_set_resolver(const unalix_resolver_t resolver, void* userdata);
+int unalix_dns_set_server(const char* const uri, const int timeout);
+
+void unalix_ssl_pool_configure(const size_t max_idle, const int half_duplex);
+int unalix_certificate_cache_configure(const size_t max_entries);
+int unalix_ssl_add_trust_anchor(const unsigned char* const certificate, const size_t certificate_size);
+
+void unalix_metrics_enable(const int enabled);
+void unalix_metrics_snapshot(struct unalix_metrics* dst);
+void unalix_metrics_reset(void);
+void unalix_metrics_set_callback(const unalix_metrics_callback_t callback, void* userdata);
+
+#endif
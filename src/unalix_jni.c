@@ -1,26 +1,81 @@
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <jni.h>
 
 #include "unalix_jni.h"
 #include "unalix.h"
 #include "errors.h"
 
-const char* get_exception_class(const int code) {
+enum Exception {
+	EXCEPTION_GENERIC,
+	EXCEPTION_MEMORY,
+	EXCEPTION_FILE,
+	EXCEPTION_JSON,
+	EXCEPTION_REGEX,
+	EXCEPTION_URI,
+	EXCEPTION_RULESETS,
+	EXCEPTION_DNS,
+	EXCEPTION_SOCKET,
+	EXCEPTION_SSL,
+	EXCEPTION_HTTP,
+	EXCEPTION_OS,
+	EXCEPTION_TOTAL
+};
+
+static const char* const EXCEPTION_CLASSES[] = {
+	"com/amanoteam/libunalix/exceptions/UnalixException",
+	"com/amanoteam/libunalix/exceptions/UnalixMemoryException",
+	"com/amanoteam/libunalix/exceptions/UnalixFileException",
+	"com/amanoteam/libunalix/exceptions/UnalixJSONException",
+	"com/amanoteam/libunalix/exceptions/UnalixRegexException",
+	"com/amanoteam/libunalix/exceptions/UnalixURIException",
+	"com/amanoteam/libunalix/exceptions/UnalixRulesetsException",
+	"com/amanoteam/libunalix/exceptions/UnalixDNSException",
+	"com/amanoteam/libunalix/exceptions/UnalixSocketException",
+	"com/amanoteam/libunalix/exceptions/UnalixSSLException",
+	"com/amanoteam/libunalix/exceptions/UnalixHTTPException",
+	"com/amanoteam/libunalix/exceptions/UnalixOSException"
+};
+
+// Global references to the exception classes, resolved once in JNI_OnLoad
+static jclass exception_classes[EXCEPTION_TOTAL] = {0};
+
+// Constructors taking the message, to create exceptions that are handed to callbacks instead of thrown
+static jmethodID exception_constructors[EXCEPTION_TOTAL] = {0};
+
+static jclass string_class = NULL;
+
+static const char UNSHORT_CALLBACK_CLASS[] = "com/amanoteam/libunalix/UnshortCallback";
+
+static JavaVM* java_vm = NULL;
+
+static jmethodID unshort_on_success = NULL;
+static jmethodID unshort_on_failure = NULL;
+
+// Reusable buffer for the URLs of a batch, avoiding an allocation per URL
+struct URLBuffer {
+	char* content;
+	size_t size;
+};
+
+static enum Exception get_exception(const int code) {
 	
 	switch (code) {
 		case UNALIXERR_MEMORY_ALLOCATE_FAILURE:
-			return "com/amanoteam/libunalix/exceptions/UnalixMemoryException";
+			return EXCEPTION_MEMORY;
 		case UNALIXERR_FILE_CANNOT_OPEN:
 		case UNALIXERR_FILE_CANNOT_READ:
 		case UNALIXERR_FILE_CANNOT_WRITE:
 		case UNALIXERR_FILE_CANNOT_MOVE:
-			return "com/amanoteam/libunalix/exceptions/UnalixFileException";
+		case UNALIXERR_URL_CACHE_INVALID_FILE:
+			return EXCEPTION_FILE;
 		case UNALIXERR_JSON_CANNOT_PARSE:
 		case UNALIXERR_JSON_MISSING_REQUIRED_KEY:
 		case UNALIXERR_JSON_NON_MATCHING_TYPE:
-			return "com/amanoteam/libunalix/exceptions/UnalixJSONException";
+			return EXCEPTION_JSON;
 		case UNALIXERR_REGEX_COMPILE_PATTERN_FAILURE:
-			return "com/amanoteam/libunalix/exceptions/UnalixRegexException";
+			return EXCEPTION_REGEX;
 		case UNALIXERR_URI_SCHEME_INVALID:
 		case UNALIXERR_URI_SCHEME_MISSING:
 		case UNALIXERR_URI_SCHEME_SHOULD_STARTS_WITH_LETTER:
@@ -39,24 +94,35 @@ const char* get_exception_class(const int code) {
 		case UNALIXERR_URI_IPV6_ADDRESS_TOO_SHORT:
 		case UNALIXERR_URI_IPV6_ADDRESS_TOO_LONG:
 		case UNALIXERR_URI_IPV6_ADDRESS_INVALID:
-			return "com/amanoteam/libunalix/exceptions/UnalixURIException";
+			return EXCEPTION_URI;
 		case UNALIXERR_RULESETS_EMPTY:
 		case UNALIXERR_RULESETS_NOT_MODIFIED:
 		case UNALIXERR_RULESETS_UPDATE_AVAILABLE:
 		case UNALIXERR_RULESETS_MISMATCH_HASH:
-			return "com/amanoteam/libunalix/exceptions/UnalixRulesetsException";
+		case UNALIXERR_RULESETS_SEGMENT_INVALID:
+		case UNALIXERR_RULESETS_SEGMENT_NOT_ATTACHED:
+		case UNALIXERR_RULESETS_NOT_BUILTIN:
+			return EXCEPTION_RULESETS;
 		case UNALIXERR_DNS_GAI_FAILURE:
 		case UNALIXERR_DNS_CANNOT_PARSE_ADDRESS:
-			return "com/amanoteam/libunalix/exceptions/UnalixDNSException";
+		case UNALIXERR_DNS_MALFORMED_RESPONSE:
+		case UNALIXERR_DNS_NXDOMAIN:
+		case UNALIXERR_DNS_SERVER_FAILURE:
+		case UNALIXERR_DNS_TRUNCATED_RESPONSE:
+		case UNALIXERR_DNS_TIMEOUT:
+		case UNALIXERR_DNS_UNSUPPORTED_PROTOCOL:
+		case UNALIXERR_DNS_NO_ADDRESS:
+			return EXCEPTION_DNS;
 		case UNALIXERR_SOCKET_FAILURE:
 		case UNALIXERR_SOCKET_SETOPT_FAILURE:
 		case UNALIXERR_SOCKET_SEND_FAILURE:
 		case UNALIXERR_SOCKET_RECV_FAILURE:
 		case UNALIXERR_SOCKET_CLOSE_FAILURE:
 		case UNALIXERR_SOCKET_CONNECT_FAILURE:
-			return "com/amanoteam/libunalix/exceptions/UnalixSocketException";
+		case UNALIXERR_SOCKET_TIMEOUT:
+			return EXCEPTION_SOCKET;
 		case UNALIXERR_SSL_FAILURE:
-			return "com/amanoteam/libunalix/exceptions/UnalixSSLException";
+			return EXCEPTION_SSL;
 		case UNALIXERR_HTTP_UNSUPPORTED_VERSION:
 		case UNALIXERR_HTTP_MALFORMED_STATUS_CODE:
 		case UNALIXERR_HTTP_UNKNOWN_STATUS_CODE:
@@ -68,19 +134,175 @@ const char* get_exception_class(const int code) {
 		case UNALIXERR_HTTP_HEADERS_INVALID_LOCATION:
 		case UNALIXERR_HTTP_TOO_MANY_REDIRECTS:
 		case UNALIXERR_HTTP_BAD_STATUS_CODE:
-			return "com/amanoteam/libunalix/exceptions/UnalixHTTPException";
+		case UNALIXERR_HTTP_MALFORMED_BODY:
+			return EXCEPTION_HTTP;
 		case UNALIXERR_OS_STAT_FAILURE:
 		case UNALIXERR_OS_GMTIME_FAILURE:
 		case UNALIXERR_OS_MKTIME_FAILURE:
 		case UNALIXERR_OS_STRFTIME_FAILURE:
 		case UNALIXERR_OS_STRPTIME_FAILURE:
-			return "com/amanoteam/libunalix/exceptions/UnalixOSException";
+		case UNALIXERR_OS_MMAP_FAILURE:
+			return EXCEPTION_OS;
 		default:
-			return "com/amanoteam/libunalix/exceptions/UnalixException";
+			return EXCEPTION_GENERIC;
 	}
 
 }
 
+const char* get_exception_class(const int code) {
+	return EXCEPTION_CLASSES[get_exception(code)];
+}
+
+static void throw_exception(JNIEnv* env, const int code) {
+	
+	const enum Exception exception = get_exception(code);
+	
+	jclass class = exception_classes[exception];
+	
+	// Only reached when the library was not loaded through System.loadLibrary()
+	if (class == NULL) {
+		class = (*env)->FindClass(env, EXCEPTION_CLASSES[exception]);
+		
+		if (class == NULL) {
+			return;
+		}
+	}
+	
+	(*env)->ThrowNew(env, class, unalix_strerror(code));
+	
+}
+
+static jclass global_class(JNIEnv* env, const char* const name) {
+	
+	const jclass class = (*env)->FindClass(env, name);
+	
+	if (class == NULL) {
+		(*env)->ExceptionClear(env);
+		return NULL;
+	}
+	
+	const jclass global = (jclass) (*env)->NewGlobalRef(env, class);
+	(*env)->DeleteLocalRef(env, class);
+	
+	return global;
+	
+}
+
+static jint attach_thread(JNIEnv** env, const int daemon) {
+	
+	// The Android NDK declares these as taking a JNIEnv** rather than a void**
+	#ifdef __ANDROID__
+		return daemon ? (*java_vm)->AttachCurrentThreadAsDaemon(java_vm, env, NULL) : (*java_vm)->AttachCurrentThread(java_vm, env, NULL);
+	#else
+		return daemon ? (*java_vm)->AttachCurrentThreadAsDaemon(java_vm, (void**) env, NULL) : (*java_vm)->AttachCurrentThread(java_vm, (void**) env, NULL);
+	#endif
+	
+}
+
+static void worker_attach(void* userdata) {
+	
+	(void) userdata;
+	
+	JNIEnv* env = NULL;
+	attach_thread(&env, 1);
+	
+}
+
+static void worker_detach(void* userdata) {
+	
+	(void) userdata;
+	
+	(*java_vm)->DetachCurrentThread(java_vm);
+	
+}
+
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved) {
+	
+	(void) reserved;
+	
+	JNIEnv* env = NULL;
+	
+	if ((*vm)->GetEnv(vm, (void**) &env, JNI_VERSION_1_6) != JNI_OK) {
+		return JNI_ERR;
+	}
+	
+	java_vm = vm;
+	
+	for (size_t index = 0; index < EXCEPTION_TOTAL; index++) {
+		exception_classes[index] = global_class(env, EXCEPTION_CLASSES[index]);
+		
+		if (exception_classes[index] == NULL) {
+			continue;
+		}
+		
+		exception_constructors[index] = (*env)->GetMethodID(env, exception_classes[index], "<init>", "(Ljava/lang/String;)V");
+		
+		if (exception_constructors[index] == NULL) {
+			(*env)->ExceptionClear(env);
+		}
+	}
+	
+	string_class = global_class(env, "java/lang/String");
+	
+	if (string_class == NULL) {
+		return JNI_ERR;
+	}
+	
+	const jclass callback_class = (*env)->FindClass(env, UNSHORT_CALLBACK_CLASS);
+	
+	if (callback_class == NULL) {
+		(*env)->ExceptionClear(env);
+	} else {
+		unshort_on_success = (*env)->GetMethodID(env, callback_class, "onSuccess", "(JLjava/lang/String;)V");
+		unshort_on_failure = (*env)->GetMethodID(env, callback_class, "onFailure", "(JLjava/lang/Throwable;)V");
+		
+		if (unshort_on_success == NULL || unshort_on_failure == NULL) {
+			(*env)->ExceptionClear(env);
+			
+			unshort_on_success = NULL;
+			unshort_on_failure = NULL;
+		}
+		
+		(*env)->DeleteLocalRef(env, callback_class);
+	}
+	
+	// Worker threads are attached to the JVM once, for as long as they live
+	unalix_unshort_async_configure(0, worker_attach, worker_detach, NULL);
+	
+	return JNI_VERSION_1_6;
+	
+}
+
+JNIEXPORT void JNICALL JNI_OnUnload(JavaVM* vm, void* reserved) {
+	
+	(void) reserved;
+	
+	JNIEnv* env = NULL;
+	
+	if ((*vm)->GetEnv(vm, (void**) &env, JNI_VERSION_1_6) != JNI_OK) {
+		return;
+	}
+	
+	// Callbacks of pending jobs still need the cached references
+	unalix_unshort_async_stop();
+	unalix_unshort_async_configure(0, NULL, NULL, NULL);
+	
+	for (size_t index = 0; index < EXCEPTION_TOTAL; index++) {
+		exception_constructors[index] = NULL;
+		
+		if (exception_classes[index] != NULL) {
+			(*env)->DeleteGlobalRef(env, exception_classes[index]);
+			exception_classes[index] = NULL;
+		}
+	}
+	
+	if (string_class != NULL) {
+		(*env)->DeleteGlobalRef(env, string_class);
+		string_class = NULL;
+	}
+	
+}
+
 jboolean Java_com_amanoteam_libunalix_LibUnalix_rulesetCheckUpdate(
 	JNIEnv *env,
 	const jobject obj,
@@ -105,14 +327,7 @@ jboolean Java_com_amanoteam_libunalix_LibUnalix_rulesetCheckUpdate(
 		return (jboolean) 0;
 	}
 	
-	(*env)->ThrowNew(
-		env,
-		(*env)->FindClass(
-			env,
-			get_exception_class(code)
-		),
-		unalix_strerror(code)
-	);
+	throw_exception(env, code);
 	
 	return (jboolean) 0;
 	
@@ -141,14 +356,7 @@ void Java_com_amanoteam_libunalix_LibUnalix_rulesetUpdate(
 	(*env)->ReleaseStringUTFChars(env, temporary_directory, ctemporary_directory);
 	
 	if (code != UNALIXERR_SUCCESS) {
-		(*env)->ThrowNew(
-			env,
-			(*env)->FindClass(
-				env,
-				get_exception_class(code)
-			),
-			unalix_strerror(code)
-		);
+		throw_exception(env, code);
 	}
 	
 }
@@ -192,14 +400,7 @@ jstring Java_com_amanoteam_libunalix_LibUnalix_cleanUrl(
 		return string;
 	}
 	
-	(*env)->ThrowNew(
-		env,
-		(*env)->FindClass(
-			env,
-			get_exception_class(code)
-		),
-		unalix_strerror(code)
-	);
+	throw_exception(env, code);
 	
 	return NULL;
 	
@@ -250,14 +451,7 @@ jstring Java_com_amanoteam_libunalix_LibUnalix_unshortUrl(
 		return string;
 	}
 	
-	(*env)->ThrowNew(
-		env,
-		(*env)->FindClass(
-			env,
-			get_exception_class(code)
-		),
-		unalix_strerror(code)
-	);
+	throw_exception(env, code);
 	
 	return NULL;
 	
@@ -278,14 +472,7 @@ void Java_com_amanoteam_libunalix_LibUnalix_loadFile(
 	(*env)->ReleaseStringUTFChars(env, filename, cfilename);
 	
 	if (code != UNALIXERR_SUCCESS) {
-		(*env)->ThrowNew(
-			env,
-			(*env)->FindClass(
-				env,
-				get_exception_class(code)
-			),
-			unalix_strerror(code)
-		);
+		throw_exception(env, code);
 	}
 	
 }
@@ -305,14 +492,436 @@ void Java_com_amanoteam_libunalix_LibUnalix_loadString(
 	(*env)->ReleaseStringUTFChars(env, string, cstring);
 	
 	if (code != UNALIXERR_SUCCESS) {
-		(*env)->ThrowNew(
-			env,
-			(*env)->FindClass(
-				env,
-				get_exception_class(code)
-			),
-			unalix_strerror(code)
+		throw_exception(env, code);
+	}
+	
+}
+
+static int url_buffer_reserve(struct URLBuffer* buffer, const size_t size) {
+	
+	if (size <= buffer->size) {
+		return UNALIXERR_SUCCESS;
+	}
+	
+	char* content = (char*) realloc(buffer->content, size);
+	
+	if (content == NULL) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	buffer->content = content;
+	buffer->size = size;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int string_to_buffer(JNIEnv* env, const jstring string, struct URLBuffer* buffer) {
+	/*
+	Copies the modified UTF-8 representation of the string into the reusable buffer, instead of
+	pinning or copying it into a new allocation as GetStringUTFChars() would.
+	*/
+	
+	const jsize length = (*env)->GetStringLength(env, string);
+	const jsize size = (*env)->GetStringUTFLength(env, string);
+	
+	const int code = url_buffer_reserve(buffer, (size_t) size + 1);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	(*env)->GetStringUTFRegion(env, string, 0, length, buffer->content);
+	buffer->content[size] = '\0';
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+jobjectArray Java_com_amanoteam_libunalix_LibUnalix_cleanUrls(
+	JNIEnv *env,
+	const jobject obj,
+	const jobjectArray urls,
+	const jintArray codes,
+	const jboolean ignoreReferralMarketing,
+	const jboolean ignoreRules,
+	const jboolean ignoreExceptions,
+	const jboolean ignoreRawRules,
+	const jboolean ignoreRedirections,
+	const jboolean stripEmpty,
+	const jboolean stripDuplicates
+) {
+	/*
+	Cleans all URLs in a single native call. URLs that could not be cleaned are left as null in the
+	returned array, with the error code of each URL written to "codes" (when it is not null).
+	*/
+	
+	(void) obj;
+	
+	const jsize total_urls = (*env)->GetArrayLength(env, urls);
+	
+	if (codes != NULL && (*env)->GetArrayLength(env, codes) != total_urls) {
+		throw_exception(env, UNALIXERR_ARG_INVALID);
+		return NULL;
+	}
+	
+	const jclass class = (string_class == NULL) ? (*env)->FindClass(env, "java/lang/String") : string_class;
+	
+	if (class == NULL) {
+		return NULL;
+	}
+	
+	const jobjectArray results = (*env)->NewObjectArray(env, total_urls, class, NULL);
+	
+	if (results == NULL) {
+		return NULL;
+	}
+	
+	jint* const results_codes = (jint*) malloc(sizeof(*results_codes) * ((size_t) total_urls + 1));
+	
+	if (results_codes == NULL) {
+		throw_exception(env, UNALIXERR_MEMORY_ALLOCATE_FAILURE);
+		return NULL;
+	}
+	
+	struct URLBuffer buffer = {0};
+	
+	for (jsize index = 0; index < total_urls; index++) {
+		const jstring url = (jstring) (*env)->GetObjectArrayElement(env, urls, index);
+		
+		if (url == NULL) {
+			results_codes[index] = UNALIXERR_ARG_INVALID;
+			continue;
+		}
+		
+		int code = string_to_buffer(env, url, &buffer);
+		
+		// Local references are released as we go, as a batch may hold more than the JVM allows at once
+		(*env)->DeleteLocalRef(env, url);
+		
+		char* target_url = NULL;
+		
+		if (code == UNALIXERR_SUCCESS) {
+			code = unalix_clean_url(
+				buffer.content,
+				&target_url,
+				ignoreReferralMarketing,
+				ignoreRules,
+				ignoreExceptions,
+				ignoreRawRules,
+				ignoreRedirections,
+				stripEmpty,
+				stripDuplicates
+			);
+		}
+		
+		results_codes[index] = code;
+		
+		if (code != UNALIXERR_SUCCESS) {
+			continue;
+		}
+		
+		const jstring string = (*env)->NewStringUTF(env, target_url);
+		free(target_url);
+		
+		if (string == NULL) {
+			break;
+		}
+		
+		(*env)->SetObjectArrayElement(env, results, index, string);
+		(*env)->DeleteLocalRef(env, string);
+	}
+	
+	free(buffer.content);
+	
+	if ((*env)->ExceptionCheck(env)) {
+		free(results_codes);
+		return NULL;
+	}
+	
+	if (codes != NULL) {
+		(*env)->SetIntArrayRegion(env, codes, 0, total_urls, results_codes);
+	}
+	
+	free(results_codes);
+	
+	return results;
+	
+}
+
+jint Java_com_amanoteam_libunalix_LibUnalix_cleanUrlsBuffer(
+	JNIEnv *env,
+	const jobject obj,
+	const jobject input,
+	const jint inputSize,
+	const jobject output,
+	const jboolean ignoreReferralMarketing,
+	const jboolean ignoreRules,
+	const jboolean ignoreExceptions,
+	const jboolean ignoreRawRules,
+	const jboolean ignoreRedirections,
+	const jboolean stripEmpty,
+	const jboolean stripDuplicates
+) {
+	/*
+	Cleans the newline-separated URLs in the first "inputSize" bytes of the direct buffer "input",
+	writing the results to the direct buffer "output" in the same format, and returns the number
+	of bytes written. Each input line yields exactly one output line, which is left empty for URLs
+	that could not be cleaned. No Java object is created at all, regardless of the number of URLs.
+	*/
+	
+	(void) obj;
+	
+	const char* const source = (const char*) (*env)->GetDirectBufferAddress(env, input);
+	char* const destination = (char*) (*env)->GetDirectBufferAddress(env, output);
+	
+	const jlong source_capacity = (*env)->GetDirectBufferCapacity(env, input);
+	const jlong destination_capacity = (*env)->GetDirectBufferCapacity(env, output);
+	
+	if (source == NULL || destination == NULL || inputSize < 0 || inputSize > source_capacity) {
+		throw_exception(env, UNALIXERR_ARG_INVALID);
+		return 0;
+	}
+	
+	const size_t source_size = (size_t) inputSize;
+	// The number of bytes written must fit in the return value
+	const size_t destination_size = (destination_capacity > INT32_MAX) ? INT32_MAX : (size_t) destination_capacity;
+	
+	size_t source_offset = 0;
+	size_t destination_offset = 0;
+	
+	struct URLBuffer buffer = {0};
+	
+	int code = UNALIXERR_SUCCESS;
+	
+	while (source_offset < source_size) {
+		const char* const start = source + source_offset;
+		const char* const end = (const char*) memchr(start, '\n', source_size - source_offset);
+		
+		const size_t size = (end == NULL) ? source_size - source_offset : (size_t) (end - start);
+		
+		source_offset += size + (end != NULL);
+		
+		code = url_buffer_reserve(&buffer, size + 1);
+		
+		if (code != UNALIXERR_SUCCESS) {
+			break;
+		}
+		
+		memcpy(buffer.content, start, size);
+		buffer.content[size] = '\0';
+		
+		char* target_url = NULL;
+		
+		const int clean_code = unalix_clean_url(
+			buffer.content,
+			&target_url,
+			ignoreReferralMarketing,
+			ignoreRules,
+			ignoreExceptions,
+			ignoreRawRules,
+			ignoreRedirections,
+			stripEmpty,
+			stripDuplicates
 		);
+		
+		const size_t target_url_size = (clean_code == UNALIXERR_SUCCESS) ? strlen(target_url) : 0;
+		
+		if (destination_offset + target_url_size + 1 > destination_size) {
+			free(target_url);
+			
+			code = UNALIXERR_BUFFER_TOO_SMALL;
+			break;
+		}
+		
+		if (target_url_size > 0) {
+			memcpy(destination + destination_offset, target_url, target_url_size);
+			destination_offset += target_url_size;
+		}
+		
+		destination[destination_offset++] = '\n';
+		
+		free(target_url);
+	}
+	
+	free(buffer.content);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		throw_exception(env, code);
+		return 0;
+	}
+	
+	return (jint) destination_offset;
+	
+}
+
+static jobject new_exception(JNIEnv* env, const int code) {
+	
+	const enum Exception exception = get_exception(code);
+	
+	if (exception_classes[exception] == NULL || exception_constructors[exception] == NULL) {
+		return NULL;
+	}
+	
+	const jstring message = (*env)->NewStringUTF(env, unalix_strerror(code));
+	
+	if (message == NULL) {
+		return NULL;
+	}
+	
+	const jobject object = (*env)->NewObject(env, exception_classes[exception], exception_constructors[exception], message);
+	(*env)->DeleteLocalRef(env, message);
+	
+	return object;
+	
+}
+
+static void unshort_callback(const unsigned long long id, const int code, const char* const target_url, void* userdata) {
+	/*
+	Runs on the worker thread that completed the job, which is already attached to the JVM. The
+	exception is a job cancelled before it started, which is reported on the cancelling thread.
+	*/
+	
+	const jobject callback = (jobject) userdata;
+	
+	JNIEnv* env = NULL;
+	int attached = 0;
+	
+	if ((*java_vm)->GetEnv(java_vm, (void**) &env, JNI_VERSION_1_6) != JNI_OK) {
+		if (attach_thread(&env, 0) != JNI_OK) {
+			return;
+		}
+		
+		attached = 1;
+	}
+	
+	if (code == UNALIXERR_SUCCESS) {
+		const jstring string = (*env)->NewStringUTF(env, target_url);
+		
+		if (string != NULL) {
+			(*env)->CallVoidMethod(env, callback, unshort_on_success, (jlong) id, string);
+			(*env)->DeleteLocalRef(env, string);
+		}
+	} else {
+		const jobject exception = new_exception(env, code);
+		
+		if (exception != NULL) {
+			(*env)->CallVoidMethod(env, callback, unshort_on_failure, (jlong) id, exception);
+			(*env)->DeleteLocalRef(env, exception);
+		}
+	}
+	
+	// Nobody on this thread could handle whatever the callback threw
+	if ((*env)->ExceptionCheck(env)) {
+		(*env)->ExceptionDescribe(env);
+		(*env)->ExceptionClear(env);
 	}
 	
+	(*env)->DeleteGlobalRef(env, callback);
+	
+	if (attached) {
+		(*java_vm)->DetachCurrentThread(java_vm);
+	}
+	
+}
+
+jlong Java_com_amanoteam_libunalix_LibUnalix_unshortUrlAsync(
+	JNIEnv *env,
+	const jobject obj,
+	const jstring url,
+	const jboolean ignoreReferralMarketing,
+	const jboolean ignoreRules,
+	const jboolean ignoreExceptions,
+	const jboolean ignoreRawRules,
+	const jboolean ignoreRedirections,
+	const jboolean stripEmpty,
+	const jboolean stripDuplicates,
+	const jstring userAgent,
+	const jint timeout,
+	const jobject callback
+) {
+	/*
+	Queues the URL to be unshortened by one of the native worker threads, returning the ID of the
+	job. The result is delivered to callback.onSuccess() or callback.onFailure() on that thread.
+	*/
+	
+	(void) obj;
+	
+	if (java_vm == NULL || unshort_on_success == NULL || callback == NULL) {
+		throw_exception(env, UNALIXERR_ARG_INVALID);
+		return 0;
+	}
+	
+	const jobject reference = (*env)->NewGlobalRef(env, callback);
+	
+	if (reference == NULL) {
+		return 0;
+	}
+	
+	const char* const curl = (*env)->GetStringUTFChars(env, url, NULL);
+	const char* const cuserAgent = (userAgent == NULL) ? NULL : (*env)->GetStringUTFChars(env, userAgent, NULL);
+	
+	unsigned long long id = 0;
+	
+	const int code = unalix_unshort_url_async(
+		curl,
+		ignoreReferralMarketing,
+		ignoreRules,
+		ignoreExceptions,
+		ignoreRawRules,
+		ignoreRedirections,
+		stripEmpty,
+		stripDuplicates,
+		cuserAgent,
+		timeout,
+		unshort_callback,
+		reference,
+		&id
+	);
+	
+	(*env)->ReleaseStringUTFChars(env, url, curl);
+	
+	if (cuserAgent != NULL) {
+		(*env)->ReleaseStringUTFChars(env, userAgent, cuserAgent);
+	}
+	
+	if (code != UNALIXERR_SUCCESS) {
+		(*env)->DeleteGlobalRef(env, reference);
+		throw_exception(env, code);
+		
+		return 0;
+	}
+	
+	return (jlong) id;
+	
+}
+
+jboolean Java_com_amanoteam_libunalix_LibUnalix_cancelUnshort(
+	JNIEnv *env,
+	const jobject obj,
+	const jlong id
+) {
+	
+	(void) env;
+	(void) obj;
+	
+	return (jboolean) (unalix_unshort_cancel((unsigned long long) id) == UNALIXERR_SUCCESS);
+	
+}
+
+void Java_com_amanoteam_libunalix_LibUnalix_configureAsync(
+	JNIEnv *env,
+	const jobject obj,
+	const jint maxThreads
+) {
+	
+	(void) obj;
+	
+	if (maxThreads < 0) {
+		throw_exception(env, UNALIXERR_ARG_INVALID);
+		return;
+	}
+	
+	unalix_unshort_async_configure((size_t) maxThreads, worker_attach, worker_detach, NULL);
+	
 }
\ No newline at end of file
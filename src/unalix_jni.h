@@ -29,6 +29,35 @@ JNIEXPORT jstring JNICALL Java_com_amanoteam_libunalix_LibUnalix_cleanUrl(
 	const jboolean stripDuplicates
 );
 
+JNIEXPORT jobjectArray JNICALL Java_com_amanoteam_libunalix_LibUnalix_cleanUrls(
+	JNIEnv *env,
+	const jobject obj,
+	const jobjectArray urls,
+	const jintArray codes,
+	const jboolean ignoreReferralMarketing,
+	const jboolean ignoreRules,
+	const jboolean ignoreExceptions,
+	const jboolean ignoreRawRules,
+	const jboolean ignoreRedirections,
+	const jboolean stripEmpty,
+	const jboolean stripDuplicates
+);
+
+JNIEXPORT jint JNICALL Java_com_amanoteam_libunalix_LibUnalix_cleanUrlsBuffer(
+	JNIEnv *env,
+	const jobject obj,
+	const jobject input,
+	const jint inputSize,
+	const jobject output,
+	const jboolean ignoreReferralMarketing,
+	const jboolean ignoreRules,
+	const jboolean ignoreExceptions,
+	const jboolean ignoreRawRules,
+	const jboolean ignoreRedirections,
+	const jboolean stripEmpty,
+	const jboolean stripDuplicates
+);
+
 JNIEXPORT jstring JNICALL Java_com_amanoteam_libunalix_LibUnalix_unshortUrl(
 	JNIEnv *env,
 	const jobject obj,
@@ -44,6 +73,34 @@ JNIEXPORT jstring JNICALL Java_com_amanoteam_libunalix_LibUnalix_unshortUrl(
 	const jint timeout
 );
 
+JNIEXPORT jlong JNICALL Java_com_amanoteam_libunalix_LibUnalix_unshortUrlAsync(
+	JNIEnv *env,
+	const jobject obj,
+	const jstring url,
+	const jboolean ignoreReferralMarketing,
+	const jboolean ignoreRules,
+	const jboolean ignoreExceptions,
+	const jboolean ignoreRawRules,
+	const jboolean ignoreRedirections,
+	const jboolean stripEmpty,
+	const jboolean stripDuplicates,
+	const jstring userAgent,
+	const jint timeout,
+	const jobject callback
+);
+
+JNIEXPORT jboolean JNICALL Java_com_amanoteam_libunalix_LibUnalix_cancelUnshort(
+	JNIEnv *env,
+	const jobject obj,
+	const jlong id
+);
+
+JNIEXPORT void JNICALL Java_com_amanoteam_libunalix_LibUnalix_configureAsync(
+	JNIEnv *env,
+	const jobject obj,
+	const jint maxThreads
+);
+
 JNIEXPORT void JNICALL Java_com_amanoteam_libunalix_LibUnalix_loadFile(
 	JNIEnv *env,
 	const jobject obj,
@@ -0,0 +1,285 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "unshort_async.h"
+#include "worker_pool.h"
+#include "threads.h"
+#include "errors.h"
+
+static const size_t UNSHORT_ASYNC_DEFAULT_THREADS = 4;
+
+struct UnshortJob {
+	struct WorkerTask task;
+	unsigned long long id;
+	char* source_url;
+	char* user_agent;
+	int ignore_referral_marketing;
+	int ignore_rules;
+	int ignore_exceptions;
+	int ignore_raw_rules;
+	int ignore_redirections;
+	int strip_empty;
+	int strip_duplicates;
+	int timeout;
+	unalix_unshort_callback_t callback;
+	void* userdata;
+	int cancelled;
+	struct UnshortJob* next;
+};
+
+static struct WorkerPool pool = WORKER_POOL_INITIALIZER;
+
+// Jobs submitted and not yet completed, so that they can be found by their ID
+static struct Mutex jobs_mutex = MUTEX_INITIALIZER;
+static struct UnshortJob* jobs = NULL;
+static unsigned long long last_id = 0;
+
+static void job_free(struct UnshortJob* job) {
+	
+	free(job->source_url);
+	free(job->user_agent);
+	free(job);
+	
+}
+
+static void job_unlink(struct UnshortJob* job) {
+	/*
+	Must be called with jobs_mutex held.
+	*/
+	
+	struct UnshortJob** link = &jobs;
+	
+	while (*link != NULL && *link != job) {
+		link = &(*link)->next;
+	}
+	
+	if (*link != NULL) {
+		*link = job->next;
+	}
+	
+}
+
+static void job_run(void* argument) {
+	
+	struct UnshortJob* const job = (struct UnshortJob*) argument;
+	
+	mutex_lock(&jobs_mutex);
+	const int cancelled = job->cancelled;
+	mutex_unlock(&jobs_mutex);
+	
+	char* target_url = NULL;
+	int code = UNALIXERR_CANCELLED;
+	
+	if (!cancelled) {
+		code = unalix_unshort_url(
+			job->source_url,
+			&target_url,
+			job->ignore_referral_marketing,
+			job->ignore_rules,
+			job->ignore_exceptions,
+			job->ignore_raw_rules,
+			job->ignore_redirections,
+			job->strip_empty,
+			job->strip_duplicates,
+			job->user_agent,
+			job->timeout
+		);
+	}
+	
+	mutex_lock(&jobs_mutex);
+	
+	job_unlink(job);
+	
+	// Whatever the outcome, jobs cancelled while running are reported as such
+	if (job->cancelled && code != UNALIXERR_CANCELLED) {
+		code = UNALIXERR_CANCELLED;
+		
+		free(target_url);
+		target_url = NULL;
+	}
+	
+	mutex_unlock(&jobs_mutex);
+	
+	job->callback(job->id, code, target_url, job->userdata);
+	
+	free(target_url);
+	job_free(job);
+	
+}
+
+static char* string_copy(const char* const source) {
+	
+	char* const destination = (char*) malloc(strlen(source) + 1);
+	
+	if (destination != NULL) {
+		strcpy(destination, source);
+	}
+	
+	return destination;
+	
+}
+
+int unalix_unshort_async_configure(
+	const size_t max_threads,
+	const unalix_thread_hook_t thread_start,
+	const unalix_thread_hook_t thread_stop,
+	void* userdata
+) {
+	/*
+	Sets how many worker threads may run unshort jobs at once (0 restores the default), and the
+	hooks each of them runs when it starts and right before it exits. Jobs already submitted are
+	completed first.
+	*/
+	
+	worker_pool_stop(&pool);
+	
+	mutex_lock(&pool.mutex);
+	
+	pool.max_threads = max_threads;
+	pool.thread_start = thread_start;
+	pool.thread_stop = thread_stop;
+	pool.userdata = userdata;
+	
+	mutex_unlock(&pool.mutex);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int unalix_unshort_url_async(
+	const char* const source_url,
+	const int ignore_referral_marketing,
+	const int ignore_rules,
+	const int ignore_exceptions,
+	const int ignore_raw_rules,
+	const int ignore_redirections,
+	const int strip_empty,
+	const int strip_duplicates,
+	const char* const user_agent,
+	const int timeout,
+	const unalix_unshort_callback_t callback,
+	void* userdata,
+	unsigned long long* id
+) {
+	/*
+	Queues the URL to be unshortened by one of the worker threads. Once done, the callback is
+	called exactly once on that thread, with the ID stored in "id", the result code and the
+	resulting URL (which is only valid during the call). Jobs cancelled before they started are
+	reported on the thread that cancelled them instead.
+	*/
+	
+	if (source_url == NULL || *source_url == '\0' || callback == NULL) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	struct UnshortJob* const job = (struct UnshortJob*) malloc(sizeof(*job));
+	
+	if (job == NULL) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	memset(job, 0, sizeof(*job));
+	
+	job->source_url = string_copy(source_url);
+	job->user_agent = (user_agent == NULL) ? NULL : string_copy(user_agent);
+	
+	if (job->source_url == NULL || (user_agent != NULL && job->user_agent == NULL)) {
+		job_free(job);
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	job->task.routine = job_run;
+	job->task.argument = job;
+	job->ignore_referral_marketing = ignore_referral_marketing;
+	job->ignore_rules = ignore_rules;
+	job->ignore_exceptions = ignore_exceptions;
+	job->ignore_raw_rules = ignore_raw_rules;
+	job->ignore_redirections = ignore_redirections;
+	job->strip_empty = strip_empty;
+	job->strip_duplicates = strip_duplicates;
+	job->timeout = timeout;
+	job->callback = callback;
+	job->userdata = userdata;
+	
+	mutex_lock(&jobs_mutex);
+	
+	job->id = ++last_id;
+	job->next = jobs;
+	jobs = job;
+	
+	if (id != NULL) {
+		*id = job->id;
+	}
+	
+	mutex_unlock(&jobs_mutex);
+	
+	mutex_lock(&pool.mutex);
+	
+	if (pool.max_threads == 0) {
+		pool.max_threads = UNSHORT_ASYNC_DEFAULT_THREADS;
+	}
+	
+	mutex_unlock(&pool.mutex);
+	
+	const int code = worker_pool_submit(&pool, &job->task);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		mutex_lock(&jobs_mutex);
+		job_unlink(job);
+		mutex_unlock(&jobs_mutex);
+		
+		job_free(job);
+		
+		return code;
+	}
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int unalix_unshort_cancel(const unsigned long long id) {
+	/*
+	Cancels the job, which is then reported with UNALIXERR_CANCELLED. A job that has not started
+	yet is reported right away, before this returns; one already running is reported once the
+	request in progress ends. Returns UNALIXERR_ARG_INVALID if no such job is pending.
+	*/
+	
+	mutex_lock(&jobs_mutex);
+	
+	struct UnshortJob* job = jobs;
+	
+	while (job != NULL && job->id != id) {
+		job = job->next;
+	}
+	
+	if (job == NULL || job->cancelled) {
+		mutex_unlock(&jobs_mutex);
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	job->cancelled = 1;
+	
+	if (!worker_pool_remove(&pool, &job->task)) {
+		mutex_unlock(&jobs_mutex);
+		return UNALIXERR_SUCCESS;
+	}
+	
+	job_unlink(job);
+	
+	mutex_unlock(&jobs_mutex);
+	
+	job->callback(job->id, UNALIXERR_CANCELLED, NULL, job->userdata);
+	job_free(job);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+void unalix_unshort_async_stop(void) {
+	/*
+	Waits for every submitted job to complete and for the worker threads to exit.
+	*/
+	
+	worker_pool_stop(&pool);
+	
+}
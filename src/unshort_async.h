@@ -0,0 +1,34 @@
+#ifndef UNSHORT_ASYNC_H_INCLUDED
+#define UNSHORT_ASYNC_H_INCLUDED
+
+#include <stddef.h>
+
+#include "unalix.h"
+
+int unalix_unshort_async_configure(
+	const size_t max_threads,
+	const unalix_thread_hook_t thread_start,
+	const unalix_thread_hook_t thread_stop,
+	void* userdata
+);
+
+int unalix_unshort_url_async(
+	const char* const source_url,
+	const int ignore_referral_marketing,
+	const int ignore_rules,
+	const int ignore_exceptions,
+	const int ignore_raw_rules,
+	const int ignore_redirections,
+	const int strip_empty,
+	const int strip_duplicates,
+	const char* const user_agent,
+	const int timeout,
+	const unalix_unshort_callback_t callback,
+	void* userdata,
+	unsigned long long* id
+);
+
+int unalix_unshort_cancel(const unsigned long long id);
+void unalix_unshort_async_stop(void);
+
+#endif
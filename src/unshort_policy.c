@@ -0,0 +1,307 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "unalix.h"
+#include "unshort_policy.h"
+#include "threads.h"
+#include "errors.h"
+#include "utils.h"
+
+/*
+Decides whether a URL needs to be probed over the network at all while following a redirect chain.
+
+Two independent policies exist, both disabled by default:
+
+- A list of known shortener/redirector hosts. Only URLs on those hosts (or their subdomains) are
+  probed; anything else is taken as the final destination.
+- A learned table of hosts that answered a probe without redirecting. They are not probed again
+  until the entry expires, and are forgotten as soon as they are seen redirecting.
+*/
+
+struct UnshortPolicy {
+	struct Mutex mutex;
+	char** shorteners; // Open addressing hash table of lowercase hostnames
+	size_t total_shorteners;
+	struct FinalHost* final_hosts;
+	size_t total_final_hosts;
+	int ttl;
+};
+
+static struct UnshortPolicy policy = {
+	.mutex = MUTEX_INITIALIZER
+};
+
+static int url_get_host(const char* const url, const char** host, size_t* host_size) {
+	/*
+	Locates the host of an absolute URL without parsing or copying anything.
+	*/
+	
+	const char* start = strstr(url, "://");
+	
+	if (start == NULL) {
+		return 0;
+	}
+	
+	start += 3;
+	
+	const char* const authority_end = start + strcspn(start, "/?#");
+	
+	// Skip the userinfo, if any
+	for (const char* ch = authority_end - 1; ch >= start; ch--) {
+		if (*ch == '@') {
+			start = ch + 1;
+			break;
+		}
+	}
+	
+	const char* end = authority_end;
+	
+	if (*start == '[') {
+		const char* const bracket = memchr(start, ']', (size_t) (authority_end - start));
+		
+		if (bracket == NULL) {
+			return 0;
+		}
+		
+		end = bracket + 1;
+	} else {
+		const char* const colon = memchr(start, ':', (size_t) (authority_end - start));
+		
+		if (colon != NULL) {
+			end = colon;
+		}
+	}
+	
+	// A trailing dot does not make a different host
+	if (end > start && *(end - 1) == '.') {
+		end--;
+	}
+	
+	if (end == start || (size_t) (end - start) >= UNSHORT_POLICY_MAX_HOST_SIZE) {
+		return 0;
+	}
+	
+	*host = start;
+	*host_size = (size_t) (end - start);
+	
+	return 1;
+	
+}
+
+static int shorteners_contains(const char* const host, const size_t host_size) {
+	/*
+	Checks whether host, or any of its parent domains, is a known shortener. Must be called with
+	the policy lock held.
+	*/
+	
+	const char* suffix = host;
+	
+	while (1) {
+		const size_t suffix_size = host_size - (size_t) (suffix - host);
+		const size_t index = hash_string(suffix, suffix_size);
+		
+		for (size_t offset = 0; offset < policy.total_shorteners; offset++) {
+			const char* const item = policy.shorteners[(index + offset) % policy.total_shorteners];
+			
+			if (item == NULL) {
+				break;
+			}
+			
+			if (strlen(item) == suffix_size && strncasecmp(item, suffix, suffix_size) == 0) {
+				return 1;
+			}
+		}
+		
+		const char* const dot = memchr(suffix, '.', suffix_size);
+		
+		if (dot == NULL) {
+			return 0;
+		}
+		
+		suffix = dot + 1;
+	}
+	
+}
+
+static struct FinalHost* final_hosts_find(const char* const host, const size_t host_size, const int insert) {
+	/*
+	Returns the slot holding host, or (when inserting) the slot it should be stored in. Must be
+	called with the policy lock held.
+	*/
+	
+	const size_t index = hash_string(host, host_size) % policy.total_final_hosts;
+	
+	struct FinalHost* victim = NULL;
+	
+	for (size_t probe = 0; probe < UNSHORT_POLICY_MAX_PROBES && probe < policy.total_final_hosts; probe++) {
+		struct FinalHost* const item = &policy.final_hosts[(index + probe) % policy.total_final_hosts];
+		
+		if (strlen(item->host) == host_size && strncasecmp(item->host, host, host_size) == 0) {
+			return item;
+		}
+		
+		if (insert && (victim == NULL || item->expires < victim->expires)) {
+			victim = item;
+		}
+	}
+	
+	return victim;
+	
+}
+
+int unshort_policy_should_probe(const char* const url) {
+	
+	const char* host = NULL;
+	size_t host_size = 0;
+	
+	int probe = 1;
+	
+	mutex_lock(&policy.mutex);
+	
+	if ((policy.total_shorteners > 0 || policy.total_final_hosts > 0) && url_get_host(url, &host, &host_size)) {
+		// Known shorteners are always probed; a single link of theirs says nothing about the rest
+		if (policy.total_shorteners > 0) {
+			probe = shorteners_contains(host, host_size);
+		} else if (policy.total_final_hosts > 0) {
+			const struct FinalHost* const item = final_hosts_find(host, host_size, 0);
+			probe = !(item != NULL && item->expires > get_monotonic_time());
+		}
+	}
+	
+	mutex_unlock(&policy.mutex);
+	
+	return probe;
+	
+}
+
+void unshort_policy_learn(const char* const url, const int redirects) {
+	/*
+	Records whether a probe of url led to a redirect. Known shorteners are never recorded as final hosts.
+	*/
+	
+	const char* host = NULL;
+	size_t host_size = 0;
+	
+	mutex_lock(&policy.mutex);
+	
+	if (policy.total_final_hosts > 0 && url_get_host(url, &host, &host_size)) {
+		if (redirects) {
+			struct FinalHost* const item = final_hosts_find(host, host_size, 0);
+			
+			if (item != NULL) {
+				item->expires = 0;
+			}
+		} else if (!(policy.total_shorteners > 0 && shorteners_contains(host, host_size))) {
+			struct FinalHost* const item = final_hosts_find(host, host_size, 1);
+			
+			memcpy(item->host, host, host_size);
+			item->host[host_size] = '\0';
+			item->expires = get_monotonic_time() + (unsigned long long) policy.ttl * 1000;
+		}
+	}
+	
+	mutex_unlock(&policy.mutex);
+	
+}
+
+static void shorteners_free(char** shorteners, const size_t total_shorteners) {
+	
+	if (shorteners == NULL) {
+		return;
+	}
+	
+	for (size_t index = 0; index < total_shorteners; index++) {
+		free(shorteners[index]);
+	}
+	
+	free(shorteners);
+	
+}
+
+int unalix_unshort_policy_set_hosts(const char* const* hosts, const size_t total_hosts) {
+	
+	if (total_hosts > 0 && hosts == NULL) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	char** shorteners = NULL;
+	
+	// Keep the table at most half full
+	const size_t total_shorteners = total_hosts * 2;
+	
+	if (total_shorteners > 0) {
+		shorteners = (char**) calloc(total_shorteners, sizeof(*shorteners));
+		
+		if (shorteners == NULL) {
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+	}
+	
+	for (size_t index = 0; index < total_hosts; index++) {
+		const char* const host = hosts[index];
+		const size_t host_size = (host == NULL) ? 0 : strlen(host);
+		
+		if (host_size == 0 || host_size >= UNSHORT_POLICY_MAX_HOST_SIZE) {
+			shorteners_free(shorteners, total_shorteners);
+			return UNALIXERR_ARG_INVALID;
+		}
+		
+		size_t slot = hash_string(host, host_size) % total_shorteners;
+		
+		while (shorteners[slot] != NULL) {
+			slot = (slot + 1) % total_shorteners;
+		}
+		
+		shorteners[slot] = (char*) malloc(host_size + 1);
+		
+		if (shorteners[slot] == NULL) {
+			shorteners_free(shorteners, total_shorteners);
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+		
+		strcpy(shorteners[slot], host);
+	}
+	
+	mutex_lock(&policy.mutex);
+	
+	shorteners_free(policy.shorteners, policy.total_shorteners);
+	
+	policy.shorteners = shorteners;
+	policy.total_shorteners = total_shorteners;
+	
+	mutex_unlock(&policy.mutex);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int unalix_unshort_policy_learn(const size_t max_hosts, const int ttl) {
+	
+	if (ttl < 0) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	struct FinalHost* final_hosts = NULL;
+	
+	if (max_hosts > 0 && ttl > 0) {
+		final_hosts = (struct FinalHost*) calloc(max_hosts, sizeof(*final_hosts));
+		
+		if (final_hosts == NULL) {
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+	}
+	
+	mutex_lock(&policy.mutex);
+	
+	free(policy.final_hosts);
+	
+	policy.final_hosts = final_hosts;
+	policy.total_final_hosts = (final_hosts == NULL) ? 0 : max_hosts;
+	policy.ttl = ttl;
+	
+	mutex_unlock(&policy.mutex);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
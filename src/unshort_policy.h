@@ -0,0 +1,19 @@
+#ifndef UNSHORT_POLICY_H_INCLUDED
+#define UNSHORT_POLICY_H_INCLUDED
+
+#include <stddef.h>
+
+// Number of consecutive slots a host may live in
+static const size_t UNSHORT_POLICY_MAX_PROBES = 4;
+
+#define UNSHORT_POLICY_MAX_HOST_SIZE 256
+
+struct FinalHost {
+	char host[UNSHORT_POLICY_MAX_HOST_SIZE];
+	unsigned long long expires; // Monotonic time (in milliseconds)
+};
+
+int unshort_policy_should_probe(const char* const url);
+void unshort_policy_learn(const char* const url, const int redirects);
+
+#endif
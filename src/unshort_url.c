@@ -1,130 +1,375 @@
-#include "clean_url.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "unalix.h"
 #include "http.h"
 #include "errors.h"
 #include "utils.h"
+#include "threads.h"
+#include "url_cache.h"
 #include "ruleset.h"
+#include "singleflight.h"
+#include "unshort_policy.h"
+#include "metrics.h"
 
-int unalix_unshort_url(
-	const char* const source_url,
-	char** target_url,
-	const int ignore_referral_marketing,
-	const int ignore_rules,
-	const int ignore_exceptions,
-	const int ignore_raw_rules,
-	const int ignore_redirections,
-	const int strip_empty,
-	const int strip_duplicates,
+#define HEAD_FALLBACK_MAX_HOSTS 256
+
+static int use_head = 0;
+
+// Hosts known to mishandle HEAD requests; these are always probed with GET
+static size_t head_fallback_hosts[HEAD_FALLBACK_MAX_HOSTS] = {0};
+static size_t head_fallback_offset = 0;
+
+static struct Mutex head_fallback_mutex = MUTEX_INITIALIZER;
+
+static struct FlightGroup chain_flights = FLIGHT_GROUP_INITIALIZER;
+static struct FlightGroup hop_flights = FLIGHT_GROUP_INITIALIZER;
+
+static int head_fallback_contains(const size_t hash) {
+	
+	int found = 0;
+	
+	mutex_lock(&head_fallback_mutex);
+	
+	for (size_t index = 0; index < HEAD_FALLBACK_MAX_HOSTS; index++) {
+		if (head_fallback_hosts[index] == hash) {
+			found = 1;
+			break;
+		}
+	}
+	
+	mutex_unlock(&head_fallback_mutex);
+	
+	return found;
+	
+}
+
+static void head_fallback_add(const size_t hash) {
+	
+	mutex_lock(&head_fallback_mutex);
+	
+	head_fallback_hosts[head_fallback_offset] = hash;
+	head_fallback_offset = (head_fallback_offset + 1) % HEAD_FALLBACK_MAX_HOSTS;
+	
+	mutex_unlock(&head_fallback_mutex);
+	
+}
+
+void unalix_unshort_use_head(const int enabled) {
+	use_head = enabled;
+}
+
+static int unshort_hop(
+	const char* const url,
+	const enum HTTPMethod method,
 	const char* const user_agent,
-	const int timeout
+	const unsigned long long deadline,
+	char** location
 ) {
+	/*
+	Probes a single hop of the redirect chain. Only the status line and headers are read; the body
+	is never buffered, whatever the status code.
+	*/
 	
-	if (source_url == NULL || *source_url == '\0' || target_url == NULL) {
-		return UNALIXERR_ARG_INVALID;
+	struct HTTPContext context = {
+		.request = {
+			.version = HTTP10,
+			.method = method,
+			.probe = 1
+		},
+		.connection = {
+			.deadline = deadline
+		}
+	};
+	
+	int code = http_request_add_static_header(&context, HTTP_HEADER_ACCEPT, "*/*");
+	
+	if (code != UNALIXERR_SUCCESS) {
+		http_context_free(&context);
+		
+		return code;
 	}
 	
-	int total_redirects = 0;
+	const char* const ua = (user_agent == NULL || *user_agent == '\0') ? HTTP_DEFAULT_USER_AGENT : user_agent;
+	
+	code = http_request_add_static_header(&context, HTTP_HEADER_USER_AGENT, ua);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		http_context_free(&context);
+		
+		return code;
+	}
+	
+	code = http_request_set_url(&context, url);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		http_context_free(&context);
+		
+		return code;
+	}
+	
+	const size_t hash = hash_string(context.request.uri.hostname, strlen(context.request.uri.hostname));
+	
+	if (method == HEAD && head_fallback_contains(hash)) {
+		http_context_free(&context);
+		
+		return unshort_hop(url, GET, user_agent, deadline, location);
+	}
+	
+	code = http_request_send(&context);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		http_context_free(&context);
+		
+		return code;
+	}
+	
+	// Servers that reject HEAD (or answer it differently from GET) are remembered and retried with GET
+	if (method == HEAD && context.response.status.code >= BAD_REQUEST) {
+		http_context_free(&context);
+		head_fallback_add(hash);
+		
+		return unshort_hop(url, GET, user_agent, deadline, location);
+	}
+	
+	char* redirect = NULL;
+	
+	code = http_get_redirect(&context, &redirect);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		http_context_free(&context);
+		
+		return code;
+	}
+	
+	/*
+	Only a redirect or a successful answer says anything about the host. Errors may be transient, or
+	specific to this one link (an expired short URL, for instance).
+	*/
+	const enum HTTPStatusCode status = context.response.status.code;
+	
+	if (redirect != NULL || (status >= OK && status < MULTIPLE_CHOICES)) {
+		unshort_policy_learn(url, redirect != NULL);
+	}
+	
+	http_context_free(&context);
+	
+	*location = redirect;
+	
+	return code;
+	
+}
+
+struct UnshortHop {
+	const char* url;
+	enum HTTPMethod method;
+	const char* user_agent;
+	unsigned long long deadline;
+};
+
+static int unshort_hop_call(void* userdata, char** location) {
+	
+	const struct UnshortHop* const hop = (const struct UnshortHop*) userdata;
+	
+	return unshort_hop(hop->url, hop->method, hop->user_agent, hop->deadline, location);
+	
+}
+
+struct UnshortChain {
+	const char* url;
+	uint32_t options;
+	const char* user_agent;
+	unsigned long long deadline;
+};
+
+static int unshort_chain(void* userdata, char** result) {
+	/*
+	Follows the redirect chain starting at chain->url (which is already clean) and stores the final
+	URL in result. The last URL reached is stored there even if following the chain failed.
+	*/
+	
+	const struct UnshortChain* const chain = (const struct UnshortChain*) userdata;
+	const uint32_t options = chain->options;
+	
+	char* url = (char*) malloc(strlen(chain->url) + 1);
+	
+	if (url == NULL) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	strcpy(url, chain->url);
+	
+	int code = UNALIXERR_SUCCESS;
+	
+	char* hops[HTTP_DEFAULT_MAX_REDIRECTS + 1];
+	size_t total_hops = 0;
 	
-	char* url = NULL;
 	char* location = NULL;
+	char* cached_url = NULL;
 	
 	while (1) {
-		int code = unalix_clean_url(
-			location == NULL ? source_url : location,
-			&url,
-			ignore_referral_marketing,
-			ignore_rules,
-			ignore_exceptions,
-			ignore_raw_rules,
-			ignore_redirections,
-			strip_empty,
-			strip_duplicates
-		);
+		hops[total_hops++] = url;
 		
-		if (location != NULL) {
-			free(location);
-			location = NULL;
-		}
+		// Chains sharing a tail with one resolved before stop at the first known hop
+		code = url_cache_get(url, options, &cached_url);
 		
-		if (code != UNALIXERR_SUCCESS) {
-			return code;
+		if (code != UNALIXERR_SUCCESS || cached_url != NULL) {
+			break;
 		}
 		
-		if (*target_url != NULL) {
-			free(*target_url);
-			*target_url = NULL;
+		// URLs that are not expected to redirect are taken as the final destination without asking
+		if (!unshort_policy_should_probe(url)) {
+			break;
 		}
 		
-		*target_url = url;
-		
-		struct HTTPContext context = {
-			.request = {
-				.version = HTTP10,
-				.method = GET
-			},
-			.connection = {
-				.timeout = (timeout > 0) ? timeout : HTTP_DEFAULT_TIMEOUT
-			}
+		// Chains that are being resolved concurrently share the hops they have in common
+		const struct UnshortHop hop = {
+			.url = url,
+			.method = use_head ? HEAD : GET,
+			.user_agent = chain->user_agent,
+			.deadline = chain->deadline
 		};
 		
-		code = http_request_add_header(&context, "Accept", "*/*");
+		code = singleflight_do(&hop_flights, url, chain->user_agent, (uint32_t) hop.method, chain->deadline, unshort_hop_call, (void*) &hop, &location);
 		
 		if (code != UNALIXERR_SUCCESS) {
-			http_context_free(&context);
-			
-			return code;
+			break;
 		}
 		
-		const char* const ua = (user_agent == NULL || *user_agent == '\0') ? HTTP_DEFAULT_USER_AGENT : user_agent;
-		
-		code = http_request_add_header(&context, HTTP_HEADER_USER_AGENT, ua);
-		
-		if (code != UNALIXERR_SUCCESS) {
-			http_context_free(&context);
-			
-			return code;
+		if (location == NULL) {
+			break;
 		}
 		
-		code = http_request_set_url(&context, url);
+		metrics_add(METRICS_REDIRECTS_FOLLOWED, 1);
 		
-		if (code != UNALIXERR_SUCCESS) {
-			http_context_free(&context);
+		if (total_hops > (size_t) HTTP_DEFAULT_MAX_REDIRECTS) {
+			free(location);
+			code = UNALIXERR_HTTP_TOO_MANY_REDIRECTS;
 			
-			return code;
+			break;
 		}
 		
-		code = http_request_send(&context);
+		url = NULL;
 		
-		if (code != UNALIXERR_SUCCESS) {
-			http_context_free(&context);
-			
-			return code;
-		}
+		code = unalix_clean_url(
+			location,
+			&url,
+			(options >> 0) & 1,
+			(options >> 1) & 1,
+			(options >> 2) & 1,
+			(options >> 3) & 1,
+			(options >> 4) & 1,
+			(options >> 5) & 1,
+			(options >> 6) & 1
+		);
 		
-		code = http_get_redirect(&context, &location);
+		free(location);
+		location = NULL;
 		
 		if (code != UNALIXERR_SUCCESS) {
-			http_context_free(&context);
-			
-			return code;
-		}
-		
-		http_context_free(&context);
-		
-		if (location == NULL) {
 			break;
 		}
-		
-		if (location != NULL) {
-			total_redirects++;
-			
-			if (total_redirects > HTTP_DEFAULT_MAX_REDIRECTS) {
-				return UNALIXERR_HTTP_TOO_MANY_REDIRECTS;
-			}
-			
-			continue;
+	}
+	
+	const char* const final_url = (cached_url != NULL) ? cached_url : hops[total_hops - 1];
+	
+	if (code == UNALIXERR_SUCCESS) {
+		for (size_t index = 0; index < total_hops - (cached_url != NULL); index++) {
+			url_cache_put(hops[index], options, final_url);
 		}
 	}
 	
-	return UNALIXERR_SUCCESS;
+	*result = (char*) final_url;
+	
+	for (size_t index = 0; index < total_hops; index++) {
+		if (hops[index] != final_url) {
+			free(hops[index]);
+		}
+	}
+	
+	return code;
+	
+}
+
+int unalix_unshort_url(
+	const char* const source_url,
+	char** target_url,
+	const int ignore_referral_marketing,
+	const int ignore_rules,
+	const int ignore_exceptions,
+	const int ignore_raw_rules,
+	const int ignore_redirections,
+	const int strip_empty,
+	const int strip_duplicates,
+	const char* const user_agent,
+	const int timeout
+) {
+	
+	if (source_url == NULL || *source_url == '\0' || target_url == NULL) {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	const unsigned long long start = metrics_is_enabled() ? get_monotonic_time_us() : 0;
+	
+	char* url = NULL;
+	
+	int code = unalix_clean_url(
+		source_url,
+		&url,
+		ignore_referral_marketing,
+		ignore_rules,
+		ignore_exceptions,
+		ignore_raw_rules,
+		ignore_redirections,
+		strip_empty,
+		strip_duplicates
+	);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		return code;
+	}
+	
+	// The final URL depends on how each hop was cleaned
+	const uint32_t options = (
+		(!!ignore_referral_marketing << 0) | (!!ignore_rules << 1) | (!!ignore_exceptions << 2) | (!!ignore_raw_rules << 3) |
+		(!!ignore_redirections << 4) | (!!strip_empty << 5) | (!!strip_duplicates << 6)
+	);
+	
+	// The timeout covers the whole redirect chain, not each hop or socket operation
+	const unsigned long long deadline = get_monotonic_time() + (unsigned long long) ((timeout > 0) ? timeout : HTTP_DEFAULT_TIMEOUT) * 1000;
+	
+	const struct UnshortChain chain = {
+		.url = url,
+		.options = options,
+		.user_agent = user_agent,
+		.deadline = deadline
+	};
+	
+	char* final_url = NULL;
+	
+	// Concurrent calls for the same (cleaned) URL wait for the first one instead of repeating it
+	code = singleflight_do(&chain_flights, url, user_agent, options, deadline, unshort_chain, (void*) &chain, &final_url);
+	
+	free(url);
+	
+	if (start > 0) {
+		const unsigned long long now = get_monotonic_time_us();
+		
+		metrics_add(METRICS_UNSHORTS, 1);
+		metrics_add(METRICS_UNSHORTS_FAILED, code != UNALIXERR_SUCCESS);
+		metrics_record_phase(UNALIX_PHASE_UNSHORT, (now > start) ? now - start : 1);
+	}
+	
+	if (final_url == NULL) {
+		return code;
+	}
+	
+	if (*target_url != NULL) {
+		free(*target_url);
+	}
+	
+	*target_url = final_url;
+	
+	return code;
 	
 }
@@ -0,0 +1,421 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+	#ifdef _WIN32_WINNT
+		#undef _WIN32_WINNT
+	#endif
+	
+	#define _WIN32_WINNT 0x0600
+	
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <sys/file.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#include "unalix.h"
+#include "url_cache.h"
+#include "threads.h"
+#include "errors.h"
+#include "utils.h"
+
+/*
+A persistent cache of short URL -> final URL mappings, stored as a fixed-size open addressing
+hash table in a memory-mapped file.
+
+Any number of processes can map the same file. Readers never take the file lock; each slot carries a
+sequence counter that writers make odd while they are modifying the slot, so a reader that raced
+with a writer simply treats the lookup as a miss. Writers serialize among themselves with an
+exclusive file lock (plus a mutex for threads of the same process).
+
+Within a process, lookups and stores only share a read lock on the mapping, which is taken exclusively
+just to map or unmap the file. Lookups thus neither wait for each other nor for a writer stuck behind
+another process's file lock.
+*/
+
+struct URLCache {
+	#ifdef _WIN32
+		HANDLE file;
+		HANDLE mapping;
+	#else
+		int fd;
+	#endif
+	void* map;
+	size_t map_size;
+	int writable;
+	int ttl;
+	struct URLCacheSlot* slots;
+	size_t total_slots;
+};
+
+static struct URLCache cache = {0};
+static struct RWLock cache_lock = RWLOCK_INITIALIZER;
+static struct Mutex writer_mutex = MUTEX_INITIALIZER;
+
+static void file_lock(void) {
+	
+	#ifdef _WIN32
+		OVERLAPPED overlapped = {0};
+		LockFileEx(cache.file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped);
+	#else
+		while (flock(cache.fd, LOCK_EX) != 0);
+	#endif
+	
+}
+
+static void file_unlock(void) {
+	
+	#ifdef _WIN32
+		OVERLAPPED overlapped = {0};
+		UnlockFileEx(cache.file, 0, MAXDWORD, MAXDWORD, &overlapped);
+	#else
+		flock(cache.fd, LOCK_UN);
+	#endif
+	
+}
+
+static void cache_unmap(void) {
+	
+	#ifdef _WIN32
+		if (cache.map != NULL) {
+			UnmapViewOfFile(cache.map);
+		}
+		
+		if (cache.mapping != NULL) {
+			CloseHandle(cache.mapping);
+		}
+		
+		if (cache.file != NULL && cache.file != INVALID_HANDLE_VALUE) {
+			CloseHandle(cache.file);
+		}
+	#else
+		if (cache.map != NULL) {
+			munmap(cache.map, cache.map_size);
+		}
+		
+		if (cache.fd > 0) {
+			close(cache.fd);
+		}
+	#endif
+	
+	memset(&cache, 0, sizeof(cache));
+	
+}
+
+static int cache_map(const char* const filename, const size_t max_entries) {
+	/*
+	Opens (creating it if needed) and maps the cache file. Files that cannot be opened for writing
+	are mapped read-only; lookups still work, but nothing new is stored.
+	*/
+	
+	const size_t expected_size = sizeof(struct URLCacheHeader) + sizeof(struct URLCacheSlot) * max_entries;
+	
+	#ifdef _WIN32
+		cache.writable = 1;
+		cache.file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		
+		if (cache.file == INVALID_HANDLE_VALUE) {
+			cache.writable = 0;
+			cache.file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		}
+		
+		if (cache.file == INVALID_HANDLE_VALUE) {
+			return UNALIXERR_FILE_CANNOT_OPEN;
+		}
+		
+		LARGE_INTEGER file_size = {0};
+		
+		if (!GetFileSizeEx(cache.file, &file_size)) {
+			return UNALIXERR_OS_STAT_FAILURE;
+		}
+		
+		size_t size = (size_t) file_size.QuadPart;
+	#else
+		cache.writable = 1;
+		cache.fd = open(filename, O_RDWR | O_CREAT, 0644);
+		
+		if (cache.fd == -1) {
+			cache.writable = 0;
+			cache.fd = open(filename, O_RDONLY);
+		}
+		
+		if (cache.fd == -1) {
+			return UNALIXERR_FILE_CANNOT_OPEN;
+		}
+		
+		struct stat st = {0};
+		
+		if (fstat(cache.fd, &st) != 0) {
+			return UNALIXERR_OS_STAT_FAILURE;
+		}
+		
+		size_t size = (size_t) st.st_size;
+	#endif
+	
+	// A new (empty) file gets sized by whoever gets the lock first
+	if (size == 0 && cache.writable) {
+		file_lock();
+		
+		#ifdef _WIN32
+			GetFileSizeEx(cache.file, &file_size);
+			size = (size_t) file_size.QuadPart;
+		#else
+			fstat(cache.fd, &st);
+			size = (size_t) st.st_size;
+		#endif
+		
+		if (size == 0) {
+			struct URLCacheHeader header = {
+				.version = URL_CACHE_VERSION,
+				.total_slots = max_entries
+			};
+			
+			memcpy(header.magic, URL_CACHE_MAGIC, sizeof(header.magic));
+			
+			#ifdef _WIN32
+				DWORD written = 0;
+				LARGE_INTEGER end = {.QuadPart = (LONGLONG) expected_size};
+				
+				const int ok = (
+					WriteFile(cache.file, &header, sizeof(header), &written, NULL) && written == sizeof(header) &&
+					SetFilePointerEx(cache.file, end, NULL, FILE_BEGIN) && SetEndOfFile(cache.file)
+				);
+			#else
+				const int ok = (
+					ftruncate(cache.fd, (off_t) expected_size) == 0 &&
+					pwrite(cache.fd, &header, sizeof(header), 0) == sizeof(header)
+				);
+			#endif
+			
+			if (!ok) {
+				file_unlock();
+				return UNALIXERR_FILE_CANNOT_WRITE;
+			}
+			
+			size = expected_size;
+		}
+		
+		file_unlock();
+	}
+	
+	if (size < sizeof(struct URLCacheHeader)) {
+		return UNALIXERR_URL_CACHE_INVALID_FILE;
+	}
+	
+	#ifdef _WIN32
+		cache.mapping = CreateFileMappingA(cache.file, NULL, cache.writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+		
+		if (cache.mapping == NULL) {
+			return UNALIXERR_OS_MMAP_FAILURE;
+		}
+		
+		cache.map = MapViewOfFile(cache.mapping, cache.writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+		
+		if (cache.map == NULL) {
+			return UNALIXERR_OS_MMAP_FAILURE;
+		}
+	#else
+		cache.map = mmap(NULL, size, cache.writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, cache.fd, 0);
+		
+		if (cache.map == MAP_FAILED) {
+			cache.map = NULL;
+			return UNALIXERR_OS_MMAP_FAILURE;
+		}
+	#endif
+	
+	cache.map_size = size;
+	
+	// An existing file keeps its own size, regardless of what this process asked for
+	const struct URLCacheHeader* const header = (const struct URLCacheHeader*) cache.map;
+	
+	if (memcmp(header->magic, URL_CACHE_MAGIC, sizeof(header->magic)) != 0 || header->version != URL_CACHE_VERSION || header->total_slots == 0) {
+		return UNALIXERR_URL_CACHE_INVALID_FILE;
+	}
+	
+	if (size != sizeof(struct URLCacheHeader) + sizeof(struct URLCacheSlot) * header->total_slots) {
+		return UNALIXERR_URL_CACHE_INVALID_FILE;
+	}
+	
+	cache.slots = (struct URLCacheSlot*) ((char*) cache.map + sizeof(struct URLCacheHeader));
+	cache.total_slots = (size_t) header->total_slots;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int unalix_url_cache_open(const char* const filename, const size_t max_entries, const int ttl) {
+	
+	if (filename == NULL || *filename == '\0') {
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	rwlock_write_lock(&cache_lock);
+	
+	cache_unmap();
+	
+	const int code = cache_map(filename, (max_entries > 0) ? max_entries : URL_CACHE_DEFAULT_MAX_ENTRIES);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		cache_unmap();
+	} else {
+		cache.ttl = (ttl > 0) ? ttl : URL_CACHE_DEFAULT_TTL;
+	}
+	
+	rwlock_write_unlock(&cache_lock);
+	
+	return code;
+	
+}
+
+void unalix_url_cache_close(void) {
+	
+	rwlock_write_lock(&cache_lock);
+	cache_unmap();
+	rwlock_write_unlock(&cache_lock);
+	
+}
+
+static int slot_matches(const struct URLCacheSlot* const slot, const size_t hash, const uint32_t options, const char* const url, const size_t url_size) {
+	return (slot->hash == hash && slot->options == options && slot->key_size == url_size && memcmp(slot->data, url, url_size) == 0);
+}
+
+int url_cache_get(const char* const url, const uint32_t options, char** dst) {
+	
+	*dst = NULL;
+	
+	const size_t url_size = strlen(url);
+	
+	if (url_size > URL_CACHE_SLOT_DATA_SIZE) {
+		return UNALIXERR_SUCCESS;
+	}
+	
+	rwlock_read_lock(&cache_lock);
+	
+	if (cache.slots == NULL) {
+		rwlock_read_unlock(&cache_lock);
+		return UNALIXERR_SUCCESS;
+	}
+	
+	const size_t hash = hash_string(url, url_size);
+	
+	const int64_t now = (int64_t) time(NULL);
+	
+	char value[URL_CACHE_SLOT_DATA_SIZE + 1];
+	size_t value_size = 0;
+	
+	int found = 0;
+	
+	for (size_t index = 0; index < URL_CACHE_MAX_PROBES && !found; index++) {
+		struct URLCacheSlot* const slot = &cache.slots[(hash + index) % cache.total_slots];
+		
+		const uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+		
+		if ((sequence & 1) != 0 || !slot_matches(slot, hash, options, url, url_size)) {
+			continue;
+		}
+		
+		value_size = slot->value_size;
+		
+		if (slot->expires <= now || url_size + value_size > URL_CACHE_SLOT_DATA_SIZE) {
+			continue;
+		}
+		
+		memcpy(value, slot->data + url_size, value_size);
+		
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		
+		// Someone rewrote the slot while it was being copied
+		if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != sequence) {
+			continue;
+		}
+		
+		found = 1;
+	}
+	
+	rwlock_read_unlock(&cache_lock);
+	
+	if (!found) {
+		return UNALIXERR_SUCCESS;
+	}
+	
+	value[value_size] = '\0';
+	
+	*dst = (char*) malloc(value_size + 1);
+	
+	if (*dst == NULL) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	memcpy(*dst, value, value_size + 1);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+void url_cache_put(const char* const url, const uint32_t options, const char* const target_url) {
+	
+	const size_t url_size = strlen(url);
+	const size_t target_url_size = strlen(target_url);
+	
+	// Entries that don't fit a slot are just not cached
+	if (url_size + target_url_size > URL_CACHE_SLOT_DATA_SIZE) {
+		return;
+	}
+	
+	rwlock_read_lock(&cache_lock);
+	
+	if (cache.slots == NULL || !cache.writable) {
+		rwlock_read_unlock(&cache_lock);
+		return;
+	}
+	
+	const size_t hash = hash_string(url, url_size);
+	const int64_t now = (int64_t) time(NULL);
+	
+	mutex_lock(&writer_mutex);
+	file_lock();
+	
+	// Prefer the slot already holding this key, then an empty or expired one, then the oldest one
+	struct URLCacheSlot* target = NULL;
+	
+	for (size_t index = 0; index < URL_CACHE_MAX_PROBES; index++) {
+		struct URLCacheSlot* const slot = &cache.slots[(hash + index) % cache.total_slots];
+		
+		if (slot_matches(slot, hash, options, url, url_size)) {
+			target = slot;
+			break;
+		}
+		
+		if (target == NULL || (target->expires > now && slot->expires < target->expires)) {
+			target = slot;
+		}
+	}
+	
+	// A writer that died halfway leaves the sequence odd; forcing the parity keeps such slots usable
+	const uint32_t sequence = target->sequence | 1;
+	
+	__atomic_store_n(&target->sequence, sequence, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	
+	target->hash = hash;
+	target->options = options;
+	target->expires = now + cache.ttl;
+	target->key_size = (uint16_t) url_size;
+	target->value_size = (uint16_t) target_url_size;
+	
+	memcpy(target->data, url, url_size);
+	memcpy(target->data + url_size, target_url, target_url_size);
+	
+	__atomic_store_n(&target->sequence, sequence + 1, __ATOMIC_RELEASE);
+	
+	file_unlock();
+	mutex_unlock(&writer_mutex);
+	
+	rwlock_read_unlock(&cache_lock);
+	
+}
@@ -0,0 +1,38 @@
+#ifndef URL_CACHE_H_INCLUDED
+#define URL_CACHE_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const char URL_CACHE_MAGIC[] = "UNXC";
+static const uint32_t URL_CACHE_VERSION = 1;
+
+static const size_t URL_CACHE_DEFAULT_MAX_ENTRIES = 4096;
+static const int URL_CACHE_DEFAULT_TTL = 60 * 60 * 24 * 7;
+
+// Number of consecutive slots a key may live in
+static const size_t URL_CACHE_MAX_PROBES = 8;
+
+// Keeps each slot at exactly 1 KiB
+#define URL_CACHE_SLOT_DATA_SIZE 996
+
+struct URLCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t total_slots;
+};
+
+struct URLCacheSlot {
+	uint32_t sequence; // Odd while the slot is being written
+	uint32_t options;
+	uint64_t hash;
+	int64_t expires;
+	uint16_t key_size;
+	uint16_t value_size;
+	char data[URL_CACHE_SLOT_DATA_SIZE];
+};
+
+int url_cache_get(const char* const url, const uint32_t options, char** dst);
+void url_cache_put(const char* const url, const uint32_t options, const char* const target_url);
+
+#endif
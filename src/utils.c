@@ -18,6 +18,7 @@
 	#include <netdb.h>
 	#include <sys/stat.h>
 	#include <unistd.h>
+	#include <time.h>
 	
 	static const char* const ENV_TMP[] = {
 		"TMPDIR",
@@ -58,6 +59,61 @@ char to_hex(const char ch) {
 	return ch + (ch > 9 ? ('a' - 10) : '0');
 }
 
+unsigned long long get_monotonic_time(void) {
+	/*
+	Returns the number of milliseconds elapsed since some unspecified point in the past.
+	Unlike time(), the value is not affected by changes to the system clock, so it is suitable for measuring intervals and deadlines.
+	*/
+	
+	#ifdef _WIN32
+		return (unsigned long long) GetTickCount64();
+	#else
+		struct timespec ts = {0};
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		
+		return (unsigned long long) ts.tv_sec * 1000 + (unsigned long long) ts.tv_nsec / 1000000;
+	#endif
+	
+}
+
+unsigned long long get_monotonic_time_us(void) {
+	/*
+	Same as get_monotonic_time(), but in microseconds.
+	*/
+	
+	#ifdef _WIN32
+		LARGE_INTEGER counter = {0};
+		LARGE_INTEGER frequency = {0};
+		
+		QueryPerformanceCounter(&counter);
+		QueryPerformanceFrequency(&frequency);
+		
+		return (unsigned long long) (counter.QuadPart / frequency.QuadPart) * 1000000 + (unsigned long long) (counter.QuadPart % frequency.QuadPart) * 1000000 / (unsigned long long) frequency.QuadPart;
+	#else
+		struct timespec ts = {0};
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		
+		return (unsigned long long) ts.tv_sec * 1000000 + (unsigned long long) ts.tv_nsec / 1000;
+	#endif
+	
+}
+
+size_t hash_string(const char* const s, const size_t slength) {
+	/*
+	Computes the 32-bit FNV-1a hash of the leading slength bytes of s, ignoring case.
+	*/
+	
+	unsigned int hash = 2166136261u;
+	
+	for (size_t index = 0; index < slength; index++) {
+		hash ^= (unsigned char) tolower((unsigned char) s[index]);
+		hash *= 16777619u;
+	}
+	
+	return (size_t) hash;
+	
+}
+
 int isnumeric(const char* const s) {
 	/*
 	Return true (1) if the string is a numeric string, false (0) otherwise.
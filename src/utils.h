@@ -7,6 +7,9 @@ int in_range(const size_t index, const size_t min, const size_t max);
 size_t countp(const char* const s, const size_t slenth, const char p);
 void httpnormpath(const char* const path, char* normalized_path);
 char to_hex(const char ch);
+unsigned long long get_monotonic_time(void);
+unsigned long long get_monotonic_time_us(void);
+size_t hash_string(const char* const s, const size_t slength);
 
 // Filesystem operations
 time_t get_last_modification_time(const char* const filename);
@@ -0,0 +1,182 @@
+#include <stdlib.h>
+
+#include "worker_pool.h"
+#include "errors.h"
+
+// Worker threads left without tasks for this long (in milliseconds) exit
+static const int WORKER_POOL_IDLE_TIMEOUT = 30000;
+
+static void worker_main(void* argument) {
+	
+	struct WorkerPool* const pool = (struct WorkerPool*) argument;
+	
+	if (pool->thread_start != NULL) {
+		pool->thread_start(pool->userdata);
+	}
+	
+	mutex_lock(&pool->mutex);
+	
+	while (1) {
+		int timed_out = 0;
+		
+		while (pool->head == NULL && !pool->stopping && !timed_out) {
+			pool->idle_threads++;
+			timed_out = condition_wait(&pool->condition, &pool->mutex, WORKER_POOL_IDLE_TIMEOUT);
+			pool->idle_threads--;
+		}
+		
+		// Queued tasks are still run when the pool is stopping
+		struct WorkerTask* const task = pool->head;
+		
+		if (task == NULL) {
+			break;
+		}
+		
+		pool->head = task->next;
+		
+		if (pool->head == NULL) {
+			pool->tail = NULL;
+		}
+		
+		task->next = NULL;
+		
+		pool->total_tasks--;
+		
+		mutex_unlock(&pool->mutex);
+		
+		task->routine(task->argument);
+		
+		mutex_lock(&pool->mutex);
+	}
+	
+	mutex_unlock(&pool->mutex);
+	
+	if (pool->thread_stop != NULL) {
+		pool->thread_stop(pool->userdata);
+	}
+	
+	mutex_lock(&pool->mutex);
+	
+	pool->total_threads--;
+	condition_broadcast(&pool->condition);
+	
+	mutex_unlock(&pool->mutex);
+	
+}
+
+static int queue_remove(struct WorkerPool* pool, struct WorkerTask* task) {
+	
+	struct WorkerTask* previous = NULL;
+	
+	for (struct WorkerTask* item = pool->head; item != NULL; item = item->next) {
+		if (item != task) {
+			previous = item;
+			continue;
+		}
+		
+		if (previous == NULL) {
+			pool->head = item->next;
+		} else {
+			previous->next = item->next;
+		}
+		
+		if (pool->tail == item) {
+			pool->tail = previous;
+		}
+		
+		item->next = NULL;
+		
+		pool->total_tasks--;
+		
+		return 1;
+	}
+	
+	return 0;
+	
+}
+
+int worker_pool_submit(struct WorkerPool* pool, struct WorkerTask* task) {
+	/*
+	Queues the task to be run on one of the worker threads. Threads are started on demand, until
+	"max_threads" of them exist; past that, tasks wait for a thread to become free.
+	*/
+	
+	mutex_lock(&pool->mutex);
+	
+	if (pool->stopping) {
+		mutex_unlock(&pool->mutex);
+		return UNALIXERR_ARG_INVALID;
+	}
+	
+	task->next = NULL;
+	
+	if (pool->tail == NULL) {
+		pool->head = task;
+	} else {
+		pool->tail->next = task;
+	}
+	
+	pool->tail = task;
+	pool->total_tasks++;
+	
+	const size_t max_threads = (pool->max_threads > 0) ? pool->max_threads : 1;
+	
+	// Idle threads are woken up below, but each of them only takes a single task
+	if (pool->total_tasks > pool->idle_threads && pool->total_threads < max_threads) {
+		const int code = thread_create_detached(worker_main, pool);
+		
+		if (code == UNALIXERR_SUCCESS) {
+			pool->total_threads++;
+		} else if (pool->total_threads == 0) {
+			// Nobody would ever run it
+			queue_remove(pool, task);
+			mutex_unlock(&pool->mutex);
+			
+			return code;
+		}
+	}
+	
+	condition_broadcast(&pool->condition);
+	
+	mutex_unlock(&pool->mutex);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int worker_pool_remove(struct WorkerPool* pool, struct WorkerTask* task) {
+	/*
+	Takes the task out of the queue if no thread picked it up yet. Returns 1 if it was removed,
+	in which case it will never run, and 0 if it is already running or done.
+	*/
+	
+	mutex_lock(&pool->mutex);
+	
+	const int removed = queue_remove(pool, task);
+	
+	mutex_unlock(&pool->mutex);
+	
+	return removed;
+	
+}
+
+void worker_pool_stop(struct WorkerPool* pool) {
+	/*
+	Waits for all queued tasks to run and for every worker thread to exit. The pool accepts
+	tasks again afterwards.
+	*/
+	
+	mutex_lock(&pool->mutex);
+	
+	pool->stopping = 1;
+	condition_broadcast(&pool->condition);
+	
+	while (pool->total_threads > 0) {
+		condition_wait(&pool->condition, &pool->mutex, -1);
+	}
+	
+	pool->stopping = 0;
+	
+	mutex_unlock(&pool->mutex);
+	
+}
@@ -0,0 +1,35 @@
+#ifndef WORKER_POOL_H_INCLUDED
+#define WORKER_POOL_H_INCLUDED
+
+#include <stddef.h>
+
+#include "threads.h"
+
+struct WorkerTask {
+	void (*routine)(void* argument);
+	void* argument;
+	struct WorkerTask* next;
+};
+
+struct WorkerPool {
+	struct Mutex mutex;
+	struct Condition condition;
+	struct WorkerTask* head;
+	struct WorkerTask* tail;
+	size_t total_tasks;
+	size_t max_threads;
+	size_t total_threads;
+	size_t idle_threads;
+	int stopping;
+	void (*thread_start)(void* userdata); // Runs once on each worker thread, before any task
+	void (*thread_stop)(void* userdata); // Runs once on each worker thread, right before it exits
+	void* userdata;
+};
+
+#define WORKER_POOL_INITIALIZER {MUTEX_INITIALIZER, CONDITION_INITIALIZER, NULL, NULL, 0, 0, 0, 0, 0, NULL, NULL, NULL}
+
+int worker_pool_submit(struct WorkerPool* pool, struct WorkerTask* task);
+int worker_pool_remove(struct WorkerPool* pool, struct WorkerTask* task);
+void worker_pool_stop(struct WorkerPool* pool);
+
+#endif
@@ -0,0 +1,378 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <bearssl.h>
+
+#include "unalix.h"
+#include "x509_cache.h"
+#include "threads.h"
+#include "errors.h"
+
+/*
+An in-memory cache of certificate chains that passed validation.
+
+X509CacheContext is an X.509 engine that wraps br_x509_minimal. The chain sent by the server is
+buffered (and each certificate decoded, which is cheap) while it is received. Once the chain
+ends, it is looked up by the SHA-256 of its contents and the server name: a chain that was
+already validated is accepted as is, without checking any signature. Anything else is replayed
+into the wrapped engine, and remembered until its earliest certificate expiry if it validates.
+*/
+
+// Days from 0000-01-01 (the epoch used by the X.509 decoder) to 1970-01-01
+static const long long X509_UNIX_EPOCH_DAYS = 719528;
+
+struct X509Cache {
+	struct Mutex mutex;
+	struct X509CacheEntry* entries;
+	size_t total_entries;
+};
+
+static struct X509Cache cache = {
+	.mutex = MUTEX_INITIALIZER
+};
+
+static size_t cache_index(const unsigned char* const key) {
+	
+	size_t index = 0;
+	memcpy(&index, key, sizeof(index));
+	
+	return index % cache.total_entries;
+	
+}
+
+static int cache_lookup(const unsigned char* const key, unsigned* usages) {
+	
+	int found = 0;
+	
+	mutex_lock(&cache.mutex);
+	
+	if (cache.total_entries > 0) {
+		const long long now = (long long) time(NULL);
+		const size_t index = cache_index(key);
+		
+		for (size_t probe = 0; probe < X509_CACHE_MAX_PROBES && probe < cache.total_entries; probe++) {
+			const struct X509CacheEntry* const entry = &cache.entries[(index + probe) % cache.total_entries];
+			
+			if (entry->expires > now && memcmp(entry->key, key, sizeof(entry->key)) == 0) {
+				*usages = entry->usages;
+				found = 1;
+				break;
+			}
+		}
+	}
+	
+	mutex_unlock(&cache.mutex);
+	
+	return found;
+	
+}
+
+static void cache_insert(const unsigned char* const key, const long long expires, const unsigned usages) {
+	/*
+	Stores the key in the first unused or expired slot it may live in. If there is none, the slot
+	closest to expiring is overwritten.
+	*/
+	
+	mutex_lock(&cache.mutex);
+	
+	if (cache.total_entries > 0) {
+		const long long now = (long long) time(NULL);
+		const size_t index = cache_index(key);
+		
+		struct X509CacheEntry* victim = NULL;
+		
+		for (size_t probe = 0; probe < X509_CACHE_MAX_PROBES && probe < cache.total_entries; probe++) {
+			struct X509CacheEntry* const entry = &cache.entries[(index + probe) % cache.total_entries];
+			
+			if (entry->expires <= now || memcmp(entry->key, key, sizeof(entry->key)) == 0) {
+				victim = entry;
+				break;
+			}
+			
+			if (victim == NULL || entry->expires < victim->expires) {
+				victim = entry;
+			}
+		}
+		
+		memcpy(victim->key, key, sizeof(victim->key));
+		victim->expires = expires;
+		victim->usages = usages;
+	}
+	
+	mutex_unlock(&cache.mutex);
+	
+}
+
+static int cache_is_enabled(void) {
+	
+	mutex_lock(&cache.mutex);
+	const int enabled = cache.total_entries > 0;
+	mutex_unlock(&cache.mutex);
+	
+	return enabled;
+	
+}
+
+static int chain_reserve(struct X509CacheContext* ctx, const size_t size) {
+	
+	if (ctx->chain_capacity - ctx->chain_size >= size) {
+		return 1;
+	}
+	
+	size_t capacity = ctx->chain_capacity == 0 ? 4096 : ctx->chain_capacity;
+	
+	while (capacity - ctx->chain_size < size) {
+		capacity *= 2;
+	}
+	
+	unsigned char* const chain = (unsigned char*) realloc(ctx->chain, capacity);
+	
+	if (chain == NULL) {
+		return 0;
+	}
+	
+	ctx->chain = chain;
+	ctx->chain_capacity = capacity;
+	
+	return 1;
+	
+}
+
+static void chain_replay(struct X509CacheContext* ctx) {
+	/*
+	Feeds the certificates buffered so far into the wrapped engine and sends any further one
+	straight to it. Only called between certificates, so every buffered one is complete.
+	*/
+	
+	const br_x509_class* const inner = ctx->inner->vtable;
+	const br_x509_class** const inner_ctx = &ctx->inner->vtable;
+	
+	inner->start_chain(inner_ctx, ctx->server_name);
+	
+	size_t offset = 0;
+	
+	while (offset < ctx->chain_size) {
+		const unsigned char* const header = ctx->chain + offset;
+		const uint32_t size = ((uint32_t) header[0] << 24) | ((uint32_t) header[1] << 16) | ((uint32_t) header[2] << 8) | (uint32_t) header[3];
+		
+		offset += 4;
+		
+		inner->start_cert(inner_ctx, size);
+		inner->append(inner_ctx, ctx->chain + offset, size);
+		inner->end_cert(inner_ctx);
+		
+		offset += size;
+	}
+	
+	ctx->passthrough = 1;
+	
+}
+
+static void x509_cache_start_chain(const br_x509_class** context, const char* server_name) {
+	
+	struct X509CacheContext* const ctx = (struct X509CacheContext*) context;
+	
+	ctx->server_name = server_name;
+	ctx->chain_size = 0;
+	ctx->certificate_size = 0;
+	ctx->total_certificates = 0;
+	ctx->expires = 0;
+	ctx->cached = 0;
+	ctx->passthrough = 0;
+	
+	if (!cache_is_enabled()) {
+		chain_replay(ctx);
+	}
+	
+}
+
+static void x509_cache_start_cert(const br_x509_class** context, uint32_t length) {
+	
+	struct X509CacheContext* const ctx = (struct X509CacheContext*) context;
+	
+	if (!ctx->passthrough && (length > X509_CACHE_MAX_CHAIN_SIZE || ctx->chain_size + 4 + length > X509_CACHE_MAX_CHAIN_SIZE || !chain_reserve(ctx, 4 + (size_t) length))) {
+		chain_replay(ctx);
+	}
+	
+	if (ctx->passthrough) {
+		ctx->inner->vtable->start_cert(&ctx->inner->vtable, length);
+		return;
+	}
+	
+	unsigned char* const header = ctx->chain + ctx->chain_size;
+	
+	header[0] = (unsigned char) (length >> 24);
+	header[1] = (unsigned char) (length >> 16);
+	header[2] = (unsigned char) (length >> 8);
+	header[3] = (unsigned char) length;
+	
+	ctx->chain_size += 4;
+	ctx->certificate_offset = ctx->chain_size;
+	ctx->certificate_size = length;
+	
+	br_x509_decoder_init(ctx->total_certificates == 0 ? &ctx->ee_decoder : &ctx->decoder, NULL, NULL);
+	
+}
+
+static void x509_cache_append(const br_x509_class** context, const unsigned char* buf, size_t len) {
+	
+	struct X509CacheContext* const ctx = (struct X509CacheContext*) context;
+	
+	if (ctx->passthrough) {
+		ctx->inner->vtable->append(&ctx->inner->vtable, buf, len);
+		return;
+	}
+	
+	// The engine never sends more than the announced length, but better safe than sorry
+	const size_t remaining = ctx->certificate_offset + ctx->certificate_size - ctx->chain_size;
+	
+	if (len > remaining) {
+		len = remaining;
+	}
+	
+	memcpy(ctx->chain + ctx->chain_size, buf, len);
+	ctx->chain_size += len;
+	
+	br_x509_decoder_push(ctx->total_certificates == 0 ? &ctx->ee_decoder : &ctx->decoder, buf, len);
+	
+}
+
+static void x509_cache_end_cert(const br_x509_class** context) {
+	
+	struct X509CacheContext* const ctx = (struct X509CacheContext*) context;
+	
+	if (ctx->passthrough) {
+		ctx->inner->vtable->end_cert(&ctx->inner->vtable);
+		return;
+	}
+	
+	br_x509_decoder_context* const decoder = ctx->total_certificates == 0 ? &ctx->ee_decoder : &ctx->decoder;
+	
+	ctx->total_certificates++;
+	
+	if (br_x509_decoder_last_error(decoder) != 0) {
+		// Let the wrapped engine report the error
+		chain_replay(ctx);
+		return;
+	}
+	
+	const long long expires = ((long long) decoder->notafter_days - X509_UNIX_EPOCH_DAYS) * 86400 + (long long) decoder->notafter_seconds;
+	
+	if (ctx->total_certificates == 1 || expires < ctx->expires) {
+		ctx->expires = expires;
+	}
+	
+}
+
+static unsigned x509_cache_end_chain(const br_x509_class** context) {
+	
+	struct X509CacheContext* const ctx = (struct X509CacheContext*) context;
+	
+	if (ctx->passthrough) {
+		return ctx->inner->vtable->end_chain(&ctx->inner->vtable);
+	}
+	
+	unsigned char key[br_sha256_SIZE];
+	
+	br_sha256_context hash = {0};
+	br_sha256_init(&hash);
+	br_sha256_update(&hash, ctx->chain, ctx->chain_size);
+	
+	if (ctx->server_name != NULL) {
+		br_sha256_update(&hash, ctx->server_name, strlen(ctx->server_name) + 1);
+	}
+	
+	br_sha256_out(&hash, key);
+	
+	unsigned usages = 0;
+	
+	if (ctx->total_certificates > 0 && cache_lookup(key, &usages)) {
+		ctx->cached = 1;
+		ctx->usages = usages;
+		ctx->pkey = br_x509_decoder_get_pkey(&ctx->ee_decoder);
+		
+		return 0;
+	}
+	
+	chain_replay(ctx);
+	
+	const unsigned code = ctx->inner->vtable->end_chain(&ctx->inner->vtable);
+	
+	if (code == 0 && ctx->inner->vtable->get_pkey((const br_x509_class* const*) &ctx->inner->vtable, &usages) != NULL) {
+		cache_insert(key, ctx->expires, usages);
+	}
+	
+	return code;
+	
+}
+
+static const br_x509_pkey* x509_cache_get_pkey(const br_x509_class* const* context, unsigned* usages) {
+	
+	const struct X509CacheContext* const ctx = (const struct X509CacheContext*) context;
+	
+	if (!ctx->cached) {
+		return ctx->inner->vtable->get_pkey((const br_x509_class* const*) &ctx->inner->vtable, usages);
+	}
+	
+	if (usages != NULL) {
+		*usages = ctx->usages;
+	}
+	
+	return ctx->pkey;
+	
+}
+
+static const br_x509_class x509_cache_vtable = {
+	sizeof(struct X509CacheContext),
+	x509_cache_start_chain,
+	x509_cache_start_cert,
+	x509_cache_append,
+	x509_cache_end_cert,
+	x509_cache_end_chain,
+	x509_cache_get_pkey
+};
+
+void x509_cache_init(struct X509CacheContext* ctx, br_x509_minimal_context* inner) {
+	
+	memset(ctx, 0, sizeof(*ctx));
+	
+	ctx->vtable = &x509_cache_vtable;
+	ctx->inner = inner;
+	
+}
+
+void x509_cache_free(struct X509CacheContext* ctx) {
+	
+	free(ctx->chain);
+	
+	ctx->chain = NULL;
+	ctx->chain_size = 0;
+	ctx->chain_capacity = 0;
+	
+}
+
+int unalix_certificate_cache_configure(const size_t max_entries) {
+	
+	struct X509CacheEntry* entries = NULL;
+	
+	if (max_entries > 0) {
+		entries = (struct X509CacheEntry*) calloc(max_entries, sizeof(*entries));
+		
+		if (entries == NULL) {
+			return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+		}
+	}
+	
+	mutex_lock(&cache.mutex);
+	
+	free(cache.entries);
+	
+	cache.entries = entries;
+	cache.total_entries = max_entries;
+	
+	mutex_unlock(&cache.mutex);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
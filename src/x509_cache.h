@@ -0,0 +1,43 @@
+#ifndef X509_CACHE_H_INCLUDED
+#define X509_CACHE_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <bearssl.h>
+
+// Certificate chains larger than this are validated without going through the cache
+static const size_t X509_CACHE_MAX_CHAIN_SIZE = 1024 * 64;
+
+// Number of consecutive slots a key may live in
+static const size_t X509_CACHE_MAX_PROBES = 4;
+
+struct X509CacheEntry {
+	unsigned char key[br_sha256_SIZE]; // SHA-256 of the certificate chain and server name
+	long long expires; // Earliest expiry date (in seconds since the epoch) among the certificates
+	unsigned usages;
+};
+
+struct X509CacheContext {
+	const br_x509_class* vtable;
+	br_x509_minimal_context* inner;
+	const char* server_name;
+	int passthrough; // Certificates go straight to the wrapped engine
+	int cached; // The last chain was accepted from the cache
+	unsigned char* chain; // Each certificate is stored as a 4 byte big-endian length followed by its DER encoding
+	size_t chain_size;
+	size_t chain_capacity;
+	size_t certificate_offset;
+	uint32_t certificate_size;
+	size_t total_certificates;
+	long long expires;
+	const br_x509_pkey* pkey;
+	unsigned usages;
+	br_x509_decoder_context decoder;
+	br_x509_decoder_context ee_decoder;
+};
+
+void x509_cache_init(struct X509CacheContext* ctx, br_x509_minimal_context* inner);
+void x509_cache_free(struct X509CacheContext* ctx);
+
+#endif
@@ -0,0 +1,310 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "unalix.h"
+#include "http.h"
+#include "errors.h"
+#include "server.h"
+
+/*
+Load generator for unalix_unshort_url().
+
+bench_unshort [options]
+	Drives unshort against the local stand-in server at a fixed concurrency and reports throughput
+	and latency. Options:
+	--tls             serve over TLS (with the test CA)
+	--chain <n>       hops per redirect chain (default: 3)
+	--delay <ms>      delay before each response (default: 0)
+	--concurrency <n> calls in flight (default: 16)
+	--requests <n>    total calls (default: 1000)
+	--same            use the same URL for every call, instead of unique ones
+	--replay <file>   replay recorded chains instead of synthetic ones
+
+bench_unshort --record <file> <url>...
+	Follows the redirect chain of each URL over the network, writing every hop to file in the
+	format expected by --replay.
+*/
+
+struct Benchmark {
+	char** urls;
+	size_t total_urls;
+	size_t total_requests;
+	size_t next_request;
+	size_t total_errors;
+	unsigned long long* latencies; // Microseconds
+	int timeout;
+};
+
+static unsigned long long now_us(void) {
+	
+	struct timespec ts = {0};
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return (unsigned long long) ts.tv_sec * 1000000 + (unsigned long long) ts.tv_nsec / 1000;
+	
+}
+
+static int compare_latencies(const void* a, const void* b) {
+	
+	const unsigned long long left = *(const unsigned long long*) a;
+	const unsigned long long right = *(const unsigned long long*) b;
+	
+	return (left > right) - (left < right);
+	
+}
+
+static void* worker(void* argument) {
+	
+	struct Benchmark* const benchmark = (struct Benchmark*) argument;
+	
+	char* target_url = NULL;
+	
+	while (1) {
+		const size_t index = __atomic_fetch_add(&benchmark->next_request, 1, __ATOMIC_SEQ_CST);
+		
+		if (index >= benchmark->total_requests) {
+			break;
+		}
+		
+		const unsigned long long start = now_us();
+		
+		const int code = unalix_unshort_url(benchmark->urls[index % benchmark->total_urls], &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, benchmark->timeout);
+		
+		benchmark->latencies[index] = now_us() - start;
+		
+		if (code != UNALIXERR_SUCCESS) {
+			__atomic_add_fetch(&benchmark->total_errors, 1, __ATOMIC_SEQ_CST);
+		}
+	}
+	
+	free(target_url);
+	
+	return NULL;
+	
+}
+
+static int record(const char* const filename, char* const* urls, const size_t total_urls) {
+	
+	FILE* const file = fopen(filename, "w");
+	
+	if (file == NULL) {
+		fprintf(stderr, "cannot open %s\n", filename);
+		return 1;
+	}
+	
+	for (size_t index = 0; index < total_urls; index++) {
+		char* url = (char*) malloc(strlen(urls[index]) + 1);
+		strcpy(url, urls[index]);
+		
+		for (int hop = 0; url != NULL && hop <= HTTP_DEFAULT_MAX_REDIRECTS; hop++) {
+			struct HTTPContext context = {
+				.request = {
+					.version = HTTP10,
+					.method = GET,
+					.probe = 1
+				}
+			};
+			
+			char* location = NULL;
+			
+			int code = http_request_set_url(&context, url);
+			
+			if (code == UNALIXERR_SUCCESS) {
+				code = http_request_send(&context);
+			}
+			
+			if (code == UNALIXERR_SUCCESS) {
+				code = http_get_redirect(&context, &location);
+			}
+			
+			if (code != UNALIXERR_SUCCESS) {
+				fprintf(stderr, "%s: %s\n", url, unalix_strerror(code));
+			} else {
+				fprintf(file, "%i %s %s\n", context.response.status.code, url, location == NULL ? "-" : location);
+			}
+			
+			http_context_free(&context);
+			
+			free(url);
+			url = location;
+		}
+		
+		free(url);
+	}
+	
+	fclose(file);
+	
+	return 0;
+	
+}
+
+int main(int argc, char* argv[]) {
+	
+	int tls = 0;
+	int same = 0;
+	long chain = 3;
+	long delay = 0;
+	long concurrency = 16;
+	long total_requests = 1000;
+	const char* replay = NULL;
+	
+	for (int index = 1; index < argc; index++) {
+		const char* const option = argv[index];
+		const char* const value = (index + 1 < argc) ? argv[index + 1] : NULL;
+		
+		if (strcmp(option, "--record") == 0 && value != NULL) {
+			return record(value, argv + index + 2, (size_t) (argc - index - 2));
+		} else if (strcmp(option, "--tls") == 0) {
+			tls = 1;
+		} else if (strcmp(option, "--same") == 0) {
+			same = 1;
+		} else if (strcmp(option, "--chain") == 0 && value != NULL) {
+			chain = strtol(value, NULL, 10);
+			index++;
+		} else if (strcmp(option, "--delay") == 0 && value != NULL) {
+			delay = strtol(value, NULL, 10);
+			index++;
+		} else if (strcmp(option, "--concurrency") == 0 && value != NULL) {
+			concurrency = strtol(value, NULL, 10);
+			index++;
+		} else if (strcmp(option, "--requests") == 0 && value != NULL) {
+			total_requests = strtol(value, NULL, 10);
+			index++;
+		} else if (strcmp(option, "--replay") == 0 && value != NULL) {
+			replay = value;
+			index++;
+		} else {
+			fprintf(stderr, "unknown option: %s\n", option);
+			return 1;
+		}
+	}
+	
+	if (concurrency < 1 || total_requests < 1 || chain < 0) {
+		fprintf(stderr, "invalid arguments\n");
+		return 1;
+	}
+	
+	if (unalix_load_file("./test/rulesets/rulesets.json") != UNALIXERR_SUCCESS) {
+		fprintf(stderr, "cannot load rulesets (run from the repository root)\n");
+		return 1;
+	}
+	
+	if (tls) {
+		unsigned char ca[2048];
+		size_t ca_size = 0;
+		
+		if (read_file("./test/certificates/ca.der", ca, sizeof(ca), &ca_size) != 0 || unalix_ssl_add_trust_anchor(ca, ca_size) != UNALIXERR_SUCCESS) {
+			fprintf(stderr, "cannot load the test CA\n");
+			return 1;
+		}
+		
+		const char* const loopback[] = {"127.0.0.1"};
+		unalix_dns_cache_add("localhost", loopback, 1, 3600);
+	}
+	
+	struct Server server;
+	
+	if (server_start(&server, tls) != 0) {
+		fprintf(stderr, "cannot start the server\n");
+		return 1;
+	}
+	
+	struct Recording recording = {0};
+	
+	if (replay != NULL && server_load_recording(&server, replay, &recording) != 0) {
+		fprintf(stderr, "cannot load %s\n", replay);
+		return 1;
+	}
+	
+	struct Benchmark benchmark = {
+		.total_requests = (size_t) total_requests,
+		.timeout = 30
+	};
+	
+	benchmark.total_urls = (replay != NULL) ? recording.total_urls : (same ? 1 : (size_t) total_requests);
+	benchmark.urls = (char**) calloc(benchmark.total_urls, sizeof(*benchmark.urls));
+	benchmark.latencies = (unsigned long long*) calloc(benchmark.total_requests, sizeof(*benchmark.latencies));
+	
+	if (benchmark.total_urls == 0 || benchmark.urls == NULL || benchmark.latencies == NULL) {
+		fprintf(stderr, "nothing to do\n");
+		return 1;
+	}
+	
+	const char* const scheme = tls ? "https" : "http";
+	const char* const host = tls ? "localhost" : "127.0.0.1";
+	
+	for (size_t index = 0; index < benchmark.total_urls; index++) {
+		char url[256];
+		
+		if (replay != NULL) {
+			snprintf(url, sizeof(url), "%s://%s:%i/replay/%zu?delay=%li", scheme, host, server.port, index, delay);
+		} else {
+			snprintf(url, sizeof(url), "%s://%s:%i/redirect/%li?delay=%li&n=%zu", scheme, host, server.port, chain, delay, index);
+		}
+		
+		benchmark.urls[index] = (char*) malloc(strlen(url) + 1);
+		strcpy(benchmark.urls[index], url);
+	}
+	
+	unalix_metrics_enable(1);
+	
+	pthread_t* const threads = (pthread_t*) calloc((size_t) concurrency, sizeof(*threads));
+	
+	const unsigned long long start = now_us();
+	
+	for (long index = 0; index < concurrency; index++) {
+		pthread_create(&threads[index], NULL, worker, &benchmark);
+	}
+	
+	for (long index = 0; index < concurrency; index++) {
+		pthread_join(threads[index], NULL);
+	}
+	
+	const unsigned long long elapsed = now_us() - start;
+	
+	qsort(benchmark.latencies, benchmark.total_requests, sizeof(*benchmark.latencies), compare_latencies);
+	
+	const unsigned long long* const latencies = benchmark.latencies;
+	const size_t total = benchmark.total_requests;
+	
+	printf("requests:     %zu (%zu failed)\n", total, benchmark.total_errors);
+	printf("concurrency:  %li\n", concurrency);
+	printf("elapsed:      %.3f s\n", (double) elapsed / 1e6);
+	printf("throughput:   %.1f unshorts/s\n", (double) total / ((double) elapsed / 1e6));
+	printf("latency (ms): p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n",
+		(double) latencies[total * 50 / 100] / 1e3,
+		(double) latencies[total * 90 / 100] / 1e3,
+		(double) latencies[total * 99 / 100] / 1e3,
+		(double) latencies[total - 1] / 1e3
+	);
+	
+	struct unalix_metrics metrics = {0};
+	unalix_metrics_snapshot(&metrics);
+	
+	const char* const phases[UNALIX_TOTAL_PHASES] = {"dns", "connect", "tls", "first byte", "request", "unshort"};
+	
+	printf("http requests: %llu, connections: %llu, handshakes: %llu, server requests: %zu\n", metrics.requests, metrics.connections_opened, metrics.tls_handshakes, server.total_requests);
+	
+	for (size_t phase = 0; phase < UNALIX_TOTAL_PHASES; phase++) {
+		if (metrics.phase_count[phase] > 0) {
+			printf("  %-11s avg %.3f ms over %llu\n", phases[phase], (double) metrics.phase_total[phase] / (double) metrics.phase_count[phase] / 1e3, metrics.phase_count[phase]);
+		}
+	}
+	
+	for (size_t index = 0; index < benchmark.total_urls; index++) {
+		free(benchmark.urls[index]);
+	}
+	
+	free(benchmark.urls);
+	free(benchmark.latencies);
+	free(threads);
+	
+	recording_free(&recording);
+	server_stop(&server);
+	
+	return 0;
+	
+}
@@ -0,0 +1,27 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include "unalix.h"
+#include "errors.h"
+#include "clean.h"
+
+char* clean(const char* const source_url) {
+	
+	char* target_url = NULL;
+	
+	const int code = unalix_clean_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	return target_url;
+	
+}
+
+void clean_expect(const char* const source_url, const char* const expected_url) {
+	
+	char* const target_url = clean(source_url);
+	assert (strcmp(target_url, expected_url) == 0);
+	
+	free(target_url);
+	
+}
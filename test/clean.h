@@ -0,0 +1,12 @@
+#ifndef CLEAN_H_INCLUDED
+#define CLEAN_H_INCLUDED
+
+/*
+Shorthands for the tests that only care about what unalix_clean_url() makes of a URL with every
+option off. Both abort the test if cleaning fails.
+*/
+
+char* clean(const char* const source_url);
+void clean_expect(const char* const source_url, const char* const expected_url);
+
+#endif
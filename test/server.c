@@ -0,0 +1,630 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <bearssl.h>
+
+#include "server.h"
+
+struct ServerConnection {
+	struct Server* server;
+	int fd;
+	br_ssl_server_context sc;
+	br_sslio_context ioc;
+	unsigned char iobuf[BR_SSL_BUFSIZE_BIDI];
+};
+
+static const size_t CHUNK_SIZE = 1000;
+
+int read_file(const char* const filename, unsigned char* buffer, const size_t buffer_size, size_t* size) {
+	
+	FILE* const file = fopen(filename, "rb");
+	
+	if (file == NULL) {
+		return -1;
+	}
+	
+	*size = fread(buffer, 1, buffer_size, file);
+	
+	const int code = (ferror(file) || !feof(file)) ? -1 : 0;
+	
+	fclose(file);
+	
+	return code;
+	
+}
+
+static int socket_read(void* userdata, unsigned char* buffer, size_t size) {
+	
+	const int fd = *(int*) userdata;
+	
+	const ssize_t received = recv(fd, buffer, size, 0);
+	
+	return (received < 1) ? -1 : (int) received;
+	
+}
+
+static int socket_write(void* userdata, const unsigned char* buffer, size_t size) {
+	
+	const int fd = *(int*) userdata;
+	
+	const ssize_t sent = send(fd, buffer, size, MSG_NOSIGNAL);
+	
+	return (sent < 1) ? -1 : (int) sent;
+	
+}
+
+static int connection_read(struct ServerConnection* connection, char* buffer, const size_t size) {
+	
+	if (connection->server->tls) {
+		return br_sslio_read(&connection->ioc, buffer, size);
+	}
+	
+	return socket_read(&connection->fd, (unsigned char*) buffer, size);
+	
+}
+
+static int connection_write(struct ServerConnection* connection, const char* buffer, const size_t size) {
+	
+	if (connection->server->tls) {
+		return br_sslio_write_all(&connection->ioc, buffer, size);
+	}
+	
+	size_t offset = 0;
+	
+	while (offset < size) {
+		const int sent = socket_write(&connection->fd, (const unsigned char*) buffer + offset, size - offset);
+		
+		if (sent == -1) {
+			return -1;
+		}
+		
+		offset += (size_t) sent;
+	}
+	
+	return 0;
+	
+}
+
+static long query_get(const char* const query, const char* const name, const long fallback) {
+	
+	if (query == NULL) {
+		return fallback;
+	}
+	
+	const size_t name_size = strlen(name);
+	
+	for (const char* item = query; item != NULL; item = strchr(item, '&')) {
+		if (*item == '&') {
+			item++;
+		}
+		
+		if (strncmp(item, name, name_size) == 0 && item[name_size] == '=') {
+			return strtol(item + name_size + 1, NULL, 10);
+		}
+	}
+	
+	return fallback;
+	
+}
+
+static int header_matches(const char* const request, const char* const name, const char* const value) {
+	/*
+	Checks whether the request carries the given header with exactly that value.
+	*/
+	
+	const size_t name_size = strlen(name);
+	const size_t value_size = strlen(value);
+	
+	for (const char* line = strstr(request, "\r\n"); line != NULL; line = strstr(line, "\r\n")) {
+		line += 2;
+		
+		if (strncasecmp(line, name, name_size) != 0 || line[name_size] != ':') {
+			continue;
+		}
+		
+		const char* start = line + name_size + 1;
+		
+		while (*start == ' ') {
+			start++;
+		}
+		
+		return strncmp(start, value, value_size) == 0 && strncmp(start + value_size, "\r\n", 2) == 0;
+	}
+	
+	return 0;
+	
+}
+
+static void respond(struct ServerConnection* connection, const char* const target, const char* const request) {
+	
+	struct Server* const server = connection->server;
+	
+	char path[1024];
+	snprintf(path, sizeof(path), "%s", target);
+	
+	char* const query = strchr(path, '?');
+	
+	if (query != NULL) {
+		*query = '\0';
+	}
+	
+	const char* const arguments = (query == NULL) ? NULL : query + 1;
+	
+	const long delay = query_get(arguments, "delay", 0);
+	
+	if (delay > 0) {
+		usleep((useconds_t) delay * 1000);
+	}
+	
+	int status = 200;
+	char location[1024] = {0};
+	
+	const struct ServerRoute* matched = NULL;
+	
+	for (size_t index = 0; index < server->total_routes; index++) {
+		const struct ServerRoute* const route = &server->routes[index];
+		
+		if (strcmp(route->path, path) == 0) {
+			matched = route;
+			status = route->status;
+			
+			if (route->location != NULL) {
+				snprintf(location, sizeof(location), "%s", route->location);
+			}
+			
+			break;
+		}
+	}
+	
+	if (strncmp(path, "/redirect/", 10) == 0) {
+		const long remaining = strtol(path + 10, NULL, 10);
+		
+		if (remaining > 0) {
+			status = (int) query_get(arguments, "status", 302);
+			snprintf(location, sizeof(location), "/redirect/%li%s%s", remaining - 1, arguments == NULL ? "" : "?", arguments == NULL ? "" : arguments);
+		}
+	}
+	
+	if (matched != NULL && matched->body != NULL) {
+		const int not_modified = matched->etag != NULL && header_matches(request, "If-None-Match", matched->etag);
+		
+		char headers[2048];
+		int headers_size = snprintf(headers, sizeof(headers), "HTTP/1.1 %i Status\r\nConnection: close\r\n", not_modified ? 304 : status);
+		
+		if (matched->etag != NULL) {
+			headers_size += snprintf(headers + headers_size, sizeof(headers) - (size_t) headers_size, "ETag: %s\r\n", matched->etag);
+		}
+		
+		headers_size += snprintf(headers + headers_size, sizeof(headers) - (size_t) headers_size, "Content-Length: %zu\r\n\r\n", not_modified ? 0 : matched->body_size);
+		
+		if (connection_write(connection, headers, (size_t) headers_size) != 0 || not_modified) {
+			return;
+		}
+		
+		connection_write(connection, matched->body, matched->body_size);
+		
+		return;
+	}
+	
+	const long size = query_get(arguments, "size", 0);
+	const long chunked = query_get(arguments, "chunked", -1);
+	
+	char headers[2048];
+	int headers_size = snprintf(headers, sizeof(headers), "HTTP/1.1 %i Status\r\nConnection: close\r\n", status);
+	
+	if (*location != '\0') {
+		headers_size += snprintf(headers + headers_size, sizeof(headers) - (size_t) headers_size, "Location: %s\r\n", location);
+	}
+	
+	if (chunked >= 0) {
+		headers_size += snprintf(headers + headers_size, sizeof(headers) - (size_t) headers_size, "Transfer-Encoding: chunked\r\n\r\n");
+	} else {
+		headers_size += snprintf(headers + headers_size, sizeof(headers) - (size_t) headers_size, "Content-Length: %li\r\n\r\n", size);
+	}
+	
+	if (connection_write(connection, headers, (size_t) headers_size) != 0) {
+		return;
+	}
+	
+	char chunk[CHUNK_SIZE + 32];
+	long remaining = (chunked >= 0) ? chunked : size;
+	
+	while (remaining > 0) {
+		const size_t chunk_size = ((size_t) remaining < CHUNK_SIZE) ? (size_t) remaining : CHUNK_SIZE;
+		
+		int offset = 0;
+		
+		if (chunked >= 0) {
+			offset = snprintf(chunk, sizeof(chunk), "%zx\r\n", chunk_size);
+		}
+		
+		memset(chunk + offset, 'A', chunk_size);
+		offset += (int) chunk_size;
+		
+		if (chunked >= 0) {
+			memcpy(chunk + offset, "\r\n", 2);
+			offset += 2;
+		}
+		
+		if (connection_write(connection, chunk, (size_t) offset) != 0) {
+			return;
+		}
+		
+		remaining -= (long) chunk_size;
+	}
+	
+	if (chunked >= 0) {
+		connection_write(connection, "0\r\n\r\n", 5);
+	}
+	
+}
+
+static void* handle(void* argument) {
+	
+	struct ServerConnection* const connection = (struct ServerConnection*) argument;
+	struct Server* const server = connection->server;
+	
+	if (server->tls) {
+		br_ssl_server_init_full_ec(&connection->sc, &server->chain, 1, BR_KEYTYPE_EC, br_skey_decoder_get_ec(&server->key));
+		br_ssl_engine_set_buffer(&connection->sc.eng, connection->iobuf, sizeof(connection->iobuf), 1);
+		br_ssl_server_reset(&connection->sc);
+		br_sslio_init(&connection->ioc, &connection->sc.eng, socket_read, &connection->fd, socket_write, &connection->fd);
+	}
+	
+	char request[4096];
+	size_t offset = 0;
+	
+	while (offset < sizeof(request) - 1) {
+		const int size = connection_read(connection, request + offset, sizeof(request) - 1 - offset);
+		
+		if (size < 1) {
+			break;
+		}
+		
+		offset += (size_t) size;
+		request[offset] = '\0';
+		
+		if (strstr(request, "\r\n\r\n") != NULL) {
+			break;
+		}
+	}
+	
+	request[offset] = '\0';
+	
+	char method[16] = {0};
+	char target[1024] = {0};
+	
+	if (sscanf(request, "%15s %1023s", method, target) == 2) {
+		__atomic_add_fetch(&server->total_requests, 1, __ATOMIC_SEQ_CST);
+		
+		respond(connection, target, request);
+		
+		if (server->tls) {
+			br_sslio_close(&connection->ioc);
+		}
+	}
+	
+	close(connection->fd);
+	free(connection);
+	
+	__atomic_sub_fetch(&server->active_connections, 1, __ATOMIC_SEQ_CST);
+	
+	return NULL;
+	
+}
+
+static void* serve(void* argument) {
+	
+	struct Server* const server = (struct Server*) argument;
+	
+	while (1) {
+		const int fd = accept(server->fd, NULL, NULL);
+		
+		if (fd == -1) {
+			break;
+		}
+		
+		struct ServerConnection* const connection = (struct ServerConnection*) malloc(sizeof(struct ServerConnection));
+		
+		if (connection == NULL) {
+			close(fd);
+			continue;
+		}
+		
+		connection->server = server;
+		connection->fd = fd;
+		
+		__atomic_add_fetch(&server->total_connections, 1, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&server->active_connections, 1, __ATOMIC_SEQ_CST);
+		
+		pthread_t thread;
+		
+		if (pthread_create(&thread, NULL, handle, connection) != 0) {
+			__atomic_sub_fetch(&server->active_connections, 1, __ATOMIC_SEQ_CST);
+			
+			close(fd);
+			free(connection);
+			
+			continue;
+		}
+		
+		pthread_detach(thread);
+	}
+	
+	return NULL;
+	
+}
+
+int server_start(struct Server* obj, const int tls) {
+	
+	memset(obj, 0, sizeof(*obj));
+	
+	obj->tls = tls;
+	
+	if (tls) {
+		unsigned char key[512];
+		size_t key_size = 0;
+		
+		if (read_file("./test/certificates/localhost.der", obj->certificate, sizeof(obj->certificate), &obj->chain.data_len) != 0) {
+			return -1;
+		}
+		
+		obj->chain.data = obj->certificate;
+		
+		if (read_file("./test/certificates/localhost.key", key, sizeof(key), &key_size) != 0) {
+			return -1;
+		}
+		
+		br_skey_decoder_init(&obj->key);
+		br_skey_decoder_push(&obj->key, key, key_size);
+		
+		if (br_skey_decoder_get_ec(&obj->key) == NULL) {
+			return -1;
+		}
+	}
+	
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+	};
+	socklen_t addr_size = sizeof(addr);
+	
+	obj->fd = socket(AF_INET, SOCK_STREAM, 0);
+	
+	if (obj->fd == -1) {
+		return -1;
+	}
+	
+	if (bind(obj->fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 || getsockname(obj->fd, (struct sockaddr*) &addr, &addr_size) != 0 || listen(obj->fd, 1024) != 0) {
+		close(obj->fd);
+		return -1;
+	}
+	
+	obj->port = ntohs(addr.sin_port);
+	
+	if (pthread_create(&obj->thread, NULL, serve, obj) != 0) {
+		close(obj->fd);
+		return -1;
+	}
+	
+	return 0;
+	
+}
+
+void server_stop(struct Server* obj) {
+	
+	shutdown(obj->fd, SHUT_RDWR);
+	close(obj->fd);
+	
+	pthread_join(obj->thread, NULL);
+	
+	// Connections still being handled reference the server
+	while (__atomic_load_n(&obj->active_connections, __ATOMIC_SEQ_CST) > 0) {
+		usleep(1000);
+	}
+	
+	for (size_t index = 0; index < obj->total_routes; index++) {
+		free(obj->routes[index].path);
+		free(obj->routes[index].location);
+		free(obj->routes[index].body);
+		free(obj->routes[index].etag);
+	}
+	
+	obj->total_routes = 0;
+	
+}
+
+static char* string_copy(const char* const source) {
+	
+	char* const destination = (char*) malloc(strlen(source) + 1);
+	
+	if (destination != NULL) {
+		strcpy(destination, source);
+	}
+	
+	return destination;
+	
+}
+
+int server_add_route(struct Server* obj, const char* const path, const int status, const char* const location) {
+	/*
+	Routes must be added before the server starts handling requests that may hit them.
+	*/
+	
+	if (obj->total_routes == SERVER_MAX_ROUTES) {
+		return -1;
+	}
+	
+	struct ServerRoute* const route = &obj->routes[obj->total_routes];
+	
+	route->path = string_copy(path);
+	route->status = status;
+	route->location = (location == NULL) ? NULL : string_copy(location);
+	route->body = NULL;
+	route->body_size = 0;
+	route->etag = NULL;
+	
+	if (route->path == NULL || (location != NULL && route->location == NULL)) {
+		free(route->path);
+		free(route->location);
+		
+		return -1;
+	}
+	
+	obj->total_routes++;
+	
+	return 0;
+	
+}
+
+int server_set_route_body(struct Server* obj, const char* const path, const char* const body, const size_t body_size, const char* const etag) {
+	/*
+	Serves the body (and ETag) at the path, replacing whatever that route served before. Just like
+	routes, bodies must not be changed while requests that may hit them are being handled.
+	*/
+	
+	struct ServerRoute* route = NULL;
+	
+	for (size_t index = 0; index < obj->total_routes; index++) {
+		if (strcmp(obj->routes[index].path, path) == 0) {
+			route = &obj->routes[index];
+			break;
+		}
+	}
+	
+	if (route == NULL) {
+		if (server_add_route(obj, path, 200, NULL) != 0) {
+			return -1;
+		}
+		
+		route = &obj->routes[obj->total_routes - 1];
+	}
+	
+	char* const content = (char*) malloc(body_size);
+	char* const tag = (etag == NULL) ? NULL : string_copy(etag);
+	
+	if ((content == NULL && body_size > 0) || (etag != NULL && tag == NULL)) {
+		free(content);
+		free(tag);
+		
+		return -1;
+	}
+	
+	memcpy(content, body, body_size);
+	
+	free(route->body);
+	free(route->etag);
+	
+	route->body = content;
+	route->body_size = body_size;
+	route->etag = tag;
+	
+	return 0;
+	
+}
+
+static long recording_index(struct Recording* obj, const char* const url) {
+	
+	for (size_t index = 0; index < obj->total_urls; index++) {
+		if (strcmp(obj->urls[index], url) == 0) {
+			return (long) index;
+		}
+	}
+	
+	char** const urls = (char**) realloc(obj->urls, sizeof(*urls) * (obj->total_urls + 1));
+	
+	if (urls == NULL) {
+		return -1;
+	}
+	
+	obj->urls = urls;
+	obj->urls[obj->total_urls] = string_copy(url);
+	
+	if (obj->urls[obj->total_urls] == NULL) {
+		return -1;
+	}
+	
+	return (long) obj->total_urls++;
+	
+}
+
+int server_load_recording(struct Server* obj, const char* const filename, struct Recording* recording) {
+	/*
+	Loads redirect chains recorded from real servers and replays them under /replay/<index>.
+
+	Each line of the file describes one hop as "<status> <url> <location>", where location is "-"
+	for hops that did not redirect. URLs that were only ever seen as a location have no route,
+	so they end the chain with a 200 response.
+	*/
+	
+	memset(recording, 0, sizeof(*recording));
+	
+	FILE* const file = fopen(filename, "r");
+	
+	if (file == NULL) {
+		return -1;
+	}
+	
+	char line[4096];
+	
+	int code = 0;
+	
+	while (code == 0 && fgets(line, sizeof(line), file) != NULL) {
+		int status = 0;
+		char url[2048];
+		char location[2048];
+		
+		if (sscanf(line, "%i %2047s %2047s", &status, url, location) != 3) {
+			continue;
+		}
+		
+		const long source = recording_index(recording, url);
+		
+		char path[64];
+		snprintf(path, sizeof(path), "/replay/%li", source);
+		
+		if (strcmp(location, "-") == 0) {
+			code = server_add_route(obj, path, status, NULL);
+			continue;
+		}
+		
+		const long destination = recording_index(recording, location);
+		
+		if (destination == -1) {
+			code = -1;
+			break;
+		}
+		
+		char destination_path[64];
+		snprintf(destination_path, sizeof(destination_path), "/replay/%li", destination);
+		
+		code = server_add_route(obj, path, status, destination_path);
+	}
+	
+	fclose(file);
+	
+	if (code != 0) {
+		recording_free(recording);
+	}
+	
+	return code;
+	
+}
+
+void recording_free(struct Recording* obj) {
+	
+	for (size_t index = 0; index < obj->total_urls; index++) {
+		free(obj->urls[index]);
+	}
+	
+	free(obj->urls);
+	
+	obj->urls = NULL;
+	obj->total_urls = 0;
+	
+}
@@ -0,0 +1,71 @@
+#ifndef SERVER_H_INCLUDED
+#define SERVER_H_INCLUDED
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include <bearssl.h>
+
+/*
+A local HTTP/HTTPS stand-in for the servers unalix talks to, shared by the tests and the benchmark.
+
+Besides the routes added explicitly, every path below /redirect/ is served dynamically:
+
+/redirect/<n>   302 to /redirect/<n - 1> (keeping the query string); /redirect/0 answers 200
+
+The query string of any request can further shape the response:
+
+delay=<ms>      wait that long before answering
+status=<code>   use that status code for redirects instead of 302
+size=<bytes>    send a body of that size, framed with Content-Length
+chunked=<bytes> send a body of that size, with chunked transfer encoding
+
+Routes given a body with server_set_route_body() send it as is, along with its ETag if one was
+set; requests carrying a matching If-None-Match header are answered with 304 instead.
+
+With TLS enabled, the server presents test/certificates/localhost.der, which is issued by
+test/certificates/ca.der.
+*/
+
+#define SERVER_MAX_ROUTES 1024
+
+struct ServerRoute {
+	char* path;
+	int status;
+	char* location;
+	char* body;
+	size_t body_size;
+	char* etag;
+};
+
+struct Server {
+	int fd;
+	int port;
+	int tls;
+	pthread_t thread;
+	struct ServerRoute routes[SERVER_MAX_ROUTES];
+	size_t total_routes;
+	size_t total_requests;
+	size_t total_connections;
+	size_t active_connections;
+	unsigned char certificate[2048];
+	br_x509_certificate chain;
+	br_skey_decoder_context key;
+};
+
+struct Recording {
+	char** urls; // The URL served at /replay/<index>
+	size_t total_urls;
+};
+
+int server_start(struct Server* obj, const int tls);
+void server_stop(struct Server* obj);
+int server_add_route(struct Server* obj, const char* const path, const int status, const char* const location);
+int server_set_route_body(struct Server* obj, const char* const path, const char* const body, const size_t body_size, const char* const etag);
+
+int server_load_recording(struct Server* obj, const char* const filename, struct Recording* recording);
+void recording_free(struct Recording* obj);
+
+int read_file(const char* const filename, unsigned char* buffer, const size_t buffer_size, size_t* size);
+
+#endif
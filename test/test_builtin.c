@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "unalix.h"
+#include "errors.h"
+#include "ruleset.h"
+#include "ruleset_segment.h"
+#include "clean.h"
+
+// Generated from test/rulesets/rulesets.json by tool/ruleset_compiler.c
+extern const unsigned char* const TEST_BUILTIN_RULESET;
+extern const size_t TEST_BUILTIN_RULESET_SIZE;
+
+static const char* const URLS[] = {
+	"https://example.com/?exampleRule=1&a=2",
+	"https://example.com/?exampleReferralMarketing=1",
+	"https://example.com/exampleRawRule?a=1",
+	"https://example.com/exampleException?exampleRule=1",
+	"https://example.com/?exampleRedirection=https%3A%2F%2Fexample.org%2F",
+	"https://example.org/?exampleRule=1"
+};
+
+int main() {
+	
+	int code = 0;
+	
+	code = unalix_load_builtin();
+	assert (code == UNALIXERR_SUCCESS || code == UNALIXERR_RULESETS_NOT_BUILTIN);
+	
+	unalix_unload_rulesets();
+	
+	code = unalix_load_file("./test/rulesets/rulesets.json");
+	assert (code == UNALIXERR_SUCCESS);
+	
+	const size_t total_urls = sizeof(URLS) / sizeof(*URLS);
+	char* expected[sizeof(URLS) / sizeof(*URLS)];
+	
+	for (size_t index = 0; index < total_urls; index++) {
+		expected[index] = clean(URLS[index]);
+	}
+	
+	unalix_unload_rulesets();
+	
+	// The embedded segment is read-only, so its patterns are copied out of it
+	struct Rulesets attached = {0};
+	
+	code = ruleset_segment_attach(TEST_BUILTIN_RULESET, TEST_BUILTIN_RULESET_SIZE, &attached);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (attached.offset == 1);
+	assert (!attached.patterns_borrowed);
+	
+	code = set_rulesets(&attached);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	for (size_t index = 0; index < total_urls; index++) {
+		char* target_url = clean(URLS[index]);
+		
+		if (strcmp(target_url, expected[index]) != 0) {
+			fprintf(stderr, "%s: expected %s, got %s\n", URLS[index], expected[index], target_url);
+			abort();
+		}
+		
+		free(target_url);
+		free(expected[index]);
+	}
+	
+	unalix_unload_rulesets();
+	
+	// Segments from another PCRE2 version (or anything else) are rejected
+	unsigned char* segment = (unsigned char*) malloc(TEST_BUILTIN_RULESET_SIZE);
+	assert (segment != NULL);
+	
+	memcpy(segment, TEST_BUILTIN_RULESET, TEST_BUILTIN_RULESET_SIZE);
+	((struct RulesetSegmentHeader*) segment)->pcre2_version++;
+	
+	code = ruleset_segment_attach(segment, TEST_BUILTIN_RULESET_SIZE, &attached);
+	assert (code == UNALIXERR_RULESETS_SEGMENT_INVALID);
+	
+	code = ruleset_segment_attach(segment, TEST_BUILTIN_RULESET_SIZE - 1, &attached);
+	assert (code == UNALIXERR_RULESETS_SEGMENT_INVALID);
+	
+	free(segment);
+	
+	return 0;
+	
+}
@@ -1,3 +1,5 @@
+#include <stdlib.h>
+#include <stdio.h>
 #include <assert.h>
 #include <string.h>
 
@@ -32,6 +34,20 @@ int main() {
 		strip_duplicates
 	);
 	
+	assert (code == UNALIXERR_ARG_INVALID);
+	
+	code = unalix_clean_url(
+		"https://example.com/",
+		&target_url,
+		ignore_referral_marketing,
+		ignore_rules,
+		ignore_exceptions,
+		ignore_raw_rules,
+		ignore_redirections,
+		strip_empty,
+		strip_duplicates
+	);
+	
 	assert (code == UNALIXERR_RULESETS_EMPTY);
 	
 	code = unalix_load_file("./test/rulesets/rulesets.json");
@@ -65,7 +81,7 @@ int main() {
 	assert (code == UNALIXERR_JSON_MISSING_REQUIRED_KEY);
 	
 	code = unalix_load_file("./test/rulesets/this_file_does_not_exists.json");
-	assert (code == UNALIXERR_CANNOT_OPEN_FILE);
+	assert (code == UNALIXERR_FILE_CANNOT_OPEN);
 	
 	source_url = "https://example.com/?exampleRule=exampleValue";
 	
@@ -323,6 +339,64 @@ int main() {
 	assert (strcmp(target_url, "http://example.com/?a=value") == 0);
 	free(target_url);
 	
+	// Nested redirections are followed...
+	source_url = "https://example.com/?exampleRedirection=https%3A%2F%2Fexample.com%2F%3FexampleRedirection%3Dexample.org%252F";
+	
+	code = unalix_clean_url(
+		source_url,
+		&target_url,
+		ignore_referral_marketing,
+		ignore_rules,
+		ignore_exceptions,
+		ignore_raw_rules,
+		ignore_redirections,
+		strip_empty,
+		strip_duplicates
+	);
+	
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, "http://example.org/") == 0);
+	free(target_url);
+	
+	// ...up to the maximum depth, where the URL reached is cleaned as is
+	unalix_clean_url_max_depth(1);
+	
+	code = unalix_clean_url(
+		source_url,
+		&target_url,
+		ignore_referral_marketing,
+		ignore_rules,
+		ignore_exceptions,
+		ignore_raw_rules,
+		ignore_redirections,
+		strip_empty,
+		strip_duplicates
+	);
+	
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, "https://example.com/?exampleRedirection=example.org%2F") == 0);
+	free(target_url);
+	
+	unalix_clean_url_max_depth(0);
+	
+	code = unalix_clean_url(
+		source_url,
+		&target_url,
+		ignore_referral_marketing,
+		ignore_rules,
+		ignore_exceptions,
+		ignore_raw_rules,
+		ignore_redirections,
+		strip_empty,
+		strip_duplicates
+	);
+	
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strncmp(target_url, "https://example.com/?exampleRedirection=https", 45) == 0);
+	free(target_url);
+	
+	unalix_clean_url_max_depth(16);
+	
 	unalix_unload_rulesets();
 	
 	return 0;
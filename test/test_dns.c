@@ -0,0 +1,367 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "unalix.h"
+#include "dns.h"
+#include "dns_cache.h"
+#include "errors.h"
+
+/*
+A local stand-in for a recursive DNS server, answering over both UDP and TCP.
+
+www.example.test     CNAME cdn.example.test, which has 2 A records and 1 AAAA record
+nx.example.test      NXDOMAIN
+big.example.test     Truncated over UDP, 1 A record over TCP
+silent.example.test  Never answered
+v4only.example.test  1 A record, AAAA queries never answered
+*/
+
+static int udp_fd = -1;
+static int tcp_fd = -1;
+static int port = 0;
+static volatile int should_stop = 0;
+
+static size_t put_u16(unsigned char* buffer, const unsigned short value) {
+	
+	buffer[0] = (unsigned char) (value >> 8);
+	buffer[1] = (unsigned char) (value & 0xFF);
+	
+	return 2;
+	
+}
+
+static size_t put_record(unsigned char* buffer, const unsigned short name_pointer, const unsigned short type, const unsigned int ttl, const unsigned char* rdata, const unsigned short rdata_size) {
+	
+	size_t offset = 0;
+	
+	offset += put_u16(buffer + offset, 0xC000 | name_pointer);
+	offset += put_u16(buffer + offset, type);
+	offset += put_u16(buffer + offset, 1);
+	offset += put_u16(buffer + offset, (unsigned short) (ttl >> 16));
+	offset += put_u16(buffer + offset, (unsigned short) (ttl & 0xFFFF));
+	offset += put_u16(buffer + offset, rdata_size);
+	
+	memcpy(buffer + offset, rdata, rdata_size);
+	offset += rdata_size;
+	
+	return offset;
+	
+}
+
+static size_t answer(const unsigned char* query, const size_t query_size, unsigned char* response, const int is_tcp) {
+	
+	char name[256] = {0};
+	size_t offset = 12;
+	
+	while (query[offset] != 0) {
+		if (*name != '\0') {
+			strcat(name, ".");
+		}
+		
+		strncat(name, (const char*) query + offset + 1, query[offset]);
+		offset += query[offset] + 1;
+	}
+	
+	offset++;
+	
+	const unsigned short qtype = (unsigned short) ((query[offset] << 8) | query[offset + 1]);
+	const size_t question_end = offset + 4;
+	
+	if (strcmp(name, "silent.example.test") == 0 || (strcmp(name, "v4only.example.test") == 0 && qtype == DNS_QTYPE_AAAA) || question_end > query_size) {
+		return 0;
+	}
+	
+	memcpy(response, query, question_end);
+	
+	unsigned short flags = 0x8180;
+	unsigned short ancount = 0;
+	
+	size_t size = question_end;
+	
+	if (strcmp(name, "www.example.test") == 0) {
+		// cdn.example.test, compressed against the question
+		const unsigned char cname[] = {3, 'c', 'd', 'n', 0xC0, 16};
+		const unsigned short cname_offset = (unsigned short) (size + 12);
+		
+		size += put_record(response + size, 12, DNS_QTYPE_CNAME, 600, cname, sizeof(cname));
+		ancount++;
+		
+		if (qtype == DNS_QTYPE_A) {
+			const unsigned char a1[] = {127, 0, 0, 10};
+			const unsigned char a2[] = {127, 0, 0, 11};
+			
+			size += put_record(response + size, cname_offset, DNS_QTYPE_A, 300, a1, sizeof(a1));
+			size += put_record(response + size, cname_offset, DNS_QTYPE_A, 120, a2, sizeof(a2));
+			ancount += 2;
+		} else {
+			unsigned char aaaa[16] = {0};
+			aaaa[15] = 1;
+			
+			size += put_record(response + size, cname_offset, DNS_QTYPE_AAAA, 200, aaaa, sizeof(aaaa));
+			ancount++;
+		}
+	} else if (strcmp(name, "v4only.example.test") == 0) {
+		const unsigned char a[] = {127, 0, 0, 13};
+		
+		size += put_record(response + size, 12, DNS_QTYPE_A, 60, a, sizeof(a));
+		ancount++;
+	} else if (strcmp(name, "nx.example.test") == 0) {
+		flags |= 3;
+	} else if (strcmp(name, "big.example.test") == 0) {
+		if (!is_tcp) {
+			flags |= 0x0200;
+		} else if (qtype == DNS_QTYPE_A) {
+			const unsigned char a[] = {127, 0, 0, 12};
+			
+			size += put_record(response + size, 12, DNS_QTYPE_A, 60, a, sizeof(a));
+			ancount++;
+		}
+	} else {
+		flags |= 3;
+	}
+	
+	put_u16(response + 2, flags);
+	put_u16(response + 6, ancount);
+	
+	return size;
+	
+}
+
+static void* serve(void* argument) {
+	
+	(void) argument;
+	
+	while (!should_stop) {
+		struct pollfd fds[] = {
+			{.fd = udp_fd, .events = POLLIN},
+			{.fd = tcp_fd, .events = POLLIN}
+		};
+		
+		if (poll(fds, 2, 50) < 1) {
+			continue;
+		}
+		
+		if (fds[0].revents & POLLIN) {
+			unsigned char query[512];
+			unsigned char response[512];
+			
+			struct sockaddr_storage peer = {0};
+			socklen_t peer_size = sizeof(peer);
+			
+			const ssize_t size = recvfrom(udp_fd, query, sizeof(query), 0, (struct sockaddr*) &peer, &peer_size);
+			
+			if (size > 12) {
+				const size_t response_size = answer(query, (size_t) size, response, 0);
+				
+				if (response_size > 0) {
+					sendto(udp_fd, response, response_size, 0, (struct sockaddr*) &peer, peer_size);
+				}
+			}
+		}
+		
+		if (fds[1].revents & POLLIN) {
+			const int fd = accept(tcp_fd, NULL, NULL);
+			
+			unsigned char buffer[1024];
+			size_t offset = 0;
+			
+			while (1) {
+				const ssize_t size = recv(fd, buffer + offset, sizeof(buffer) - offset, 0);
+				
+				if (size <= 0) {
+					break;
+				}
+				
+				offset += (size_t) size;
+				
+				while (offset >= 2 && offset >= (size_t) ((buffer[0] << 8) | buffer[1]) + 2) {
+					const size_t query_size = (size_t) ((buffer[0] << 8) | buffer[1]);
+					
+					unsigned char response[1024];
+					const size_t response_size = answer(buffer + 2, query_size, response + 2, 1);
+					
+					put_u16(response, (unsigned short) response_size);
+					send(fd, response, response_size + 2, 0);
+					
+					offset -= query_size + 2;
+					memmove(buffer, buffer + query_size + 2, offset);
+				}
+			}
+			
+			close(fd);
+		}
+	}
+	
+	return NULL;
+	
+}
+
+static void* resolve_repeatedly(void* argument) {
+	
+	(void) argument;
+	
+	for (size_t index = 0; index < 50; index++) {
+		struct Addresses addresses = {0};
+		dns_cache_resolve("www.example.test", 443, &addresses);
+	}
+	
+	return NULL;
+	
+}
+
+static void start_server(void) {
+	
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+	};
+	socklen_t addr_size = sizeof(addr);
+	
+	udp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	assert (bind(udp_fd, (struct sockaddr*) &addr, sizeof(addr)) == 0);
+	assert (getsockname(udp_fd, (struct sockaddr*) &addr, &addr_size) == 0);
+	
+	port = ntohs(addr.sin_port);
+	
+	const int enabled = 1;
+	
+	tcp_fd = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(tcp_fd, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled));
+	assert (bind(tcp_fd, (struct sockaddr*) &addr, sizeof(addr)) == 0);
+	assert (listen(tcp_fd, 8) == 0);
+	
+}
+
+int main() {
+	
+	int code = 0;
+	int ttl = 0;
+	
+	char* buffer = NULL;
+	size_t buffer_size = 0;
+	
+	struct Addresses addresses = {0};
+	
+	// Request serialization
+	const struct DNSRequest request = {
+		.id = 0x1234,
+		.qtype = DNS_QTYPE_AAAA,
+		.domain_name = "example.com",
+		.specification = DNS_OVER_PLAIN_TCP
+	};
+	
+	code = dns_request_stringify(request, &buffer, &buffer_size);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (buffer_size == 31);
+	assert (memcmp(buffer, "\x00\x1d\x12\x34\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00\x07""example\x03""com\x00\x00\x1c\x00\x01", buffer_size) == 0);
+	
+	free(buffer);
+	
+	start_server();
+	
+	pthread_t thread;
+	pthread_create(&thread, NULL, serve, NULL);
+	
+	char uri[64];
+	struct DNSServer server = {.timeout = 2000};
+	
+	// UDP
+	snprintf(uri, sizeof(uri), "udp://127.0.0.1:%i", port);
+	
+	code = dns_server_parse(&server, uri);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (server.specification == DNS_OVER_PLAIN_UDP);
+	
+	code = dns_query(&server, "www.example.test", &addresses, &ttl);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (addresses.offset == 3);
+	assert (addresses.items[0].af == AF_INET);
+	assert (addresses.items[1].af == AF_INET);
+	assert (addresses.items[2].af == AF_INET6);
+	assert (ttl == 120);
+	
+	code = dns_query(&server, "nx.example.test", &addresses, &ttl);
+	assert (code == UNALIXERR_DNS_NXDOMAIN);
+	
+	// Truncated answers are retried over TCP
+	code = dns_query(&server, "big.example.test", &addresses, &ttl);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (addresses.offset == 1);
+	assert (ttl == 60);
+	
+	// TCP
+	snprintf(uri, sizeof(uri), "tcp://127.0.0.1:%i", port);
+	
+	code = dns_server_parse(&server, uri);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (server.specification == DNS_OVER_PLAIN_TCP);
+	
+	code = dns_query(&server, "www.example.test", &addresses, &ttl);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (addresses.offset == 3);
+	assert (ttl == 120);
+	
+	// Unanswered queries don't block past the timeout
+	snprintf(uri, sizeof(uri), "udp://127.0.0.1:%i", port);
+	
+	server.timeout = 300;
+	
+	code = dns_server_parse(&server, uri);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = dns_query(&server, "silent.example.test", &addresses, &ttl);
+	assert (code == UNALIXERR_DNS_TIMEOUT);
+	
+	// Answers that did arrive are kept when the other query times out
+	code = dns_query(&server, "v4only.example.test", &addresses, &ttl);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (addresses.offset == 1);
+	assert (addresses.items[0].af == AF_INET);
+	assert (ttl == 60);
+	
+	code = dns_server_parse(&server, "https://127.0.0.1/dns-query");
+	assert (code == UNALIXERR_DNS_UNSUPPORTED_PROTOCOL);
+	
+	// Through the cache used by the HTTP client
+	code = unalix_dns_set_server(uri, 2000);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = dns_cache_resolve("www.example.test", 443, &addresses);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (addresses.offset == 3);
+	assert (ntohs(((struct sockaddr_in*) &addresses.items[0].addr_storage)->sin_port) == 443);
+	
+	// The server can be replaced while lookups through the previous one are in flight
+	pthread_t resolvers[4];
+	
+	for (size_t index = 0; index < sizeof(resolvers) / sizeof(*resolvers); index++) {
+		pthread_create(&resolvers[index], NULL, resolve_repeatedly, NULL);
+	}
+	
+	for (size_t index = 0; index < 50; index++) {
+		code = unalix_dns_set_server(uri, 2000);
+		assert (code == UNALIXERR_SUCCESS);
+	}
+	
+	for (size_t index = 0; index < sizeof(resolvers) / sizeof(*resolvers); index++) {
+		pthread_join(resolvers[index], NULL);
+	}
+	
+	unalix_dns_set_server(NULL, 0);
+	
+	should_stop = 1;
+	pthread_join(thread, NULL);
+	
+	close(udp_fd);
+	close(tcp_fd);
+	
+	return 0;
+	
+}
@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "unalix.h"
+#include "dns_cache.h"
+#include "address.h"
+#include "errors.h"
+
+static int total_calls = 0;
+
+static int resolver(
+	const char* const hostname,
+	struct sockaddr_storage* addresses,
+	size_t* total_addresses,
+	int* ttl,
+	void* userdata
+) {
+	
+	(void) userdata;
+	
+	__atomic_add_fetch(&total_calls, 1, __ATOMIC_SEQ_CST);
+	
+	if (strcmp(hostname, "nxdomain.test") == 0) {
+		return UNALIXERR_DNS_GAI_FAILURE;
+	}
+	
+	struct sockaddr_in* const addr = (struct sockaddr_in*) &addresses[0];
+	memset(addr, 0, sizeof(*addresses));
+	
+	addr->sin_family = AF_INET;
+	inet_pton(AF_INET, "127.0.0.2", &addr->sin_addr);
+	
+	*total_addresses = 1;
+	*ttl = strcmp(hostname, "stale.test") == 0 ? 0 : 60;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+int main() {
+	
+	int code = 0;
+	struct Addresses addresses = {0};
+	
+	unalix_dns_set_resolver(resolver, NULL);
+	
+	// Fresh entries are served from the cache
+	code = dns_cache_resolve("example.test", 80, &addresses);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (addresses.offset == 1);
+	assert (ntohs(((struct sockaddr_in*) &addresses.items[0].addr_storage)->sin_port) == 80);
+	
+	code = dns_cache_resolve("EXAMPLE.test", 443, &addresses);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (ntohs(((struct sockaddr_in*) &addresses.items[0].addr_storage)->sin_port) == 443);
+	assert (total_calls == 1);
+	
+	// IP addresses bypass both the cache and the resolver
+	code = dns_cache_resolve("::1", 80, &addresses);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (addresses.items[0].af == AF_INET6);
+	assert (total_calls == 1);
+	
+	// Failures are cached too
+	code = dns_cache_resolve("nxdomain.test", 80, &addresses);
+	assert (code == UNALIXERR_DNS_GAI_FAILURE);
+	
+	code = dns_cache_resolve("nxdomain.test", 80, &addresses);
+	assert (code == UNALIXERR_DNS_GAI_FAILURE);
+	assert (total_calls == 2);
+	
+	// Prepopulated entries never reach the resolver
+	const char* const prepopulated[] = {"10.0.0.1", "fd00::1"};
+	
+	code = unalix_dns_cache_add("prepopulated.test", prepopulated, 2, 60);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = dns_cache_resolve("prepopulated.test", 8080, &addresses);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (addresses.offset == 2);
+	assert (addresses.items[0].af == AF_INET);
+	assert (addresses.items[1].af == AF_INET6);
+	assert (ntohs(((struct sockaddr_in6*) &addresses.items[1].addr_storage)->sin6_port) == 8080);
+	assert (total_calls == 2);
+	
+	// Expired entries are served stale while being revalidated in the background
+	code = dns_cache_resolve("stale.test", 80, &addresses);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (total_calls == 3);
+	
+	code = dns_cache_resolve("stale.test", 80, &addresses);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (addresses.offset == 1);
+	
+	for (int index = 0; index < 100 && __atomic_load_n(&total_calls, __ATOMIC_SEQ_CST) < 4; index++) {
+		usleep(10000);
+	}
+	
+	assert (__atomic_load_n(&total_calls, __ATOMIC_SEQ_CST) == 4);
+	
+	// The cache is bounded
+	code = unalix_dns_cache_configure(1, 60, 30, 60);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	dns_cache_resolve("a.test", 80, &addresses);
+	dns_cache_resolve("b.test", 80, &addresses);
+	dns_cache_resolve("a.test", 80, &addresses);
+	assert (total_calls == 7);
+	
+	unalix_dns_cache_clear();
+	
+	return 0;
+	
+}
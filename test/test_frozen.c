@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "unalix.h"
+#include "errors.h"
+#include "ruleset.h"
+#include "regex.h"
+#include "frozen.h"
+#include "clean.h"
+
+// Generated from test/rulesets/frozen.json by tool/ruleset.c.py
+extern const struct FrozenRuleset TEST_FROZEN_RULESET;
+
+static const char* const URLS[] = {
+	"https://example.com/?utm_source=a&id=1",
+	"https://example.com/?id=1&utm_source=a&utm_medium=b",
+	"https://example.com/?fbclid=x",
+	"https://example.com/?ref.src=x&refXsrc=y",
+	"https://example.com/?tag=x&other=1#utm=1&tag=2",
+	"https://example.com/?notutm=1&a=utm",
+	"https://example.com/?utmx",
+	"https://example.com/?a=1?utm=2",
+	"https://example.com/keep?utm=1",
+	"https://example.com/path/ref=abc?fbclid=1",
+	"https://example.com/out?to=https%3A%2F%2Fexample.com%2F%3Futm%3D1",
+	"https://www.example.com/?utm=1",
+	"https://a.b.example.com:443/?utm=1",
+	"https://user@example.com/?utm=1",
+	"https://notexample.com/?utm=1",
+	"https://example.community/?utm=1",
+	"http://example.com/?gclid=1&utm=2",
+	"https://mixed.org/?id=1&sess12=2&idle=3",
+	"https://www.mixed.org/?sess=1",
+	"https://mixed.org.evil.com/?id=1",
+	"https://shop.net/?cart=1",
+	"https://store.net/?cart=1&gclid=2",
+	"https://localhost:8080/?debug=1",
+	"https://localhost/?debug=1",
+	"https://complete.com/?utm=1",
+	"https://ignored.com/?ignored=1",
+	"ftp://example.com/?utm=1"
+};
+
+static void check_literal_strip(const char* const rule, const char* const literal, const char* const subject, const char* const expected) {
+	
+	// Must behave exactly like the compiled rule
+	pcre2_code* pattern = NULL;
+	assert (rule_compile(rule, PATTERN_USAGE_STRIP_PARAMETER, &pattern) == UNALIXERR_SUCCESS);
+	
+	char* a = (char*) malloc(strlen(subject) + 1);
+	char* b = (char*) malloc(strlen(subject) + 1);
+	
+	assert (a != NULL && b != NULL);
+	
+	strcpy(a, subject);
+	strcpy(b, subject);
+	
+	regex_strip(pattern, (PCRE2_SPTR) a, &a);
+	literal_strip(literal, &b);
+	
+	pcre2_code_free(pattern);
+	
+	if (expected == NULL) {
+		assert (a == NULL && b == NULL);
+		return;
+	}
+	
+	assert (a != NULL && b != NULL);
+	assert (strcmp(a, expected) == 0);
+	assert (strcmp(b, expected) == 0);
+	
+	free(a);
+	free(b);
+	
+}
+
+int main() {
+	
+	int code = 0;
+	
+	code = unalix_load_frozen();
+	assert (code == UNALIXERR_SUCCESS || code == UNALIXERR_RULESETS_NOT_BUILTIN);
+	
+	unalix_unload_rulesets();
+	
+	// Literal rules
+	check_literal_strip("utm", "utm", "utm=1", NULL);
+	check_literal_strip("utm", "utm", "utm=1&a=2", "&a=2");
+	check_literal_strip("utm", "utm", "a=1&utm=2&b=3", "a=1&b=3");
+	check_literal_strip("utm", "utm", "a=1&utm_source=2", "a=1_source=2");
+	check_literal_strip("utm", "utm", "a=utm&notutm=1", "a=utm&notutm=1");
+	check_literal_strip("utm", "utm", "a=1?utm=2&utm", "a=1");
+	check_literal_strip("utm", "utm", "&utm=1", NULL);
+	check_literal_strip("utm", "utm", "utmutm", "utm");
+	check_literal_strip("ref\\.src", "ref.src", "ref.src=1&refXsrc=2", "&refXsrc=2");
+	
+	// Perfect hash sets
+	const struct FrozenProvider* const example = &TEST_FROZEN_RULESET.providers[0];
+	const struct FrozenSet* const set = &example->lists[FROZEN_LIST_RULES].set;
+	
+	assert (example->lists[FROZEN_LIST_RULES].all_literal);
+	assert (frozen_set_contains(set, "utm", 3));
+	assert (frozen_set_contains(set, "ref.src", 7));
+	assert (!frozen_set_contains(set, "utn", 3));
+	assert (!frozen_set_contains(set, "ut", 2));
+	
+	assert (frozen_set_matches_parameters(set, "utm_source=1"));
+	assert (frozen_set_matches_parameters(set, "a=1&fbclid=2"));
+	assert (!frozen_set_matches_parameters(set, "a=utm&notutm=1"));
+	assert (!frozen_set_matches_parameters(set, ""));
+	
+	// Host labels
+	assert (TEST_FROZEN_RULESET.total_providers == 5);
+	
+	assert (strcmp(example->host, "example") == 0);
+	assert (strcmp(TEST_FROZEN_RULESET.providers[1].host, "mixed") == 0);
+	assert (TEST_FROZEN_RULESET.providers[2].host == NULL);
+	assert (TEST_FROZEN_RULESET.providers[3].host == NULL);
+	assert (strcmp(TEST_FROZEN_RULESET.providers[4].host, "localhost") == 0);
+	
+	assert (!TEST_FROZEN_RULESET.providers[1].lists[FROZEN_LIST_RULES].all_literal);
+	
+	unsigned char candidates[5];
+	
+	frozen_candidates(&TEST_FROZEN_RULESET, "https://a.example.com:8080/", candidates);
+	assert (candidates[0] && !candidates[1] && !candidates[4]);
+	
+	frozen_candidates(&TEST_FROZEN_RULESET, "https://mixed.org/example", candidates);
+	assert (!candidates[0] && candidates[1]);
+	
+	frozen_candidates(&TEST_FROZEN_RULESET, "example.com", candidates);
+	assert (!candidates[0]);
+	
+	// The frozen ruleset cleans URLs exactly like the same ruleset loaded from JSON
+	code = unalix_load_file("./test/rulesets/frozen.json");
+	assert (code == UNALIXERR_SUCCESS);
+	
+	const size_t total_urls = sizeof(URLS) / sizeof(*URLS);
+	char* expected[sizeof(URLS) / sizeof(*URLS)];
+	
+	for (size_t index = 0; index < total_urls; index++) {
+		expected[index] = clean(URLS[index]);
+	}
+	
+	struct Rulesets compiled = {0};
+	
+	code = frozen_load(&TEST_FROZEN_RULESET, &compiled);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = set_rulesets(&compiled);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	for (size_t index = 0; index < total_urls; index++) {
+		char* target_url = clean(URLS[index]);
+		
+		if (strcmp(target_url, expected[index]) != 0) {
+			fprintf(stderr, "%s: expected %s, got %s\n", URLS[index], expected[index], target_url);
+			abort();
+		}
+		
+		free(target_url);
+	}
+	
+	char* target_url = clean("https://www.example.com/?a=1&utm=2&tag=3");
+	assert (strcmp(target_url, "https://www.example.com/?a=1") == 0);
+	free(target_url);
+	
+	// Rulesets loaded from JSON afterwards are added after the frozen ones
+	code = unalix_load_file("./test/rulesets/rulesets.json");
+	assert (code == UNALIXERR_SUCCESS);
+	
+	target_url = clean("https://example.com/?exampleRule=1&utm=2");
+	assert (strcmp(target_url, "https://example.com/") == 0);
+	free(target_url);
+	
+	for (size_t index = 0; index < total_urls; index++) {
+		free(expected[index]);
+	}
+	
+	unalix_unload_rulesets();
+	
+	return 0;
+	
+}
@@ -1,24 +1,104 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
 
 #include "http.h"
 #include "errors.h"
 
+static const char* const RESPONSES[] = {
+	// Sent one byte at a time, so that every line is split across reads; the body ends with the connection
+	"HTTP/1.1 301 Moved Permanently\r\n"
+	"location:  http://example.com/  \r\n"
+	"Content-Type: text/plain\r\n"
+	"\r\n"
+	"body",
+	
+	// The connection stays open after these, so the body must end where its framing says
+	"HTTP/1.1 200 OK\r\n"
+	"Transfer-Encoding: chunked\r\n"
+	"\r\n"
+	"4;name=value\r\n"
+	"Wiki\r\n"
+	"6\r\n"
+	"pedia \r\n"
+	"E\r\n"
+	"in \r\n"
+	"\r\n"
+	"chunks.\r\n"
+	"0\r\n"
+	"X-Trailer: value\r\n"
+	"\r\n",
+	
+	"HTTP/1.1 200 OK\r\n"
+	"Content-Length: 5\r\n"
+	"\r\n"
+	"hello"
+};
+
+static int server_fd = -1;
+
+static void* serve(void* argument) {
+	
+	(void) argument;
+	
+	for (size_t index = 0; index < sizeof(RESPONSES) / sizeof(*RESPONSES); index++) {
+		const char* const response = RESPONSES[index];
+		
+		const int fd = accept(server_fd, NULL, NULL);
+		const int enabled = 1;
+		
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+		
+		char request[1024];
+		recv(fd, request, sizeof(request), 0);
+		
+		if (index == 0) {
+			for (size_t offset = 0; offset < strlen(response); offset++) {
+				send(fd, response + offset, 1, MSG_NOSIGNAL);
+				usleep(500);
+			}
+		} else {
+			send(fd, response, strlen(response), MSG_NOSIGNAL);
+			
+			while (recv(fd, request, sizeof(request), 0) > 0);
+		}
+		
+		close(fd);
+	}
+	
+	return NULL;
+	
+}
+
+static int append_sink(const char* const buffer, const size_t buffer_size, void* userdata) {
+	
+	strncat((char*) userdata, buffer, buffer_size);
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
 int main() {
 	
 	int code = 0;
-	struct HTTPRequest request = {};
+	struct HTTPContext context = {0};
+	struct HTTPRequest* request = &context.request;
 	
 	char* buffer = NULL;
 	size_t buffer_size = 0;
 	
-	request.version = HTTP10;
-	request.method = GET;
+	request->version = HTTP10;
+	request->method = GET;
 	
-	http_request_set_url(&request, "http://example.com/");
+	http_request_set_url(&context, "http://example.com/");
 	
-	code = http_request_stringify(&request, &buffer, &buffer_size);
+	code = http_request_stringify(request, &buffer, &buffer_size);
 	assert (code == UNALIXERR_SUCCESS);
 	
 	assert (strncmp("GET / HTTP/1.0\r\nHost: example.com\r\n\r\n", buffer, 37) == 0);
@@ -26,14 +106,14 @@ int main() {
 	free(buffer);
 	buffer = NULL;
 	
-	http_request_free(&request);
+	http_request_free(request);
 	
-	request.version = HTTP10;
-	request.method = GET;
+	request->version = HTTP10;
+	request->method = GET;
 	
-	http_request_set_url(&request, "http://example.com:8080/path?key=value#fragment");
+	http_request_set_url(&context, "http://example.com:8080/path?key=value#fragment");
 	
-	code = http_request_stringify(&request, &buffer, &buffer_size);
+	code = http_request_stringify(request, &buffer, &buffer_size);
 	assert (code == UNALIXERR_SUCCESS);
 	
 	assert (strncmp("GET /path?key=value HTTP/1.0\r\nHost: example.com:8080\r\n\r\n", buffer, 56) == 0);
@@ -41,19 +121,19 @@ int main() {
 	free(buffer);
 	buffer = NULL;
 	
-	http_request_free(&request);
+	http_request_free(request);
 	
-	request.version = HTTP10;
-	request.method = GET;
+	request->version = HTTP10;
+	request->method = GET;
 	
-	http_headers_add(&request.headers, "Accept", "*/*");
-	http_headers_add(&request.headers, "User-Agent", "Unalix/0.1");
+	http_request_add_header(&context, "Accept", "*/*");
+	http_request_add_header(&context, "User-Agent", "Unalix/0.1");
 	
-	http_request_set_url(&request, "http://example.com/");
+	http_request_set_url(&context, "http://example.com/");
 	
-	http_body_set(&request.body, "Hello World!", 12);
+	http_body_set(&request->body, "Hello World!", 12);
 	
-	code = http_request_stringify(&request, &buffer, &buffer_size);
+	code = http_request_stringify(request, &buffer, &buffer_size);
 	assert (code == UNALIXERR_SUCCESS);
 	
 	assert (strncmp("GET / HTTP/1.0\r\nAccept: */*\r\nUser-Agent: Unalix/0.1\r\nHost: example.com\r\nContent-Length: 12\r\n\r\nHello World!", buffer, 106) == 0);
@@ -61,16 +141,16 @@ int main() {
 	free(buffer);
 	buffer = NULL;
 	
-	http_request_free(&request);
+	http_request_free(request);
 	
-	request.version = HTTP10;
-	request.method = GET;
+	request->version = HTTP10;
+	request->method = GET;
 	
-	http_request_set_url(&request, "http://example.com/");
+	http_request_set_url(&context, "http://example.com/");
 	
-	http_body_set(&request.body, "\0\0\0", 3);
+	http_body_set(&request->body, "\0\0\0", 3);
 	
-	code = http_request_stringify(&request, &buffer, &buffer_size);
+	code = http_request_stringify(request, &buffer, &buffer_size);
 	assert (code == UNALIXERR_SUCCESS);
 	
 	assert (strncmp("GET / HTTP/1.0\r\nHost: example.com\r\nContent-Length: 3\r\n\r\n\0\0\0", buffer, 59) == 0);
@@ -78,7 +158,130 @@ int main() {
 	free(buffer);
 	buffer = NULL;
 	
-	http_request_free(&request);
+	http_request_free(request);
+	
+	// Static headers and a reused serialization buffer
+	struct HTTPBody serialized = {0};
+	
+	request->version = HTTP11;
+	request->method = HEAD;
+	
+	http_request_add_static_header(&context, "Accept", "*/*");
+	http_request_set_url(&context, "http://example.com/a");
+	
+	code = http_request_serialize(request, &serialized);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (serialized.size == 52);
+	assert (memcmp("HEAD /a HTTP/1.1\r\nAccept: */*\r\nHost: example.com\r\n\r\n", serialized.content, serialized.size) == 0);
+	
+	http_request_free(request);
+	
+	request->version = HTTP11;
+	request->method = GET;
+	
+	http_request_set_url(&context, "http://example.com/");
+	
+	const char* const previous_content = serialized.content;
+	
+	code = http_request_serialize(request, &serialized);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (serialized.content == previous_content);
+	assert (memcmp("GET / HTTP/1.1\r\nHost: example.com\r\n\r\n", serialized.content, serialized.size) == 0);
+	
+	free(serialized.content);
+	http_request_free(request);
+	
+	// Response parsing
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+	};
+	socklen_t addr_size = sizeof(addr);
+	
+	server_fd = socket(AF_INET, SOCK_STREAM, 0);
+	assert (bind(server_fd, (struct sockaddr*) &addr, sizeof(addr)) == 0);
+	assert (getsockname(server_fd, (struct sockaddr*) &addr, &addr_size) == 0);
+	assert (listen(server_fd, 1) == 0);
+	
+	pthread_t thread;
+	pthread_create(&thread, NULL, serve, NULL);
+	
+	char url[64];
+	snprintf(url, sizeof(url), "http://127.0.0.1:%i/", ntohs(addr.sin_port));
+	
+	request->version = HTTP11;
+	request->method = GET;
+	context.connection.timeout = 5;
+	
+	code = http_request_set_url(&context, url);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = http_request_send(&context);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	assert (http_response_get_status(&context)->code == MOVED_PERMANENTLY);
+	assert (context.response.version == HTTP11);
+	assert (context.response.headers.offset == 2);
+	
+	// Names are matched case-insensitively, values are trimmed
+	const struct HTTPHeader* header = http_response_get_header(&context, "Location");
+	assert (header != NULL);
+	assert (strcmp(header->value, "http://example.com/") == 0);
+	
+	header = http_response_get_header(&context, "CONTENT-TYPE");
+	assert (header != NULL);
+	assert (strcmp(header->value, "text/plain") == 0);
+	
+	code = http_response_read(&context, NULL);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	const struct HTTPBody* body = http_response_get_body(&context);
+	assert (body->size == 4);
+	assert (memcmp(body->content, "body", body->size) == 0);
+	
+	http_context_free(&context);
+	
+	// Chunked transfer coding
+	request->version = HTTP11;
+	request->method = GET;
+	context.connection.timeout = 5;
+	
+	code = http_request_set_url(&context, url);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = http_request_send(&context);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	char content[64] = {0};
+	
+	code = http_response_stream(&context, append_sink, content);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(content, "Wikipedia in \r\n\r\nchunks.") == 0);
+	
+	http_context_free(&context);
+	
+	// Content-Length
+	request->version = HTTP11;
+	request->method = GET;
+	context.connection.timeout = 5;
+	
+	code = http_request_set_url(&context, url);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = http_request_send(&context);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = http_response_read(&context, NULL);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	body = http_response_get_body(&context);
+	assert (body->size == 5);
+	assert (memcmp(body->content, "hello", body->size) == 0);
+	
+	http_context_free(&context);
+	
+	pthread_join(thread, NULL);
+	close(server_fd);
 	
 	return 0;
 	
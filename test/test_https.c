@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "unalix.h"
+#include "http.h"
+#include "errors.h"
+#include "server.h"
+
+static long long elapsed_ms(const struct timespec start) {
+	
+	struct timespec now = {0};
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	
+	return (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+	
+}
+
+static void unshort(const char* const source_url, const char* const expected_url, const int timeout, const int expected_code) {
+	
+	char* target_url = NULL;
+	
+	const int code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, timeout);
+	assert (code == expected_code);
+	
+	if (expected_url != NULL) {
+		assert (strcmp(target_url, expected_url) == 0);
+	}
+	
+	free(target_url);
+	
+}
+
+int main() {
+	
+	int code = 0;
+	
+	char source_url[128];
+	char expected_url[128];
+	
+	code = unalix_load_file("./test/rulesets/rulesets.json");
+	assert (code == UNALIXERR_SUCCESS);
+	
+	unsigned char ca[2048];
+	size_t ca_size = 0;
+	
+	assert (read_file("./test/certificates/ca.der", ca, sizeof(ca), &ca_size) == 0);
+	
+	code = unalix_ssl_add_trust_anchor(ca, ca_size);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	const char* const loopback[] = {"127.0.0.1"};
+	
+	code = unalix_dns_cache_add("localhost", loopback, 1, 60);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	struct Server server;
+	assert (server_start(&server, 1) == 0);
+	
+	// Redirect chains over TLS
+	snprintf(source_url, sizeof(source_url), "https://localhost:%i/redirect/3", server.port);
+	snprintf(expected_url, sizeof(expected_url), "https://localhost:%i/redirect/0", server.port);
+	
+	unshort(source_url, expected_url, 5, UNALIXERR_SUCCESS);
+	assert (server.total_requests == 4);
+	
+	// With validated chains cached and half-duplex buffers
+	unalix_ssl_pool_configure(4, 1);
+	
+	code = unalix_certificate_cache_configure(16);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	unshort(source_url, expected_url, 5, UNALIXERR_SUCCESS);
+	unshort(source_url, expected_url, 5, UNALIXERR_SUCCESS);
+	assert (server.total_requests == 12);
+	
+	unalix_ssl_pool_configure(4, 0);
+	
+	// The server name is still checked
+	code = unalix_dns_cache_add("not-localhost.test", loopback, 1, 60);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	snprintf(source_url, sizeof(source_url), "https://not-localhost.test:%i/redirect/0", server.port);
+	
+	unshort(source_url, NULL, 5, UNALIXERR_SSL_FAILURE);
+	
+	// Chunked bodies
+	struct HTTPContext context = {0};
+	
+	snprintf(source_url, sizeof(source_url), "https://localhost:%i/data?chunked=100000", server.port);
+	
+	code = http_request_set_url(&context, source_url);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = http_request_send(&context);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (context.response.status.code == 200);
+	
+	code = http_response_read(&context, NULL);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (context.response.body.size == 100000);
+	
+	http_context_free(&context);
+	
+	// Slow servers
+	struct timespec start = {0};
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	
+	snprintf(source_url, sizeof(source_url), "https://localhost:%i/redirect/1?delay=3000", server.port);
+	
+	unshort(source_url, NULL, 1, UNALIXERR_SOCKET_TIMEOUT);
+	assert (elapsed_ms(start) < 2000);
+	
+	server_stop(&server);
+	
+	// Recorded chains are replayed under /replay/<index>
+	char filename[] = "/tmp/unalix_recording_XXXXXX";
+	const int fd = mkstemp(filename);
+	assert (fd != -1);
+	
+	const char recording_content[] = (
+		"301 https://sho.rt/a https://example.com/redirect\n"
+		"302 https://example.com/redirect https://www.example.com/article\n"
+		"200 https://www.example.com/article -\n"
+		"301 https://sho.rt/b https://example.com/redirect\n"
+	);
+	
+	assert (write(fd, recording_content, strlen(recording_content)) == (ssize_t) strlen(recording_content));
+	close(fd);
+	
+	struct Recording recording = {0};
+	
+	assert (server_start(&server, 0) == 0);
+	assert (server_load_recording(&server, filename, &recording) == 0);
+	assert (recording.total_urls == 4);
+	assert (strcmp(recording.urls[3], "https://sho.rt/b") == 0);
+	
+	remove(filename);
+	
+	snprintf(source_url, sizeof(source_url), "http://127.0.0.1:%i/replay/3", server.port);
+	snprintf(expected_url, sizeof(expected_url), "http://127.0.0.1:%i/replay/2", server.port);
+	
+	unshort(source_url, expected_url, 5, UNALIXERR_SUCCESS);
+	assert (server.total_requests == 3);
+	
+	recording_free(&recording);
+	server_stop(&server);
+	
+	return 0;
+	
+}
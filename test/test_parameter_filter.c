@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "unalix.h"
+#include "errors.h"
+#include "ruleset.h"
+#include "ruleset_segment.h"
+#include "parameter_filter.h"
+#include "clean.h"
+
+static const char RULESET[] = "{\"providers\": {"
+	"\"literal\": {\"urlPattern\": \"^https?:\\\\/\\\\/literal\\\\.com\", \"rules\": [\"utm\", \"ref\\\\.src\"], \"referralMarketing\": [\"tag\"]},"
+	"\"mixed\": {\"urlPattern\": \"^https?:\\\\/\\\\/mixed\\\\.com\", \"rules\": [\"id\", \"sess[0-9]+\"]}"
+"}}";
+
+int main() {
+	
+	char name[PARAMETER_MAX_NAME_LENGTH + 1];
+	
+	// Rules that are plain names
+	assert (parameter_name_from_rule("utm_source", name) == 10 && strcmp(name, "utm_source") == 0);
+	assert (parameter_name_from_rule("ref\\.src", name) == 7 && strcmp(name, "ref.src") == 0);
+	assert (parameter_name_from_rule("sess[0-9]+", name) == 0);
+	assert (parameter_name_from_rule("ref.src", name) == 0);
+	assert (parameter_name_from_rule("a\\", name) == 0);
+	assert (parameter_name_from_rule("", name) == 0);
+	
+	char long_rule[PARAMETER_MAX_NAME_LENGTH + 2];
+	memset(long_rule, 'a', sizeof(long_rule) - 1);
+	long_rule[sizeof(long_rule) - 1] = '\0';
+	
+	assert (parameter_name_from_rule(long_rule, name) == 0);
+	
+	long_rule[sizeof(long_rule) - 2] = '\0';
+	assert (parameter_name_from_rule(long_rule, name) == PARAMETER_MAX_NAME_LENGTH);
+	
+	// Keys are only matched by their beginning, as the rules themselves do
+	struct ParameterFilter filter = {0};
+	
+	assert (!parameter_filter_matches(&filter, "utm=1"));
+	
+	parameter_filter_add(&filter, "utm", 3);
+	
+	assert (parameter_filter_may_contain(&filter, "utm", 3));
+	assert (!parameter_filter_may_contain(&filter, "utm", 2));
+	
+	assert (parameter_filter_matches(&filter, "utm=1"));
+	assert (parameter_filter_matches(&filter, "a=1&utm_source=2"));
+	assert (parameter_filter_matches(&filter, "a=1?utm"));
+	assert (!parameter_filter_matches(&filter, "a=utm&notutm=1"));
+	assert (!parameter_filter_matches(&filter, "ut"));
+	assert (!parameter_filter_matches(&filter, NULL));
+	
+	// Providers with rules that are not plain names are never skipped
+	int code = unalix_load_string(RULESET);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	const struct Rulesets* const rulesets = rulesets_acquire();
+	
+	assert (rulesets->offset == 2);
+	assert (rulesets->items[0].parameters_filtered);
+	assert (!rulesets->items[1].parameters_filtered);
+	
+	assert (parameter_filter_matches(&rulesets->filter, "ref.src=1"));
+	assert (parameter_filter_matches(&rulesets->filter, "id=1"));
+	assert (!parameter_filter_matches(&rulesets->filter, "sess1=1"));
+	
+	clean_expect("https://literal.com/?a=1", "https://literal.com/?a=1");
+	clean_expect("https://literal.com/?a=1&utm_source=2&tag=3#x=1&ref.src=2", "https://literal.com/?a=1_source=2#x=1");
+	clean_expect("https://mixed.com/?a=1&sess12=2", "https://mixed.com/?a=1");
+	
+	// The filter travels with the compiled rulesets
+	unsigned char* segment = NULL;
+	size_t segment_size = 0;
+	
+	code = ruleset_segment_encode(rulesets, &segment, &segment_size);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	struct Rulesets attached = {0};
+	
+	code = ruleset_segment_attach(segment, segment_size, &attached);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	assert (memcmp(&attached.filter, &rulesets->filter, sizeof(rulesets->filter)) == 0);
+	assert (attached.items[0].parameters_filtered);
+	assert (!attached.items[1].parameters_filtered);
+	
+	rulesets_release(rulesets);
+	
+	code = set_rulesets(&attached);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	free(segment);
+	
+	clean_expect("https://literal.com/?a=1&utm=2", "https://literal.com/?a=1");
+	clean_expect("https://mixed.com/?a=1&sess12=2", "https://mixed.com/?a=1");
+	
+	unalix_unload_rulesets();
+	
+	return 0;
+	
+}
@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#define PCRE2_CODE_UNIT_WIDTH 8
+
+#include <pcre2.h>
+
+#include "pattern_optimizer.h"
+
+/*
+Differential test: every pattern is compiled as written and as rewritten by pattern_optimize(), and both
+must give the same result on every subject, for what the pattern is used for.
+*/
+
+struct Case {
+	const char* pattern;
+	enum PatternUsage usage;
+	int rewritten; // Whether pattern_optimize() is expected to change anything
+};
+
+static const struct Case CASES[] = {
+	{"^https?:\\/\\/(?:[a-z0-9-]+\\.)*?example\\.com", PATTERN_USAGE_MATCH, 1},
+	{".*example\\.com\\/(?:out|redirect)", PATTERN_USAGE_MATCH, 1},
+	{".*?(utm|ref)=", PATTERN_USAGE_MATCH, 1},
+	{".*a|b", PATTERN_USAGE_MATCH, 1},
+	{".*", PATTERN_USAGE_MATCH, 1},
+	{".*|x", PATTERN_USAGE_MATCH, 1},
+	{".*(?<=m)p", PATTERN_USAGE_MATCH, 1},
+	{".*\\Gh", PATTERN_USAGE_MATCH, 1},
+	{"^.*\\/out", PATTERN_USAGE_MATCH, 1},
+	{".*+x", PATTERN_USAGE_MATCH, 1},
+	{".+\\.com", PATTERN_USAGE_MATCH, 1},
+	{"(e)x\\1", PATTERN_USAGE_MATCH, 0},
+	{"(?<n>a)\\k<n>", PATTERN_USAGE_MATCH, 0},
+	{"(a)(?1)", PATTERN_USAGE_MATCH, 0},
+	{"(a)?(?(1)b|c)", PATTERN_USAGE_MATCH, 0},
+	{"\\/ref=[^\\/?]*", PATTERN_USAGE_STRIP, 1},
+	{"(?:\\/|%2F)(sr|ref)_[a-z]+", PATTERN_USAGE_STRIP, 1},
+	{"(?:^|&|\\?)(?:utm_[a-z]+|fbclid)(?:=[^&]*)?", PATTERN_USAGE_STRIP_PARAMETER, 1},
+	{"(?:^|&|\\?)(a)\\1(?:=[^&]*)?", PATTERN_USAGE_STRIP_PARAMETER, 0},
+	{"^https?:\\/\\/example\\.com\\/.*\\?to=([^&]+)", PATTERN_USAGE_CAPTURE, 0},
+	{".*[?&]url=([^&]+)", PATTERN_USAGE_CAPTURE, 0}
+};
+
+static const char* const SUBJECTS[] = {
+	"",
+	"a",
+	"b",
+	"x",
+	"h",
+	"ee",
+	"exe",
+	"aa",
+	"ab",
+	"c",
+	"https://example.com/",
+	"https://www.example.com/redirect?url=https%3A%2F%2Fexample.org",
+	"http://a.b.example.com/out?to=https%3A%2F%2Fexample.org&utm_source=1",
+	"https://example.org/path/ref=abc/x?ref=1",
+	"https://example.com/product/sr_abc%2Fref_def",
+	"utm_source=1&a=2&fbclid=3",
+	"a=1&utm_medium=x?fbclid",
+	"aa=1&aab",
+	"line\nhttps://example.com/out",
+	"map",
+	"hhh",
+	"xxx"
+};
+
+static pcre2_code* compile(const char* const pattern, const uint32_t options) {
+	
+	int error_number = 0;
+	PCRE2_SIZE error_offset = 0;
+	
+	return pcre2_compile((PCRE2_SPTR) pattern, PCRE2_ZERO_TERMINATED, options, &error_number, &error_offset, NULL);
+	
+}
+
+static void result(const pcre2_code* const code, const enum PatternUsage usage, const char* const subject, char* dst, const size_t dst_size) {
+	
+	pcre2_match_data* match_data = pcre2_match_data_create_from_pattern(code, NULL);
+	assert (match_data != NULL);
+	
+	if (usage == PATTERN_USAGE_STRIP || usage == PATTERN_USAGE_STRIP_PARAMETER) {
+		PCRE2_SIZE size = dst_size;
+		
+		const int code_substitute = pcre2_substitute(
+			code,
+			(PCRE2_SPTR) subject,
+			PCRE2_ZERO_TERMINATED,
+			0,
+			PCRE2_SUBSTITUTE_GLOBAL,
+			match_data,
+			NULL,
+			(PCRE2_SPTR) "",
+			0,
+			(PCRE2_UCHAR*) dst,
+			&size
+		);
+		
+		assert (code_substitute >= 0);
+	} else {
+		const int matches = pcre2_match(code, (PCRE2_SPTR) subject, PCRE2_ZERO_TERMINATED, 0, 0, match_data, NULL);
+		
+		if (usage == PATTERN_USAGE_MATCH || matches < 2) {
+			snprintf(dst, dst_size, "%i", matches > 0);
+		} else {
+			const PCRE2_SIZE* const ovector = pcre2_get_ovector_pointer(match_data);
+			snprintf(dst, dst_size, "%.*s", (int) (ovector[3] - ovector[2]), subject + ovector[2]);
+		}
+	}
+	
+	pcre2_match_data_free(match_data);
+	
+}
+
+int main() {
+	
+	for (size_t index = 0; index < sizeof(CASES) / sizeof(*CASES); index++) {
+		const struct Case* const test = &CASES[index];
+		
+		const char* optimized = NULL;
+		const uint32_t options = pattern_optimize(test->pattern, test->usage, &optimized);
+		
+		assert ((optimized != test->pattern || options != 0) == test->rewritten);
+		
+		pcre2_code* original_code = compile(test->pattern, 0);
+		pcre2_code* optimized_code = compile(optimized, options);
+		
+		assert (original_code != NULL);
+		
+		// Rejected rewrites fall back to the original (see regex_compile() in src/ruleset.c)
+		if (optimized_code == NULL) {
+			optimized_code = compile(test->pattern, 0);
+		}
+		
+		for (size_t subject = 0; subject < sizeof(SUBJECTS) / sizeof(*SUBJECTS); subject++) {
+			char expected[256];
+			char got[256];
+			
+			result(original_code, test->usage, SUBJECTS[subject], expected, sizeof(expected));
+			result(optimized_code, test->usage, SUBJECTS[subject], got, sizeof(got));
+			
+			if (strcmp(expected, got) != 0) {
+				fprintf(stderr, "%s on \"%s\": expected \"%s\", got \"%s\"\n", test->pattern, SUBJECTS[subject], expected, got);
+				abort();
+			}
+		}
+		
+		pcre2_code_free(original_code);
+		pcre2_code_free(optimized_code);
+	}
+	
+	return 0;
+	
+}
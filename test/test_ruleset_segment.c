@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "unalix.h"
+#include "errors.h"
+#include "ruleset.h"
+#include "clean.h"
+
+static const char SECOND_RULESET[] = "{\"providers\": {\"test\": {\"urlPattern\": \"^https?:\\\\/\\\\/example\\\\.com\", \"rules\": [\"otherRule\"]}}}";
+
+int main() {
+	
+	int code = 0;
+	
+	char filename[256];
+	snprintf(filename, sizeof(filename), "/tmp/unalix-ruleset-segment-%i.bin", (int) getpid());
+	
+	unlink(filename);
+	
+	code = unalix_ruleset_segment_refresh();
+	assert (code == UNALIXERR_RULESETS_SEGMENT_NOT_ATTACHED);
+	
+	code = unalix_ruleset_segment_publish(filename);
+	assert (code == UNALIXERR_RULESETS_EMPTY);
+	
+	code = unalix_load_file("./test/rulesets/rulesets.json");
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = unalix_ruleset_segment_publish(filename);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = unalix_ruleset_segment_attach(filename);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (unalix_ruleset_segment_generation() == 1);
+	
+	// Nothing else is mapped at the address the segment was published for, so patterns are used in place
+	const struct Rulesets* rulesets = rulesets_acquire();
+	assert (rulesets->patterns_borrowed);
+	rulesets_release(rulesets);
+	
+	clean_expect("https://example.com/?exampleRule=exampleValue", "https://example.com/");
+	clean_expect("https://example.com/exampleException?exampleRule=exampleValue", "https://example.com/exampleException?exampleRule=exampleValue");
+	clean_expect("https://example.com/go?exampleRedirection=https%3A%2F%2Fexample.com%2F%3FexampleRule%3D1", "https://example.com/");
+	
+	code = unalix_ruleset_segment_refresh();
+	assert (code == UNALIXERR_RULESETS_NOT_MODIFIED);
+	
+	int ready[2];
+	int published[2];
+	
+	assert (pipe(ready) == 0 && pipe(published) == 0);
+	
+	const pid_t pid = fork();
+	assert (pid != -1);
+	
+	if (pid == 0) {
+		// A worker keeps using the segment it is attached to until it asks for the new one
+		char byte = 0;
+		
+		assert (write(ready[1], &byte, 1) == 1);
+		assert (read(published[0], &byte, 1) == 1);
+		
+		clean_expect("https://example.com/?exampleRule=exampleValue", "https://example.com/");
+		
+		code = unalix_ruleset_segment_refresh();
+		assert (code == UNALIXERR_SUCCESS);
+		assert (unalix_ruleset_segment_generation() == 2);
+		
+		clean_expect("https://example.com/?exampleRule=exampleValue&otherRule=1", "https://example.com/?exampleRule=exampleValue");
+		
+		code = unalix_ruleset_segment_refresh();
+		assert (code == UNALIXERR_RULESETS_NOT_MODIFIED);
+		
+		unalix_unload_rulesets();
+		
+		_exit(0);
+	}
+	
+	char byte = 0;
+	assert (read(ready[0], &byte, 1) == 1);
+	
+	// Loading a ruleset replaces the attached segment instead of extending it
+	code = unalix_load_string(SECOND_RULESET);
+	assert (code == UNALIXERR_SUCCESS);
+	rulesets = rulesets_acquire();
+	assert (rulesets->segment == NULL);
+	rulesets_release(rulesets);
+	
+	code = unalix_ruleset_segment_refresh();
+	assert (code == UNALIXERR_RULESETS_SEGMENT_NOT_ATTACHED);
+	
+	code = unalix_ruleset_segment_publish(filename);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	assert (write(published[1], &byte, 1) == 1);
+	
+	int status = 0;
+	assert (waitpid(pid, &status, 0) == pid);
+	assert (WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	
+	code = unalix_ruleset_segment_attach(filename);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (unalix_ruleset_segment_generation() == 2);
+	
+	clean_expect("https://example.com/?otherRule=1", "https://example.com/");
+	
+	// Files that are not segments are rejected, keeping the attached one
+	unlink(filename);
+	
+	FILE* file = fopen(filename, "wb");
+	assert (file != NULL);
+	
+	char garbage[256];
+	memset(garbage, 'x', sizeof(garbage));
+	
+	assert (fwrite(garbage, 1, sizeof(garbage), file) == sizeof(garbage));
+	fclose(file);
+	
+	code = unalix_ruleset_segment_attach(filename);
+	assert (code == UNALIXERR_RULESETS_SEGMENT_INVALID);
+	
+	clean_expect("https://example.com/?otherRule=1", "https://example.com/");
+	
+	unalix_unload_rulesets();
+	
+	unlink(filename);
+	
+	return 0;
+	
+}
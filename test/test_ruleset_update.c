@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <bearssl.h>
+
+#include "unalix.h"
+#include "errors.h"
+#include "server.h"
+#include "clean.h"
+
+static void hexdigest(const unsigned char* const buffer, const size_t buffer_size, char* dst) {
+	
+	br_sha256_context context = {0};
+	br_sha256_init(&context);
+	br_sha256_update(&context, buffer, buffer_size);
+	
+	unsigned char hash[br_sha256_SIZE];
+	br_sha256_out(&context, hash);
+	
+	for (size_t index = 0; index < sizeof(hash); index++) {
+		sprintf(dst + index * 2, "%02x", hash[index]);
+	}
+	
+}
+
+static volatile int should_stop = 0;
+
+static void* clean_repeatedly(void* argument) {
+	
+	(void) argument;
+	
+	while (!should_stop) {
+		clean_expect("https://example.com/?exampleRule=exampleValue", "https://example.com/");
+	}
+	
+	return NULL;
+	
+}
+
+int main() {
+	
+	int code = 0;
+	
+	static unsigned char ruleset[1024 * 1024];
+	size_t ruleset_size = 0;
+	
+	assert (read_file("./test/rulesets/rulesets.json", ruleset, sizeof(ruleset), &ruleset_size) == 0);
+	
+	char hash[br_sha256_SIZE * 2 + 1];
+	hexdigest(ruleset, ruleset_size, hash);
+	
+	struct Server server;
+	assert (server_start(&server, 0) == 0);
+	
+	assert (server_set_route_body(&server, "/rules.json", (const char*) ruleset, ruleset_size, "\"v1\"") == 0);
+	assert (server_set_route_body(&server, "/rules.hash", hash, strlen(hash), NULL) == 0);
+	
+	char url[128];
+	char sha256_url[128];
+	
+	snprintf(url, sizeof(url), "http://127.0.0.1:%i/rules.json", server.port);
+	snprintf(sha256_url, sizeof(sha256_url), "http://127.0.0.1:%i/rules.hash", server.port);
+	
+	char filename[256];
+	char etag_filename[256 + 8];
+	char temporary_filename[256 + 8];
+	
+	snprintf(filename, sizeof(filename), "/tmp/unalix-ruleset-update-%i.json", (int) getpid());
+	snprintf(etag_filename, sizeof(etag_filename), "%s.etag", filename);
+	snprintf(temporary_filename, sizeof(temporary_filename), "%s.tmp", filename);
+	
+	unlink(filename);
+	unlink(etag_filename);
+	
+	code = unalix_ruleset_update_load(NULL, url, NULL);
+	assert (code == UNALIXERR_ARG_INVALID);
+	
+	// The downloaded ruleset is verified, saved and loaded in a single pass
+	code = unalix_ruleset_update_load(filename, url, sha256_url);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (server.total_requests == 2);
+	assert (access(filename, F_OK) == 0);
+	assert (access(temporary_filename, F_OK) != 0);
+	
+	clean_expect("https://example.com/?exampleRule=exampleValue", "https://example.com/");
+	
+	unsigned char saved[sizeof(ruleset)];
+	size_t saved_size = 0;
+	
+	assert (read_file(filename, saved, sizeof(saved), &saved_size) == 0);
+	assert (saved_size == ruleset_size && memcmp(saved, ruleset, ruleset_size) == 0);
+	
+	char etag[16];
+	size_t etag_size = 0;
+	
+	assert (read_file(etag_filename, (unsigned char*) etag, sizeof(etag) - 1, &etag_size) == 0);
+	etag[etag_size] = '\0';
+	assert (strcmp(etag, "\"v1\"") == 0);
+	
+	// Nothing is downloaded while the entity tag matches
+	code = unalix_ruleset_update_load(filename, url, sha256_url);
+	assert (code == UNALIXERR_RULESETS_NOT_MODIFIED);
+	assert (server.total_requests == 3);
+	
+	code = unalix_ruleset_check_update(filename, url);
+	assert (code == UNALIXERR_RULESETS_NOT_MODIFIED);
+	
+	clean_expect("https://example.com/?exampleRule=exampleValue", "https://example.com/");
+	
+	// A ruleset not matching the published hash is discarded, keeping the local copy
+	static unsigned char tampered[sizeof(ruleset)];
+	memcpy(tampered, ruleset, ruleset_size);
+	tampered[ruleset_size - 1] = ' ';
+	
+	assert (server_set_route_body(&server, "/rules.json", (const char*) tampered, ruleset_size, "\"v2\"") == 0);
+	
+	code = unalix_ruleset_check_update(filename, url);
+	assert (code == UNALIXERR_RULESETS_UPDATE_AVAILABLE);
+	
+	code = unalix_ruleset_update_load(filename, url, sha256_url);
+	assert (code == UNALIXERR_RULESETS_MISMATCH_HASH);
+	assert (access(temporary_filename, F_OK) != 0);
+	
+	assert (read_file(filename, saved, sizeof(saved), &saved_size) == 0);
+	assert (saved_size == ruleset_size && memcmp(saved, ruleset, ruleset_size) == 0);
+	
+	clean_expect("https://example.com/?exampleRule=exampleValue", "https://example.com/");
+	
+	// Unparseable rulesets are discarded as well
+	assert (server_set_route_body(&server, "/rules.json", "{", 1, "\"v3\"") == 0);
+	
+	code = unalix_ruleset_update_load(filename, url, NULL);
+	assert (code == UNALIXERR_JSON_CANNOT_PARSE);
+	assert (access(temporary_filename, F_OK) != 0);
+	
+	clean_expect("https://example.com/?exampleRule=exampleValue", "https://example.com/");
+	
+	// The update without loading goes through the same download
+	assert (server_set_route_body(&server, "/rules.json", (const char*) tampered, ruleset_size, "\"v2\"") == 0);
+	
+	hexdigest(tampered, ruleset_size, hash);
+	assert (server_set_route_body(&server, "/rules.hash", hash, strlen(hash), NULL) == 0);
+	
+	code = unalix_ruleset_update(filename, url, sha256_url, "/tmp/");
+	assert (code == UNALIXERR_SUCCESS);
+	
+	assert (read_file(filename, saved, sizeof(saved), &saved_size) == 0);
+	assert (saved_size == ruleset_size && memcmp(saved, tampered, ruleset_size) == 0);
+	
+	code = unalix_ruleset_update_load(filename, url, sha256_url);
+	assert (code == UNALIXERR_RULESETS_NOT_MODIFIED);
+	
+	// Rulesets can be replaced while other threads are cleaning with them
+	pthread_t cleaners[4];
+	
+	for (size_t index = 0; index < sizeof(cleaners) / sizeof(*cleaners); index++) {
+		pthread_create(&cleaners[index], NULL, clean_repeatedly, NULL);
+	}
+	
+	for (size_t index = 0; index < 50; index++) {
+		code = unalix_reload_file(filename);
+		assert (code == UNALIXERR_SUCCESS);
+		
+		code = unalix_load_string("{\"providers\": {\"other\": {\"urlPattern\": \"^https?:\\\\/\\\\/example\\\\.org\", \"rules\": [\"otherRule\"]}}}");
+		assert (code == UNALIXERR_SUCCESS);
+	}
+	
+	should_stop = 1;
+	
+	for (size_t index = 0; index < sizeof(cleaners) / sizeof(*cleaners); index++) {
+		pthread_join(cleaners[index], NULL);
+	}
+	
+	clean_expect("https://example.org/?otherRule=1", "https://example.org/");
+	
+	unalix_unload_rulesets();
+	
+	unlink(filename);
+	unlink(etag_filename);
+	
+	server_stop(&server);
+	
+	return 0;
+	
+}
@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "unalix.h"
+#include "errors.h"
+
+struct Output {
+	char* content;
+	size_t size;
+	size_t calls;
+};
+
+static int sink(const char* const buffer, const size_t buffer_size, void* userdata) {
+	
+	struct Output* const output = (struct Output*) userdata;
+	
+	char* content = (char*) realloc(output->content, output->size + buffer_size + 1);
+	
+	if (content == NULL) {
+		return UNALIXERR_MEMORY_ALLOCATE_FAILURE;
+	}
+	
+	memcpy(content + output->size, buffer, buffer_size);
+	
+	output->content = content;
+	output->size += buffer_size;
+	output->content[output->size] = '\0';
+	output->calls++;
+	
+	return UNALIXERR_SUCCESS;
+	
+}
+
+static int failing_sink(const char* const buffer, const size_t buffer_size, void* userdata) {
+	
+	(void) buffer;
+	(void) buffer_size;
+	(void) userdata;
+	
+	return UNALIXERR_FILE_CANNOT_WRITE;
+	
+}
+
+static void clean(const char* const source_text, const char* const expected_text) {
+	
+	char* target_text = NULL;
+	size_t target_text_size = 0;
+	
+	const int code = unalix_clean_text(source_text, strlen(source_text), &target_text, &target_text_size, 0, 0, 0, 0, 0, 0, 0);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_text, expected_text) == 0);
+	assert (target_text_size == strlen(expected_text));
+	
+	free(target_text);
+	
+}
+
+static void stream(const char* const source_text, const size_t source_text_size, const size_t chunk_size, const char* const expected_text) {
+	
+	struct Output output = {0};
+	struct unalix_scanner* scanner = NULL;
+	
+	int code = unalix_scanner_new(&scanner, 0, 0, 0, 0, 0, 0, 0, sink, &output);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	for (size_t offset = 0; offset < source_text_size; offset += chunk_size) {
+		const size_t size = (source_text_size - offset < chunk_size) ? source_text_size - offset : chunk_size;
+		
+		code = unalix_scanner_feed(scanner, source_text + offset, size);
+		assert (code == UNALIXERR_SUCCESS);
+	}
+	
+	code = unalix_scanner_finish(scanner);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	assert (output.size == strlen(expected_text));
+	assert (memcmp(output.content, expected_text, output.size) == 0);
+	
+	unalix_scanner_free(scanner);
+	free(output.content);
+	
+}
+
+int main() {
+	
+	int code = 0;
+	
+	code = unalix_load_file("./test/rulesets/rulesets.json");
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = unalix_load_string("{\"providers\": {\"test\": {\"urlPattern\": \"^https?:\\\\/\\\\/(?:www\\\\.)?example\\\\.org\", \"rules\": [\"tracking\"]}}}");
+	assert (code == UNALIXERR_SUCCESS);
+	
+	const char source_text[] =
+		"Check https://example.com/?exampleRule=exampleValue, and (www.example.org/page?id=2&tracking=1).\n"
+		"Wiki: https://example.com/wiki/Foo_(bar)?exampleRule=1 or <https://example.com/?exampleRule=2>\n"
+		"Nothing here: https:// foo.www.example.org/?tracking=1 ftp: a.b.c www. 1https://example.com/?exampleRule=3\n"
+		"Redirected https://example.com/r?exampleRedirection=https%3A%2F%2Fexample.org%2F%3Ftracking%3D1\n"
+		"Plain www.example.org/?tracking=1; done";
+	
+	const char expected_text[] =
+		"Check https://example.com/, and (www.example.org/page?id=2).\n"
+		"Wiki: https://example.com/wiki/Foo_(bar) or <https://example.com/>\n"
+		"Nothing here: https:// foo.www.example.org/?tracking=1 ftp: a.b.c www. 1https://example.com/?exampleRule=3\n"
+		"Redirected https://example.org/\n"
+		"Plain www.example.org/; done";
+	
+	clean(source_text, expected_text);
+	
+	clean("", "");
+	clean("no links at all", "no links at all");
+	clean("https://example.com/?exampleRule=1", "https://example.com/");
+	
+	// Chunk boundaries can fall anywhere, including in the middle of a URL
+	for (size_t chunk_size = 1; chunk_size < 64; chunk_size++) {
+		stream(source_text, strlen(source_text), chunk_size, expected_text);
+	}
+	
+	// Large documents are scanned with bounded memory
+	const size_t copies = 2000;
+	
+	char* const document = (char*) malloc(sizeof(source_text) * copies);
+	char* const expected_document = (char*) malloc(sizeof(expected_text) * copies);
+	
+	assert (document != NULL && expected_document != NULL);
+	
+	for (size_t index = 0; index < copies; index++) {
+		memcpy(document + index * sizeof(source_text), source_text, sizeof(source_text));
+		document[(index + 1) * sizeof(source_text) - 1] = '\n';
+		
+		memcpy(expected_document + index * sizeof(expected_text), expected_text, sizeof(expected_text));
+		expected_document[(index + 1) * sizeof(expected_text) - 1] = '\n';
+	}
+	
+	document[sizeof(source_text) * copies - 1] = '\0';
+	expected_document[sizeof(expected_text) * copies - 1] = '\0';
+	
+	stream(document, strlen(document), 4096, expected_document);
+	stream(document, strlen(document), 1000, expected_document);
+	
+	free(document);
+	free(expected_document);
+	
+	// Words too long to hold on to are passed through unchanged
+	const size_t long_word_size = 64 * 1024;
+	
+	char* const long_word = (char*) malloc(long_word_size + 64);
+	assert (long_word != NULL);
+	
+	strcpy(long_word, "https://example.com/?exampleRule=");
+	memset(long_word + strlen(long_word), 'a', long_word_size);
+	strcpy(long_word + 33 + long_word_size, " x");
+	
+	stream(long_word, strlen(long_word), 1000, long_word);
+	stream(long_word, strlen(long_word), strlen(long_word), long_word);
+	
+	free(long_word);
+	
+	// Errors from the sink are passed on
+	struct unalix_scanner* scanner = NULL;
+	
+	code = unalix_scanner_new(&scanner, 0, 0, 0, 0, 0, 0, 0, failing_sink, NULL);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = unalix_scanner_feed(scanner, "some text ", 10);
+	assert (code == UNALIXERR_FILE_CANNOT_WRITE);
+	
+	unalix_scanner_free(scanner);
+	
+	code = unalix_scanner_new(&scanner, 0, 0, 0, 0, 0, 0, 0, NULL, NULL);
+	assert (code == UNALIXERR_ARG_INVALID);
+	
+	unalix_unload_rulesets();
+	
+	return 0;
+	
+}
@@ -0,0 +1,59 @@
+#include <stdlib.h>
+#include <assert.h>
+
+#include "unalix.h"
+#include "ssl_pool.h"
+#include "errors.h"
+
+int main(void) {
+	
+	struct SSLContext* first = NULL;
+	struct SSLContext* second = NULL;
+	
+	// Contexts are set up once and handed out again after being released
+	assert(ssl_context_acquire(&first) == UNALIXERR_SUCCESS);
+	assert(!first->half_duplex);
+	
+	assert(ssl_context_acquire(&second) == UNALIXERR_SUCCESS);
+	assert(first != second);
+	
+	ssl_context_release(first);
+	ssl_context_release(second);
+	
+	struct SSLContext* context = NULL;
+	
+	assert(ssl_context_acquire(&context) == UNALIXERR_SUCCESS);
+	assert(context == second);
+	assert(!context->is_initialized);
+	
+	ssl_context_release(context);
+	
+	// Switching to half-duplex drops the idle bidirectional contexts
+	unalix_ssl_pool_configure(1, 1);
+	
+	assert(ssl_context_acquire(&first) == UNALIXERR_SUCCESS);
+	assert(first->half_duplex);
+	
+	assert(ssl_context_acquire(&second) == UNALIXERR_SUCCESS);
+	assert(second->half_duplex);
+	
+	// Only one idle context is kept around
+	ssl_context_release(first);
+	ssl_context_release(second);
+	
+	assert(ssl_context_acquire(&context) == UNALIXERR_SUCCESS);
+	assert(context == first);
+	
+	// Contexts created before a mode change are not put back
+	unalix_ssl_pool_configure(SSL_POOL_DEFAULT_MAX_IDLE, 0);
+	
+	ssl_context_release(context);
+	
+	assert(ssl_context_acquire(&context) == UNALIXERR_SUCCESS);
+	assert(!context->half_duplex);
+	
+	ssl_context_release(context);
+	
+	return 0;
+	
+}
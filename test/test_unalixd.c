@@ -0,0 +1,300 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "unalixd_client.h"
+#include "errors.h"
+#include "server.h"
+
+#define TOTAL_PIPELINED 500
+#define TOTAL_UNREAD 2000
+
+static const char FIRST_RULESET[] = "{\"providers\": {\"test\": {\"urlPattern\": \"^https?:\\\\/\\\\/example\\\\.com\", \"rules\": [\"exampleRule\"]}}}";
+static const char SECOND_RULESET[] = "{\"providers\": {\"test\": {\"urlPattern\": \"^https?:\\\\/\\\\/example\\\\.com\", \"rules\": [\"otherRule\"]}}}";
+static const char THIRD_RULESET[] = "{\"providers\": {\"test\": {\"urlPattern\": \"^https?:\\\\/\\\\/example\\\\.com\", \"rules\": [\"thirdRule\"]}}}";
+
+static void write_ruleset(const char* const filename, const char* const content) {
+	
+	// Replaced atomically, the way rulesets are usually deployed
+	char temporary_filename[256 + 8];
+	snprintf(temporary_filename, sizeof(temporary_filename), "%s.tmp", filename);
+	
+	FILE* file = fopen(temporary_filename, "wb");
+	assert (file != NULL);
+	
+	assert (fwrite(content, 1, strlen(content), file) == strlen(content));
+	fclose(file);
+	
+	assert (rename(temporary_filename, filename) == 0);
+	
+}
+
+static long long elapsed_ms(const struct timespec start) {
+	
+	struct timespec now = {0};
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	
+	return (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+	
+}
+
+static int wait_until_cleaned(struct unalixd_client* client, const char* const source_url, const char* const expected_url) {
+	
+	for (size_t attempt = 0; attempt < 100; attempt++) {
+		char* target_url = NULL;
+		
+		const int code = unalixd_clean_url(client, source_url, &target_url, 0);
+		assert (code == UNALIXERR_SUCCESS);
+		
+		const int matches = (strcmp(target_url, expected_url) == 0);
+		free(target_url);
+		
+		if (matches) {
+			return 1;
+		}
+		
+		usleep(50 * 1000);
+	}
+	
+	return 0;
+	
+}
+
+static void flood(const char* const path) {
+	
+	// Sends requests with long responses and never reads any of them
+	struct unalixd_client* client = NULL;
+	assert (unalixd_connect(&client, path) == UNALIXERR_SUCCESS);
+	
+	static char url[4096];
+	const int prefix_size = snprintf(url, sizeof(url), "https://example.com/");
+	memset(url + prefix_size, 'a', sizeof(url) - (size_t) prefix_size - 1);
+	
+	for (size_t index = 0; index < TOTAL_UNREAD; index++) {
+		unsigned int id = 0;
+		
+		if (unalixd_send_clean(client, url, 0, &id) != UNALIXERR_SUCCESS) {
+			break;
+		}
+	}
+	
+	while (1) {
+		pause();
+	}
+	
+}
+
+int main(int argc, char* argv[]) {
+	
+	assert (argc == 2);
+	
+	int code = 0;
+	
+	char rulesets[256];
+	char path[256];
+	
+	snprintf(rulesets, sizeof(rulesets), "/tmp/unalixd-%i.json", (int) getpid());
+	snprintf(path, sizeof(path), "/tmp/unalixd-%i.sock", (int) getpid());
+	
+	write_ruleset(rulesets, FIRST_RULESET);
+	
+	const pid_t pid = fork();
+	assert (pid != -1);
+	
+	if (pid == 0) {
+		execl(argv[1], "unalixd", "-r", rulesets, "-s", path, "-t", "1", "-u", "1", "-T", "5", (char*) NULL);
+		_exit(127);
+	}
+	
+	struct unalixd_client* client = NULL;
+	
+	for (size_t attempt = 0; attempt < 100; attempt++) {
+		code = unalixd_connect(&client, path);
+		
+		if (code == UNALIXERR_SUCCESS) {
+			break;
+		}
+		
+		usleep(50 * 1000);
+	}
+	
+	assert (code == UNALIXERR_SUCCESS);
+	
+	int status = 0;
+	char* target_url = NULL;
+	
+	code = unalixd_clean_url(client, "https://example.com/?exampleRule=1", &target_url, 0);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, "https://example.com/") == 0);
+	free(target_url);
+	
+	code = unalixd_clean_url(client, "https://example.com/?exampleRule=1", &target_url, UNALIXD_IGNORE_RULES);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, "https://example.com/?exampleRule=1") == 0);
+	free(target_url);
+	
+	// Errors come back as the same codes the library returns
+	code = unalixd_clean_url(client, "example.com", &target_url, 0);
+	assert (code < 0);
+	assert (target_url == NULL);
+	
+	// Pipelined requests are all answered, in whatever order
+	static int answered[TOTAL_PIPELINED + 1];
+	static unsigned int ids[TOTAL_PIPELINED];
+	
+	for (size_t index = 0; index < TOTAL_PIPELINED; index++) {
+		char url[64];
+		snprintf(url, sizeof(url), "https://example.com/%zu?exampleRule=1", index);
+		
+		code = unalixd_send_clean(client, url, 0, &ids[index]);
+		assert (code == UNALIXERR_SUCCESS);
+	}
+	
+	for (size_t index = 0; index < TOTAL_PIPELINED; index++) {
+		unsigned int id = 0;
+		int result = 0;
+		
+		code = unalixd_receive(client, &id, &result, &target_url);
+		assert (code == UNALIXERR_SUCCESS);
+		assert (result == UNALIXERR_SUCCESS);
+		
+		const unsigned int position = id - ids[0];
+		assert (position < TOTAL_PIPELINED && !answered[position]);
+		
+		char expected_url[64];
+		snprintf(expected_url, sizeof(expected_url), "https://example.com/%u", position);
+		
+		assert (strcmp(target_url, expected_url) == 0);
+		free(target_url);
+		
+		answered[position] = 1;
+	}
+	
+	// Unshort requests go through the daemon's own connection pools
+	struct Server server;
+	assert (server_start(&server, 0) == 0);
+	
+	char short_url[128];
+	char final_url[128];
+	
+	snprintf(short_url, sizeof(short_url), "http://127.0.0.1:%i/redirect/3", server.port);
+	snprintf(final_url, sizeof(final_url), "http://127.0.0.1:%i/redirect/0", server.port);
+	
+	code = unalixd_unshort_url(client, short_url, &target_url, 0);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, final_url) == 0);
+	free(target_url);
+	
+	server_stop(&server);
+	
+	// Rulesets are reloaded on SIGHUP...
+	write_ruleset(rulesets, SECOND_RULESET);
+	assert (kill(pid, SIGHUP) == 0);
+	
+	assert (wait_until_cleaned(client, "https://example.com/?otherRule=1", "https://example.com/"));
+	
+	// ...and when the file changes
+	write_ruleset(rulesets, THIRD_RULESET);
+	assert (wait_until_cleaned(client, "https://example.com/?thirdRule=1", "https://example.com/"));
+	
+	// A broken ruleset leaves the current one in place
+	write_ruleset(rulesets, "{");
+	assert (kill(pid, SIGHUP) == 0);
+	
+	usleep(200 * 1000);
+	
+	code = unalixd_clean_url(client, "https://example.com/?thirdRule=1", &target_url, 0);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, "https://example.com/") == 0);
+	free(target_url);
+	
+	// An unshort request stuck on the network holds back neither clean requests nor reloads
+	const int stalled = socket(AF_INET, SOCK_STREAM, 0);
+	assert (stalled != -1);
+	
+	struct sockaddr_in address = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+	};
+	socklen_t address_size = sizeof(address);
+	
+	assert (bind(stalled, (struct sockaddr*) &address, sizeof(address)) == 0);
+	assert (listen(stalled, 1) == 0);
+	assert (getsockname(stalled, (struct sockaddr*) &address, &address_size) == 0);
+	
+	char stalled_url[128];
+	snprintf(stalled_url, sizeof(stalled_url), "http://127.0.0.1:%i/", (int) ntohs(address.sin_port));
+	
+	unsigned int stalled_id = 0;
+	
+	code = unalixd_send_unshort(client, stalled_url, 0, &stalled_id);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	usleep(200 * 1000);
+	
+	struct timespec start = {0};
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	
+	write_ruleset(rulesets, FIRST_RULESET);
+	assert (kill(pid, SIGHUP) == 0);
+	
+	assert (wait_until_cleaned(client, "https://example.com/?exampleRule=1", "https://example.com/"));
+	assert (elapsed_ms(start) < 2000);
+	
+	// Pending connections are reset along with the listening socket
+	close(stalled);
+	
+	unsigned int id = 0;
+	int result = 0;
+	
+	code = unalixd_receive(client, &id, &result, &target_url);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (id == stalled_id);
+	free(target_url);
+	
+	// A client that does not read its responses does not delay anyone else
+	const pid_t flooder = fork();
+	assert (flooder != -1);
+	
+	if (flooder == 0) {
+		flood(path);
+	}
+	
+	usleep(500 * 1000);
+	
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	
+	for (size_t index = 0; index < 10; index++) {
+		code = unalixd_clean_url(client, "https://example.com/?exampleRule=1", &target_url, 0);
+		assert (code == UNALIXERR_SUCCESS);
+		assert (strcmp(target_url, "https://example.com/") == 0);
+		free(target_url);
+	}
+	
+	assert (elapsed_ms(start) < 1000);
+	
+	assert (kill(flooder, SIGKILL) == 0);
+	assert (waitpid(flooder, &status, 0) == flooder);
+	
+	unalixd_close(client);
+	
+	assert (kill(pid, SIGTERM) == 0);
+	
+	assert (waitpid(pid, &status, 0) == pid);
+	assert (WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	
+	assert (access(path, F_OK) != 0);
+	
+	unlink(rulesets);
+	
+	return 0;
+	
+}
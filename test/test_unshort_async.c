@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "unalix.h"
+#include "errors.h"
+#include "server.h"
+
+#define TOTAL_JOBS 16
+
+struct Results {
+	pthread_mutex_t mutex;
+	pthread_cond_t condition;
+	size_t total_results;
+	int codes[TOTAL_JOBS + 1];
+	char urls[TOTAL_JOBS + 1][128];
+	pthread_t threads[TOTAL_JOBS + 1];
+};
+
+static struct Results results = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, {0}, {{0}}, {0}};
+
+static size_t threads_started = 0;
+static size_t threads_stopped = 0;
+
+static void thread_start(void* userdata) {
+	
+	assert (userdata == &results);
+	__atomic_add_fetch(&threads_started, 1, __ATOMIC_SEQ_CST);
+	
+}
+
+static void thread_stop(void* userdata) {
+	
+	assert (userdata == &results);
+	__atomic_add_fetch(&threads_stopped, 1, __ATOMIC_SEQ_CST);
+	
+}
+
+static void callback(const unsigned long long id, const int code, const char* const target_url, void* userdata) {
+	
+	assert (userdata == &results);
+	assert (id > 0 && id <= TOTAL_JOBS);
+	
+	pthread_mutex_lock(&results.mutex);
+	
+	results.codes[id] = code;
+	results.threads[id] = pthread_self();
+	
+	if (target_url != NULL) {
+		snprintf(results.urls[id], sizeof(results.urls[id]), "%s", target_url);
+	}
+	
+	results.total_results++;
+	
+	pthread_cond_broadcast(&results.condition);
+	pthread_mutex_unlock(&results.mutex);
+	
+}
+
+static void wait_results(const size_t total_results) {
+	
+	pthread_mutex_lock(&results.mutex);
+	
+	while (results.total_results < total_results) {
+		pthread_cond_wait(&results.condition, &results.mutex);
+	}
+	
+	pthread_mutex_unlock(&results.mutex);
+	
+}
+
+static unsigned long long submit(const char* const url) {
+	
+	unsigned long long id = 0;
+	
+	const int code = unalix_unshort_url_async(url, 0, 0, 0, 0, 0, 0, 0, NULL, 5, callback, &results, &id);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	return id;
+	
+}
+
+int main() {
+	
+	int code = 0;
+	
+	code = unalix_load_file("./test/rulesets/rulesets.json");
+	assert (code == UNALIXERR_SUCCESS);
+	
+	struct Server server;
+	assert (server_start(&server, 0) == 0);
+	
+	char url[128];
+	char slow_url[128];
+	char expected_url[128];
+	
+	snprintf(url, sizeof(url), "http://127.0.0.1:%i/redirect/2?delay=50", server.port);
+	snprintf(slow_url, sizeof(slow_url), "http://127.0.0.1:%i/redirect/0?delay=300", server.port);
+	
+	code = unalix_unshort_url_async(NULL, 0, 0, 0, 0, 0, 0, 0, NULL, 5, callback, &results, NULL);
+	assert (code == UNALIXERR_ARG_INVALID);
+	
+	code = unalix_unshort_url_async(url, 0, 0, 0, 0, 0, 0, 0, NULL, 5, NULL, &results, NULL);
+	assert (code == UNALIXERR_ARG_INVALID);
+	
+	code = unalix_unshort_async_configure(4, thread_start, thread_stop, &results);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	// A few worker threads serve many more pending jobs
+	for (size_t index = 1; index <= 12; index++) {
+		snprintf(url, sizeof(url), "http://127.0.0.1:%i/redirect/2?delay=50&job=%zu", server.port, index);
+		assert (submit(url) == index);
+	}
+	
+	wait_results(12);
+	
+	for (size_t index = 1; index <= 12; index++) {
+		snprintf(expected_url, sizeof(expected_url), "http://127.0.0.1:%i/redirect/0?delay=50&job=%zu", server.port, index);
+		
+		assert (results.codes[index] == UNALIXERR_SUCCESS);
+		assert (strcmp(results.urls[index], expected_url) == 0);
+	}
+	
+	assert (threads_started > 0 && threads_started <= 4);
+	assert (server.total_requests == 12 * 3);
+	
+	// Cancelling jobs, both queued and running, on a single worker
+	unalix_unshort_async_stop();
+	assert (threads_stopped == threads_started);
+	
+	code = unalix_unshort_async_configure(1, thread_start, thread_stop, &results);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	const size_t total_requests = server.total_requests;
+	
+	const unsigned long long running = submit(slow_url);
+	
+	while (__atomic_load_n(&server.total_requests, __ATOMIC_SEQ_CST) == total_requests) {
+		usleep(1000);
+	}
+	
+	const unsigned long long queued = submit(slow_url);
+	
+	code = unalix_unshort_cancel(queued);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	// Jobs that never started are reported right away, on the cancelling thread
+	assert (results.total_results == 13);
+	assert (results.codes[queued] == UNALIXERR_CANCELLED);
+	assert (pthread_equal(results.threads[queued], pthread_self()));
+	
+	code = unalix_unshort_cancel(queued);
+	assert (code == UNALIXERR_ARG_INVALID);
+	
+	code = unalix_unshort_cancel(running);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	wait_results(14);
+	
+	assert (results.codes[running] == UNALIXERR_CANCELLED);
+	assert (!pthread_equal(results.threads[running], pthread_self()));
+	
+	code = unalix_unshort_cancel(running);
+	assert (code == UNALIXERR_ARG_INVALID);
+	
+	unalix_unshort_async_stop();
+	assert (threads_stopped == threads_started);
+	
+	unalix_unload_rulesets();
+	
+	server_stop(&server);
+	
+	return 0;
+	
+}
@@ -0,0 +1,651 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "unalix.h"
+#include "errors.h"
+
+/*
+A local stand-in for a chain of redirecting servers.
+
+/start   302 to /big
+/big     200 with a 64 MiB body
+/nohead  405 for HEAD, 302 to /final for GET
+/final   200 with a small body
+/other   302 to /start
+/slow    302 to /final, after a 300 ms delay
+/fan-*   302 to /slow
+/away    302 to http://final.test/final
+/gone    404
+
+Each connection is handled on its own thread.
+*/
+
+static const size_t BIG_BODY_SIZE = 64 * 1024 * 1024;
+
+static int server_fd = -1;
+static int port = 0;
+
+static size_t total_head_requests = 0;
+static size_t total_get_requests = 0;
+static size_t big_body_sent = 0;
+static size_t total_slow_requests = 0;
+
+static void respond(const int fd, const char* const method, const char* const path) {
+	
+	char response[256];
+	
+	if (strncmp(path, "/slow", 5) == 0) {
+		__atomic_add_fetch(&total_slow_requests, 1, __ATOMIC_SEQ_CST);
+		usleep(300 * 1000);
+		
+		snprintf(response, sizeof(response), "HTTP/1.0 302 Found\r\nLocation: /final\r\nContent-Length: 0\r\n\r\n");
+	} else if (strncmp(path, "/fan-", 5) == 0) {
+		snprintf(response, sizeof(response), "HTTP/1.0 302 Found\r\nLocation: /slow\r\nContent-Length: 0\r\n\r\n");
+	} else if (strcmp(path, "/away") == 0) {
+		snprintf(response, sizeof(response), "HTTP/1.0 302 Found\r\nLocation: http://final.test:%i/final\r\nContent-Length: 0\r\n\r\n", port);
+	} else if (strcmp(path, "/gone") == 0) {
+		snprintf(response, sizeof(response), "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+	} else if (strcmp(path, "/other") == 0) {
+		snprintf(response, sizeof(response), "HTTP/1.0 302 Found\r\nLocation: /start\r\nContent-Length: 0\r\n\r\n");
+	} else if (strcmp(path, "/start") == 0) {
+		snprintf(response, sizeof(response), "HTTP/1.0 302 Found\r\nLocation: /big\r\nContent-Length: 0\r\n\r\n");
+	} else if (strcmp(path, "/big") == 0) {
+		snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n\r\n", BIG_BODY_SIZE);
+	} else if (strcmp(path, "/nohead") == 0 && strcmp(method, "HEAD") == 0) {
+		snprintf(response, sizeof(response), "HTTP/1.0 405 Method Not Allowed\r\nContent-Length: 0\r\n\r\n");
+	} else if (strcmp(path, "/nohead") == 0) {
+		snprintf(response, sizeof(response), "HTTP/1.0 302 Found\r\nLocation: /final\r\nContent-Length: 0\r\n\r\n");
+	} else {
+		snprintf(response, sizeof(response), "HTTP/1.0 200 OK\r\nContent-Length: 5\r\n\r\nHello");
+	}
+	
+	send(fd, response, strlen(response), MSG_NOSIGNAL);
+	
+	if (strcmp(path, "/big") == 0 && strcmp(method, "GET") == 0) {
+		char chunk[16384];
+		memset(chunk, 'A', sizeof(chunk));
+		
+		big_body_sent = 0;
+		
+		while (big_body_sent < BIG_BODY_SIZE) {
+			const ssize_t size = send(fd, chunk, sizeof(chunk), MSG_NOSIGNAL);
+			
+			if (size < 1) {
+				break;
+			}
+			
+			big_body_sent += (size_t) size;
+		}
+	}
+	
+}
+
+static void* handle(void* argument) {
+	
+	const int fd = (int) (intptr_t) argument;
+	
+	char request[2048];
+	size_t offset = 0;
+	
+	while (offset < sizeof(request) - 1) {
+		const ssize_t size = recv(fd, request + offset, sizeof(request) - 1 - offset, 0);
+		
+		if (size < 1) {
+			break;
+		}
+		
+		offset += (size_t) size;
+		request[offset] = '\0';
+		
+		if (strstr(request, "\r\n\r\n") != NULL) {
+			break;
+		}
+	}
+	
+	request[offset] = '\0';
+	
+	char method[16] = {0};
+	char path[256] = {0};
+	
+	if (sscanf(request, "%15s %255s", method, path) == 2) {
+		if (strcmp(method, "HEAD") == 0) {
+			__atomic_add_fetch(&total_head_requests, 1, __ATOMIC_SEQ_CST);
+		} else {
+			__atomic_add_fetch(&total_get_requests, 1, __ATOMIC_SEQ_CST);
+		}
+		
+		respond(fd, method, path);
+	}
+	
+	close(fd);
+	
+	return NULL;
+	
+}
+
+static void* serve(void* argument) {
+	
+	(void) argument;
+	
+	while (1) {
+		const int fd = accept(server_fd, NULL, NULL);
+		
+		if (fd == -1) {
+			break;
+		}
+		
+		pthread_t thread;
+		pthread_create(&thread, NULL, handle, (void*) (intptr_t) fd);
+		pthread_detach(thread);
+	}
+	
+	return NULL;
+	
+}
+
+struct Unshort {
+	char source_url[64];
+	char* target_url;
+	int code;
+};
+
+static void* unshort(void* argument) {
+	
+	struct Unshort* const obj = (struct Unshort*) argument;
+	
+	obj->code = unalix_unshort_url(obj->source_url, &obj->target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+	
+	return NULL;
+	
+}
+
+static void unshort_concurrently(struct Unshort* items, const size_t total_items) {
+	
+	pthread_t threads[16];
+	
+	for (size_t index = 0; index < total_items; index++) {
+		pthread_create(&threads[index], NULL, unshort, &items[index]);
+	}
+	
+	for (size_t index = 0; index < total_items; index++) {
+		pthread_join(threads[index], NULL);
+	}
+	
+}
+
+static int blackhole(const int port, int* fds, const size_t total_fds) {
+	/*
+	Makes 127.0.0.2:port swallow new connection attempts: it listens, but its accept queue is full
+	and never drained, so further SYNs go unanswered.
+	*/
+	
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(0x7F000002)
+	};
+	
+	const int fd = socket(AF_INET, SOCK_STREAM, 0);
+	
+	if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(fd, 0) != 0) {
+		return -1;
+	}
+	
+	for (size_t index = 0; index < total_fds; index++) {
+		fds[index] = socket(AF_INET, SOCK_STREAM, 0);
+		fcntl(fds[index], F_SETFL, O_NONBLOCK);
+		
+		connect(fds[index], (struct sockaddr*) &addr, sizeof(addr));
+		
+		struct pollfd pfd = {.fd = fds[index], .events = POLLOUT};
+		
+		if (poll(&pfd, 1, 200) == 0) {
+			return fd;
+		}
+	}
+	
+	return -1;
+	
+}
+
+static size_t total_callbacks = 0;
+
+static void metrics_callback(const struct unalix_request_metrics* metrics, void* userdata) {
+	
+	assert (userdata == &total_callbacks);
+	assert (strcmp(metrics->hostname, "127.0.0.1") == 0);
+	assert (metrics->phases[UNALIX_PHASE_REQUEST] >= metrics->phases[UNALIX_PHASE_FIRST_BYTE]);
+	assert (metrics->phases[UNALIX_PHASE_TLS] == 0);
+	assert (metrics->phases[UNALIX_PHASE_UNSHORT] == 0);
+	
+	if (metrics->code == UNALIXERR_SUCCESS) {
+		assert (metrics->phases[UNALIX_PHASE_FIRST_BYTE] > 0);
+		assert (metrics->bytes_received > 0);
+		assert (metrics->bytes_sent > 0);
+	}
+	
+	total_callbacks++;
+	
+}
+
+static long long elapsed_ms(const struct timespec start) {
+	
+	struct timespec now = {0};
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	
+	return (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+	
+}
+
+int main() {
+	
+	int code = 0;
+	
+	char* target_url = NULL;
+	char source_url[64];
+	char expected_url[64];
+	
+	code = unalix_load_file("./test/rulesets/rulesets.json");
+	assert (code == UNALIXERR_SUCCESS);
+	
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+	};
+	socklen_t addr_size = sizeof(addr);
+	
+	server_fd = socket(AF_INET, SOCK_STREAM, 0);
+	assert (bind(server_fd, (struct sockaddr*) &addr, sizeof(addr)) == 0);
+	assert (getsockname(server_fd, (struct sockaddr*) &addr, &addr_size) == 0);
+	assert (listen(server_fd, 8) == 0);
+	
+	port = ntohs(addr.sin_port);
+	
+	pthread_t thread;
+	pthread_create(&thread, NULL, serve, NULL);
+	
+	// The body of the final hop is never downloaded
+	snprintf(source_url, sizeof(source_url), "http://127.0.0.1:%i/start", port);
+	snprintf(expected_url, sizeof(expected_url), "http://127.0.0.1:%i/big", port);
+	
+	code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, expected_url) == 0);
+	assert (total_get_requests == 2);
+	
+	free(target_url);
+	target_url = NULL;
+	
+	// HEAD falls back to GET for hosts that reject it, and the fallback is remembered
+	unalix_unshort_use_head(1);
+	
+	snprintf(source_url, sizeof(source_url), "http://127.0.0.1:%i/nohead", port);
+	snprintf(expected_url, sizeof(expected_url), "http://127.0.0.1:%i/final", port);
+	
+	total_head_requests = 0;
+	total_get_requests = 0;
+	
+	code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, expected_url) == 0);
+	assert (total_head_requests == 1);
+	assert (total_get_requests == 2);
+	
+	free(target_url);
+	target_url = NULL;
+	
+	code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, expected_url) == 0);
+	assert (total_head_requests == 1);
+	assert (total_get_requests == 4);
+	
+	free(target_url);
+	target_url = NULL;
+	
+	unalix_unshort_use_head(0);
+	
+	assert (big_body_sent < BIG_BODY_SIZE);
+	
+	// Persistent cache
+	char filename[] = "/tmp/unalix_url_cache_XXXXXX";
+	close(mkstemp(filename));
+	remove(filename);
+	
+	code = unalix_url_cache_open(filename, 64, 60);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	snprintf(source_url, sizeof(source_url), "http://127.0.0.1:%i/start", port);
+	snprintf(expected_url, sizeof(expected_url), "http://127.0.0.1:%i/big", port);
+	
+	total_get_requests = 0;
+	
+	code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, expected_url) == 0);
+	assert (total_get_requests == 2);
+	
+	code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, expected_url) == 0);
+	assert (total_get_requests == 2);
+	
+	// Different cleaning options don't share entries
+	code = unalix_unshort_url(source_url, &target_url, 1, 0, 0, 0, 0, 0, 0, NULL, 5);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (total_get_requests == 4);
+	
+	// Chains sharing a tail stop at the first known hop
+	snprintf(source_url, sizeof(source_url), "http://127.0.0.1:%i/other", port);
+	
+	code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, expected_url) == 0);
+	assert (total_get_requests == 5);
+	
+	free(target_url);
+	target_url = NULL;
+	
+	unalix_url_cache_close();
+	
+	// Other processes see the same entries
+	const pid_t pid = fork();
+	
+	if (pid == 0) {
+		if (unalix_url_cache_open(filename, 0, 0) != UNALIXERR_SUCCESS) {
+			_exit(1);
+		}
+		
+		snprintf(source_url, sizeof(source_url), "http://127.0.0.1:%i/start", port);
+		
+		code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+		
+		_exit(code == UNALIXERR_SUCCESS && strcmp(target_url, expected_url) == 0 ? 0 : 1);
+	}
+	
+	int status = 0;
+	waitpid(pid, &status, 0);
+	
+	assert (WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	assert (total_get_requests == 5);
+	
+	remove(filename);
+	
+	// Addresses that never answer don't hold up the ones that do
+	int blackhole_fds[16] = {0};
+	const int blackhole_fd = blackhole(port, blackhole_fds, sizeof(blackhole_fds) / sizeof(*blackhole_fds));
+	
+	if (blackhole_fd != -1) {
+		const char* const addresses[] = {"127.0.0.2", "127.0.0.1"};
+		
+		code = unalix_dns_cache_add("eyeballs.test", addresses, 2, 60);
+		assert (code == UNALIXERR_SUCCESS);
+		
+		code = unalix_dns_cache_add("blackhole.test", addresses, 1, 60);
+		assert (code == UNALIXERR_SUCCESS);
+		
+		struct timespec start = {0};
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		
+		snprintf(source_url, sizeof(source_url), "http://eyeballs.test:%i/final", port);
+		
+		code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+		assert (code == UNALIXERR_SUCCESS);
+		assert (strcmp(target_url, source_url) == 0);
+		assert (elapsed_ms(start) < 2000);
+		
+		free(target_url);
+		target_url = NULL;
+		
+		// A failed attempt starts the next one without waiting out the delay
+		const char* const staggered[] = {"127.0.0.2", "127.0.0.3", "127.0.0.1"};
+		
+		code = unalix_dns_cache_add("staggered.test", staggered, 3, 60);
+		assert (code == UNALIXERR_SUCCESS);
+		
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		
+		snprintf(source_url, sizeof(source_url), "http://staggered.test:%i/final", port);
+		
+		code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+		assert (code == UNALIXERR_SUCCESS);
+		assert (strcmp(target_url, source_url) == 0);
+		assert (elapsed_ms(start) < 450);
+		
+		free(target_url);
+		target_url = NULL;
+		
+		// The timeout is a deadline, not a per-syscall limit
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		
+		snprintf(source_url, sizeof(source_url), "http://blackhole.test:%i/final", port);
+		
+		code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 1);
+		assert (code == UNALIXERR_SOCKET_TIMEOUT);
+		assert (elapsed_ms(start) < 2000);
+		
+		free(target_url);
+		target_url = NULL;
+		
+		close(blackhole_fd);
+	}
+	
+	// Only known shorteners are probed
+	const char* const loopback[] = {"127.0.0.1"};
+	
+	assert (unalix_dns_cache_add("sho.rt", loopback, 1, 60) == UNALIXERR_SUCCESS);
+	assert (unalix_dns_cache_add("www.sho.rt", loopback, 1, 60) == UNALIXERR_SUCCESS);
+	assert (unalix_dns_cache_add("final.test", loopback, 1, 60) == UNALIXERR_SUCCESS);
+	
+	const char* const shorteners[] = {"sho.rt", "example.com"};
+	
+	code = unalix_unshort_policy_set_hosts(shorteners, 2);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	snprintf(expected_url, sizeof(expected_url), "http://final.test:%i/final", port);
+	
+	const char* const via_shortener[] = {"http://sho.rt:%i/away", "http://www.sho.rt:%i/away"};
+	
+	for (size_t index = 0; index < sizeof(via_shortener) / sizeof(*via_shortener); index++) {
+		snprintf(source_url, sizeof(source_url), via_shortener[index], port);
+		
+		total_get_requests = 0;
+		
+		code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+		assert (code == UNALIXERR_SUCCESS);
+		assert (strcmp(target_url, expected_url) == 0);
+		assert (total_get_requests == 1);
+	}
+	
+	snprintf(source_url, sizeof(source_url), "http://127.0.0.1:%i/start", port);
+	
+	code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, source_url) == 0);
+	assert (total_get_requests == 1);
+	
+	code = unalix_unshort_policy_set_hosts(NULL, 0);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	// Hosts that answered without redirecting are not asked again
+	code = unalix_unshort_policy_learn(16, 60);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	snprintf(source_url, sizeof(source_url), "http://sho.rt:%i/away", port);
+	
+	total_get_requests = 0;
+	
+	code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, expected_url) == 0);
+	assert (total_get_requests == 2);
+	
+	code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, expected_url) == 0);
+	assert (total_get_requests == 3);
+	
+	code = unalix_unshort_url(expected_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, expected_url) == 0);
+	assert (total_get_requests == 3);
+	
+	// Errors are not learned...
+	snprintf(source_url, sizeof(source_url), "http://sho.rt:%i/gone", port);
+	
+	for (size_t index = 0; index < 2; index++) {
+		code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+		assert (code == UNALIXERR_SUCCESS);
+		assert (strcmp(target_url, source_url) == 0);
+	}
+	
+	assert (total_get_requests == 5);
+	
+	// ...and neither are known shorteners, even when they answer without redirecting
+	code = unalix_unshort_policy_set_hosts(shorteners, 2);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	snprintf(source_url, sizeof(source_url), "http://www.sho.rt:%i/final", port);
+	
+	for (size_t index = 0; index < 2; index++) {
+		code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+		assert (code == UNALIXERR_SUCCESS);
+		assert (strcmp(target_url, source_url) == 0);
+	}
+	
+	assert (total_get_requests == 7);
+	
+	code = unalix_unshort_policy_set_hosts(NULL, 0);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = unalix_unshort_policy_learn(0, 0);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	free(target_url);
+	target_url = NULL;
+	
+	// Metrics
+	struct unalix_metrics metrics = {0};
+	
+	unalix_metrics_set_callback(metrics_callback, &total_callbacks);
+	unalix_metrics_enable(1);
+	
+	snprintf(source_url, sizeof(source_url), "http://127.0.0.1:%i/start", port);
+	snprintf(expected_url, sizeof(expected_url), "http://127.0.0.1:%i/big", port);
+	
+	code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (strcmp(target_url, expected_url) == 0);
+	
+	unalix_metrics_snapshot(&metrics);
+	
+	assert (metrics.requests == 2);
+	assert (metrics.connections_opened == 2);
+	assert (metrics.tls_handshakes == 0);
+	assert (metrics.redirects_followed == 1);
+	assert (metrics.unshorts == 1);
+	assert (metrics.unshorts_failed == 0);
+	assert (metrics.bytes_received > 0 && metrics.bytes_sent > 0);
+	assert (metrics.phase_count[UNALIX_PHASE_DNS] == 2);
+	assert (metrics.phase_count[UNALIX_PHASE_CONNECT] == 2);
+	assert (metrics.phase_count[UNALIX_PHASE_TLS] == 0);
+	assert (metrics.phase_count[UNALIX_PHASE_FIRST_BYTE] == 2);
+	assert (metrics.phase_count[UNALIX_PHASE_REQUEST] == 2);
+	assert (metrics.phase_count[UNALIX_PHASE_UNSHORT] == 1);
+	assert (metrics.phase_total[UNALIX_PHASE_UNSHORT] >= metrics.phase_total[UNALIX_PHASE_REQUEST]);
+	assert (total_callbacks == 2);
+	
+	for (size_t phase = 0; phase < UNALIX_TOTAL_PHASES; phase++) {
+		unsigned long long total = 0;
+		
+		for (size_t bucket = 0; bucket < UNALIX_METRICS_TOTAL_BUCKETS; bucket++) {
+			total += metrics.histogram[phase][bucket];
+		}
+		
+		assert (total == metrics.phase_count[phase]);
+	}
+	
+	// Errors are counted by code
+	code = unalix_unshort_url("http://127.0.0.1:1/", &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+	assert (code != UNALIXERR_SUCCESS);
+	
+	unalix_metrics_snapshot(&metrics);
+	
+	assert (metrics.requests == 3);
+	assert (metrics.errors[-code] == 1);
+	assert (metrics.unshorts_failed == 1);
+	assert (total_callbacks == 3);
+	
+	// Nothing is recorded while disabled
+	unalix_metrics_enable(0);
+	unalix_metrics_reset();
+	
+	code = unalix_unshort_url(source_url, &target_url, 0, 0, 0, 0, 0, 0, 0, NULL, 5);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	unalix_metrics_snapshot(&metrics);
+	
+	assert (metrics.requests == 0 && metrics.connections_opened == 0 && metrics.bytes_received == 0);
+	assert (total_callbacks == 3);
+	
+	unalix_metrics_set_callback(NULL, NULL);
+	
+	free(target_url);
+	target_url = NULL;
+	
+	// Concurrent calls for the same URL are resolved once
+	snprintf(expected_url, sizeof(expected_url), "http://127.0.0.1:%i/final", port);
+	
+	struct Unshort items[8] = {0};
+	const size_t total_items = sizeof(items) / sizeof(*items);
+	
+	for (size_t index = 0; index < total_items; index++) {
+		snprintf(items[index].source_url, sizeof(items[index].source_url), "http://127.0.0.1:%i/slow", port);
+	}
+	
+	unshort_concurrently(items, total_items);
+	
+	for (size_t index = 0; index < total_items; index++) {
+		assert (items[index].code == UNALIXERR_SUCCESS);
+		assert (strcmp(items[index].target_url, expected_url) == 0);
+		
+		free(items[index].target_url);
+		items[index].target_url = NULL;
+	}
+	
+	assert (total_slow_requests == 1);
+	
+	// So are hops shared by different chains
+	for (size_t index = 0; index < total_items; index++) {
+		snprintf(items[index].source_url, sizeof(items[index].source_url), "http://127.0.0.1:%i/fan-%zu", port, index);
+	}
+	
+	unshort_concurrently(items, total_items);
+	
+	for (size_t index = 0; index < total_items; index++) {
+		assert (items[index].code == UNALIXERR_SUCCESS);
+		assert (strcmp(items[index].target_url, expected_url) == 0);
+		
+		free(items[index].target_url);
+	}
+	
+	assert (total_slow_requests == 2);
+	
+	shutdown(server_fd, SHUT_RDWR);
+	close(server_fd);
+	pthread_join(thread, NULL);
+	
+	return 0;
+	
+}
@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "unalix.h"
+#include "url_cache.h"
+#include "errors.h"
+
+static const size_t TOTAL_SLOTS = 64;
+
+static void expect(const char* const url, const char* const expected_url) {
+	
+	char* target_url = NULL;
+	
+	const int code = url_cache_get(url, 0, &target_url);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (target_url != NULL && strcmp(target_url, expected_url) == 0);
+	
+	free(target_url);
+	
+}
+
+static void set_sequences(const char* const filename, const uint32_t sequence) {
+	
+	const int fd = open(filename, O_RDWR);
+	assert (fd != -1);
+	
+	for (size_t index = 0; index < TOTAL_SLOTS; index++) {
+		const off_t offset = (off_t) (sizeof(struct URLCacheHeader) + sizeof(struct URLCacheSlot) * index + offsetof(struct URLCacheSlot, sequence));
+		assert (pwrite(fd, &sequence, sizeof(sequence), offset) == sizeof(sequence));
+	}
+	
+	close(fd);
+	
+}
+
+int main() {
+	
+	int code = 0;
+	
+	char filename[] = "/tmp/unalix_url_cache_XXXXXX";
+	close(mkstemp(filename));
+	remove(filename);
+	
+	code = unalix_url_cache_open(filename, TOTAL_SLOTS, 60);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	url_cache_put("https://short.test/a", 0, "https://example.com/a");
+	expect("https://short.test/a", "https://example.com/a");
+	
+	char* target_url = NULL;
+	
+	code = url_cache_get("https://short.test/b", 0, &target_url);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (target_url == NULL);
+	
+	unalix_url_cache_close();
+	
+	// Every slot as a writer killed halfway through a store would have left it
+	set_sequences(filename, 7);
+	
+	code = unalix_url_cache_open(filename, 0, 0);
+	assert (code == UNALIXERR_SUCCESS);
+	
+	code = url_cache_get("https://short.test/a", 0, &target_url);
+	assert (code == UNALIXERR_SUCCESS);
+	assert (target_url == NULL);
+	
+	url_cache_put("https://short.test/a", 0, "https://example.com/a");
+	expect("https://short.test/a", "https://example.com/a");
+	
+	url_cache_put("https://short.test/a", 0, "https://example.com/b");
+	expect("https://short.test/a", "https://example.com/b");
+	
+	url_cache_put("https://short.test/c", 0, "https://example.com/c");
+	expect("https://short.test/c", "https://example.com/c");
+	
+	unalix_url_cache_close();
+	
+	remove(filename);
+	
+	return 0;
+	
+}
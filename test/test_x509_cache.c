@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include <bearssl.h>
+
+#include "unalix.h"
+#include "x509_cache.h"
+#include "errors.h"
+
+/*
+test/certificates holds a P-256 test CA and a "localhost" certificate issued by it, both valid
+for 100 years and stored as DER.
+*/
+
+struct Certificate {
+	unsigned char data[2048];
+	size_t size;
+};
+
+struct DistinguishedName {
+	unsigned char data[512];
+	size_t size;
+};
+
+static void certificate_load(struct Certificate* obj, const char* const filename) {
+	
+	FILE* const file = fopen(filename, "rb");
+	assert(file != NULL);
+	
+	obj->size = fread(obj->data, 1, sizeof(obj->data), file);
+	assert(obj->size > 0);
+	
+	fclose(file);
+	
+}
+
+static void dn_append(void* userdata, const void* buffer, size_t size) {
+	
+	struct DistinguishedName* const dn = (struct DistinguishedName*) userdata;
+	
+	assert(dn->size + size <= sizeof(dn->data));
+	
+	memcpy(dn->data + dn->size, buffer, size);
+	dn->size += size;
+	
+}
+
+static unsigned validate(
+	const br_x509_trust_anchor* anchors,
+	const size_t total_anchors,
+	const struct Certificate* const* chain,
+	const size_t chain_size,
+	const char* const server_name,
+	int* cached
+) {
+	
+	br_x509_minimal_context xc = {0};
+	br_x509_minimal_init_full(&xc, anchors, total_anchors);
+	
+	struct X509CacheContext ctx;
+	x509_cache_init(&ctx, &xc);
+	
+	const br_x509_class** const engine = &ctx.vtable;
+	
+	ctx.vtable->start_chain(engine, server_name);
+	
+	for (size_t index = 0; index < chain_size; index++) {
+		const struct Certificate* const certificate = chain[index];
+		
+		ctx.vtable->start_cert(engine, (uint32_t) certificate->size);
+		
+		// Mimic the SSL engine, which hands certificates over in small pieces
+		for (size_t offset = 0; offset < certificate->size; offset += 100) {
+			const size_t size = (certificate->size - offset) < 100 ? certificate->size - offset : 100;
+			ctx.vtable->append(engine, certificate->data + offset, size);
+		}
+		
+		ctx.vtable->end_cert(engine);
+	}
+	
+	const unsigned code = ctx.vtable->end_chain(engine);
+	
+	if (code == 0) {
+		unsigned usages = 0;
+		const br_x509_pkey* const pkey = ctx.vtable->get_pkey(engine, &usages);
+		
+		assert(pkey != NULL);
+		assert(pkey->key_type == BR_KEYTYPE_EC);
+		assert(pkey->key.ec.curve == BR_EC_secp256r1);
+		assert((usages & BR_KEYTYPE_SIGN) != 0);
+	}
+	
+	*cached = ctx.cached;
+	
+	x509_cache_free(&ctx);
+	
+	return code;
+	
+}
+
+int main(void) {
+	
+	struct Certificate ca = {0};
+	struct Certificate leaf = {0};
+	
+	certificate_load(&ca, "./test/certificates/ca.der");
+	certificate_load(&leaf, "./test/certificates/localhost.der");
+	
+	struct DistinguishedName dn = {0};
+	
+	br_x509_decoder_context decoder;
+	br_x509_decoder_init(&decoder, dn_append, &dn);
+	br_x509_decoder_push(&decoder, ca.data, ca.size);
+	
+	const br_x509_pkey* const ca_pkey = br_x509_decoder_get_pkey(&decoder);
+	assert(ca_pkey != NULL);
+	
+	const br_x509_trust_anchor anchor = {
+		.dn = {
+			.data = dn.data,
+			.len = dn.size
+		},
+		.flags = BR_X509_TA_CA,
+		.pkey = *ca_pkey
+	};
+	
+	const struct Certificate* const chain[] = {&leaf, &ca};
+	const size_t chain_size = sizeof(chain) / sizeof(*chain);
+	
+	int cached = 0;
+	
+	// Disabled by default
+	assert(validate(&anchor, 1, chain, chain_size, "localhost", &cached) == 0);
+	assert(!cached);
+	
+	assert(validate(NULL, 0, chain, chain_size, "localhost", &cached) == BR_ERR_X509_NOT_TRUSTED);
+	
+	assert(unalix_certificate_cache_configure(16) == UNALIXERR_SUCCESS);
+	
+	// A chain that fails validation is not remembered
+	struct Certificate tampered = leaf;
+	tampered.data[tampered.size - 1] ^= 0x01;
+	
+	const struct Certificate* const tampered_chain[] = {&tampered, &ca};
+	
+	assert(validate(&anchor, 1, tampered_chain, chain_size, "localhost", &cached) != 0);
+	assert(validate(&anchor, 1, tampered_chain, chain_size, "localhost", &cached) != 0);
+	assert(!cached);
+	
+	// The first validation goes through the full engine; the second one does not
+	assert(validate(&anchor, 1, chain, chain_size, "localhost", &cached) == 0);
+	assert(!cached);
+	
+	assert(validate(&anchor, 1, chain, chain_size, "localhost", &cached) == 0);
+	assert(cached);
+	
+	// No signature is checked on a hit, so not even a trust anchor is needed
+	assert(validate(NULL, 0, chain, chain_size, "localhost", &cached) == 0);
+	assert(cached);
+	
+	// The server name is part of the key
+	assert(validate(NULL, 0, chain, chain_size, "example.com", &cached) != 0);
+	assert(!cached);
+	
+	assert(validate(&anchor, 1, chain, chain_size, "example.com", &cached) == BR_ERR_X509_BAD_SERVER_NAME);
+	
+	// So is the whole chain
+	assert(validate(NULL, 0, chain, 1, "localhost", &cached) != 0);
+	
+	assert(unalix_certificate_cache_configure(0) == UNALIXERR_SUCCESS);
+	
+	assert(validate(NULL, 0, chain, chain_size, "localhost", &cached) == BR_ERR_X509_NOT_TRUSTED);
+	assert(!cached);
+	
+	return 0;
+	
+}
@@ -0,0 +1,353 @@
+#!/usr/bin/env python3
+
+"""
+Compiles a ClearURLs ruleset into C source, to be linked into the library as a "frozen" ruleset
+(see src/frozen.h and the UNALIX_FROZEN_RULESET CMake option).
+
+Besides the patterns themselves, it generates:
+
+- A perfect hash table from host labels to the providers whose URL pattern requires that label,
+  so that only those providers are tried against a URL
+- For rules and referral marketing rules that are plain parameter names, a perfect hash set of
+  those names per provider; they are stripped without PCRE2, and skipped altogether when none of
+  the names occurs in the URL
+
+usage: ruleset.c.py <rulesets.json> <output.c> [symbol]
+"""
+
+import json
+import re
+import sys
+
+PREFIX_PROVIDER_IGNORE = "ClearURLsTest"
+
+ARRAY_KEYS = (
+	"rules",
+	"rawRules",
+	"referralMarketing",
+	"exceptions",
+	"redirections"
+)
+
+# Lists whose entries match parameter names (see PREFIX_EXTENDED_PATTERN in src/ruleset.c)
+PARAMETER_KEYS = ("rules", "referralMarketing")
+
+SCHEME_PREFIX = "^https?:\\/\\/"
+
+# Prefixes that may only consume whole host labels, each followed by a dot
+SUBDOMAIN_PREFIXES = (
+	"(?:[a-z0-9-]+\\.)*?",
+	"(?:[a-z0-9-]+\\.)*",
+	"(?:[a-z0-9-]+\\.)+?",
+	"(?:[a-z0-9-]+\\.)+",
+	"(?:[a-z0-9-]+\\.)?",
+	"([a-z0-9-]+\\.)*?",
+	"([a-z0-9-]+\\.)*",
+	"(?:www\\.)?",
+	""
+)
+
+# What may follow a host label for it to end right there
+HOST_LABEL_SUFFIXES = (
+	"\\.",
+	"(?:\\.",
+	"\\/",
+	"(?:\\/",
+	"\\?",
+	":"
+)
+
+HOST_LABEL = re.compile(pattern = "[a-z0-9-]+")
+LITERAL_RULE = re.compile(pattern = "(?:[A-Za-z0-9_-]|\\\\\\.)+")
+CASELESS_FLAG = re.compile(pattern = "\\(\\?[a-zA-Z^-]*i")
+
+# Must match PARAMETER_MAX_NAME_LENGTH in src/parameter_filter.h
+MAX_LITERAL_LENGTH = 63
+
+FNV_OFFSET_BASIS = 2166136261
+FNV_PRIME = 16777619
+
+def has_top_level_alternation(pattern):
+
+	depth = 0
+	index = 0
+	in_class = False
+
+	while index < len(pattern):
+		character = pattern[index]
+
+		if character == "\\":
+			index += 2
+			continue
+
+		if in_class:
+			if character == "]":
+				in_class = False
+		elif character == "[":
+			in_class = True
+		elif character == "(":
+			depth += 1
+		elif character == ")":
+			depth -= 1
+		elif character == "|" and depth == 0:
+			return True
+
+		index += 1
+
+	return False
+
+def get_host_label(url_pattern):
+	"""
+	Returns the host label every URL matching url_pattern must have, or None if that cannot be
+	told for sure. The runtime splits the authority on dots, colons and at signs, so the label must be
+	bounded by those (or by the end of the authority) on both sides.
+	"""
+
+	if not url_pattern.startswith(SCHEME_PREFIX):
+		return None
+
+	if has_top_level_alternation(pattern = url_pattern) or CASELESS_FLAG.search(url_pattern):
+		return None
+
+	rest = url_pattern[len(SCHEME_PREFIX):]
+
+	for prefix in SUBDOMAIN_PREFIXES:
+		if not rest.startswith(prefix):
+			continue
+
+		remainder = rest[len(prefix):]
+		match = HOST_LABEL.match(remainder)
+
+		if match is None:
+			return None
+
+		if remainder[match.end():].startswith(HOST_LABEL_SUFFIXES):
+			return match.group()
+
+		return None
+
+	return None
+
+def get_literal(rule):
+	"""
+	Returns the parameter name a rule matches, if it matches nothing but that name.
+	"""
+
+	if LITERAL_RULE.fullmatch(rule) is None:
+		return None
+
+	literal = rule.replace("\\.", ".")
+
+	if len(literal) > MAX_LITERAL_LENGTH:
+		return None
+
+	return literal
+
+def frozen_hash(key, seed):
+	"""
+	Must match frozen_hash() in src/frozen.c.
+	"""
+
+	value = (FNV_OFFSET_BASIS ^ seed) & 0xffffffff
+
+	for byte in key.encode():
+		value ^= byte
+		value = (value * FNV_PRIME) & 0xffffffff
+
+	value ^= value >> 16
+
+	return value
+
+def build_set(keys):
+	"""
+	Builds a perfect hash set (hash and displace) of keys. Returns the displacements and the slots.
+	"""
+
+	keys = sorted(set(keys))
+
+	if not keys:
+		return ([0], [None])
+
+	total_slots = len(keys) + len(keys) // 4 + 1
+	total_buckets = (len(keys) + 3) // 4
+
+	buckets = [[] for _ in range(total_buckets)]
+
+	for key in keys:
+		buckets[frozen_hash(key = key, seed = 0) % total_buckets].append(key)
+
+	displacements = [0] * total_buckets
+	slots = [None] * total_slots
+
+	for bucket in sorted(range(total_buckets), key = lambda index: -len(buckets[index])):
+		items = buckets[bucket]
+
+		if not items:
+			continue
+
+		displacement = 1
+
+		while True:
+			positions = [frozen_hash(key = key, seed = displacement) % total_slots for key in items]
+
+			if len(set(positions)) == len(positions) and all(slots[position] is None for position in positions):
+				break
+
+			displacement += 1
+
+		displacements[bucket] = displacement
+
+		for key, position in zip(items, positions):
+			slots[position] = key
+
+	return (displacements, slots)
+
+def c_string(value):
+
+	if value is None:
+		return "NULL"
+
+	content = ""
+
+	for byte in value.encode():
+		character = chr(byte)
+
+		if character in ("\\", "\""):
+			content += "\\" + character
+		elif character == "?" and content.endswith("?"):
+			# Would risk forming a trigraph
+			content += "\\077"
+		elif 0x20 <= byte < 0x7f:
+			content += character
+		else:
+			# Octal escapes cannot swallow the characters that follow
+			content += "\\%03o" % byte
+
+	return "\"%s\"" % content
+
+def c_array(kind, name, values):
+
+	if not values:
+		values = ["0"] if kind == "uint32_t" else ["NULL"]
+
+	return "static const %s %s[] = {\n\t%s\n};\n" % (kind, name, ",\n\t".join(values))
+
+def c_set(name, keys):
+	"""
+	Emits the tables of a set, and returns the initializer of its struct FrozenSet.
+	"""
+
+	(displacements, slots) = build_set(keys = keys)
+
+	lengths = 0
+
+	for key in keys:
+		lengths |= 1 << len(key)
+
+	source = c_array("uint32_t", "%s_DISPLACEMENTS" % name, [str(value) for value in displacements])
+	source += c_array("char* const", "%s_SLOTS" % name, [c_string(value = value) for value in slots])
+
+	initializer = "{%i, %i, %s_DISPLACEMENTS, %s_SLOTS, UINT64_C(%i)}" % (len(displacements), len(slots), name, name, lengths)
+
+	return (source, initializer)
+
+def load_providers(tree):
+	"""
+	Same selection as load_ruleset() in src/ruleset.c.
+	"""
+
+	providers = []
+
+	for (name, value) in tree["providers"].items():
+		if name.startswith(PREFIX_PROVIDER_IGNORE):
+			continue
+
+		if value.get("completeProvider"):
+			continue
+
+		provider = {
+			"urlPattern": value["urlPattern"]
+		}
+
+		for key in ARRAY_KEYS:
+			provider[key] = value.get(key) or []
+
+		providers.append(provider)
+
+	return providers
+
+def generate(providers, source_name, symbol):
+
+	source = "/*\nGenerated by tool/ruleset.c.py from %s. Do not edit.\n*/\n\n" % source_name
+	source += "#include <stddef.h>\n#include <stdint.h>\n\n#include \"frozen.h\"\n\n"
+
+	initializers = []
+	hosts = {}
+
+	for (index, provider) in enumerate(providers):
+		lists = []
+
+		for (position, key) in enumerate(ARRAY_KEYS):
+			name = "PROVIDER_%i_LIST_%i" % (index, position)
+			patterns = provider[key]
+
+			literals = [get_literal(rule = pattern) if key in PARAMETER_KEYS else None for pattern in patterns]
+			all_literal = bool(patterns) and all(literal is not None for literal in literals)
+
+			source += c_array("char* const", "%s_PATTERNS" % name, [c_string(value = pattern) for pattern in patterns])
+			source += c_array("char* const", "%s_LITERALS" % name, [c_string(value = literal) for literal in literals])
+
+			(set_source, set_initializer) = c_set(name = "%s_SET" % name, keys = [literal for literal in literals if literal is not None] if all_literal else [])
+			source += set_source
+
+			lists.append("{%i, %s_PATTERNS, %s_LITERALS, %i, %s}" % (len(patterns), name, name, all_literal, set_initializer))
+
+		host = get_host_label(url_pattern = provider["urlPattern"])
+
+		if host is not None:
+			hosts.setdefault(host, []).append(index)
+
+		initializers.append("{\n\t\t%s,\n\t\t%s,\n\t\t{\n\t\t\t%s\n\t\t}\n\t}" % (c_string(value = provider["urlPattern"]), c_string(value = host), ",\n\t\t\t".join(lists)))
+		source += "\n"
+
+	source += c_array("struct FrozenProvider", "PROVIDERS", initializers)
+	source += "\n"
+
+	(hosts_source, hosts_initializer) = c_set(name = "HOSTS", keys = list(hosts))
+	source += hosts_source
+
+	(displacements, slots) = build_set(keys = list(hosts))
+
+	offsets = [0]
+	host_providers = []
+
+	for slot in slots:
+		host_providers.extend(hosts.get(slot, []))
+		offsets.append(len(host_providers))
+
+	source += c_array("uint32_t", "HOST_OFFSETS", [str(value) for value in offsets])
+	source += c_array("uint32_t", "HOST_PROVIDERS", [str(value) for value in host_providers])
+	source += "\n"
+
+	source += "const struct FrozenRuleset %s = {\n\t%i,\n\tPROVIDERS,\n\t%s,\n\tHOST_OFFSETS,\n\tHOST_PROVIDERS\n};\n" % (symbol, len(providers), hosts_initializer)
+
+	return source
+
+if len(sys.argv) not in (3, 4):
+	print(__doc__.strip().splitlines()[-1], file = sys.stderr)
+	sys.exit(1)
+
+input_filename = sys.argv[1]
+output_filename = sys.argv[2]
+
+# Tests link a ruleset of their own under a different name
+symbol = sys.argv[3] if len(sys.argv) == 4 else "FROZEN_RULESET"
+
+with open(file = input_filename, mode = "r", encoding = "utf-8") as file:
+	tree = json.load(fp = file)
+
+providers = load_providers(tree = tree)
+content = generate(providers = providers, source_name = input_filename.replace("\\", "/").split("/")[-1], symbol = symbol)
+
+with open(file = output_filename, mode = "w", encoding = "utf-8") as file:
+	file.write(content)
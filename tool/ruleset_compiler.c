@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "unalix.h"
+#include "errors.h"
+#include "ruleset.h"
+#include "ruleset_segment.h"
+
+/*
+Loads a ClearURLs ruleset and writes its compiled form (a ruleset segment, see src/ruleset_segment.h)
+as C source, to be linked into the library as its builtin ruleset (see the UNALIX_BUILTIN_RULESET
+CMake option). The ruleset is therefore validated at build time.
+
+usage: ruleset_compiler <rulesets.json> <output.c> [symbol]
+*/
+
+static const char DEFAULT_SYMBOL[] = "BUILTIN_RULESET";
+
+// Bytes written per line of the array
+static const size_t BYTES_PER_LINE = 16;
+
+static int write_source(FILE* file, const char* const symbol, const unsigned char* const segment, const size_t segment_size) {
+	
+	fprintf(file, "/*\nGenerated by tool/ruleset_compiler.c. Do not edit.\n*/\n\n");
+	fprintf(file, "#include <stddef.h>\n#include <stdint.h>\n\n");
+	
+	// Code blocks are read in place before being copied, so they need their natural alignment
+	fprintf(file, "static const union {\n\tuint64_t alignment;\n\tunsigned char bytes[%zu];\n} SEGMENT = {\n\t.bytes = {", segment_size);
+	
+	for (size_t index = 0; index < segment_size; index++) {
+		if (index % BYTES_PER_LINE == 0) {
+			fprintf(file, "\n\t\t");
+		}
+		
+		fprintf(file, "0x%02x,", segment[index]);
+	}
+	
+	fprintf(file, "\n\t}\n};\n\n");
+	fprintf(file, "const unsigned char* const %s = SEGMENT.bytes;\n", symbol);
+	fprintf(file, "const size_t %s_SIZE = %zu;\n", symbol, segment_size);
+	
+	return ferror(file) ? UNALIXERR_FILE_CANNOT_WRITE : UNALIXERR_SUCCESS;
+	
+}
+
+int main(int argc, char* argv[]) {
+	
+	if (argc != 3 && argc != 4) {
+		fprintf(stderr, "usage: %s <rulesets.json> <output.c> [symbol]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	
+	const char* const symbol = (argc == 4) ? argv[3] : DEFAULT_SYMBOL;
+	
+	int code = unalix_load_file(argv[1]);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		fprintf(stderr, "%s: %s\n", argv[1], unalix_strerror(code));
+		return EXIT_FAILURE;
+	}
+	
+	const struct Rulesets* const rulesets = rulesets_acquire();
+	
+	if (rulesets->offset < 1) {
+		fprintf(stderr, "%s: %s\n", argv[1], unalix_strerror(UNALIXERR_RULESETS_EMPTY));
+		return EXIT_FAILURE;
+	}
+	
+	unsigned char* segment = NULL;
+	size_t segment_size = 0;
+	
+	code = ruleset_segment_encode(rulesets, &segment, &segment_size);
+	
+	rulesets_release(rulesets);
+	
+	if (code != UNALIXERR_SUCCESS) {
+		fprintf(stderr, "%s: %s\n", argv[1], unalix_strerror(code));
+		return EXIT_FAILURE;
+	}
+	
+	FILE* file = fopen(argv[2], "w");
+	
+	if (file == NULL) {
+		free(segment);
+		fprintf(stderr, "%s: %s\n", argv[2], unalix_strerror(UNALIXERR_FILE_CANNOT_OPEN));
+		return EXIT_FAILURE;
+	}
+	
+	code = write_source(file, symbol, segment, segment_size);
+	
+	if (fclose(file) != 0 && code == UNALIXERR_SUCCESS) {
+		code = UNALIXERR_FILE_CANNOT_WRITE;
+	}
+	
+	free(segment);
+	unalix_unload_rulesets();
+	
+	if (code != UNALIXERR_SUCCESS) {
+		remove(argv[2]);
+		fprintf(stderr, "%s: %s\n", argv[2], unalix_strerror(code));
+		return EXIT_FAILURE;
+	}
+	
+	return EXIT_SUCCESS;
+	
+}